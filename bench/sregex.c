@@ -13,11 +13,22 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
+
+
+typedef struct {
+    sre_program_t       *prog;
+    unsigned             engine_types;
+    sre_uint_t           ncaps;
+    sre_char            *input;
+    size_t               len;
+} run_args_t;
 
 
 static void usage(int rc);
 static void run_engines(sre_program_t *prog, unsigned engine_types,
     sre_uint_t ncaps, sre_char *input, size_t len);
+static void *run_engines_thread(void *data);
 static void alloc_error(void);
 sre_int_t run_jitted_thompson(sre_vm_thompson_exec_pt handler,
     sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size, unsigned eof);
@@ -26,7 +37,10 @@ sre_int_t run_jitted_thompson(sre_vm_thompson_exec_pt handler,
 enum {
     ENGINE_THOMPSON     = (1 << 0),
     ENGINE_THOMPSON_JIT = (1 << 1),
-    ENGINE_PIKE         = (1 << 2)
+    ENGINE_PIKE         = (1 << 2),
+    ENGINE_DFA          = (1 << 3),
+    ENGINE_FULL_DFA     = (1 << 4),
+    ENGINE_PIKE_JIT     = (1 << 5)
 };
 
 
@@ -60,7 +74,12 @@ main(int argc, char **argv)
     sre_char            *input;
     FILE                *f;
     size_t               len;
+    size_t               stack_size = 0;
+    long                 max_ncaps = -1;
     long                 rc;
+    run_args_t           args;
+    pthread_t            thread;
+    pthread_attr_t       attr;
 
     if (argc < 3) {
         usage(1);
@@ -81,11 +100,42 @@ main(int argc, char **argv)
         {
             engine_types |= ENGINE_THOMPSON;
 
+        } else if (strncmp(argv[i], "--pike-jit", sizeof("--pike-jit") - 1)
+                   == 0)
+        {
+            engine_types |= ENGINE_PIKE_JIT;
+
         } else if (strncmp(argv[i], "--pike", sizeof("--pike") - 1)
                    == 0)
         {
             engine_types |= ENGINE_PIKE;
 
+        } else if (strncmp(argv[i], "--full-dfa", sizeof("--full-dfa") - 1)
+                   == 0)
+        {
+            engine_types |= ENGINE_FULL_DFA;
+
+        } else if (strncmp(argv[i], "--dfa", sizeof("--dfa") - 1) == 0) {
+            engine_types |= ENGINE_DFA;
+
+        } else if (strncmp(argv[i], "--stack-size", sizeof("--stack-size") - 1)
+                   == 0)
+        {
+            if (++i == argc) {
+                usage(1);
+            }
+
+            stack_size = (size_t) atol(argv[i]);
+
+        } else if (strncmp(argv[i], "--captures", sizeof("--captures") - 1)
+                   == 0)
+        {
+            if (++i == argc) {
+                usage(1);
+            }
+
+            max_ncaps = atol(argv[i]);
+
         } else if (strncmp(argv[i], "-i", 2) == 0) {
             flags |= SRE_REGEX_CASELESS;
 
@@ -125,7 +175,11 @@ main(int argc, char **argv)
         return 2;
     }
 
-    prog = sre_regex_compile(cpool, re);
+    if (max_ncaps >= 0 && ncaps > (sre_uint_t) max_ncaps) {
+        ncaps = max_ncaps;
+    }
+
+    prog = sre_regex_compile_captures(cpool, re, ncaps);
     if (prog == NULL) {
         fprintf(stderr, "failed to compile the regex.\n");
         return 2;
@@ -182,7 +236,28 @@ main(int argc, char **argv)
         return 1;
     }
 
-    run_engines(prog, engine_types, ncaps, input, len);
+    if (stack_size) {
+        /* only the engines run on the small stack, not the compiler */
+
+        args.prog = prog;
+        args.engine_types = engine_types;
+        args.ncaps = ncaps;
+        args.input = input;
+        args.len = len;
+
+        if (pthread_attr_init(&attr) != 0
+            || pthread_attr_setstacksize(&attr, stack_size) != 0
+            || pthread_create(&thread, &attr, run_engines_thread, &args) != 0
+            || pthread_join(thread, NULL) != 0)
+        {
+            fprintf(stderr, "failed to run the engines in a thread with a "
+                    "stack of %lu bytes.\n", (unsigned long) stack_size);
+            return 2;
+        }
+
+    } else {
+        run_engines(prog, engine_types, ncaps, input, len);
+    }
 
     free(input);
     sre_destroy_pool(cpool);
@@ -204,8 +279,13 @@ run_engines(sre_program_t *prog, unsigned engine_types, sre_uint_t ncaps,
 
     sre_vm_thompson_ctx_t       *tctx;
     sre_vm_pike_ctx_t           *pctx;
+    sre_vm_pike_code_t          *pcode;
+    sre_vm_pike_exec_pt          pexec;
     sre_vm_thompson_code_t      *tcode;
     sre_vm_thompson_exec_pt      texec;
+    sre_vm_dfa_ctx_t            *dctx;
+    sre_vm_dfa_table_t          *dtable;
+    sre_vm_dfa_table_ctx_t      *dtctx;
 
     pool = sre_create_pool(1024);
     if (pool == NULL) {
@@ -313,6 +393,108 @@ run_engines(sre_program_t *prog, unsigned engine_types, sre_uint_t ncaps,
         sre_reset_pool(pool);
     }
 
+    if (engine_types & ENGINE_DFA) {
+
+        printf("sregex DFA ");
+
+        dctx = sre_vm_dfa_create_ctx(pool, prog, 0);
+        if (dctx == NULL) {
+            alloc_error();
+        }
+
+        TIMER_START
+
+        rc = sre_vm_dfa_exec(dctx, input, len, 1);
+
+        TIMER_STOP
+
+        switch (rc) {
+        case SRE_OK:
+            printf("match");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match");
+            break;
+
+        case SRE_AGAIN:
+            printf("again");
+            break;
+
+        case SRE_ERROR:
+            printf("error");
+            break;
+
+        default:
+            printf("bad retval: %lx\n", (unsigned long) rc);
+            exit(2);
+        }
+
+        printf(": %.02lf ms elapsed.\n", elapsed);
+
+        sre_reset_pool(pool);
+    }
+
+    if (engine_types & ENGINE_FULL_DFA) {
+        TIMER_START
+
+        rc = sre_vm_dfa_compile(pool, prog, 0, &dtable);
+
+        TIMER_STOP
+
+        if (rc == SRE_DECLINED) {
+            printf("sregex full DFA disabled (too many states)\n");
+            exit(2);
+        }
+
+        if (rc != SRE_OK) {
+            fprintf(stderr, "failed to run dfa compile: %ld\n", (long) rc);
+            exit(2);
+        }
+
+        printf("sregex full DFA compiled %lu states: %.02lf ms elapsed.\n",
+               (unsigned long) sre_vm_dfa_table_nstates(dtable), elapsed);
+
+        printf("sregex full DFA ");
+
+        dtctx = sre_vm_dfa_table_create_ctx(pool, dtable);
+        if (dtctx == NULL) {
+            alloc_error();
+        }
+
+        TIMER_START
+
+        rc = sre_vm_dfa_table_exec(dtctx, input, len, 1);
+
+        TIMER_STOP
+
+        switch (rc) {
+        case SRE_OK:
+            printf("match");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match");
+            break;
+
+        case SRE_AGAIN:
+            printf("again");
+            break;
+
+        case SRE_ERROR:
+            printf("error");
+            break;
+
+        default:
+            printf("bad retval: %lx\n", (unsigned long) rc);
+            exit(2);
+        }
+
+        printf(": %.02lf ms elapsed.\n", elapsed);
+
+        sre_reset_pool(pool);
+    }
+
     if (engine_types & ENGINE_PIKE) {
         ovecsize = 2 * (ncaps + 1) * sizeof(sre_int_t);
         ovector = malloc(ovecsize);
@@ -366,10 +548,94 @@ run_engines(sre_program_t *prog, unsigned engine_types, sre_uint_t ncaps,
         sre_reset_pool(pool);
     }
 
+    if (engine_types & ENGINE_PIKE_JIT) {
+        rc = sre_vm_pike_jit_compile(pool, prog, &pcode);
+
+        if (rc == SRE_DECLINED) {
+            printf("sregex Pike JIT disabled\n");
+            exit(2);
+        }
+
+        if (rc != SRE_OK) {
+            fprintf(stderr, "failed to run pike jit compile: %ld\n", (long) rc);
+            exit(2);
+        }
+
+        pexec = sre_vm_pike_jit_get_handler(pcode);
+        if (pexec == NULL) {
+            fprintf(stderr, "failed to get Pike JIT handler.\n");
+            exit(2);
+        }
+
+        ovecsize = 2 * (ncaps + 1) * sizeof(sre_int_t);
+        ovector = malloc(ovecsize);
+        if (ovector == NULL) {
+            alloc_error();
+        }
+
+        printf("sregex Pike JIT ");
+
+        pctx = sre_vm_pike_create_ctx(pool, prog, ovector, ovecsize);
+        if (pctx == NULL) {
+            alloc_error();
+        }
+
+        TIMER_START
+
+        rc = pexec(pctx, input, len, 1 /* eof */, NULL);
+
+        TIMER_STOP
+
+        switch (rc) {
+        case SRE_OK:
+            printf("match");
+
+            for (i = 0; i < 2 * (ncaps + 1); i += 2) {
+                printf(" (%ld, %ld)", (long) ovector[i], (long) ovector[i + 1]);
+            }
+
+            break;
+
+        case SRE_AGAIN:
+            printf("again");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match");
+            break;
+
+        case SRE_ERROR:
+            printf("error");
+            break;
+
+        default:
+            assert(rc);
+            break;
+        }
+
+        printf(": %.02lf ms elapsed.\n", elapsed);
+
+        free(ovector);
+        sre_vm_pike_jit_free(pcode);
+        sre_reset_pool(pool);
+    }
+
     sre_destroy_pool(pool);
 }
 
 
+static void *
+run_engines_thread(void *data)
+{
+    run_args_t          *args = data;
+
+    run_engines(args->prog, args->engine_types, args->ncaps, args->input,
+                args->len);
+
+    return NULL;
+}
+
+
 static void
 alloc_error(void)
 {
@@ -384,9 +650,15 @@ usage(int rc)
     fprintf(stderr, "usage: sregex [options] <regexp> <file>\n"
             "options:\n"
             "   -i                  use case insensitive matching\n"
+            "   --dfa               use the lazy DFA\n"
+            "   --full-dfa          use the fully compiled and minimized DFA\n"
             "   --pike              use the Pike VM interpreter\n"
+            "   --pike-jit          use the Pike VM JIT compiler\n"
             "   --thompson          use the Thompson VM interpreter\n"
-            "   --thompson-jit      use the Thompson VM JIT compiler\n");
+            "   --thompson-jit      use the Thompson VM JIT compiler\n"
+            "   --stack-size <n>    run the engines in a thread with a stack "
+            "of n bytes\n"
+            "   --captures <n>      only capture $& and the first n groups\n");
     exit(rc);
 }
 
@@ -19,15 +19,54 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+#define SRE_CLI_THREAD_ROUNDS  64
+
+
+enum {
+    SRE_CLI_THOMPSON = 0,
+    SRE_CLI_JITTED_THOMPSON,
+    SRE_CLI_DFA,
+    SRE_CLI_FULL_DFA,
+    SRE_CLI_PIKE,
+    SRE_CLI_JITTED_PIKE,
+    SRE_CLI_ENGINES
+};
+
+
+/* the compiled forms of a regex shared by all the stress threads */
+typedef struct {
+    sre_program_t               *prog;
+    sre_vm_thompson_code_t      *tcode;
+    sre_vm_pike_code_t          *pcode;
+    sre_vm_dfa_table_t          *dtable;
+    sre_char                    *subject;
+    size_t                       len;
+    size_t                       ovecsize;
+    sre_int_t                    rcs[SRE_CLI_ENGINES];
+    sre_int_t                   *ovector;
+    sre_int_t                   *jitted_ovector;
+} shared_regex_t;
 
 
 static void usage(void);
+static sre_program_t *reload_program(sre_pool_t *pool, sre_program_t *prog);
 static void process_string(sre_char *s, size_t len, sre_program_t *prog,
-    sre_int_t *ovector, size_t ovecsize, sre_uint_t ncaps);
+    sre_int_t *ovector, size_t ovecsize, sre_uint_t ncaps,
+    sre_int_t nregexes);
+static void print_set_result(sre_int_t rc, sre_int_t *regex_ids);
 sre_int_t run_jitted_thompson(sre_vm_thompson_exec_pt handler,
     sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size, unsigned eof);
 static sre_int_t parse_regex_flags(const char *flags_str, int nregexes,
     int *multi_flags);
+static void run_threads(sre_char *s, size_t len, sre_program_t *prog,
+    size_t ovecsize, int nthreads);
+static sre_int_t run_engines(shared_regex_t *sr, sre_int_t *rcs,
+    sre_int_t *ovector, sre_int_t *jitted_ovector);
+static void *run_engines_in_thread(void *data);
 
 
 int
@@ -48,6 +87,9 @@ main(int argc, char **argv)
     size_t               len;
     unsigned             from_stdin = 0;
     sre_int_t            nregexes = 1;
+    int                  nthreads = 0;
+    sre_int_t            max_ncaps = -1;
+    unsigned             reload = 0;
 
     if (argc < 2) {
         usage();
@@ -61,6 +103,11 @@ main(int argc, char **argv)
         if (strncmp(argv[i], "--stdin", sizeof("--stdin") - 1) == 0) {
             from_stdin = 1;
 
+        } else if (strncmp(argv[i], "--reload", sizeof("--reload") - 1)
+                   == 0)
+        {
+            reload = 1;
+
         } else if (strncmp(argv[i], "--flags", sizeof("--flags") - 1) == 0) {
             if (i == argc - 1) {
                 fprintf(stderr, "--flags should take a value.\n");
@@ -85,6 +132,38 @@ main(int argc, char **argv)
                 return 1;
             }
 
+        } else if (strncmp(argv[i], "--threads", sizeof("--threads") - 1)
+                   == 0)
+        {
+            if (i == argc - 1) {
+                fprintf(stderr, "--threads should take a value.\n");
+                return 1;
+            }
+
+            i++;
+
+            nthreads = atoi(argv[i]);
+            if (nthreads <= 0) {
+                fprintf(stderr, "invalid --threads value: %s.\n", argv[i]);
+                return 1;
+            }
+
+        } else if (strncmp(argv[i], "--captures", sizeof("--captures") - 1)
+                   == 0)
+        {
+            if (i == argc - 1) {
+                fprintf(stderr, "--captures should take a value.\n");
+                return 1;
+            }
+
+            i++;
+
+            max_ncaps = atoi(argv[i]);
+            if (max_ncaps < 0) {
+                fprintf(stderr, "invalid --captures value: %s.\n", argv[i]);
+                return 1;
+            }
+
         } else {
             fprintf(stderr, "unknown option: %s\n", argv[i]);
             return 1;
@@ -184,7 +263,11 @@ main(int argc, char **argv)
         return 2;
     }
 
-    prog = sre_regex_compile(cpool, re);
+    if (max_ncaps >= 0 && ncaps > (sre_uint_t) max_ncaps) {
+        ncaps = max_ncaps;
+    }
+
+    prog = sre_regex_compile_captures(cpool, re, ncaps);
     if (prog == NULL) {
         fprintf(stderr, "failed to compile the regex.\n");
         sre_destroy_pool(ppool);
@@ -199,6 +282,18 @@ main(int argc, char **argv)
     ppool = NULL;
     re = NULL;
 
+    if (reload) {
+        prog = reload_program(cpool, prog);
+        if (prog == NULL) {
+            fprintf(stderr, "failed to reload the program.\n");
+            sre_destroy_pool(cpool);
+            if (multi_flags) {
+                free(multi_flags);
+            }
+            return 2;
+        }
+    }
+
     sre_program_dump(prog);
 
     ovecsize = 2 * (ncaps + 1) * sizeof(sre_int_t);
@@ -252,7 +347,11 @@ main(int argc, char **argv)
                 return 2;
             }
 
-            process_string(s, len, prog, ovector, ovecsize, ncaps);
+            process_string(s, len, prog, ovector, ovecsize, ncaps, nregexes);
+
+            if (nthreads) {
+                run_threads(s, len, prog, ovecsize, nthreads);
+            }
 
             free(s);
         }
@@ -276,7 +375,11 @@ main(int argc, char **argv)
 
             memcpy(s, p, len);
 
-            process_string(s, len, prog, ovector, ovecsize, ncaps);
+            process_string(s, len, prog, ovector, ovecsize, ncaps, nregexes);
+
+            if (nthreads) {
+                run_threads(s, len, prog, ovecsize, nthreads);
+            }
 
             free(s);
         }
@@ -297,18 +400,24 @@ main(int argc, char **argv)
 
 static void
 process_string(sre_char *s, size_t len, sre_program_t *prog, sre_int_t *ovector,
-    size_t ovecsize, sre_uint_t ncaps)
+    size_t ovecsize, sre_uint_t ncaps, sre_int_t nregexes)
 {
     sre_uint_t                   i, j;
     sre_int_t                    rc;
     sre_char                    *p;
     unsigned                     gen_empty_buf;
     sre_int_t                   *pending_matched;
+    sre_int_t                   *regex_ids;
     sre_pool_t                  *pool;
     sre_vm_pike_ctx_t           *pctx;
+    sre_vm_pike_code_t          *pcode;
+    sre_vm_pike_exec_pt          pexec;
     sre_vm_thompson_ctx_t       *tctx;
     sre_vm_thompson_code_t      *tcode;
     sre_vm_thompson_exec_pt      texec;
+    sre_vm_dfa_ctx_t            *dctx;
+    sre_vm_dfa_table_t          *dtable;
+    sre_vm_dfa_table_ctx_t      *dtctx;
 
     printf("## %.*s (len %d)\n", (int) len, s, (int) len);
 
@@ -323,6 +432,13 @@ process_string(sre_char *s, size_t len, sre_program_t *prog, sre_int_t *ovector,
         exit(2);
     }
 
+    regex_ids = malloc(nregexes * sizeof(sre_int_t));
+    if (regex_ids == NULL) {
+        sre_destroy_pool(pool);
+        free(p);
+        exit(2);
+    }
+
     /*
      * Thompson
      */
@@ -412,6 +528,238 @@ process_string(sre_char *s, size_t len, sre_program_t *prog, sre_int_t *ovector,
 
     sre_reset_pool(pool);
 
+    /*
+     * Thompson set
+     */
+
+    printf("set ");
+
+    tctx = sre_vm_thompson_create_set_ctx(pool, prog, regex_ids);
+    assert(tctx);
+
+    rc = sre_vm_thompson_exec(tctx, s, len, 1);
+
+    print_set_result(rc, regex_ids);
+
+    sre_reset_pool(pool);
+
+    /*
+     * Splitted Thompson set
+     */
+
+    printf("splitted set ");
+
+    tctx = sre_vm_thompson_create_set_ctx(pool, prog, regex_ids);
+    assert(tctx);
+
+    for (i = 0; i <= len; i++) {
+        if (i == len) {
+            rc = sre_vm_thompson_exec(tctx, NULL, 0 /* len */, 1 /* eof */);
+
+        } else {
+            p[0] = s[i];
+
+            rc = sre_vm_thompson_exec(tctx, p, 1 /* len */, 0 /* eof */);
+        }
+
+        if (rc != SRE_AGAIN) {
+            break;
+        }
+    }
+
+    print_set_result(rc, regex_ids);
+
+    sre_reset_pool(pool);
+
+    /*
+     * lazy DFA
+     */
+
+    printf("dfa ");
+
+    dctx = sre_vm_dfa_create_ctx(pool, prog, 0);
+    assert(dctx);
+
+    rc = sre_vm_dfa_exec(dctx, s, len, 1);
+
+    switch (rc) {
+    case SRE_OK:
+        printf("match\n");
+        break;
+
+    case SRE_DECLINED:
+        printf("no match\n");
+        break;
+
+    case SRE_AGAIN:
+        printf("again\n");
+        break;
+
+    case SRE_ERROR:
+        printf("error\n");
+        break;
+
+    default:
+        assert(rc);
+    }
+
+    sre_reset_pool(pool);
+
+    /*
+     * Splitted lazy DFA (with a tiny state cache to exercise cache resets
+     * and the NFA fallback)
+     */
+
+    printf("splitted dfa ");
+
+    dctx = sre_vm_dfa_create_ctx(pool, prog, 1);
+    assert(dctx);
+
+    gen_empty_buf = 1;
+
+    for (i = 0; i <= len; i++) {
+        if (i == len) {
+            rc = sre_vm_dfa_exec(dctx, NULL, 0 /* len */, 1 /* eof */);
+
+        } else if (gen_empty_buf) {
+            rc = sre_vm_dfa_exec(dctx, NULL, 0 /* len */, 0 /* eof */);
+            gen_empty_buf = 0;
+            i--;
+
+        } else {
+            p[0] = s[i];
+
+            rc = sre_vm_dfa_exec(dctx, p, 1 /* len */, 0 /* eof */);
+            gen_empty_buf = 1;
+        }
+
+        switch (rc) {
+        case SRE_AGAIN:
+            continue;
+
+        case SRE_OK:
+            printf("match\n");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match\n");
+            break;
+
+        case SRE_ERROR:
+            printf("error\n");
+            break;
+
+        default:
+            assert(rc);
+        }
+
+        break;
+    }
+
+    sre_reset_pool(pool);
+
+    /*
+     * run the full DFA compiler
+     */
+
+    rc = sre_vm_dfa_compile(pool, prog, 0, &dtable);
+    if (rc == SRE_DECLINED) {
+        printf("full dfa disabled\n");
+        printf("splitted full dfa disabled\n");
+        goto jit;
+    }
+
+    if (rc != SRE_OK) {
+        fprintf(stderr, "failed to run dfa compile: %ld\n", (long) rc);
+        exit(2);
+    }
+
+    /*
+     * full DFA
+     */
+
+    printf("full dfa ");
+
+    dtctx = sre_vm_dfa_table_create_ctx(pool, dtable);
+    assert(dtctx);
+
+    rc = sre_vm_dfa_table_exec(dtctx, s, len, 1);
+
+    switch (rc) {
+    case SRE_OK:
+        printf("match\n");
+        break;
+
+    case SRE_DECLINED:
+        printf("no match\n");
+        break;
+
+    case SRE_AGAIN:
+        printf("again\n");
+        break;
+
+    case SRE_ERROR:
+        printf("error\n");
+        break;
+
+    default:
+        assert(rc);
+    }
+
+    /*
+     * Splitted full DFA
+     */
+
+    printf("splitted full dfa ");
+
+    dtctx = sre_vm_dfa_table_create_ctx(pool, dtable);
+    assert(dtctx);
+
+    gen_empty_buf = 1;
+
+    for (i = 0; i <= len; i++) {
+        if (i == len) {
+            rc = sre_vm_dfa_table_exec(dtctx, NULL, 0 /* len */, 1 /* eof */);
+
+        } else if (gen_empty_buf) {
+            rc = sre_vm_dfa_table_exec(dtctx, NULL, 0 /* len */, 0 /* eof */);
+            gen_empty_buf = 0;
+            i--;
+
+        } else {
+            p[0] = s[i];
+
+            rc = sre_vm_dfa_table_exec(dtctx, p, 1 /* len */, 0 /* eof */);
+            gen_empty_buf = 1;
+        }
+
+        switch (rc) {
+        case SRE_AGAIN:
+            continue;
+
+        case SRE_OK:
+            printf("match\n");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match\n");
+            break;
+
+        case SRE_ERROR:
+            printf("error\n");
+            break;
+
+        default:
+            assert(rc);
+        }
+
+        break;
+    }
+
+jit:
+
+    sre_reset_pool(pool);
+
     /*
      * run Thompson VM's JIT compiler
      */
@@ -571,23 +919,48 @@ pike:
         }
     }
 
-    sre_reset_pool(pool);
+    /* the same context again, after the eof call */
 
-    printf("splitted pike ");
+    printf("pike after eof ");
 
-    dd("===== splitted pike =====");
+    rc = sre_vm_pike_exec(pctx, s, len, 1 /* eof */, NULL);
 
-    pctx = sre_vm_pike_create_ctx(pool, prog, ovector, ovecsize);
-    assert(pctx);
+    if (rc >= 0) {
+        printf("match\n");
 
-    gen_empty_buf = 1;
+    } else {
+        switch (rc) {
+        case SRE_DECLINED:
+            printf("no match\n");
+            break;
 
-    for (i = 0; i <= len; i++) {
-        if (i == len) {
-            rc = sre_vm_pike_exec(pctx, NULL, 0 /* len */, 1 /* eof */,
-                                  &pending_matched);
+        case SRE_ERROR:
+            printf("error\n");
+            break;
 
-        } else if (gen_empty_buf) {
+        default:
+            printf("unknown (%d)\n", (int) rc);
+            break;
+        }
+    }
+
+    sre_reset_pool(pool);
+
+    printf("splitted pike ");
+
+    dd("===== splitted pike =====");
+
+    pctx = sre_vm_pike_create_ctx(pool, prog, ovector, ovecsize);
+    assert(pctx);
+
+    gen_empty_buf = 1;
+
+    for (i = 0; i <= len; i++) {
+        if (i == len) {
+            rc = sre_vm_pike_exec(pctx, NULL, 0 /* len */, 1 /* eof */,
+                                  &pending_matched);
+
+        } else if (gen_empty_buf) {
             rc = sre_vm_pike_exec(pctx, NULL, 0 /* len */, 0 /* eof */, NULL);
             gen_empty_buf = 0;
             i--;
@@ -655,20 +1028,235 @@ pike:
         break;
     }
 
+    sre_reset_pool(pool);
+
+    /*
+     * run Pike VM's JIT compiler
+     */
+
+    rc = sre_vm_pike_jit_compile(pool, prog, &pcode);
+    if (rc == SRE_DECLINED) {
+        printf("jitted pike disabled\n");
+        printf("splitted jitted pike disabled\n");
+        goto done;
+    }
+
+    if (rc != SRE_OK) {
+        fprintf(stderr, "failed to run pike jit compile: %ld\n", (long) rc);
+        exit(2);
+    }
+
+    pexec = sre_vm_pike_jit_get_handler(pcode);
+    if (pexec == NULL) {
+        fprintf(stderr, "failed to get pike jit handler.\n");
+        exit(2);
+    }
+
+    /*
+     * JITted Pike
+     */
+
+    printf("jitted pike ");
+
+    pctx = sre_vm_pike_create_ctx(pool, prog, ovector, ovecsize);
+    assert(pctx);
+
+    rc = pexec(pctx, s, len, 1 /* eof */, NULL);
+
+    if (rc >= 0) {
+        printf("match %ld", (long) rc);
+
+        for (i = 0; i < 2 * (ncaps + 1); i += 2) {
+            printf(" (%ld, %ld)", (long) ovector[i], (long) ovector[i + 1]);
+        }
+
+        printf("\n");
+
+    } else {
+        switch (rc) {
+        case SRE_AGAIN:
+            printf("again\n");
+            break;
+
+        case SRE_DECLINED:
+            printf("no match\n");
+            break;
+
+        case SRE_ERROR:
+            printf("error\n");
+            break;
+
+        default:
+            printf("unknown (%d)\n", (int) rc);
+            break;
+        }
+    }
+
+    sre_reset_pool(pool);
+
+    /*
+     * Splitted JITted Pike
+     */
+
+    printf("splitted jitted pike ");
+
+    pctx = sre_vm_pike_create_ctx(pool, prog, ovector, ovecsize);
+    assert(pctx);
+
+    gen_empty_buf = 1;
+
+    for (i = 0; i <= len; i++) {
+        if (i == len) {
+            rc = pexec(pctx, NULL, 0 /* len */, 1 /* eof */, &pending_matched);
+
+        } else if (gen_empty_buf) {
+            rc = pexec(pctx, NULL, 0 /* len */, 0 /* eof */, NULL);
+            gen_empty_buf = 0;
+            i--;
+
+        } else {
+            p[0] = s[i];
+            rc = pexec(pctx, p, 1 /* len */, 0 /* eof */, &pending_matched);
+
+            if (rc == SRE_AGAIN) {
+                printf("[");
+                for (j = 0; j < 2; j += 2) {
+                    printf("(%ld, %ld)", (long) ovector[j],
+                           (long) ovector[j + 1]);
+                }
+                printf("]");
+
+                if (pending_matched) {
+                    printf("(%ld, %ld) ", (long) pending_matched[0],
+                           (long) pending_matched[1]);
+
+                } else {
+                    printf(" ");
+                }
+            }
+
+            gen_empty_buf = 1;
+        }
+
+        if (rc >= 0) {
+            printf("match %ld", (long) rc);
+
+            for (j = 0; j < 2 * (ncaps + 1); j += 2) {
+                printf(" (%ld, %ld)", (long) ovector[j], (long) ovector[j + 1]);
+            }
+
+            printf("\n");
+
+        } else {
+            switch (rc) {
+            case SRE_AGAIN:
+                continue;
+
+            case SRE_DECLINED:
+                printf("no match\n");
+                break;
+
+            case SRE_ERROR:
+                printf("error\n");
+                break;
+
+            default:
+                printf("unknown (%d)\n", (int) rc);
+                break;
+            }
+        }
+
+        break;
+    }
+
+    if (sre_vm_pike_jit_free(pcode) != SRE_OK) {
+        fprintf(stderr, "failed to free pike jit.\n");
+        exit(2);
+    }
+
+done:
+
     sre_destroy_pool(pool);
+    free(regex_ids);
     free(p);
 }
 
 
+static void
+print_set_result(sre_int_t rc, sre_int_t *regex_ids)
+{
+    sre_int_t       i;
+
+    switch (rc) {
+    case SRE_DECLINED:
+        printf("no match\n");
+        break;
+
+    case SRE_AGAIN:
+        printf("again\n");
+        break;
+
+    case SRE_ERROR:
+        printf("error\n");
+        break;
+
+    default:
+        assert(rc > 0);
+
+        printf("match");
+
+        for (i = 0; i < rc; i++) {
+            printf(" %ld", (long) regex_ids[i]);
+        }
+
+        printf("\n");
+    }
+}
+
+
 static void
 usage(void)
 {
     fprintf(stderr, "usage: sregex-cli regexp string...\n");
     fprintf(stderr, "       sregex-cli --stdin regexp\n");
+    fprintf(stderr, "       sregex-cli --threads N --stdin regexp\n");
+    fprintf(stderr, "       sregex-cli --captures N --stdin regexp\n");
+    fprintf(stderr, "       sregex-cli --reload --stdin regexp\n");
     exit(2);
 }
 
 
+/*
+ * Saves the program into a file and runs the one loaded from it instead,
+ * as a program cache would.
+ */
+static sre_program_t *
+reload_program(sre_pool_t *pool, sre_program_t *prog)
+{
+    char             path[256];
+    const char      *dir;
+
+    dir = getenv("TMPDIR");
+    if (dir == NULL) {
+        dir = "/tmp";
+    }
+
+    snprintf(path, sizeof(path), "%s/sregex-cli-%ld.prog", dir,
+             (long) getpid());
+
+    if (sre_program_save(prog, path) != SRE_OK) {
+        return NULL;
+    }
+
+    prog = sre_program_load(pool, path);
+
+    /* the mapping outlives the file */
+    (void) unlink(path);
+
+    return prog;
+}
+
+
 sre_int_t
 run_jitted_thompson(sre_vm_thompson_exec_pt handler, sre_vm_thompson_ctx_t *ctx,
     sre_char *input, size_t size, unsigned eof)
@@ -709,3 +1297,236 @@ parse_regex_flags(const char *flags_str, int nregexes,
 
     return SRE_OK;
 }
+
+
+/*
+ * Runs all the engines on the same compiled program (and the same JIT
+ * compiled code) from several threads at once and checks that every
+ * thread gets the same results as a single-threaded run.
+ */
+static void
+run_threads(sre_char *s, size_t len, sre_program_t *prog, size_t ovecsize,
+    int nthreads)
+{
+    int                  i, failed;
+    void                *res;
+    sre_int_t            rc;
+    sre_pool_t          *pool;
+    pthread_t           *tids;
+    shared_regex_t       sr;
+
+    pool = sre_create_pool(1024);
+    if (pool == NULL) {
+        exit(2);
+    }
+
+    sr.prog = prog;
+    sr.subject = s;
+    sr.len = len;
+    sr.ovecsize = ovecsize;
+
+    /* all the compilers must finish before the program is shared */
+
+    rc = sre_vm_thompson_jit_compile(pool, prog, &sr.tcode);
+    if (rc == SRE_DECLINED) {
+        sr.tcode = NULL;
+
+    } else if (rc != SRE_OK) {
+        fprintf(stderr, "failed to run thompson jit compile: %ld\n", (long) rc);
+        exit(2);
+    }
+
+    rc = sre_vm_pike_jit_compile(pool, prog, &sr.pcode);
+    if (rc == SRE_DECLINED) {
+        sr.pcode = NULL;
+
+    } else if (rc != SRE_OK) {
+        fprintf(stderr, "failed to run pike jit compile: %ld\n", (long) rc);
+        exit(2);
+    }
+
+    rc = sre_vm_dfa_compile(pool, prog, 0, &sr.dtable);
+    if (rc == SRE_DECLINED) {
+        sr.dtable = NULL;
+
+    } else if (rc != SRE_OK) {
+        fprintf(stderr, "failed to run dfa compile: %ld\n", (long) rc);
+        exit(2);
+    }
+
+    sr.ovector = malloc(2 * ovecsize);
+    tids = malloc(nthreads * sizeof(pthread_t));
+
+    if (sr.ovector == NULL || tids == NULL) {
+        exit(2);
+    }
+
+    sr.jitted_ovector = (sre_int_t *) ((char *) sr.ovector + ovecsize);
+
+    if (run_engines(&sr, sr.rcs, sr.ovector, sr.jitted_ovector) != SRE_OK) {
+        fprintf(stderr, "failed to run the engines.\n");
+        exit(2);
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&tids[i], NULL, run_engines_in_thread, &sr) != 0) {
+            perror("pthread_create");
+            exit(2);
+        }
+    }
+
+    failed = 0;
+
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_join(tids[i], &res) != 0) {
+            perror("pthread_join");
+            exit(2);
+        }
+
+        if (res != NULL) {
+            failed++;
+        }
+    }
+
+    if (failed) {
+        printf("threads: %d of %d failed\n", failed, nthreads);
+
+    } else {
+        printf("threads: ok\n");
+    }
+
+    if (sr.tcode && sre_vm_thompson_jit_free(sr.tcode) != SRE_OK) {
+        fprintf(stderr, "failed to free thompson jit.\n");
+        exit(2);
+    }
+
+    if (sr.pcode && sre_vm_pike_jit_free(sr.pcode) != SRE_OK) {
+        fprintf(stderr, "failed to free pike jit.\n");
+        exit(2);
+    }
+
+    free(sr.ovector);
+    free(tids);
+
+    sre_destroy_pool(pool);
+}
+
+
+static void *
+run_engines_in_thread(void *data)
+{
+    shared_regex_t      *sr = data;
+
+    int                  i, failed;
+    sre_int_t            rcs[SRE_CLI_ENGINES];
+    sre_int_t           *ovector, *jitted_ovector;
+
+    ovector = malloc(2 * sr->ovecsize);
+    if (ovector == NULL) {
+        return sr;
+    }
+
+    jitted_ovector = (sre_int_t *) ((char *) ovector + sr->ovecsize);
+
+    failed = 0;
+
+    for (i = 0; i < SRE_CLI_THREAD_ROUNDS && !failed; i++) {
+        if (run_engines(sr, rcs, ovector, jitted_ovector) != SRE_OK
+            || memcmp(rcs, sr->rcs, sizeof(rcs)) != 0
+            || memcmp(ovector, sr->ovector, sr->ovecsize) != 0
+            || memcmp(jitted_ovector, sr->jitted_ovector, sr->ovecsize) != 0)
+        {
+            failed = 1;
+        }
+    }
+
+    free(ovector);
+
+    return failed ? sr : NULL;
+}
+
+
+static sre_int_t
+run_engines(shared_regex_t *sr, sre_int_t *rcs, sre_int_t *ovector,
+    sre_int_t *jitted_ovector)
+{
+    sre_pool_t                  *pool;
+    sre_vm_pike_ctx_t           *pctx;
+    sre_vm_thompson_ctx_t       *tctx;
+    sre_vm_dfa_ctx_t            *dctx;
+    sre_vm_dfa_table_ctx_t      *dtctx;
+
+    pool = sre_create_pool(1024);
+    if (pool == NULL) {
+        return SRE_ERROR;
+    }
+
+    memset(rcs, 0, SRE_CLI_ENGINES * sizeof(sre_int_t));
+    memset(ovector, 0, sr->ovecsize);
+    memset(jitted_ovector, 0, sr->ovecsize);
+
+    tctx = sre_vm_thompson_create_ctx(pool, sr->prog);
+    if (tctx == NULL) {
+        goto failed;
+    }
+
+    rcs[SRE_CLI_THOMPSON] = sre_vm_thompson_exec(tctx, sr->subject, sr->len,
+                                                 1);
+
+    if (sr->tcode) {
+        tctx = sre_vm_thompson_jit_create_ctx(pool, sr->prog);
+        if (tctx == NULL) {
+            goto failed;
+        }
+
+        rcs[SRE_CLI_JITTED_THOMPSON] =
+            run_jitted_thompson(sre_vm_thompson_jit_get_handler(sr->tcode),
+                                tctx, sr->subject, sr->len, 1);
+    }
+
+    dctx = sre_vm_dfa_create_ctx(pool, sr->prog, 0);
+    if (dctx == NULL) {
+        goto failed;
+    }
+
+    rcs[SRE_CLI_DFA] = sre_vm_dfa_exec(dctx, sr->subject, sr->len, 1);
+
+    if (sr->dtable) {
+        dtctx = sre_vm_dfa_table_create_ctx(pool, sr->dtable);
+        if (dtctx == NULL) {
+            goto failed;
+        }
+
+        rcs[SRE_CLI_FULL_DFA] = sre_vm_dfa_table_exec(dtctx, sr->subject,
+                                                      sr->len, 1);
+    }
+
+    pctx = sre_vm_pike_create_ctx(pool, sr->prog, ovector, sr->ovecsize);
+    if (pctx == NULL) {
+        goto failed;
+    }
+
+    rcs[SRE_CLI_PIKE] = sre_vm_pike_exec(pctx, sr->subject, sr->len, 1, NULL);
+
+    if (sr->pcode) {
+        pctx = sre_vm_pike_create_ctx(pool, sr->prog, jitted_ovector,
+                                      sr->ovecsize);
+        if (pctx == NULL) {
+            goto failed;
+        }
+
+        rcs[SRE_CLI_JITTED_PIKE] =
+            sre_vm_pike_jit_get_handler(sr->pcode)(pctx, sr->subject,
+                                                   sr->len, 1, NULL);
+    }
+
+    sre_destroy_pool(pool);
+
+    return SRE_OK;
+
+failed:
+
+    sre_destroy_pool(pool);
+
+    return SRE_ERROR;
+}
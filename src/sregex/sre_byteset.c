@@ -0,0 +1,268 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_byteset.h>
+
+
+#if (SRE_TARGET == SRE_ARCH_X64) && defined(__GNUC__)
+#define SRE_BYTESET_SIMD  1
+#include <immintrin.h>
+#else
+#define SRE_BYTESET_SIMD  0
+#endif
+
+
+static sre_char *sre_byteset_find_byte(sre_byteset_t *set, sre_char *pos,
+    sre_char *last);
+static sre_char *sre_byteset_find_table(sre_byteset_t *set, sre_char *pos,
+    sre_char *last);
+#if (SRE_BYTESET_SIMD)
+static sre_char *sre_byteset_find_bytes_sse2(sre_byteset_t *set,
+    sre_char *pos, sre_char *last);
+static sre_char *sre_byteset_find_ssse3(sre_byteset_t *set, sre_char *pos,
+    sre_char *last);
+static sre_char *sre_byteset_find_avx2(sre_byteset_t *set, sre_char *pos,
+    sre_char *last);
+#endif
+
+
+SRE_NOAPI void
+sre_byteset_add_range(sre_byteset_t *set, sre_char from, sre_char to)
+{
+    unsigned        c;
+
+    for (c = from; c <= to; c++) {
+        set->bits[c >> 3] |= 1 << (c & 7);
+    }
+}
+
+
+SRE_NOAPI void
+sre_byteset_negate(sre_byteset_t *set)
+{
+    unsigned        i;
+
+    for (i = 0; i < sizeof(set->bits); i++) {
+        set->bits[i] = ~set->bits[i];
+    }
+}
+
+
+/*
+ * Prepares the lookup tables and picks the fastest scanner for the set:
+ * memchr() for a single byte, SSE2 byte comparisons for 2 or 3 bytes,
+ * and the nibble-shuffle classification (AVX2 or SSSE3, detected at
+ * runtime) for larger sets. The scalar table lookup is the fallback.
+ */
+SRE_NOAPI void
+sre_byteset_compile(sre_byteset_t *set)
+{
+    unsigned        c;
+
+    set->nbytes = 0;
+    sre_memzero(set->low_nibbles, sizeof(set->low_nibbles));
+    sre_memzero(set->high_nibbles, sizeof(set->high_nibbles));
+
+    for (c = 0; c < 256; c++) {
+        if (!sre_byteset_test(set, c)) {
+            continue;
+        }
+
+        if (set->nbytes < sizeof(set->bytes)) {
+            set->bytes[set->nbytes] = (sre_char) c;
+        }
+
+        set->nbytes++;
+
+        if (c < 0x80) {
+            set->low_nibbles[c & 0xf] |= 1 << (c >> 4);
+
+        } else {
+            set->high_nibbles[c & 0xf] |= 1 << ((c >> 4) & 7);
+        }
+    }
+
+    dd("byte set size: %u", set->nbytes);
+
+    if (set->nbytes == 1) {
+        set->find = sre_byteset_find_byte;
+        return;
+    }
+
+    set->find = sre_byteset_find_table;
+
+#if (SRE_BYTESET_SIMD)
+    if (set->nbytes == 0 || set->nbytes == 256) {
+        return;
+    }
+
+    if (set->nbytes <= sizeof(set->bytes)) {
+        if (set->nbytes == 2) {
+            set->bytes[2] = set->bytes[1];
+        }
+
+        set->find = sre_byteset_find_bytes_sse2;
+        return;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        set->find = sre_byteset_find_avx2;
+
+    } else if (__builtin_cpu_supports("ssse3")) {
+        set->find = sre_byteset_find_ssse3;
+    }
+#endif
+}
+
+
+static sre_char *
+sre_byteset_find_byte(sre_byteset_t *set, sre_char *pos, sre_char *last)
+{
+    pos = memchr(pos, set->bytes[0], last - pos);
+    if (pos == NULL) {
+        return last;
+    }
+
+    return pos;
+}
+
+
+static sre_char *
+sre_byteset_find_table(sre_byteset_t *set, sre_char *pos, sre_char *last)
+{
+    for ( ; pos != last; pos++) {
+        if (sre_byteset_test(set, *pos)) {
+            return pos;
+        }
+    }
+
+    return last;
+}
+
+
+#if (SRE_BYTESET_SIMD)
+
+static sre_char *
+sre_byteset_find_bytes_sse2(sre_byteset_t *set, sre_char *pos,
+    sre_char *last)
+{
+    int             mask;
+    __m128i         a, b, c, v, m;
+
+    a = _mm_set1_epi8((char) set->bytes[0]);
+    b = _mm_set1_epi8((char) set->bytes[1]);
+    c = _mm_set1_epi8((char) set->bytes[2]);
+
+    for ( ; last - pos >= 16; pos += 16) {
+        v = _mm_loadu_si128((__m128i *) pos);
+
+        m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a),
+                                      _mm_cmpeq_epi8(v, b)),
+                         _mm_cmpeq_epi8(v, c));
+
+        mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+    return sre_byteset_find_table(set, pos, last);
+}
+
+
+/*
+ * The low nibble of an input byte selects an entry in one of the two
+ * nibble tables (by its high bit) and the bits 4-6 select a bit in that
+ * entry, which is set when the byte is in the set.
+ */
+
+__attribute__((target("ssse3")))
+static sre_char *
+sre_byteset_find_ssse3(sre_byteset_t *set, sre_char *pos, sre_char *last)
+{
+    int             mask;
+    __m128i         lo, hi, bits, highbit, seven, v, t, r;
+
+    lo = _mm_loadu_si128((__m128i *) set->low_nibbles);
+    hi = _mm_loadu_si128((__m128i *) set->high_nibbles);
+    bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                         1, 2, 4, 8, 16, 32, 64, -128);
+    highbit = _mm_set1_epi8((char) 0x80);
+    seven = _mm_set1_epi8(7);
+
+    for ( ; last - pos >= 16; pos += 16) {
+        v = _mm_loadu_si128((__m128i *) pos);
+
+        t = _mm_or_si128(_mm_shuffle_epi8(lo, v),
+                         _mm_shuffle_epi8(hi, _mm_xor_si128(v, highbit)));
+
+        r = _mm_shuffle_epi8(bits,
+                             _mm_and_si128(_mm_srli_epi16(v, 4), seven));
+
+        r = _mm_cmpeq_epi8(_mm_and_si128(t, r), _mm_setzero_si128());
+
+        mask = _mm_movemask_epi8(r) ^ 0xffff;
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+    return sre_byteset_find_table(set, pos, last);
+}
+
+
+__attribute__((target("avx2")))
+static sre_char *
+sre_byteset_find_avx2(sre_byteset_t *set, sre_char *pos, sre_char *last)
+{
+    unsigned        mask;
+    __m256i         lo, hi, bits, highbit, seven, v, t, r;
+
+    lo = _mm256_broadcastsi128_si256(
+             _mm_loadu_si128((__m128i *) set->low_nibbles));
+    hi = _mm256_broadcastsi128_si256(
+             _mm_loadu_si128((__m128i *) set->high_nibbles));
+    bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                            1, 2, 4, 8, 16, 32, 64, -128,
+                            1, 2, 4, 8, 16, 32, 64, -128,
+                            1, 2, 4, 8, 16, 32, 64, -128);
+    highbit = _mm256_set1_epi8((char) 0x80);
+    seven = _mm256_set1_epi8(7);
+
+    for ( ; last - pos >= 32; pos += 32) {
+        v = _mm256_loadu_si256((__m256i *) pos);
+
+        t = _mm256_or_si256(_mm256_shuffle_epi8(lo, v),
+                            _mm256_shuffle_epi8(hi,
+                                                _mm256_xor_si256(v, highbit)));
+
+        r = _mm256_shuffle_epi8(bits,
+                                _mm256_and_si256(_mm256_srli_epi16(v, 4),
+                                                 seven));
+
+        r = _mm256_cmpeq_epi8(_mm256_and_si256(t, r),
+                              _mm256_setzero_si256());
+
+        mask = ~ (unsigned) _mm256_movemask_epi8(r);
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+    return sre_byteset_find_ssse3(set, pos, last);
+}
+
+#endif /* SRE_BYTESET_SIMD */
@@ -0,0 +1,50 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_BYTESET_H_INCLUDED_
+#define _SRE_BYTESET_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+
+
+#define sre_byteset_test(set, c)                                            \
+    ((set)->bits[(sre_char) (c) >> 3] & (1 << ((sre_char) (c) & 7)))
+
+#define sre_byteset_find(set, pos, last)                                    \
+    (set)->find((set), (pos), (last))
+
+
+typedef struct sre_byteset_s  sre_byteset_t;
+
+typedef sre_char *(*sre_byteset_find_pt)(sre_byteset_t *set, sre_char *pos,
+    sre_char *last);
+
+struct sre_byteset_s {
+    uint8_t                  bits[32];      /* 256-bit membership table */
+
+    /* the nibble-shuffle tables for the bytes < 0x80 and >= 0x80 */
+    uint8_t                  low_nibbles[16];
+    uint8_t                  high_nibbles[16];
+
+    unsigned                 nbytes;        /* number of bytes in the set */
+    sre_char                 bytes[3];      /* the bytes for small sets */
+
+    sre_byteset_find_pt      find;
+};
+
+
+SRE_NOAPI void sre_byteset_add_range(sre_byteset_t *set, sre_char from,
+    sre_char to);
+
+SRE_NOAPI void sre_byteset_negate(sre_byteset_t *set);
+
+SRE_NOAPI void sre_byteset_compile(sre_byteset_t *set);
+
+
+#endif /* _SRE_BYTESET_H_INCLUDED_ */
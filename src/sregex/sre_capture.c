@@ -17,22 +17,26 @@
 #include <stdio.h>
 
 
+static sre_capture_t *sre_capture_flatten(sre_pool_t *pool,
+    sre_capture_t *cap, sre_capture_free_t *freecap);
+
+
 SRE_NOAPI sre_capture_t *
 sre_capture_create(sre_pool_t *pool, size_t ovecsize, unsigned clear,
-    sre_capture_t **freecap)
+    sre_capture_free_t *freecap)
 {
     sre_char            *p;
     sre_capture_t       *cap;
 
-    if (*freecap) {
-        dd("reusing cap %p", *freecap);
-        cap = *freecap;
-        *freecap = cap->next;
+    if (freecap->vectors && freecap->vectors->ovecsize == ovecsize) {
+        dd("reusing cap %p", freecap->vectors);
+        cap = freecap->vectors;
+        freecap->vectors = cap->next;
         cap->next = NULL;
         cap->ref = 1;
 
     } else {
-        p = sre_pnalloc(pool, sizeof(sre_capture_t) + ovecsize);
+        p = sre_palloc(pool, sizeof(sre_capture_t) + ovecsize);
         if (p == NULL) {
             return NULL;
         }
@@ -41,6 +45,8 @@ sre_capture_create(sre_pool_t *pool, size_t ovecsize, unsigned clear,
 
         cap->ovecsize = ovecsize;
         cap->ref = 1;
+        cap->depth = 0;
+        cap->parent = NULL;
         cap->next = NULL;
         cap->regex_id = 0;
 
@@ -56,32 +62,197 @@ sre_capture_create(sre_pool_t *pool, size_t ovecsize, unsigned clear,
 }
 
 
+/*
+ * Sets "group" of the capture "cap" to "pos", taking over the reference to
+ * "cap" of the caller: in place when nobody else holds "cap", and in a new
+ * record on top of it otherwise.
+ */
 SRE_NOAPI sre_capture_t *
 sre_capture_update(sre_pool_t *pool, sre_capture_t *cap, sre_uint_t group,
-    sre_int_t pos, sre_capture_t **freecap)
+    sre_int_t pos, sre_capture_free_t *freecap)
 {
     sre_capture_t       *newcap;
 
     dd("update cap %u to %d", group, pos);
 
-    if (cap->ref > 1) {
-        newcap = sre_capture_create(pool, cap->ovecsize, 0, freecap);
-        if (newcap == NULL) {
-            return NULL;
+    if (group >= cap->ovecsize / sizeof(sre_int_t)) {
+        dd("bad group: %u", group);
+        return NULL;
+    }
+
+    if (cap->ref == 1) {
+        if (cap->vector) {
+            dd("!! cap %p: set group %u to %d", cap, group, pos);
+            cap->vector[group] = pos;
+            return cap;
         }
 
-        memcpy(newcap->vector, cap->vector, cap->ovecsize);
+        if (cap->group == group) {
+            dd("!! record %p: set group %u to %d", cap, group, pos);
+            cap->pos = pos;
+            return cap;
+        }
+    }
 
-        cap->ref--;
+    if (cap->depth + 1 >= cap->ovecsize / sizeof(sre_int_t)) {
+        newcap = sre_capture_flatten(pool, cap, freecap);
+        if (newcap == NULL) {
+            return NULL;
+        }
 
         dd("!! cap %p: set group %u to %d", newcap, group, pos);
         newcap->vector[group] = pos;
         return newcap;
     }
 
-    dd("!! cap %p: set group %u to %d", cap, group, pos);
-    cap->vector[group] = pos;
-    return cap;
+    if (freecap->records) {
+        newcap = freecap->records;
+        freecap->records = newcap->next;
+
+    } else {
+        newcap = sre_palloc(pool, sizeof(sre_capture_t));
+        if (newcap == NULL) {
+            return NULL;
+        }
+
+        newcap->vector = NULL;
+        newcap->next = NULL;
+        newcap->regex_id = 0;
+    }
+
+    newcap->ref = 1;
+    newcap->ovecsize = cap->ovecsize;
+    newcap->depth = cap->depth + 1;
+    newcap->parent = cap;
+    newcap->group = group;
+    newcap->pos = pos;
+
+    dd("!! record %p: set group %u to %d", newcap, group, pos);
+
+    return newcap;
+}
+
+
+/* copies the chain of records "cap" into a new whole ovector */
+static sre_capture_t *
+sre_capture_flatten(sre_pool_t *pool, sre_capture_t *cap,
+    sre_capture_free_t *freecap)
+{
+    sre_capture_t       *newcap;
+
+    newcap = sre_capture_create(pool, cap->ovecsize, 0, freecap);
+    if (newcap == NULL) {
+        return NULL;
+    }
+
+    sre_capture_copy(newcap->vector, cap, 0, cap->ovecsize);
+
+    if (--cap->ref == 0) {
+        sre_capture_free(freecap, cap);
+    }
+
+    return newcap;
+}
+
+
+/* gives back "cap", and the captures only its records were holding */
+SRE_NOAPI void
+sre_capture_free(sre_capture_free_t *freecap, sre_capture_t *cap)
+{
+    sre_capture_t       *parent;
+
+    for ( ;; ) {
+        if (cap->vector) {
+            cap->next = freecap->vectors;
+            freecap->vectors = cap;
+            return;
+        }
+
+        parent = cap->parent;
+
+        cap->next = freecap->records;
+        freecap->records = cap;
+
+        if (--parent->ref) {
+            return;
+        }
+
+        cap = parent;
+    }
+}
+
+
+SRE_NOAPI sre_int_t
+sre_capture_get(sre_capture_t *cap, sre_uint_t group)
+{
+    if (group >= cap->ovecsize / sizeof(sre_int_t)) {
+        return -1;
+    }
+
+    while (cap->vector == NULL) {
+        if (cap->group == group) {
+            return cap->pos;
+        }
+
+        cap = cap->parent;
+    }
+
+    return cap->vector[group];
+}
+
+
+/*
+ * Copies "len" bytes of the ovector of "cap" from "group" on to "vector",
+ * with the latest records first. The bytes past the end of the ovector
+ * are set to -1.
+ */
+SRE_NOAPI void
+sre_capture_copy(sre_int_t *vector, sre_capture_t *cap, sre_uint_t group,
+    size_t len)
+{
+    size_t               size;
+    sre_uint_t           i, n;
+
+    size = cap->ovecsize;
+
+    if (group * sizeof(sre_int_t) >= size) {
+        (void) memset(vector, -1, len);
+        return;
+    }
+
+    size -= group * sizeof(sre_int_t);
+
+    if (len > size) {
+        (void) memset((char *) vector + size, -1, len - size);
+        len = size;
+    }
+
+    n = len / sizeof(sre_int_t);
+
+    if (cap->vector) {
+        memcpy(vector, &cap->vector[group], len);
+        return;
+    }
+
+    /* no position is below -1, so -2 tells the groups not copied yet */
+
+    for (i = 0; i < n; i++) {
+        vector[i] = -2;
+    }
+
+    for (/* void */; cap->vector == NULL; cap = cap->parent) {
+        if (cap->group >= group && cap->group < group + n
+            && vector[cap->group - group] == -2)
+        {
+            vector[cap->group - group] = cap->pos;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (vector[i] == -2) {
+            vector[i] = cap->vector[group + i];
+        }
+    }
 }
 
 
@@ -93,7 +264,7 @@ sre_capture_dump(sre_capture_t *cap)
     n = cap->ovecsize / sizeof(sre_int_t);
 
     for (i = 0; i < n; i += 2) {
-        fprintf(stderr, " (%lld, %lld)", (long long) cap->vector[i],
-                (long long) cap->vector[i + 1]);
+        fprintf(stderr, " (%lld, %lld)", (long long) sre_capture_get(cap, i),
+                (long long) sre_capture_get(cap, i + 1));
     }
 }
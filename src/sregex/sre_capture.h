@@ -17,28 +17,53 @@
 
 #define sre_capture_decr_ref(ctx, cap)                                       \
     if (--(cap)->ref == 0) {                                                 \
-        (cap)->next = (ctx)->free_capture;                                   \
-        (ctx)->free_capture = (cap);                                         \
+        sre_capture_free(&(ctx)->free_captures, cap);                        \
     }
 
 
 typedef struct sre_capture_s  sre_capture_t;
 
+/*
+ * A capture is either a whole ovector, or a record of a single group
+ * saved on top of a capture still shared with other threads, so that a
+ * SAVE never copies the ovector of a shared capture. Each record holds a
+ * reference to the capture it updates. Chains of records as long as the
+ * ovector are copied into a new whole one.
+ */
 struct sre_capture_s {
-    unsigned         ref;  /* reference count */
+    unsigned         ref;       /* reference count */
+    unsigned         depth;     /* of the records down to the ovector */
     size_t           ovecsize;
     sre_int_t        regex_id;
-    sre_int_t       *vector;
+    sre_int_t       *vector;    /* NULL for a record */
+    sre_capture_t   *parent;    /* the capture a record updates */
+    sre_uint_t       group;     /* of a record */
+    sre_int_t        pos;
     sre_capture_t   *next;
 };
 
 
+/* the captures given back, for reuse */
+typedef struct {
+    sre_capture_t   *vectors;
+    sre_capture_t   *records;
+} sre_capture_free_t;
+
+
 SRE_NOAPI sre_capture_t *sre_capture_create(sre_pool_t *pool, size_t ovecsize,
-    unsigned clear, sre_capture_t **freecap);
+    unsigned clear, sre_capture_free_t *freecap);
 
 SRE_NOAPI sre_capture_t *sre_capture_update(sre_pool_t *pool,
     sre_capture_t *cap, sre_uint_t group, sre_int_t pos,
-    sre_capture_t **freecap);
+    sre_capture_free_t *freecap);
+
+SRE_NOAPI void sre_capture_free(sre_capture_free_t *freecap,
+    sre_capture_t *cap);
+
+SRE_NOAPI sre_int_t sre_capture_get(sre_capture_t *cap, sre_uint_t group);
+
+SRE_NOAPI void sre_capture_copy(sre_int_t *vector, sre_capture_t *cap,
+    sre_uint_t group, size_t len);
 
 SRE_NOAPI void sre_capture_dump(sre_capture_t *cap);
 
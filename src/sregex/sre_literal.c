@@ -0,0 +1,189 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_literal.h>
+
+
+#if (SRE_TARGET == SRE_ARCH_X64) && defined(__GNUC__)
+#define SRE_LITERAL_SIMD  1
+#include <immintrin.h>
+#else
+#define SRE_LITERAL_SIMD  0
+#endif
+
+
+static sre_char *sre_literal_find_byte(sre_literal_t *lit, sre_char *pos,
+    sre_char *last);
+static sre_char *sre_literal_find_scalar(sre_literal_t *lit, sre_char *pos,
+    sre_char *last);
+#if (SRE_LITERAL_SIMD)
+static sre_char *sre_literal_find_sse2(sre_literal_t *lit, sre_char *pos,
+    sre_char *last);
+static sre_char *sre_literal_find_avx2(sre_literal_t *lit, sre_char *pos,
+    sre_char *last);
+#endif
+
+
+/*
+ * All the scanners return the first position where either the whole
+ * literal matches or the rest of the buffer matches a prefix of the
+ * literal (which may be completed by the next data chunk in a stream).
+ * "last" is returned when there is no such position.
+ *
+ * The SIMD scanners test the first and the last byte of the literal for
+ * 16 or 32 positions at once and only verify the candidates passing
+ * both tests.
+ */
+SRE_NOAPI void
+sre_literal_compile(sre_literal_t *lit)
+{
+    if (lit->len == 1 && lit->bytes[0] == lit->alt_bytes[0]) {
+        lit->find = sre_literal_find_byte;
+        return;
+    }
+
+    lit->find = sre_literal_find_scalar;
+
+#if (SRE_LITERAL_SIMD)
+    if (lit->len < 2) {
+        return;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        lit->find = sre_literal_find_avx2;
+
+    } else {
+        lit->find = sre_literal_find_sse2;
+    }
+#endif
+}
+
+
+static sre_uint_t
+sre_literal_match(sre_literal_t *lit, sre_char *p, sre_uint_t n)
+{
+    sre_uint_t      i;
+
+    for (i = 0; i < n; i++) {
+        if (p[i] != lit->bytes[i] && p[i] != lit->alt_bytes[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+static sre_char *
+sre_literal_find_byte(sre_literal_t *lit, sre_char *pos, sre_char *last)
+{
+    pos = memchr(pos, lit->bytes[0], last - pos);
+    if (pos == NULL) {
+        return last;
+    }
+
+    return pos;
+}
+
+
+static sre_char *
+sre_literal_find_scalar(sre_literal_t *lit, sre_char *pos, sre_char *last)
+{
+    sre_uint_t      n;
+
+    for ( ; pos != last; pos++) {
+        n = sre_min(lit->len, (sre_uint_t) (last - pos));
+
+        if (sre_literal_match(lit, pos, n)) {
+            return pos;
+        }
+    }
+
+    return last;
+}
+
+
+#if (SRE_LITERAL_SIMD)
+
+static sre_char *
+sre_literal_find_sse2(sre_literal_t *lit, sre_char *pos, sre_char *last)
+{
+    unsigned        mask;
+    sre_uint_t      k;
+    __m128i         fa, fb, la, lb, f, l, m;
+
+    k = lit->len - 1;
+
+    fa = _mm_set1_epi8((char) lit->bytes[0]);
+    fb = _mm_set1_epi8((char) lit->alt_bytes[0]);
+    la = _mm_set1_epi8((char) lit->bytes[k]);
+    lb = _mm_set1_epi8((char) lit->alt_bytes[k]);
+
+    for ( ; (sre_uint_t) (last - pos) >= 16 + k; pos += 16) {
+        f = _mm_loadu_si128((__m128i *) pos);
+        l = _mm_loadu_si128((__m128i *) (pos + k));
+
+        m = _mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(f, fa),
+                                       _mm_cmpeq_epi8(f, fb)),
+                          _mm_or_si128(_mm_cmpeq_epi8(l, la),
+                                       _mm_cmpeq_epi8(l, lb)));
+
+        for (mask = _mm_movemask_epi8(m); mask; mask &= mask - 1) {
+            if (sre_literal_match(lit, pos + __builtin_ctz(mask), lit->len)) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+    }
+
+    return sre_literal_find_scalar(lit, pos, last);
+}
+
+
+__attribute__((target("avx2")))
+static sre_char *
+sre_literal_find_avx2(sre_literal_t *lit, sre_char *pos, sre_char *last)
+{
+    unsigned        mask;
+    sre_uint_t      k;
+    __m256i         fa, fb, la, lb, f, l, m;
+
+    k = lit->len - 1;
+
+    fa = _mm256_set1_epi8((char) lit->bytes[0]);
+    fb = _mm256_set1_epi8((char) lit->alt_bytes[0]);
+    la = _mm256_set1_epi8((char) lit->bytes[k]);
+    lb = _mm256_set1_epi8((char) lit->alt_bytes[k]);
+
+    for ( ; (sre_uint_t) (last - pos) >= 32 + k; pos += 32) {
+        f = _mm256_loadu_si256((__m256i *) pos);
+        l = _mm256_loadu_si256((__m256i *) (pos + k));
+
+        m = _mm256_and_si256(_mm256_or_si256(_mm256_cmpeq_epi8(f, fa),
+                                             _mm256_cmpeq_epi8(f, fb)),
+                             _mm256_or_si256(_mm256_cmpeq_epi8(l, la),
+                                             _mm256_cmpeq_epi8(l, lb)));
+
+        for (mask = _mm256_movemask_epi8(m); mask; mask &= mask - 1) {
+            if (sre_literal_match(lit, pos + __builtin_ctz(mask), lit->len)) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+    }
+
+    return sre_literal_find_sse2(lit, pos, last);
+}
+
+#endif /* SRE_LITERAL_SIMD */
@@ -0,0 +1,41 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_LITERAL_H_INCLUDED_
+#define _SRE_LITERAL_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+
+
+#define sre_literal_find(lit, pos, last)                                    \
+    (lit)->find((lit), (pos), (last))
+
+
+typedef struct sre_literal_s  sre_literal_t;
+
+typedef sre_char *(*sre_literal_find_pt)(sre_literal_t *lit, sre_char *pos,
+    sre_char *last);
+
+/*
+ * A literal string in which every byte may have an alternative byte,
+ * like the other letter case in caseless regexes.
+ */
+struct sre_literal_s {
+    sre_uint_t               len;
+    sre_char                *bytes;
+    sre_char                *alt_bytes;     /* same as bytes if no variant */
+
+    sre_literal_find_pt      find;
+};
+
+
+SRE_NOAPI void sre_literal_compile(sre_literal_t *lit);
+
+
+#endif /* _SRE_LITERAL_H_INCLUDED_ */
@@ -0,0 +1,667 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_multi_literal.h>
+
+
+#if (SRE_TARGET == SRE_ARCH_X64) && defined(__GNUC__)
+#define SRE_MULTI_LITERAL_SIMD  1
+#include <immintrin.h>
+#else
+#define SRE_MULTI_LITERAL_SIMD  0
+#endif
+
+
+#define sre_multi_literal_isalpha(c)                                        \
+    (((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'z')
+
+
+static void sre_multi_literal_build_classes(sre_multi_literal_t *ml);
+static sre_int_t sre_multi_literal_build_automaton(sre_pool_t *pool,
+    sre_multi_literal_t *ml);
+static sre_char *sre_multi_literal_find_ac(sre_multi_literal_t *ml,
+    sre_char *pos, sre_char *last);
+#if (SRE_MULTI_LITERAL_SIMD)
+static void sre_multi_literal_build_buckets(sre_multi_literal_t *ml);
+static sre_char *sre_multi_literal_find_ssse3(sre_multi_literal_t *ml,
+    sre_char *pos, sre_char *last);
+static sre_char *sre_multi_literal_find_avx2(sre_multi_literal_t *ml,
+    sre_char *pos, sre_char *last);
+#endif
+
+
+/*
+ * Cuts every literal to SRE_MULTI_LITERAL_MAX_LEN bytes and before the
+ * first alternative byte that is not the other case of a letter, then
+ * builds the automaton and picks the scanner: the bucket filter (AVX2 or
+ * SSSE3, detected at runtime) for up to SRE_MULTI_LITERAL_MAX_BUCKETED
+ * literals and the Aho-Corasick automaton otherwise.
+ *
+ * Returns SRE_DECLINED when no literal is left.
+ */
+SRE_NOAPI sre_int_t
+sre_multi_literal_compile(sre_pool_t *pool, sre_multi_literal_t *ml)
+{
+    sre_char            b, a;
+    sre_uint_t          i, j, n;
+    sre_literal_t      *lit;
+
+    n = 0;
+
+    for (i = 0; i < ml->count; i++) {
+        lit = &ml->literals[i];
+
+        if (lit->len > SRE_MULTI_LITERAL_MAX_LEN) {
+            lit->len = SRE_MULTI_LITERAL_MAX_LEN;
+        }
+
+        for (j = 0; j < lit->len; j++) {
+            b = lit->bytes[j];
+            a = lit->alt_bytes[j];
+
+            if (a != b && !(sre_multi_literal_isalpha(b) && (a ^ b) == 0x20)) {
+                lit->len = j;
+                break;
+            }
+        }
+
+        if (lit->len) {
+            n++;
+        }
+    }
+
+    dd("%d literals", (int) n);
+
+    if (n == 0) {
+        return SRE_DECLINED;
+    }
+
+    sre_multi_literal_build_classes(ml);
+
+    if (sre_multi_literal_build_automaton(pool, ml) != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    ml->nbucket_bytes = 0;
+    ml->same_bucket = NULL;
+
+#if (SRE_MULTI_LITERAL_SIMD)
+    if (n <= SRE_MULTI_LITERAL_MAX_BUCKETED) {
+        ml->same_bucket = sre_palloc(pool, ml->count * sizeof(sre_uint_t));
+        if (ml->same_bucket == NULL) {
+            return SRE_ERROR;
+        }
+
+        sre_multi_literal_build_buckets(ml);
+    }
+#endif
+
+    sre_multi_literal_select(ml);
+
+    return SRE_OK;
+}
+
+
+/*
+ * Picks the scanner of literals already compiled: the bucket filter when
+ * the buckets were built and the CPU has it, the automaton otherwise.
+ */
+SRE_NOAPI void
+sre_multi_literal_select(sre_multi_literal_t *ml)
+{
+    ml->find = sre_multi_literal_find_ac;
+
+#if (SRE_MULTI_LITERAL_SIMD)
+    if (ml->same_bucket == NULL) {
+        return;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        ml->find = sre_multi_literal_find_avx2;
+
+    } else if (__builtin_cpu_supports("ssse3")) {
+        ml->find = sre_multi_literal_find_ssse3;
+    }
+#endif
+}
+
+
+/*
+ * The two cases of a letter share a class when the letter is used with
+ * its other case as the alternative byte anywhere. Class 0 is for the
+ * bytes in no literal.
+ */
+static void
+sre_multi_literal_build_classes(sre_multi_literal_t *ml)
+{
+    unsigned            c, f;
+    sre_uint_t          i, j;
+    uint8_t             folded[256], used[256];
+    sre_literal_t      *lit;
+
+    sre_memzero(folded, sizeof(folded));
+    sre_memzero(used, sizeof(used));
+
+    for (i = 0; i < ml->count; i++) {
+        lit = &ml->literals[i];
+
+        for (j = 0; j < lit->len; j++) {
+            if (lit->bytes[j] != lit->alt_bytes[j]) {
+                folded[lit->bytes[j] | 0x20] = 1;
+            }
+        }
+    }
+
+    for (i = 0; i < ml->count; i++) {
+        lit = &ml->literals[i];
+
+        for (j = 0; j < lit->len; j++) {
+            used[lit->bytes[j]] = 1;
+            used[lit->alt_bytes[j]] = 1;
+        }
+    }
+
+    sre_memzero(ml->classes, sizeof(ml->classes));
+    ml->nclasses = 1;
+
+    for (c = 0; c < 256; c++) {
+        if (!used[c] || ml->classes[c]) {
+            continue;
+        }
+
+        ml->classes[c] = (uint8_t) ml->nclasses;
+
+        if (sre_multi_literal_isalpha(c) && folded[c | 0x20]) {
+            f = c ^ 0x20;
+
+            if (used[f]) {
+                ml->classes[f] = (uint8_t) ml->nclasses;
+            }
+        }
+
+        ml->nclasses++;
+    }
+
+    dd("%d byte classes", (int) ml->nclasses);
+}
+
+
+/*
+ * Builds the trie of the literals on the byte classes and completes it
+ * into the Aho-Corasick automaton. A transition goes to a child in the
+ * trie if and only if it increases the depth.
+ */
+static sre_int_t
+sre_multi_literal_build_automaton(sre_pool_t *pool, sre_multi_literal_t *ml)
+{
+    uint32_t           *next, *fail, *queue, s, t;
+    sre_uint_t          i, j, c, nc, max, head, tail;
+    sre_literal_t      *lit;
+
+    nc = ml->nclasses;
+
+    max = 1;
+    for (i = 0; i < ml->count; i++) {
+        max += ml->literals[i].len;
+    }
+
+    next = sre_pcalloc(pool, max * nc * sizeof(uint32_t));
+    if (next == NULL) {
+        return SRE_ERROR;
+    }
+
+    ml->depth = sre_pcalloc(pool, 2 * max);
+    if (ml->depth == NULL) {
+        return SRE_ERROR;
+    }
+
+    ml->out = ml->depth + max;
+
+    ml->ends = sre_palloc(pool, max * sizeof(sre_uint_t));
+    if (ml->ends == NULL) {
+        return SRE_ERROR;
+    }
+
+    ml->same_end = sre_palloc(pool, ml->count * sizeof(sre_uint_t));
+    if (ml->same_end == NULL) {
+        return SRE_ERROR;
+    }
+
+    fail = sre_palloc(pool, 2 * max * sizeof(uint32_t));
+    if (fail == NULL) {
+        return SRE_ERROR;
+    }
+
+    queue = fail + max;
+
+    for (i = 0; i < max; i++) {
+        ml->ends[i] = ml->count;
+    }
+
+    ml->nstates = 1;
+
+    /* in the reverse order so that the lists of the literal ids ascend */
+
+    for (i = ml->count; i > 0; i--) {
+        lit = &ml->literals[i - 1];
+
+        if (lit->len == 0) {
+            ml->same_end[i - 1] = ml->count;
+            continue;
+        }
+
+        s = 0;
+
+        for (j = 0; j < lit->len; j++) {
+            c = ml->classes[lit->bytes[j]];
+
+            if (next[s * nc + c] == 0) {
+                next[s * nc + c] = ml->nstates;
+                ml->depth[ml->nstates] = ml->depth[s] + 1;
+                ml->nstates++;
+            }
+
+            s = next[s * nc + c];
+        }
+
+        ml->same_end[i - 1] = ml->ends[s];
+        ml->ends[s] = i - 1;
+    }
+
+    dd("%d states", (int) ml->nstates);
+
+    /* compute the failure links breadth-first */
+
+    head = 0;
+    tail = 0;
+
+    for (c = 0; c < nc; c++) {
+        t = next[c];
+        if (t) {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+
+    while (head < tail) {
+        s = queue[head++];
+
+        if (ml->ends[s] != ml->count) {
+            ml->out[s] = ml->depth[s];
+
+        } else {
+            ml->out[s] = ml->out[fail[s]];
+        }
+
+        for (c = 0; c < nc; c++) {
+            t = next[s * nc + c];
+
+            if (t) {
+                fail[t] = next[fail[s] * nc + c];
+                queue[tail++] = t;
+
+            } else {
+                next[s * nc + c] = next[fail[s] * nc + c];
+            }
+        }
+    }
+
+    ml->next = next;
+
+    return SRE_OK;
+}
+
+
+static sre_uint_t
+sre_multi_literal_equal(sre_literal_t *lit, sre_char *p, sre_uint_t n)
+{
+    sre_uint_t      i;
+
+    for (i = 0; i < n; i++) {
+        if (p[i] != lit->bytes[i] && p[i] != lit->alt_bytes[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ * Walks the trie from "p" and collects the ids of the literals matching
+ * at "p" into "ids" in ascending order, or only tests for one when "ids"
+ * is NULL. Returns the number of them, or SRE_AGAIN when the data ends
+ * before the longer literals can be ruled out.
+ */
+SRE_NOAPI sre_int_t
+sre_multi_literal_match(sre_multi_literal_t *ml, sre_char *p,
+    sre_char *last, sre_uint_t *ids)
+{
+    uint32_t            s, t;
+    sre_char           *sp;
+    sre_uint_t          i, j, n, id;
+
+    n = 0;
+    s = 0;
+
+    for (sp = p; ; sp++) {
+        for (id = ml->ends[s]; id != ml->count; id = ml->same_end[id]) {
+            if (!sre_multi_literal_equal(&ml->literals[id], p, sp - p)) {
+                continue;
+            }
+
+            if (ids == NULL) {
+                return 1;
+            }
+
+            ids[n++] = id;
+        }
+
+        if (sp == last) {
+            return SRE_AGAIN;
+        }
+
+        t = ml->next[s * ml->nclasses + ml->classes[*sp]];
+        if (ml->depth[t] != ml->depth[s] + 1) {
+            break;
+        }
+
+        s = t;
+    }
+
+    /* merge the ids collected at the different depths */
+
+    for (i = 1; i < n; i++) {
+        id = ids[i];
+
+        for (j = i; j > 0 && ids[j - 1] > id; j--) {
+            ids[j] = ids[j - 1];
+        }
+
+        ids[j] = id;
+    }
+
+    return (sre_int_t) n;
+}
+
+
+/*
+ * Like the single literal scanners, returns the first position where a
+ * literal matches or the rest of the data matches a prefix of one.
+ *
+ * The automaton finds the leftmost occurrence on the byte classes: once
+ * one is seen, the scan goes on only while the current state may still
+ * lead to an occurrence starting before it. The occurrence is then
+ * checked against the exact literal bytes.
+ */
+static sre_char *
+sre_multi_literal_find_ac(sre_multi_literal_t *ml, sre_char *pos,
+    sre_char *last)
+{
+    uint32_t            s;
+    sre_char           *p, *best, *start;
+
+    for ( ;; ) {
+        s = 0;
+        best = NULL;
+
+        for (p = pos; p != last; p++) {
+            s = ml->next[s * ml->nclasses + ml->classes[*p]];
+
+            if (ml->out[s]) {
+                start = p + 1 - ml->out[s];
+
+                if (best == NULL || start < best) {
+                    best = start;
+                }
+            }
+
+            if (best && p + 1 - ml->depth[s] >= best) {
+                break;
+            }
+        }
+
+        if (p == last && ml->depth[s]) {
+            start = last - ml->depth[s];
+
+            if (best == NULL || start < best) {
+                best = start;
+            }
+        }
+
+        if (best == NULL) {
+            return last;
+        }
+
+        if (sre_multi_literal_match(ml, best, last, NULL) != 0) {
+            return best;
+        }
+
+        pos = best + 1;
+    }
+
+    /* impossible to reach here */
+}
+
+
+#if (SRE_MULTI_LITERAL_SIMD)
+
+static void
+sre_multi_literal_build_buckets(sre_multi_literal_t *ml)
+{
+    sre_char            c;
+    sre_uint_t          i, j, k, b, n;
+    sre_literal_t      *lit;
+
+    n = 3;
+
+    for (i = 0; i < ml->count; i++) {
+        if (ml->literals[i].len) {
+            n = sre_min(n, ml->literals[i].len);
+        }
+    }
+
+    ml->nbucket_bytes = n;
+
+    sre_memzero(ml->low_nibbles, sizeof(ml->low_nibbles));
+    sre_memzero(ml->high_nibbles, sizeof(ml->high_nibbles));
+
+    for (b = 0; b < 8; b++) {
+        ml->buckets[b] = ml->count;
+    }
+
+    for (i = 0, b = 0; i < ml->count; i++) {
+        lit = &ml->literals[i];
+
+        if (lit->len == 0) {
+            ml->same_bucket[i] = ml->count;
+            continue;
+        }
+
+        ml->same_bucket[i] = ml->buckets[b];
+        ml->buckets[b] = i;
+
+        for (j = 0; j < n; j++) {
+            for (k = 0; k < 2; k++) {
+                c = k ? lit->alt_bytes[j] : lit->bytes[j];
+
+                ml->low_nibbles[j][c & 0xf] |= 1 << b;
+                ml->high_nibbles[j][c >> 4] |= 1 << b;
+            }
+        }
+
+        b = (b + 1) & 7;
+    }
+}
+
+
+static sre_uint_t
+sre_multi_literal_verify(sre_multi_literal_t *ml, unsigned buckets,
+    sre_char *p, sre_char *last)
+{
+    sre_uint_t          i, n;
+    sre_literal_t      *lit;
+
+    for ( ; buckets; buckets &= buckets - 1) {
+        for (i = ml->buckets[__builtin_ctz(buckets)];
+             i != ml->count;
+             i = ml->same_bucket[i])
+        {
+            lit = &ml->literals[i];
+            n = sre_min(lit->len, (sre_uint_t) (last - p));
+
+            if (sre_multi_literal_equal(lit, p, n)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+static sre_char *
+sre_multi_literal_find_tail(sre_multi_literal_t *ml, sre_char *pos,
+    sre_char *last)
+{
+    for ( ; pos != last; pos++) {
+        if (sre_multi_literal_match(ml, pos, last, NULL) != 0) {
+            return pos;
+        }
+    }
+
+    return last;
+}
+
+
+/*
+ * The bucket filter: for each of the first "nbucket_bytes" bytes of the
+ * literals, the low and the high nibbles of the input byte at that
+ * offset select the buckets having a literal with a byte of such a
+ * nibble there. A position is a candidate for the buckets left in all
+ * the lookups, whose literals are then verified.
+ */
+
+__attribute__((target("ssse3")))
+static sre_char *
+sre_multi_literal_find_ssse3(sre_multi_literal_t *ml, sre_char *pos,
+    sre_char *last)
+{
+    unsigned        mask;
+    sre_uint_t      i, j, k;
+    uint8_t         buckets[16];
+    __m128i         lo[3], hi[3], nibble, v, m;
+
+    k = ml->nbucket_bytes;
+    nibble = _mm_set1_epi8(0xf);
+
+    for (j = 0; j < k; j++) {
+        lo[j] = _mm_loadu_si128((__m128i *) ml->low_nibbles[j]);
+        hi[j] = _mm_loadu_si128((__m128i *) ml->high_nibbles[j]);
+    }
+
+    for ( ; (sre_uint_t) (last - pos) >= 16 + k - 1; pos += 16) {
+        m = _mm_set1_epi8((char) 0xff);
+
+        for (j = 0; j < k; j++) {
+            v = _mm_loadu_si128((__m128i *) (pos + j));
+
+            m = _mm_and_si128(m, _mm_and_si128(
+                    _mm_shuffle_epi8(lo[j], _mm_and_si128(v, nibble)),
+                    _mm_shuffle_epi8(hi[j],
+                                     _mm_and_si128(_mm_srli_epi16(v, 4),
+                                                   nibble))));
+        }
+
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(m, _mm_setzero_si128()))
+               ^ 0xffff;
+
+        if (mask == 0) {
+            continue;
+        }
+
+        _mm_storeu_si128((__m128i *) buckets, m);
+
+        for ( ; mask; mask &= mask - 1) {
+            i = __builtin_ctz(mask);
+
+            if (sre_multi_literal_verify(ml, buckets[i], pos + i, last)) {
+                return pos + i;
+            }
+        }
+    }
+
+    return sre_multi_literal_find_tail(ml, pos, last);
+}
+
+
+__attribute__((target("avx2")))
+static sre_char *
+sre_multi_literal_find_avx2(sre_multi_literal_t *ml, sre_char *pos,
+    sre_char *last)
+{
+    unsigned        mask;
+    sre_uint_t      i, j, k;
+    uint8_t         buckets[32];
+    __m256i         lo[3], hi[3], nibble, v, m;
+
+    k = ml->nbucket_bytes;
+    nibble = _mm256_set1_epi8(0xf);
+
+    for (j = 0; j < k; j++) {
+        lo[j] = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((__m128i *) ml->low_nibbles[j]));
+        hi[j] = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((__m128i *) ml->high_nibbles[j]));
+    }
+
+    for ( ; (sre_uint_t) (last - pos) >= 32 + k - 1; pos += 32) {
+        m = _mm256_set1_epi8((char) 0xff);
+
+        for (j = 0; j < k; j++) {
+            v = _mm256_loadu_si256((__m256i *) (pos + j));
+
+            m = _mm256_and_si256(m, _mm256_and_si256(
+                    _mm256_shuffle_epi8(lo[j], _mm256_and_si256(v, nibble)),
+                    _mm256_shuffle_epi8(hi[j],
+                                        _mm256_and_si256(
+                                            _mm256_srli_epi16(v, 4),
+                                            nibble))));
+        }
+
+        mask = ~ (unsigned) _mm256_movemask_epi8(
+                   _mm256_cmpeq_epi8(m, _mm256_setzero_si256()));
+
+        if (mask == 0) {
+            continue;
+        }
+
+        _mm256_storeu_si256((__m256i *) buckets, m);
+
+        for ( ; mask; mask &= mask - 1) {
+            i = __builtin_ctz(mask);
+
+            if (sre_multi_literal_verify(ml, buckets[i], pos + i, last)) {
+                return pos + i;
+            }
+        }
+    }
+
+    return sre_multi_literal_find_ssse3(ml, pos, last);
+}
+
+#endif /* SRE_MULTI_LITERAL_SIMD */
@@ -0,0 +1,78 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_MULTI_LITERAL_H_INCLUDED_
+#define _SRE_MULTI_LITERAL_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_literal.h>
+
+
+/* longer literals are cut to this length */
+#define SRE_MULTI_LITERAL_MAX_LEN  8
+
+/* up to this many literals are scanned by the SIMD bucket filter */
+#define SRE_MULTI_LITERAL_MAX_BUCKETED  32
+
+
+#define sre_multi_literal_find(ml, pos, last)                               \
+    (ml)->find((ml), (pos), (last))
+
+
+typedef struct sre_multi_literal_s  sre_multi_literal_t;
+
+typedef sre_char *(*sre_multi_literal_find_pt)(sre_multi_literal_t *ml,
+    sre_char *pos, sre_char *last);
+
+/*
+ * A set of literals searched for at once. The id of a literal is its
+ * index in "literals", and literals of zero length are not searched.
+ *
+ * All the literals are folded into an Aho-Corasick automaton on byte
+ * classes, in which the two cases of the letters used with their other
+ * case as the alternative byte share a class. For small sets, the
+ * literals are also spread into 8 buckets for the SIMD filter on their
+ * first bytes.
+ */
+struct sre_multi_literal_s {
+    sre_uint_t                   count;
+    sre_literal_t               *literals;
+
+    sre_uint_t                   nclasses;
+    sre_uint_t                   nstates;
+    uint8_t                      classes[256];
+    uint32_t                    *next;      /* nstates * nclasses */
+    uint8_t                     *depth;     /* per state */
+    uint8_t                     *out;       /* per state, the longest
+                                               literal ending there */
+    sre_uint_t                  *ends;      /* per state, the first literal
+                                               ending there, or count */
+    sre_uint_t                  *same_end;  /* per literal, the next one
+                                               ending at the same state */
+
+    sre_uint_t                   nbucket_bytes;
+    uint8_t                      low_nibbles[3][16];
+    uint8_t                      high_nibbles[3][16];
+    sre_uint_t                   buckets[8];    /* the first literal in a
+                                                   bucket, or count */
+    sre_uint_t                  *same_bucket;
+
+    sre_multi_literal_find_pt    find;
+};
+
+
+SRE_NOAPI sre_int_t sre_multi_literal_compile(sre_pool_t *pool,
+    sre_multi_literal_t *ml);
+SRE_NOAPI void sre_multi_literal_select(sre_multi_literal_t *ml);
+
+SRE_NOAPI sre_int_t sre_multi_literal_match(sre_multi_literal_t *ml,
+    sre_char *p, sre_char *last, sre_uint_t *ids);
+
+
+#endif /* _SRE_MULTI_LITERAL_H_INCLUDED_ */
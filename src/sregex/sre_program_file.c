@@ -0,0 +1,1189 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_glushkov.h>
+#include <sregex/sre_vm_onepass.h>
+#include <sregex/sre_vm_tdfa.h>
+#include <sregex/sre_vm_closure.h>
+#include <sregex/sre_vm_backtrack.h>
+#include <sregex/sre_vm_thompson.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#define SRE_PROGRAM_FILE_MAGIC      0x50455253  /* "SREP" */
+#define SRE_PROGRAM_FILE_VERSION    2
+
+/* the alignment of every table in the file */
+#define SRE_PROGRAM_FILE_ALIGNMENT  16
+
+
+/*
+ * The layout of a saved program. The file is the image of the tables the
+ * VMs read, in the layout they read them, so that a program loaded is
+ * the mapping of the file plus a few structures pointing into it. All the
+ * references are offsets from the start of the file, 0 for the tables
+ * absent. The numbers are in the byte order and with the word size of the
+ * machine saving it, which the header records.
+ */
+typedef struct {
+    uint64_t            start;      /* the instructions */
+    uint64_t            len;        /* 0 for no program */
+    uint64_t            data;
+    uint64_t            data_len;
+    uint64_t            slots;      /* len sre_uint_t */
+    uint64_t            nslots;
+    uint64_t            emitted_len;
+    uint64_t            threaded_jumps;
+    uint64_t            simplified_classes;
+    uint64_t            nullable;
+} sre_program_file_image_t;
+
+
+typedef struct {
+    uint64_t            len;        /* 0 for no literal */
+    uint64_t            bytes;      /* len bytes, then len alt_bytes */
+} sre_program_file_literal_t;
+
+
+/* see sre_program_multi_t and sre_multi_literal_t */
+typedef struct {
+    uint64_t            starts;     /* nregexes uint32_t */
+    uint64_t            always;     /* nalways sre_uint_t, then ngated */
+    uint64_t            nalways;
+    uint64_t            ngated;
+    uint64_t            lens;       /* nregexes sre_uint_t */
+    uint64_t            bytes;      /* SRE_MULTI_LITERAL_MAX_LEN bytes and
+                                       as many alt_bytes per literal */
+    uint64_t            nclasses;
+    uint64_t            nstates;
+    uint64_t            next;       /* nstates * nclasses uint32_t */
+    uint64_t            depth;      /* nstates bytes */
+    uint64_t            out;        /* nstates bytes */
+    uint64_t            ends;       /* nstates sre_uint_t */
+    uint64_t            same_end;   /* nregexes sre_uint_t */
+    uint64_t            same_bucket;    /* nregexes sre_uint_t, or 0 */
+    uint64_t            nbucket_bytes;
+    uint64_t            buckets[8];
+    uint8_t             classes[256];
+    uint8_t             low_nibbles[3][16];
+    uint8_t             high_nibbles[3][16];
+} sre_program_file_multi_t;
+
+
+typedef struct {
+    uint32_t                     magic;
+    uint16_t                     version;
+    uint8_t                      word_size;  /* sizeof(sre_uint_t) */
+    uint8_t                      inst_size;  /* sizeof(sre_instruction_t) */
+    uint32_t                     checksum;   /* of the whole file, taken
+                                                with this field as 0 */
+    uint32_t                     reserved;
+    uint64_t                     size;
+    uint64_t                     nregexes;
+    uint64_t                     multi_ncaps;    /* nregexes sre_uint_t */
+    uint64_t                     ovecsize;
+    uint64_t                     leading_set;    /* the 32-byte table */
+    sre_program_file_literal_t   prefix;
+    sre_program_file_literal_t   inner;
+    sre_program_file_image_t     program;
+    sre_program_file_image_t     inner_prefix;
+    sre_program_file_image_t     reverse;
+    uint64_t                     multi;  /* sre_program_file_multi_t */
+} sre_program_file_header_t;
+
+
+typedef struct {
+    sre_pool_t          *pool;
+    uint8_t             *buf;
+    size_t               len;
+    size_t               size;
+} sre_program_file_writer_t;
+
+
+typedef struct {
+    uint8_t             *addr;
+    size_t               size;
+} sre_program_file_mapping_t;
+
+
+static sre_int_t sre_program_file_save_image(sre_program_file_writer_t *w,
+    sre_program_t *prog, sre_program_file_image_t *image);
+static sre_int_t sre_program_file_save_literal(sre_program_file_writer_t *w,
+    sre_literal_t *lit, sre_program_file_literal_t *res);
+static sre_int_t sre_program_file_save_multi(sre_program_file_writer_t *w,
+    sre_program_t *prog, uint64_t *res);
+static sre_int_t sre_program_file_add(sre_program_file_writer_t *w,
+    const void *data, size_t len, uint64_t *offset);
+static uint32_t sre_program_file_checksum(const uint8_t *p, size_t len);
+static void sre_program_file_unmap(void *data);
+static const void *sre_program_file_get(sre_program_file_header_t *h,
+    uint64_t offset, uint64_t n, size_t size);
+static sre_program_t *sre_program_file_load_image(sre_pool_t *pool,
+    sre_program_file_header_t *h, sre_program_file_image_t *image,
+    sre_program_t *prog);
+static sre_int_t sre_program_file_check_image(sre_program_t *prog,
+    sre_uint_t nregexes, sre_uint_t ngroups);
+static sre_int_t sre_program_file_check_counter(sre_program_t *prog,
+    sre_instruction_t *pc);
+static sre_literal_t *sre_program_file_load_literal(sre_pool_t *pool,
+    sre_program_file_header_t *h, sre_program_file_literal_t *lit);
+static sre_program_multi_t *sre_program_file_load_multi(sre_pool_t *pool,
+    sre_program_file_header_t *h, sre_program_t *prog);
+
+
+/*
+ * Saves the compiled program into the file at "path", to be mapped by
+ * sre_program_load. The file is written aside and renamed into place, so
+ * that the processes still mapping the former one keep seeing it whole.
+ */
+SRE_API sre_int_t
+sre_program_save(sre_program_t *prog, const char *path)
+{
+    int                          fd;
+    char                        *tmp;
+    size_t                       n;
+    ssize_t                      written;
+    sre_int_t                    rc;
+    sre_pool_t                  *pool;
+    sre_program_file_header_t   *h, header;
+    sre_program_file_writer_t    w;
+
+    pool = sre_create_pool(1024);
+    if (pool == NULL) {
+        return SRE_ERROR;
+    }
+
+    rc = SRE_ERROR;
+    fd = -1;
+    tmp = NULL;
+
+    sre_memzero(&w, sizeof(sre_program_file_writer_t));
+    sre_memzero(&header, sizeof(sre_program_file_header_t));
+
+    w.pool = pool;
+
+    /* the header is filled in at last */
+
+    if (sre_program_file_add(&w, NULL, sizeof(header), NULL) != SRE_OK) {
+        goto done;
+    }
+
+    header.magic = SRE_PROGRAM_FILE_MAGIC;
+    header.version = SRE_PROGRAM_FILE_VERSION;
+    header.word_size = (uint8_t) sizeof(sre_uint_t);
+    header.inst_size = (uint8_t) sizeof(sre_instruction_t);
+    header.nregexes = prog->nregexes;
+    header.ovecsize = prog->ovecsize;
+
+    if (sre_program_file_add(&w, prog->multi_ncaps,
+                             prog->nregexes * sizeof(sre_uint_t),
+                             &header.multi_ncaps)
+        != SRE_OK)
+    {
+        goto done;
+    }
+
+    if (sre_program_file_save_image(&w, prog, &header.program) != SRE_OK) {
+        goto done;
+    }
+
+    if (prog->inner_prefix
+        && sre_program_file_save_image(&w, prog->inner_prefix,
+                                       &header.inner_prefix)
+           != SRE_OK)
+    {
+        goto done;
+    }
+
+    if (prog->reverse
+        && sre_program_file_save_image(&w, prog->reverse, &header.reverse)
+           != SRE_OK)
+    {
+        goto done;
+    }
+
+    if (prog->leading_set
+        && sre_program_file_add(&w, prog->leading_set->bits,
+                                sizeof(prog->leading_set->bits),
+                                &header.leading_set)
+           != SRE_OK)
+    {
+        goto done;
+    }
+
+    if (sre_program_file_save_literal(&w, prog->prefix, &header.prefix)
+        != SRE_OK
+        || sre_program_file_save_literal(&w, prog->inner, &header.inner)
+           != SRE_OK
+        || sre_program_file_save_multi(&w, prog, &header.multi) != SRE_OK)
+    {
+        goto done;
+    }
+
+    /* the padding of the last table */
+
+    if (sre_program_file_add(&w, NULL, 0, NULL) != SRE_OK) {
+        goto done;
+    }
+
+    header.size = w.len;
+
+    h = (sre_program_file_header_t *) w.buf;
+    memcpy(h, &header, sizeof(header));
+    h->checksum = sre_program_file_checksum(w.buf, w.len);
+
+    dd("program file size: %d", (int) w.len);
+
+    n = strlen(path);
+
+    tmp = sre_pnalloc(pool, n + sizeof(".XXXXXX"));
+    if (tmp == NULL) {
+        goto done;
+    }
+
+    memcpy(tmp, path, n);
+    memcpy(tmp + n, ".XXXXXX", sizeof(".XXXXXX"));
+
+    fd = mkstemp(tmp);
+    if (fd == -1) {
+        tmp = NULL;
+        goto done;
+    }
+
+    for (n = 0; n < w.len; n += written) {
+        written = write(fd, w.buf + n, w.len - n);
+        if (written == -1) {
+            goto done;
+        }
+    }
+
+    if (fchmod(fd, 0644) == -1 || close(fd) == -1) {
+        fd = -1;
+        goto done;
+    }
+
+    fd = -1;
+
+    if (rename(tmp, path) == -1) {
+        goto done;
+    }
+
+    tmp = NULL;
+    rc = SRE_OK;
+
+done:
+
+    if (fd != -1) {
+        (void) close(fd);
+    }
+
+    if (tmp) {
+        (void) unlink(tmp);
+    }
+
+    sre_destroy_pool(pool);
+
+    return rc;
+}
+
+
+static sre_int_t
+sre_program_file_save_image(sre_program_file_writer_t *w, sre_program_t *prog,
+    sre_program_file_image_t *image)
+{
+    image->len = prog->len;
+    image->data_len = prog->data_len;
+    image->nslots = prog->nslots;
+    image->emitted_len = prog->emitted_len;
+    image->threaded_jumps = prog->threaded_jumps;
+    image->simplified_classes = prog->simplified_classes;
+    image->nullable = prog->nullable;
+
+    if (sre_program_file_add(w, prog->start,
+                             prog->len * sizeof(sre_instruction_t),
+                             &image->start)
+        != SRE_OK)
+    {
+        return SRE_ERROR;
+    }
+
+    if (prog->data_len
+        && sre_program_file_add(w, prog->data, prog->data_len, &image->data)
+           != SRE_OK)
+    {
+        return SRE_ERROR;
+    }
+
+    if (prog->slots
+        && sre_program_file_add(w, prog->slots,
+                                prog->len * sizeof(sre_uint_t),
+                                &image->slots)
+           != SRE_OK)
+    {
+        return SRE_ERROR;
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_program_file_save_literal(sre_program_file_writer_t *w,
+    sre_literal_t *lit, sre_program_file_literal_t *res)
+{
+    sre_char            *bytes;
+
+    if (lit == NULL) {
+        return SRE_OK;
+    }
+
+    bytes = sre_pnalloc(w->pool, 2 * lit->len);
+    if (bytes == NULL) {
+        return SRE_ERROR;
+    }
+
+    memcpy(bytes, lit->bytes, lit->len);
+    memcpy(bytes + lit->len, lit->alt_bytes, lit->len);
+
+    res->len = lit->len;
+
+    return sre_program_file_add(w, bytes, 2 * lit->len, &res->bytes);
+}
+
+
+static sre_int_t
+sre_program_file_save_multi(sre_program_file_writer_t *w, sre_program_t *prog,
+    uint64_t *res)
+{
+    sre_char                    *bytes;
+    sre_uint_t                   i, n, max, *lens, *ids;
+    sre_literal_t               *lit;
+    sre_multi_literal_t         *ml;
+    sre_program_multi_t         *multi;
+    sre_program_file_multi_t     fm;
+
+    multi = prog->multi;
+    if (multi == NULL) {
+        return SRE_OK;
+    }
+
+    ml = &multi->prefixes;
+    n = prog->nregexes;
+    max = SRE_MULTI_LITERAL_MAX_LEN;
+
+    sre_memzero(&fm, sizeof(sre_program_file_multi_t));
+
+    lens = sre_palloc(w->pool, 2 * n * sizeof(sre_uint_t));
+    bytes = sre_pcalloc(w->pool, 2 * n * max);
+
+    if (lens == NULL || bytes == NULL) {
+        return SRE_ERROR;
+    }
+
+    /* the regexes always started and the gated ones, back to back */
+
+    ids = lens + n;
+
+    memcpy(ids, multi->always, multi->nalways * sizeof(sre_uint_t));
+    memcpy(ids + multi->nalways, multi->gated,
+           multi->ngated * sizeof(sre_uint_t));
+
+    for (i = 0; i < n; i++) {
+        lit = &ml->literals[i];
+
+        lens[i] = lit->len;
+        memcpy(bytes + 2 * i * max, lit->bytes, lit->len);
+        memcpy(bytes + 2 * i * max + max, lit->alt_bytes, lit->len);
+    }
+
+    fm.nalways = multi->nalways;
+    fm.ngated = multi->ngated;
+    fm.nclasses = ml->nclasses;
+    fm.nstates = ml->nstates;
+    fm.nbucket_bytes = ml->nbucket_bytes;
+
+    memcpy(fm.buckets, ml->buckets, sizeof(fm.buckets));
+    memcpy(fm.classes, ml->classes, sizeof(fm.classes));
+    memcpy(fm.low_nibbles, ml->low_nibbles, sizeof(fm.low_nibbles));
+    memcpy(fm.high_nibbles, ml->high_nibbles, sizeof(fm.high_nibbles));
+
+    if (sre_program_file_add(w, multi->starts, n * sizeof(uint32_t),
+                             &fm.starts) != SRE_OK
+        || sre_program_file_add(w, ids, n * sizeof(sre_uint_t), &fm.always)
+           != SRE_OK
+        || sre_program_file_add(w, lens, n * sizeof(sre_uint_t), &fm.lens)
+           != SRE_OK
+        || sre_program_file_add(w, bytes, 2 * n * max, &fm.bytes) != SRE_OK
+        || sre_program_file_add(w, ml->next,
+                                ml->nstates * ml->nclasses * sizeof(uint32_t),
+                                &fm.next) != SRE_OK
+        || sre_program_file_add(w, ml->depth, ml->nstates, &fm.depth)
+           != SRE_OK
+        || sre_program_file_add(w, ml->out, ml->nstates, &fm.out) != SRE_OK
+        || sre_program_file_add(w, ml->ends, ml->nstates * sizeof(sre_uint_t),
+                                &fm.ends) != SRE_OK
+        || sre_program_file_add(w, ml->same_end, n * sizeof(sre_uint_t),
+                                &fm.same_end) != SRE_OK
+        || (ml->same_bucket
+            && sre_program_file_add(w, ml->same_bucket,
+                                    n * sizeof(sre_uint_t), &fm.same_bucket)
+               != SRE_OK))
+    {
+        return SRE_ERROR;
+    }
+
+    return sre_program_file_add(w, &fm, sizeof(fm), res);
+}
+
+
+/*
+ * Appends "len" bytes at the next aligned offset, which is stored in
+ * "offset" unless it is NULL. A NULL "data" appends zeros.
+ */
+static sre_int_t
+sre_program_file_add(sre_program_file_writer_t *w, const void *data,
+    size_t len, uint64_t *offset)
+{
+    size_t           start, size;
+    uint8_t         *buf;
+
+    start = sre_align(w->len, SRE_PROGRAM_FILE_ALIGNMENT);
+
+    if (start + len > w->size) {
+        size = w->size ? 2 * w->size : 4096;
+        while (size < start + len) {
+            size *= 2;
+        }
+
+        buf = sre_palloc(w->pool, size);
+        if (buf == NULL) {
+            return SRE_ERROR;
+        }
+
+        if (w->len) {
+            memcpy(buf, w->buf, w->len);
+            (void) sre_pfree(w->pool, w->buf);
+        }
+
+        w->buf = buf;
+        w->size = size;
+    }
+
+    sre_memzero(w->buf + w->len, start - w->len);
+
+    if (data) {
+        memcpy(w->buf + start, data, len);
+
+    } else {
+        sre_memzero(w->buf + start, len);
+    }
+
+    w->len = start + len;
+
+    if (offset) {
+        *offset = start;
+    }
+
+    return SRE_OK;
+}
+
+
+/* FNV-1a over the 32-bit words */
+static uint32_t
+sre_program_file_checksum(const uint8_t *p, size_t len)
+{
+    size_t           i;
+    uint32_t         hash, word;
+
+    hash = 2166136261u;
+
+    for (i = 0; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+        memcpy(&word, p + i, sizeof(uint32_t));
+
+        if (i == offsetof(sre_program_file_header_t, checksum)) {
+            word = 0;
+        }
+
+        hash = (hash ^ word) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+/*
+ * Maps the program saved at "path" by sre_program_save read-only and
+ * private, so that the forked processes loading the same file share its
+ * pages, which stay mapped until the pool is destroyed. Only the header,
+ * the checksum and the bounds of the indices and offsets in the tables
+ * are checked: the instructions are used in place. The analyses of the
+ * program for the VMs are run again on the mapping, as sre_regex_compile
+ * does.
+ *
+ * Returns NULL if the file cannot be read, is not a program saved by
+ * this version of the library on this kind of machine, or is corrupted.
+ */
+SRE_API sre_program_t *
+sre_program_load(sre_pool_t *pool, const char *path)
+{
+    int                          fd;
+    uint8_t                     *addr;
+    sre_uint_t                   i, ovecsize, ngroups;
+    struct stat                  st;
+    const uint8_t               *bits;
+    const sre_uint_t            *multi_ncaps;
+    sre_program_t               *prog;
+    sre_pool_cleanup_t          *cln;
+    sre_program_file_header_t   *h;
+    sre_program_file_mapping_t  *m;
+
+    cln = sre_pool_cleanup_add(pool, sizeof(sre_program_file_mapping_t));
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == -1
+        || (size_t) st.st_size < sizeof(sre_program_file_header_t))
+    {
+        (void) close(fd);
+        return NULL;
+    }
+
+    addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    (void) close(fd);
+
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    m = cln->data;
+    m->addr = addr;
+    m->size = (size_t) st.st_size;
+
+    cln->handler = sre_program_file_unmap;
+
+    h = (sre_program_file_header_t *) addr;
+
+    if (h->magic != SRE_PROGRAM_FILE_MAGIC
+        || h->version != SRE_PROGRAM_FILE_VERSION
+        || h->word_size != sizeof(sre_uint_t)
+        || h->inst_size != sizeof(sre_instruction_t)
+        || h->size != (uint64_t) st.st_size
+        || h->size % sizeof(uint32_t)
+        || h->checksum != sre_program_file_checksum(addr, m->size))
+    {
+        dd("bad program file header");
+        return NULL;
+    }
+
+    if (h->nregexes == 0 || h->program.len == 0
+        || (h->inner.len && h->inner_prefix.len == 0))
+    {
+        return NULL;
+    }
+
+    /*
+     * every regex and every group kept is saved by two SAVE instructions,
+     * which bounds the sizes computed from them below
+     */
+
+    if (h->program.len > (uint32_t) -1
+        || h->ovecsize % (2 * sizeof(sre_uint_t))
+        || h->ovecsize / sizeof(sre_uint_t) > h->program.len
+        || h->nregexes > h->ovecsize / (2 * sizeof(sre_uint_t)))
+    {
+        return NULL;
+    }
+
+    ngroups = h->ovecsize / sizeof(sre_uint_t);
+
+    multi_ncaps = sre_program_file_get(h, h->multi_ncaps, h->nregexes,
+                                       sizeof(sre_uint_t));
+    if (multi_ncaps == NULL) {
+        return NULL;
+    }
+
+    ovecsize = 0;
+    for (i = 0; i < h->nregexes; i++) {
+        if (multi_ncaps[i] >= ngroups / 2 - ovecsize) {
+            return NULL;
+        }
+
+        ovecsize += multi_ncaps[i] + 1;
+    }
+
+    if (ovecsize != ngroups / 2) {
+        return NULL;
+    }
+
+    prog = sre_pcalloc(pool, sizeof(sre_program_t)
+                             + (h->nregexes - 1) * sizeof(sre_uint_t));
+    if (prog == NULL) {
+        return NULL;
+    }
+
+    prog->nregexes = h->nregexes;
+    prog->ovecsize = h->ovecsize;
+
+    memcpy(prog->multi_ncaps, multi_ncaps,
+           h->nregexes * sizeof(sre_uint_t));
+
+    if (sre_program_file_load_image(pool, h, &h->program, prog) == NULL
+        || sre_program_file_check_image(prog, prog->nregexes, ngroups)
+           != SRE_OK)
+    {
+        return NULL;
+    }
+
+    if (h->inner_prefix.len) {
+        prog->inner_prefix = sre_program_file_load_image(pool, h,
+                                                         &h->inner_prefix,
+                                                         NULL);
+        if (prog->inner_prefix == NULL
+            || sre_program_file_check_image(prog->inner_prefix, 1, 0)
+               != SRE_OK)
+        {
+            return NULL;
+        }
+    }
+
+    if (h->reverse.len) {
+        prog->reverse = sre_program_file_load_image(pool, h, &h->reverse,
+                                                    NULL);
+        if (prog->reverse == NULL
+            || sre_program_file_check_image(prog->reverse, prog->nregexes, 0)
+               != SRE_OK)
+        {
+            return NULL;
+        }
+    }
+
+    if (h->leading_set) {
+        prog->leading_set = sre_pcalloc(pool, sizeof(sre_byteset_t));
+        bits = sre_program_file_get(h, h->leading_set, 1,
+                                    sizeof(prog->leading_set->bits));
+
+        if (prog->leading_set == NULL || bits == NULL) {
+            return NULL;
+        }
+
+        memcpy(prog->leading_set->bits, bits,
+               sizeof(prog->leading_set->bits));
+
+        sre_byteset_compile(prog->leading_set);
+    }
+
+    if (h->prefix.len) {
+        prog->prefix = sre_program_file_load_literal(pool, h, &h->prefix);
+        if (prog->prefix == NULL) {
+            return NULL;
+        }
+    }
+
+    if (h->inner.len) {
+        prog->inner = sre_program_file_load_literal(pool, h, &h->inner);
+        if (prog->inner == NULL) {
+            return NULL;
+        }
+    }
+
+    if (h->multi) {
+        prog->multi = sre_program_file_load_multi(pool, h, prog);
+        if (prog->multi == NULL) {
+            return NULL;
+        }
+    }
+
+    /* see sre_regex_compile_captures */
+
+    if (sre_vm_closure_compile(pool, prog) == SRE_ERROR
+        || sre_vm_glushkov_compile(pool, prog) == SRE_ERROR
+        || sre_vm_onepass_compile(pool, prog) == SRE_ERROR)
+    {
+        return NULL;
+    }
+
+    if (prog->onepass == NULL) {
+        if (sre_vm_tdfa_compile(pool, prog) == SRE_ERROR) {
+            return NULL;
+        }
+
+    } else {
+        prog->tdfa = NULL;
+    }
+
+    if (sre_vm_backtrack_compile(pool, prog) == SRE_ERROR
+        || sre_vm_thompson_jit_count_threads(prog) == SRE_ERROR)
+    {
+        return NULL;
+    }
+
+    return prog;
+}
+
+
+static void
+sre_program_file_unmap(void *data)
+{
+    sre_program_file_mapping_t  *m = data;
+
+    (void) munmap(m->addr, m->size);
+}
+
+
+/*
+ * Returns the table of "n" items of "size" bytes at "offset", or NULL
+ * when it does not lie in the file.
+ */
+static const void *
+sre_program_file_get(sre_program_file_header_t *h, uint64_t offset,
+    uint64_t n, size_t size)
+{
+    if (offset < sizeof(sre_program_file_header_t)
+        || offset % SRE_PROGRAM_FILE_ALIGNMENT
+        || offset > h->size
+        || n > (h->size - offset) / size)
+    {
+        return NULL;
+    }
+
+    return (uint8_t *) h + offset;
+}
+
+
+static sre_program_t *
+sre_program_file_load_image(sre_pool_t *pool, sre_program_file_header_t *h,
+    sre_program_file_image_t *image, sre_program_t *prog)
+{
+    if (image->len > (uint32_t) -1 || image->data_len > (uint32_t) -1) {
+        return NULL;
+    }
+
+    if (prog == NULL) {
+        /* see sre_regex_compile_anchored */
+
+        prog = sre_pcalloc(pool, sizeof(sre_program_t));
+        if (prog == NULL) {
+            return NULL;
+        }
+
+        prog->nregexes = 1;
+    }
+
+    prog->len = image->len;
+    prog->start = (sre_instruction_t *)
+                  sre_program_file_get(h, image->start, image->len,
+                                       sizeof(sre_instruction_t));
+
+    prog->data_len = image->data_len;
+    prog->data = NULL;
+
+    if (image->data_len) {
+        prog->data = (uint8_t *) sre_program_file_get(h, image->data,
+                                                      image->data_len, 1);
+        if (prog->data == NULL) {
+            return NULL;
+        }
+    }
+
+    prog->nslots = image->nslots;
+    prog->slots = NULL;
+
+    if (image->slots) {
+        if (image->nslots > SRE_PROGRAM_MAX_SLOTS) {
+            return NULL;
+        }
+
+        prog->slots = (sre_uint_t *)
+                      sre_program_file_get(h, image->slots, image->len,
+                                           sizeof(sre_uint_t));
+        if (prog->slots == NULL) {
+            return NULL;
+        }
+    }
+
+    prog->emitted_len = image->emitted_len;
+    prog->threaded_jumps = image->threaded_jumps;
+    prog->simplified_classes = image->simplified_classes;
+    prog->nullable = (unsigned) image->nullable;
+
+    if (prog->start == NULL) {
+        return NULL;
+    }
+
+    return prog;
+}
+
+
+/*
+ * Checks that the instructions only refer to other instructions, the
+ * data, the groups and the regexes of the program, and that none but the
+ * jumps and MATCH ends it.
+ */
+static sre_int_t
+sre_program_file_check_image(sre_program_t *prog, sre_uint_t nregexes,
+    sre_uint_t ngroups)
+{
+    sre_uint_t           i, size;
+    sre_instruction_t   *pc;
+
+    if (prog->slots == NULL && prog->nslots != prog->len) {
+        return SRE_ERROR;
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (prog->slots && prog->slots[i] >= prog->nslots) {
+            return SRE_ERROR;
+        }
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_MATCH:
+            if (pc->v.regex_id < 0
+                || (sre_uint_t) pc->v.regex_id >= nregexes)
+            {
+                return SRE_ERROR;
+            }
+
+            continue;
+
+        case SRE_OPCODE_JMP:
+            if (pc->x >= prog->len) {
+                return SRE_ERROR;
+            }
+
+            continue;
+
+        case SRE_OPCODE_SPLIT:
+            if (pc->x >= prog->len || pc->y >= prog->len) {
+                return SRE_ERROR;
+            }
+
+            continue;
+
+        case SRE_OPCODE_COUNT:
+            if (pc->x > i || pc->y >= prog->len || prog->slots == NULL) {
+                return SRE_ERROR;
+            }
+
+            size = sizeof(sre_vm_repeat_t);
+            break;
+
+        case SRE_OPCODE_BITMAP:
+            if (pc->v.data & SRE_PROGRAM_CLASS_BITMAP) {
+                if ((pc->v.data & ~SRE_PROGRAM_CLASS_BITMAP)
+                    >= SRE_PROGRAM_NCLASS_BITMAPS)
+                {
+                    return SRE_ERROR;
+                }
+
+                size = 0;
+                break;
+            }
+
+            size = 32;
+            break;
+
+        case SRE_OPCODE_SAVE:
+            if (pc->v.group >= ngroups) {
+                return SRE_ERROR;
+            }
+
+            size = 0;
+            break;
+
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_ASSERT:
+            size = 0;
+            break;
+
+        default:
+            return SRE_ERROR;
+        }
+
+        if (size
+            && (pc->v.data > prog->data_len
+                || size > prog->data_len - pc->v.data
+                || (pc->opcode == SRE_OPCODE_COUNT
+                    && pc->v.data % sizeof(sre_uint_t))))
+        {
+            return SRE_ERROR;
+        }
+
+        if (pc->opcode == SRE_OPCODE_COUNT
+            && sre_program_file_check_counter(prog, pc) != SRE_OK)
+        {
+            return SRE_ERROR;
+        }
+
+        if (i + 1 == prog->len) {
+            return SRE_ERROR;
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+/*
+ * Checks that the body of a counter loop only jumps inside itself or to
+ * its COUNT, which the threads carrying a counter never leave but through
+ * "y", and that the slots of every instruction of the body hold all the
+ * counter values: from 0 to max - 1, or to min for the loops without an
+ * upper bound (see sre_program_slot and sre_vm_pike_add_thread).
+ */
+static sre_int_t
+sre_program_file_check_counter(sre_program_t *prog, sre_instruction_t *pc)
+{
+    sre_uint_t           i, j, n;
+    sre_vm_repeat_t     *repeat;
+    sre_instruction_t   *body;
+
+    i = pc - prog->start;
+    repeat = sre_program_repeat(prog, pc);
+
+    if (repeat->max) {
+        if (repeat->min > repeat->max) {
+            return SRE_ERROR;
+        }
+
+        n = repeat->max;
+
+    } else {
+        if (repeat->min == (sre_uint_t) -1) {
+            return SRE_ERROR;
+        }
+
+        n = repeat->min + 1;
+    }
+
+    for (j = pc->x; j <= i; j++) {
+        if (n > prog->nslots - prog->slots[j]) {
+            return SRE_ERROR;
+        }
+
+        if (j == i) {
+            break;
+        }
+
+        body = &prog->start[j];
+
+        switch (body->opcode) {
+        case SRE_OPCODE_SPLIT:
+            if (body->y < pc->x || body->y > i) {
+                return SRE_ERROR;
+            }
+
+            /* fall through */
+
+        case SRE_OPCODE_JMP:
+            if (body->x < pc->x || body->x > i) {
+                return SRE_ERROR;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+        case SRE_OPCODE_COUNT:
+            return SRE_ERROR;
+
+        default:
+            break;
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_literal_t *
+sre_program_file_load_literal(sre_pool_t *pool, sre_program_file_header_t *h,
+    sre_program_file_literal_t *lit)
+{
+    sre_char            *bytes;
+    sre_literal_t       *res;
+
+    bytes = (sre_char *) sre_program_file_get(h, lit->bytes, lit->len, 2);
+    if (bytes == NULL) {
+        return NULL;
+    }
+
+    res = sre_palloc(pool, sizeof(sre_literal_t));
+    if (res == NULL) {
+        return NULL;
+    }
+
+    res->len = lit->len;
+    res->bytes = bytes;
+    res->alt_bytes = bytes + lit->len;
+
+    sre_literal_compile(res);
+
+    return res;
+}
+
+
+static sre_program_multi_t *
+sre_program_file_load_multi(sre_pool_t *pool, sre_program_file_header_t *h,
+    sre_program_t *prog)
+{
+    sre_char                    *bytes;
+    sre_uint_t                   i, n, max, nnext;
+    const sre_uint_t            *lens;
+    sre_literal_t               *lit;
+    sre_multi_literal_t         *ml;
+    sre_program_multi_t         *multi;
+    sre_program_file_multi_t    *fm;
+
+    n = prog->nregexes;
+    max = SRE_MULTI_LITERAL_MAX_LEN;
+
+    fm = (sre_program_file_multi_t *)
+         sre_program_file_get(h, h->multi, 1,
+                              sizeof(sre_program_file_multi_t));
+    if (fm == NULL
+        || fm->nalways > n || fm->ngated != n - fm->nalways
+        || fm->nclasses == 0 || fm->nclasses > 256
+        || fm->nstates == 0 || fm->nstates > (uint32_t) -1
+        || fm->nbucket_bytes > 3)
+    {
+        return NULL;
+    }
+
+    multi = sre_pcalloc(pool, sizeof(sre_program_multi_t));
+    if (multi == NULL) {
+        return NULL;
+    }
+
+    ml = &multi->prefixes;
+
+    nnext = fm->nstates * fm->nclasses;
+    if (nnext / fm->nclasses != fm->nstates) {
+        return NULL;
+    }
+
+    multi->starts = (uint32_t *) sre_program_file_get(h, fm->starts, n,
+                                                      sizeof(uint32_t));
+    multi->always = (sre_uint_t *) sre_program_file_get(h, fm->always, n,
+                                                        sizeof(sre_uint_t));
+    lens = sre_program_file_get(h, fm->lens, n, sizeof(sre_uint_t));
+    bytes = (sre_char *) sre_program_file_get(h, fm->bytes, n, 2 * max);
+    ml->next = (uint32_t *) sre_program_file_get(h, fm->next, nnext,
+                                                 sizeof(uint32_t));
+    ml->depth = (uint8_t *) sre_program_file_get(h, fm->depth, fm->nstates,
+                                                 1);
+    ml->out = (uint8_t *) sre_program_file_get(h, fm->out, fm->nstates, 1);
+    ml->ends = (sre_uint_t *) sre_program_file_get(h, fm->ends, fm->nstates,
+                                                   sizeof(sre_uint_t));
+    ml->same_end = (sre_uint_t *) sre_program_file_get(h, fm->same_end, n,
+                                                       sizeof(sre_uint_t));
+    ml->literals = sre_palloc(pool, n * sizeof(sre_literal_t));
+
+    if (multi->starts == NULL || multi->always == NULL || lens == NULL
+        || bytes == NULL || ml->next == NULL || ml->depth == NULL
+        || ml->out == NULL || ml->ends == NULL || ml->same_end == NULL
+        || ml->literals == NULL)
+    {
+        return NULL;
+    }
+
+    if (fm->same_bucket) {
+        ml->same_bucket = (sre_uint_t *)
+                          sre_program_file_get(h, fm->same_bucket, n,
+                                               sizeof(sre_uint_t));
+        if (ml->same_bucket == NULL) {
+            return NULL;
+        }
+    }
+
+    multi->gated = multi->always + fm->nalways;
+    multi->nalways = fm->nalways;
+    multi->ngated = fm->ngated;
+
+    for (i = 0; i < n; i++) {
+        if (multi->starts[i] >= prog->len
+            || lens[i] > max
+            || ml->same_end[i] > n
+            || (ml->same_bucket && ml->same_bucket[i] > n)
+            || (i < multi->nalways && multi->always[i] >= n)
+            || (i < multi->ngated && multi->gated[i] >= n))
+        {
+            return NULL;
+        }
+
+        lit = &ml->literals[i];
+
+        lit->len = lens[i];
+        lit->bytes = bytes + 2 * i * max;
+        lit->alt_bytes = lit->bytes + max;
+        lit->find = NULL;
+    }
+
+    for (i = 0; i < nnext; i++) {
+        if (ml->next[i] >= fm->nstates) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < fm->nstates; i++) {
+        if (ml->ends[i] > n || ml->depth[i] > max || ml->out[i] > max) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < 256; i++) {
+        if (fm->classes[i] >= fm->nclasses) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < sre_nelems(fm->buckets); i++) {
+        if (fm->buckets[i] > n) {
+            return NULL;
+        }
+    }
+
+    ml->count = n;
+    ml->nclasses = fm->nclasses;
+    ml->nstates = fm->nstates;
+    ml->nbucket_bytes = fm->nbucket_bytes;
+
+    memcpy(ml->classes, fm->classes, sizeof(ml->classes));
+    memcpy(ml->low_nibbles, fm->low_nibbles, sizeof(ml->low_nibbles));
+    memcpy(ml->high_nibbles, fm->high_nibbles, sizeof(ml->high_nibbles));
+
+    for (i = 0; i < sre_nelems(ml->buckets); i++) {
+        ml->buckets[i] = fm->buckets[i];
+    }
+
+    sre_multi_literal_select(ml);
+
+    return multi;
+}
@@ -96,6 +96,16 @@ sre_regex_dump(sre_regex_t *r)
         printf(")");
         break;
 
+    case SRE_REGEX_TYPE_REPEAT:
+        if (!r->data.cquant.greedy) {
+            printf("Ng");
+        }
+
+        printf("Repeat(%d, %d, ", r->data.cquant.from, r->data.cquant.to);
+        sre_regex_dump(r->left);
+        printf(")");
+        break;
+
     case SRE_REGEX_TYPE_NIL:
         printf("Nil");
         break;
@@ -167,6 +177,63 @@ sre_regex_dump(sre_regex_t *r)
 }
 
 
+/* assertions are taken as matching the empty string */
+SRE_NOAPI unsigned
+sre_regex_nullable(sre_regex_t *r)
+{
+    switch (r->type) {
+    case SRE_REGEX_TYPE_ALT:
+        return sre_regex_nullable(r->left) || sre_regex_nullable(r->right);
+
+    case SRE_REGEX_TYPE_CAT:
+        return sre_regex_nullable(r->left) && sre_regex_nullable(r->right);
+
+    case SRE_REGEX_TYPE_LIT:
+    case SRE_REGEX_TYPE_DOT:
+    case SRE_REGEX_TYPE_CLASS:
+    case SRE_REGEX_TYPE_NCLASS:
+        return 0;
+
+    case SRE_REGEX_TYPE_PAREN:
+    case SRE_REGEX_TYPE_PLUS:
+    case SRE_REGEX_TYPE_TOPLEVEL:
+        return sre_regex_nullable(r->left);
+
+    case SRE_REGEX_TYPE_REPEAT:
+        return r->data.cquant.from == 0 || sre_regex_nullable(r->left);
+
+    default:
+        /* SRE_REGEX_TYPE_NIL, STAR, QUEST, and ASSERT */
+        return 1;
+    }
+}
+
+
+SRE_NOAPI unsigned
+sre_regex_has_repeat(sre_regex_t *r)
+{
+    switch (r->type) {
+    case SRE_REGEX_TYPE_ALT:
+    case SRE_REGEX_TYPE_CAT:
+        return sre_regex_has_repeat(r->left)
+               || sre_regex_has_repeat(r->right);
+
+    case SRE_REGEX_TYPE_PAREN:
+    case SRE_REGEX_TYPE_STAR:
+    case SRE_REGEX_TYPE_PLUS:
+    case SRE_REGEX_TYPE_QUEST:
+    case SRE_REGEX_TYPE_TOPLEVEL:
+        return sre_regex_has_repeat(r->left);
+
+    case SRE_REGEX_TYPE_REPEAT:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+
 SRE_NOAPI sre_regex_range_t *
 sre_regex_turn_char_class_caseless(sre_pool_t *pool, sre_regex_range_t *range)
 {
@@ -28,7 +28,8 @@ typedef enum {
     SRE_REGEX_TYPE_CLASS    = 9,
     SRE_REGEX_TYPE_NCLASS   = 10,
     SRE_REGEX_TYPE_ASSERT   = 11,
-    SRE_REGEX_TYPE_TOPLEVEL = 12
+    SRE_REGEX_TYPE_TOPLEVEL = 12,
+    SRE_REGEX_TYPE_REPEAT   = 13
 } sre_regex_type_t;
 
 
@@ -62,11 +63,25 @@ struct sre_regex_range_s {
 };
 
 
+/*
+ * Counted quantifiers with bounds up to SRE_REGEX_MAX_UNROLL are unrolled
+ * into copies of their operand. Larger ones (and bounds up to
+ * SRE_REGEX_MAX_COUNT) are kept as SRE_REGEX_TYPE_REPEAT nodes and compiled
+ * into counter loops, which requires an operand that cannot match the
+ * empty string and contains no such loop itself. Otherwise the bounds
+ * must stay below SRE_REGEX_MAX_UNROLLED.
+ */
+#define SRE_REGEX_MAX_UNROLL     32
+#define SRE_REGEX_MAX_UNROLLED   500
+#define SRE_REGEX_MAX_COUNT      65535
+
+
 /* counted quantifier */
 
 typedef struct {
     int     from;
-    int     to;
+    int     to;         /* -1 for no upper bound */
+    int     greedy;
 } sre_regex_cquant_t;
 
 
@@ -86,6 +101,7 @@ struct sre_regex_s {
         sre_uint_t           assertion;
         sre_uint_t           greedy;
         sre_int_t            regex_id;
+        sre_regex_cquant_t   cquant;
     }                    data;
 };
 
@@ -93,6 +109,10 @@ struct sre_regex_s {
 SRE_NOAPI sre_regex_t *sre_regex_create(sre_pool_t *pool, sre_regex_type_t type,
     sre_regex_t *left, sre_regex_t *right);
 
+SRE_NOAPI unsigned sre_regex_nullable(sre_regex_t *r);
+
+SRE_NOAPI unsigned sre_regex_has_repeat(sre_regex_t *r);
+
 SRE_NOAPI sre_regex_range_t *
     sre_regex_turn_char_class_caseless(sre_pool_t *pool,
                                        sre_regex_range_t *range);
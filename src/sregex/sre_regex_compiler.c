@@ -14,147 +14,1338 @@
 
 
 #include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_glushkov.h>
+#include <sregex/sre_vm_onepass.h>
+#include <sregex/sre_vm_tdfa.h>
+#include <sregex/sre_vm_closure.h>
+#include <sregex/sre_vm_backtrack.h>
+#include <sregex/sre_vm_thompson.h>
+
+
+typedef struct sre_regex_compiler_s  sre_regex_compiler_t;
 
 
 static sre_int_t sre_program_get_leading_bytes(sre_pool_t *pool,
     sre_program_t *prog, sre_chain_t **res);
 static sre_int_t sre_program_get_leading_bytes_helper(sre_pool_t *pool,
     sre_instruction_t *pc, sre_program_t *prog, sre_chain_t **res,
-    unsigned tag);
+    uint8_t *visited);
+static sre_byteset_t *sre_program_get_leading_set(sre_pool_t *pool,
+    sre_program_t *prog);
+static sre_int_t sre_program_prune_captures(sre_pool_t *pool,
+    sre_program_t *prog, sre_uint_t ncaps);
+static sre_int_t sre_program_optimize(sre_pool_t *pool, sre_program_t *prog);
+static uint32_t sre_program_thread_jump(sre_program_t *prog, uint32_t x);
+static sre_int_t sre_program_get_slots(sre_pool_t *pool, sre_program_t *prog);
+static sre_int_t sre_program_get_prefix(sre_pool_t *pool,
+    sre_program_t *prog, sre_literal_t **res);
+static sre_uint_t sre_program_get_literal(sre_program_t *prog,
+    sre_instruction_t *pc, sre_char *bytes, sre_char *alt_bytes,
+    sre_uint_t max);
+static sre_int_t sre_program_get_multi(sre_pool_t *pool, sre_regex_t *re,
+    sre_program_t *prog);
+static void sre_program_get_regex_starts(sre_program_t *prog,
+    sre_regex_t *r, uint32_t x, uint32_t *starts);
+static sre_int_t sre_program_get_inner(sre_pool_t *pool, sre_regex_t *re,
+    sre_program_t *prog);
+static sre_int_t sre_program_get_reverse(sre_pool_t *pool, sre_regex_t *re,
+    sre_program_t *prog);
+static sre_regex_t *sre_regex_reverse_regexes(sre_pool_t *pool,
+    sre_regex_t *r);
+static sre_uint_t sre_regex_flatten_cat(sre_regex_t *r, sre_regex_t **items);
+static sre_int_t sre_regex_get_literal_byte(sre_regex_t *r, sre_char *ch,
+    sre_char *alt);
+static void sre_regex_add_byteset(sre_regex_t *r, sre_byteset_t *set);
+static sre_regex_t *sre_regex_reverse(sre_pool_t *pool, sre_regex_t *r);
+static sre_program_t *sre_regex_compile_anchored(sre_pool_t *pool,
+    sre_regex_t *re);
 static sre_uint_t sre_program_len(sre_regex_t *r);
-static sre_instruction_t *sre_regex_emit_bytecode(sre_pool_t *pool,
+static sre_instruction_t *sre_regex_emit_bytecode(sre_regex_compiler_t *c,
     sre_instruction_t *pc, sre_regex_t *re);
-static sre_int_t sre_regex_compiler_add_char_class(sre_pool_t *pool,
+static sre_int_t sre_regex_compiler_add_char_class(sre_regex_compiler_t *c,
     sre_instruction_t *pc, sre_regex_range_t *range);
+static sre_int_t sre_regex_compiler_add_data(sre_regex_compiler_t *c,
+    const void *data, size_t size, uint32_t *offset);
+
+
+struct sre_regex_compiler_s {
+    sre_pool_t              *pool;
+    sre_program_t           *program;
+    size_t                   data_size;     /* allocated for program->data */
+};
 
 
 sre_program_t *
 sre_regex_compile(sre_pool_t *pool, sre_regex_t *re)
 {
-    sre_uint_t           i, n, multi_ncaps_size;
-    sre_char            *p;
-    sre_program_t       *prog;
-    sre_instruction_t   *pc;
+    return sre_regex_compile_captures(pool, re, (sre_uint_t) -1);
+}
+
+
+/*
+ * Compiles the regex keeping only $0 and the first ncaps sub-match
+ * captures of every regex, so that the VMs neither save nor carry the
+ * others. The ovectors then hold those groups alone.
+ */
+sre_program_t *
+sre_regex_compile_captures(sre_pool_t *pool, sre_regex_t *re,
+    sre_uint_t ncaps)
+{
+    sre_uint_t            i, n, multi_ncaps_size;
+    sre_char             *p;
+    sre_program_t        *prog;
+    sre_instruction_t    *pc;
+    sre_regex_compiler_t  c;
+
+    n = sre_program_len(re);
+
+    multi_ncaps_size = (re->nregexes - 1) * sizeof(sre_uint_t);
+
+    p = sre_pnalloc(pool,
+                    sizeof(sre_program_t) + multi_ncaps_size
+                    + n * sizeof(sre_instruction_t));
+
+    if (p == NULL) {
+        return NULL;
+    }
+
+    prog = (sre_program_t *) p;
+
+    prog->nregexes = re->nregexes;
+
+    memcpy(prog->multi_ncaps, re->data.multi_ncaps,
+           re->nregexes * sizeof(sre_uint_t));
+
+    prog->start = (sre_instruction_t *) (p + sizeof(sre_program_t)
+                                         + multi_ncaps_size);
+
+    sre_memzero(prog->start, n * sizeof(sre_instruction_t));
+
+    prog->data = NULL;
+    prog->data_len = 0;
+    prog->simplified_classes = 0;
+
+    c.pool = pool;
+    c.program = prog;
+    c.data_size = 0;
+
+    pc = sre_regex_emit_bytecode(&c, prog->start, re);
+    if (pc == NULL) {
+        return NULL;
+    }
+
+    if (pc - prog->start != n) {
+        dd("buffer error: %d != %d", (int) (pc - prog->start), (int) n);
+        return NULL;
+    }
+
+    prog->len = pc - prog->start;
+
+    if (sre_program_prune_captures(pool, prog, ncaps) != SRE_OK) {
+        return NULL;
+    }
+
+    if (sre_program_optimize(pool, prog) != SRE_OK) {
+        return NULL;
+    }
+
+    if (sre_program_get_slots(pool, prog) != SRE_OK) {
+        return NULL;
+    }
+
+    prog->lookahead_asserts = 0;
+    prog->dup_threads = 0;
+    prog->uniq_threads = 0;
+    prog->nullable = 0;
+    prog->leading_bytes = NULL;
+    prog->leading_set = NULL;
+    prog->prefix = NULL;
+    prog->inner = NULL;
+    prog->inner_prefix = NULL;
+    prog->reverse = NULL;
+    prog->multi = NULL;
+
+    prog->ovecsize = 0;
+    for (i = 0; i < prog->nregexes; i++) {
+        prog->ovecsize += prog->multi_ncaps[i] + 1;
+    }
+    prog->ovecsize *= 2 * sizeof(sre_uint_t);
+
+    if (sre_program_get_leading_bytes(pool, prog, &prog->leading_bytes)
+        == SRE_ERROR)
+    {
+        return NULL;
+    }
+
+    if (prog->leading_bytes) {
+        prog->leading_set = sre_program_get_leading_set(pool, prog);
+        if (prog->leading_set == NULL) {
+            return NULL;
+        }
+
+        if (sre_program_get_prefix(pool, prog, &prog->prefix) != SRE_OK) {
+            return NULL;
+        }
+    }
+
+    if (prog->prefix == NULL
+        && sre_program_get_inner(pool, re, prog) != SRE_OK)
+    {
+        return NULL;
+    }
+
+    if (prog->nregexes > 1
+        && sre_program_get_multi(pool, re, prog) != SRE_OK)
+    {
+        return NULL;
+    }
+
+    if (sre_vm_closure_compile(pool, prog) == SRE_ERROR) {
+        return NULL;
+    }
+
+    if (sre_vm_glushkov_compile(pool, prog) == SRE_ERROR) {
+        return NULL;
+    }
+
+    if (sre_vm_onepass_compile(pool, prog) == SRE_ERROR) {
+        return NULL;
+    }
+
+    if (prog->onepass == NULL) {
+        if (sre_vm_tdfa_compile(pool, prog) == SRE_ERROR) {
+            return NULL;
+        }
+
+    } else {
+        prog->tdfa = NULL;
+    }
+
+    if (prog->onepass == NULL && prog->tdfa == NULL
+        && sre_program_get_reverse(pool, re, prog) != SRE_OK)
+    {
+        return NULL;
+    }
+
+    if (sre_vm_backtrack_compile(pool, prog) == SRE_ERROR) {
+        return NULL;
+    }
+
+    if (sre_vm_thompson_jit_count_threads(prog) == SRE_ERROR) {
+        return NULL;
+    }
+
+    dd("nullable: %u", prog->nullable);
+
+#if (DDEBUG)
+    {
+        sre_chain_t         *cl;
+
+        for (cl = prog->leading_bytes; cl; cl = cl->next) {
+            pc = cl->data;
+            fprintf(stderr, "[");
+            sre_dump_instruction(stderr, pc, prog);
+            fprintf(stderr, "]");
+        }
+        if (prog->leading_bytes) {
+            fprintf(stderr, "\n");
+        }
+    }
+#endif
+
+    return prog;
+}
+
+
+static sre_int_t
+sre_program_get_leading_bytes(sre_pool_t *pool, sre_program_t *prog,
+    sre_chain_t **res)
+{
+    uint8_t             *visited;
+    sre_int_t            rc;
+
+    visited = sre_pcalloc(pool, prog->len);
+    if (visited == NULL) {
+        return SRE_ERROR;
+    }
+
+    rc = sre_program_get_leading_bytes_helper(pool, prog->start, prog, res,
+                                              visited);
+    if (rc == SRE_ERROR) {
+        return SRE_ERROR;
+    }
+
+    if (rc == SRE_DECLINED || prog->nullable) {
+        *res = NULL;
+        return SRE_DECLINED;
+    }
+
+    return rc;
+}
+
+
+static sre_byteset_t *
+sre_program_get_leading_set(sre_pool_t *pool, sre_program_t *prog)
+{
+    unsigned             i;
+    sre_uint_t           j;
+    sre_chain_t         *cl;
+    sre_byteset_t       *set, notin;
+    const uint8_t       *bitmap;
+    sre_vm_range_t      *range;
+    sre_instruction_t   *pc;
+
+    set = sre_pcalloc(pool, sizeof(sre_byteset_t));
+    if (set == NULL) {
+        return NULL;
+    }
+
+    for (cl = prog->leading_bytes; cl; cl = cl->next) {
+        pc = cl->data;
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+            sre_byteset_add_range(set, pc->v.ch, pc->v.ch);
+            break;
+
+        case SRE_OPCODE_IN:
+            for (j = 0; j < sre_vm_nranges(pc); j++) {
+                range = &pc->v.ranges[j];
+                sre_byteset_add_range(set, range->from, range->to);
+            }
+
+            break;
+
+        case SRE_OPCODE_BITMAP:
+            bitmap = sre_program_bitmap(prog, pc);
+
+            for (i = 0; i < sizeof(set->bits); i++) {
+                set->bits[i] |= bitmap[i];
+            }
+
+            break;
+
+        case SRE_OPCODE_NOTIN:
+            sre_memzero(&notin, sizeof(sre_byteset_t));
+
+            for (j = 0; j < sre_vm_nranges(pc); j++) {
+                range = &pc->v.ranges[j];
+                sre_byteset_add_range(&notin, range->from, range->to);
+            }
+
+            sre_byteset_negate(&notin);
+
+            for (i = 0; i < sizeof(set->bits); i++) {
+                set->bits[i] |= notin.bits[i];
+            }
+
+            break;
+
+        default:
+            sre_assert(pc->opcode);
+            break;
+        }
+    }
+
+    sre_byteset_compile(set);
+
+    return set;
+}
+
+
+/*
+ * Removes the SAVEs of the captures beyond the first ncaps ones of every
+ * regex, the jumps to them going to the instructions right after, and
+ * numbers the groups left anew, $0 of every regex first.
+ */
+static sre_int_t
+sre_program_prune_captures(sre_pool_t *pool, sre_program_t *prog,
+    sre_uint_t ncaps)
+{
+    sre_uint_t           i, j, n, ngroups, *groups, *map;
+    sre_instruction_t   *pc, *start;
+
+    ngroups = 0;
+    n = 0;
+
+    for (i = 0; i < prog->nregexes; i++) {
+        ngroups += prog->multi_ncaps[i] + 1;
+
+        if (prog->multi_ncaps[i] > ncaps) {
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return SRE_OK;
+    }
+
+    groups = sre_palloc(pool, ngroups * sizeof(sre_uint_t));
+    if (groups == NULL) {
+        return SRE_ERROR;
+    }
+
+    map = sre_palloc(pool, (prog->len + 1) * sizeof(sre_uint_t));
+    if (map == NULL) {
+        return SRE_ERROR;
+    }
+
+    ngroups = 0;
+    n = 0;
+
+    for (i = 0; i < prog->nregexes; i++) {
+        for (j = 0; j <= prog->multi_ncaps[i]; j++) {
+            groups[ngroups++] = j <= ncaps ? n++ : (sre_uint_t) -1;
+        }
+
+        if (prog->multi_ncaps[i] > ncaps) {
+            prog->multi_ncaps[i] = ncaps;
+        }
+    }
+
+    start = prog->start;
+
+    for (i = 0, n = 0; i < prog->len; i++) {
+        map[i] = n;
+
+        pc = &start[i];
+
+        if (pc->opcode != SRE_OPCODE_SAVE
+            || groups[pc->v.group / 2] != (sre_uint_t) -1)
+        {
+            n++;
+        }
+    }
+
+    map[prog->len] = n;
+
+    dd("%d of %d instructions left", (int) n, (int) prog->len);
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_SAVE:
+            j = groups[pc->v.group / 2];
+            if (j == (sre_uint_t) -1) {
+                continue;
+            }
+
+            pc->v.group = 2 * j + pc->v.group % 2;
+            break;
+
+        case SRE_OPCODE_SPLIT:
+        case SRE_OPCODE_COUNT:
+            pc->y = map[pc->y];
+
+            /* fall through */
+
+        case SRE_OPCODE_JMP:
+            pc->x = map[pc->x];
+            break;
+
+        default:
+            break;
+        }
+
+        start[map[i]] = *pc;
+    }
+
+    prog->len = n;
+
+    return SRE_OK;
+}
+
+
+/*
+ * A peephole pass over the emitted program. Branch targets are threaded
+ * past jumps, and the jumps to a split (like the one closing the body of
+ * a star) are replaced by a copy of that split. After that the
+ * instructions no longer reachable (like the jumps following the match of
+ * every regex in a multi-regex program) are removed. The order of the
+ * remaining instructions is kept, which the bodies of counter loops and
+ * the regexes of multi-regex programs rely on.
+ */
+static sre_int_t
+sre_program_optimize(sre_pool_t *pool, sre_program_t *prog)
+{
+    uint32_t            *stack;
+    sre_uint_t           i, n, top, *map;
+    unsigned             counted;
+    uint8_t             *reachable;
+    sre_instruction_t   *pc, *start;
+
+    start = prog->start;
+
+    prog->emitted_len = prog->len;
+    prog->threaded_jumps = 0;
+
+    counted = 0;
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_SPLIT:
+        case SRE_OPCODE_COUNT:
+            pc->y = sre_program_thread_jump(prog, pc->y);
+            counted |= (pc->opcode == SRE_OPCODE_COUNT);
+
+            /* fall through */
+
+        case SRE_OPCODE_JMP:
+            pc->x = sre_program_thread_jump(prog, pc->x);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /*
+     * the slots of the instructions in counter loops depend on their
+     * positions, and the VMs check the split at the start of the program
+     * by its address, so neither gets copied
+     */
+
+    for (i = 0; i < prog->len && !counted; i++) {
+        pc = &start[i];
+
+        if (pc->opcode == SRE_OPCODE_JMP
+            && pc->x > 0 && pc->x < prog->len
+            && start[pc->x].opcode == SRE_OPCODE_SPLIT)
+        {
+            dd("copying split %d to %d", (int) pc->x, (int) i);
+
+            *pc = start[pc->x];
+            prog->threaded_jumps++;
+        }
+    }
+
+    reachable = sre_pcalloc(pool, prog->len);
+    if (reachable == NULL) {
+        return SRE_ERROR;
+    }
+
+    stack = sre_palloc(pool, prog->len * sizeof(uint32_t));
+    if (stack == NULL) {
+        return SRE_ERROR;
+    }
+
+    reachable[0] = 1;
+    stack[0] = 0;
+    top = 1;
+
+    while (top) {
+        i = stack[--top];
+        pc = &start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_SPLIT:
+        case SRE_OPCODE_COUNT:
+            if (pc->y < prog->len && !reachable[pc->y]) {
+                reachable[pc->y] = 1;
+                stack[top++] = pc->y;
+            }
+
+            /* fall through */
+
+        case SRE_OPCODE_JMP:
+            if (pc->x < prog->len && !reachable[pc->x]) {
+                reachable[pc->x] = 1;
+                stack[top++] = pc->x;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+            break;
+
+        default:
+            if (i + 1 < prog->len && !reachable[i + 1]) {
+                reachable[i + 1] = 1;
+                stack[top++] = (uint32_t) (i + 1);
+            }
+
+            break;
+        }
+    }
+
+    map = sre_palloc(pool, (prog->len + 1) * sizeof(sre_uint_t));
+    if (map == NULL) {
+        return SRE_ERROR;
+    }
+
+    for (i = 0, n = 0; i < prog->len; i++) {
+        map[i] = n;
+        n += reachable[i];
+    }
+
+    map[prog->len] = n;
+
+    dd("%d of %d instructions reachable", (int) n, (int) prog->len);
+
+    if (n == prog->len) {
+        return SRE_OK;
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        if (!reachable[i]) {
+            continue;
+        }
+
+        pc = &start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_SPLIT:
+        case SRE_OPCODE_COUNT:
+            pc->y = map[pc->y];
+
+            /* fall through */
+
+        case SRE_OPCODE_JMP:
+            pc->x = map[pc->x];
+            break;
+
+        default:
+            break;
+        }
+
+        start[map[i]] = *pc;
+    }
+
+    prog->len = n;
+
+    return SRE_OK;
+}
+
+
+static uint32_t
+sre_program_thread_jump(sre_program_t *prog, uint32_t x)
+{
+    sre_uint_t           n;
+
+    /* every loop goes through a split, so the limit is never reached */
+
+    for (n = 0;
+         x < prog->len && prog->start[x].opcode == SRE_OPCODE_JMP
+         && n < prog->len;
+         n++)
+    {
+        x = prog->start[x].x;
+        prog->threaded_jumps++;
+    }
+
+    return x;
+}
+
+
+static sre_int_t
+sre_program_get_slots(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_uint_t           i, j, n, *slots;
+    sre_vm_repeat_t     *repeat;
+    sre_instruction_t   *pc;
+
+    prog->slots = NULL;
+    prog->nslots = prog->len;
+
+    for (i = 0; i < prog->len; i++) {
+        if (prog->start[i].opcode == SRE_OPCODE_COUNT) {
+            break;
+        }
+    }
+
+    if (i == prog->len) {
+        return SRE_OK;
+    }
+
+    slots = sre_palloc(pool, prog->len * sizeof(sre_uint_t));
+    if (slots == NULL) {
+        return SRE_ERROR;
+    }
+
+    /* the number of counter values of every instruction first */
+
+    for (i = 0; i < prog->len; i++) {
+        slots[i] = 1;
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (pc->opcode != SRE_OPCODE_COUNT) {
+            continue;
+        }
+
+        repeat = sre_program_repeat(prog, pc);
+        n = repeat->max ? repeat->max : repeat->min + 1;
+
+        for (j = pc->x; j <= i; j++) {
+            slots[j] = n;
+        }
+    }
+
+    for (i = 0, n = 0; i < prog->len; i++) {
+        j = slots[i];
+
+        if (j > SRE_PROGRAM_MAX_SLOTS - n) {
+            dd("more than %d slots", SRE_PROGRAM_MAX_SLOTS);
+            return SRE_ERROR;
+        }
+
+        slots[i] = n;
+        n += j;
+    }
+
+    dd("%d slots for %d instructions", (int) n, (int) prog->len);
+
+    prog->slots = slots;
+    prog->nslots = n;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Collects the literal string every match must start with by following
+ * the bytecode of the regex from its entry until the first branch. A
+ * class of at most two bytes (like a caseless letter) still counts as a
+ * literal byte with an alternative. Assertions are zero-width, so they
+ * are skipped here and checked by the VMs as usual.
+ */
+static sre_int_t
+sre_program_get_prefix(sre_pool_t *pool, sre_program_t *prog,
+    sre_literal_t **res)
+{
+    sre_uint_t           n;
+    sre_char            *bytes, *alt_bytes;
+    sre_literal_t       *lit;
+
+    *res = NULL;
+
+    if (prog->start->opcode != SRE_OPCODE_SPLIT) {
+        return SRE_OK;
+    }
+
+    bytes = sre_pnalloc(pool, 2 * prog->len);
+    if (bytes == NULL) {
+        return SRE_ERROR;
+    }
+
+    alt_bytes = bytes + prog->len;
+
+    n = sre_program_get_literal(prog, sre_program_x(prog, prog->start), bytes,
+                                alt_bytes, prog->len);
+
+    dd("literal prefix length: %d", (int) n);
+
+    if (n < 2) {
+        return SRE_OK;
+    }
+
+    lit = sre_palloc(pool, sizeof(sre_literal_t));
+    if (lit == NULL) {
+        return SRE_ERROR;
+    }
+
+    lit->len = n;
+    lit->bytes = bytes;
+    lit->alt_bytes = alt_bytes;
+
+    sre_literal_compile(lit);
+
+    *res = lit;
+
+    return SRE_OK;
+}
+
+
+static sre_uint_t
+sre_program_get_literal(sre_program_t *prog, sre_instruction_t *pc,
+    sre_char *bytes, sre_char *alt_bytes, sre_uint_t max)
+{
+    sre_uint_t           n;
+    sre_vm_range_t      *range;
+
+    for (n = 0; n < max; /* void */) {
+        switch (pc->opcode) {
+        case SRE_OPCODE_SAVE:
+        case SRE_OPCODE_ASSERT:
+            pc++;
+            continue;
+
+        case SRE_OPCODE_JMP:
+            pc = sre_program_x(prog, pc);
+            continue;
+
+        case SRE_OPCODE_CHAR:
+            bytes[n] = pc->v.ch;
+            alt_bytes[n] = pc->v.ch;
+            n++;
+            pc++;
+            continue;
+
+        case SRE_OPCODE_IN:
+            range = pc->v.ranges;
+
+            if (sre_vm_nranges(pc) == 1 && range[0].to - range[0].from <= 1) {
+                bytes[n] = range[0].from;
+                alt_bytes[n] = range[0].to;
+
+            } else if (sre_vm_nranges(pc) == 2
+                       && range[0].from == range[0].to
+                       && range[1].from == range[1].to)
+            {
+                bytes[n] = range[0].from;
+                alt_bytes[n] = range[1].from;
+
+            } else {
+                break;
+            }
+
+            n++;
+            pc++;
+            continue;
+
+        default:
+            break;
+        }
+
+        break;
+    }
+
+    return n;
+}
+
+
+/*
+ * Collects the literal prefix of every regex in a multi-regex program,
+ * so that the VMs only need to start a regex where its prefix is seen
+ * by the combined scanner. The regexes without a prefix are always
+ * started.
+ */
+static sre_int_t
+sre_program_get_multi(sre_pool_t *pool, sre_regex_t *re, sre_program_t *prog)
+{
+    sre_int_t                rc;
+    sre_uint_t               i, n, max;
+    sre_char                *bytes;
+    sre_literal_t           *lit;
+    sre_program_multi_t     *multi;
+
+    n = prog->nregexes;
+
+    multi = sre_pcalloc(pool, sizeof(sre_program_multi_t));
+    if (multi == NULL) {
+        return SRE_ERROR;
+    }
+
+    multi->starts = sre_palloc(pool, n * sizeof(uint32_t));
+    if (multi->starts == NULL) {
+        return SRE_ERROR;
+    }
+
+    /* the regexes follow the ".*?" part in a tree of alternations */
+
+    sre_program_get_regex_starts(prog, re->right, prog->start->x,
+                                 multi->starts);
+
+    multi->prefixes.count = n;
+    multi->prefixes.literals = sre_palloc(pool, n * sizeof(sre_literal_t));
+    if (multi->prefixes.literals == NULL) {
+        return SRE_ERROR;
+    }
+
+    max = SRE_MULTI_LITERAL_MAX_LEN;
+
+    bytes = sre_pnalloc(pool, 2 * n * max);
+    if (bytes == NULL) {
+        return SRE_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        lit = &multi->prefixes.literals[i];
+
+        lit->bytes = bytes + 2 * i * max;
+        lit->alt_bytes = lit->bytes + max;
+        lit->len = sre_program_get_literal(prog,
+                                           &prog->start[multi->starts[i]],
+                                           lit->bytes, lit->alt_bytes, max);
+        lit->find = NULL;
+    }
+
+    rc = sre_multi_literal_compile(pool, &multi->prefixes);
+    if (rc == SRE_DECLINED) {
+        return SRE_OK;
+    }
+
+    if (rc != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    multi->always = sre_palloc(pool, 2 * n * sizeof(sre_uint_t));
+    if (multi->always == NULL) {
+        return SRE_ERROR;
+    }
+
+    multi->gated = multi->always + n;
+
+    for (i = 0; i < n; i++) {
+        if (multi->prefixes.literals[i].len) {
+            multi->gated[multi->ngated++] = i;
+
+        } else {
+            multi->always[multi->nalways++] = i;
+        }
+    }
+
+    dd("%d regexes always started", (int) multi->nalways);
+
+    prog->multi = multi;
+
+    return SRE_OK;
+}
+
+
+static void
+sre_program_get_regex_starts(sre_program_t *prog, sre_regex_t *r,
+    uint32_t x, uint32_t *starts)
+{
+    if (r->type == SRE_REGEX_TYPE_ALT) {
+        sre_program_get_regex_starts(prog, r->left, prog->start[x].x, starts);
+        sre_program_get_regex_starts(prog, r->right, prog->start[x].y, starts);
+        return;
+    }
+
+    /* SRE_REGEX_TYPE_TOPLEVEL */
+
+    starts[r->data.regex_id] = x;
+}
+
+
+/*
+ * Looks for a literal string in the top-level concatenation of a single
+ * regex that every match must contain, preferring the longest one. The
+ * first byte of the literal must not be matched anywhere in the part of
+ * the regex before it, so that the first occurrence of the literal after
+ * the start of a match is always the one the match uses. That part is
+ * compiled into a reversed program, to be run backward from the literal
+ * hits by sre_vm_inner_find.
+ */
+static sre_int_t
+sre_program_get_inner(sre_pool_t *pool, sre_regex_t *re, sre_program_t *prog)
+{
+    sre_uint_t           i, j, n, best, best_len;
+    sre_char            *bytes, *alt_bytes;
+    sre_regex_t        **items, *r;
+    sre_literal_t       *lit;
+    sre_byteset_t        set;
+
+    /* the regex is assembled as ".*?(regex)" by sre_regex_parse */
+
+    if (re->nregexes != 1
+        || re->type != SRE_REGEX_TYPE_CAT
+        || re->right->type != SRE_REGEX_TYPE_TOPLEVEL
+        || re->right->left->type != SRE_REGEX_TYPE_PAREN)
+    {
+        return SRE_OK;
+    }
+
+    re = re->right->left->left;
+
+    items = sre_palloc(pool, prog->len * sizeof(sre_regex_t *));
+    if (items == NULL) {
+        return SRE_ERROR;
+    }
+
+    bytes = sre_pnalloc(pool, 2 * prog->len);
+    if (bytes == NULL) {
+        return SRE_ERROR;
+    }
+
+    alt_bytes = bytes + prog->len;
+
+    n = sre_regex_flatten_cat(re, items);
+
+    sre_memzero(&set, sizeof(sre_byteset_t));
+
+    best = 0;
+    best_len = 0;
+
+    for (i = 1; i < n; i++) {
+        if (sre_regex_has_repeat(items[i - 1])) {
+            /* the inner VM running the prefix has no loop counters */
+            break;
+        }
+
+        sre_regex_add_byteset(items[i - 1], &set);
+
+        if (sre_regex_get_literal_byte(items[i], &bytes[0], &alt_bytes[0])
+            != SRE_OK
+            || sre_byteset_test(&set, bytes[0])
+            || sre_byteset_test(&set, alt_bytes[0]))
+        {
+            continue;
+        }
+
+        for (j = i + 1; j < n; j++) {
+            if (sre_regex_get_literal_byte(items[j], &bytes[0], &alt_bytes[0])
+                != SRE_OK)
+            {
+                break;
+            }
+        }
+
+        if (j - i > best_len) {
+            best = i;
+            best_len = j - i;
+        }
+    }
+
+    dd("inner literal at item %d, length %d", (int) best, (int) best_len);
+
+    if (best_len == 0) {
+        return SRE_OK;
+    }
+
+    for (i = 0; i < best_len; i++) {
+        (void) sre_regex_get_literal_byte(items[best + i], &bytes[i],
+                                          &alt_bytes[i]);
+    }
+
+    /* the items before the literal, reversed */
+
+    r = NULL;
+    for (i = 0; i < best; i++) {
+        re = sre_regex_reverse(pool, items[i]);
+        if (re == NULL) {
+            return SRE_ERROR;
+        }
+
+        if (r) {
+            r = sre_regex_create(pool, SRE_REGEX_TYPE_CAT, re, r);
+            if (r == NULL) {
+                return SRE_ERROR;
+            }
+
+        } else {
+            r = re;
+        }
+    }
+
+    prog->inner_prefix = sre_regex_compile_anchored(pool, r);
+    if (prog->inner_prefix == NULL) {
+        return SRE_ERROR;
+    }
+
+    lit = sre_palloc(pool, sizeof(sre_literal_t));
+    if (lit == NULL) {
+        return SRE_ERROR;
+    }
+
+    lit->len = best_len;
+    lit->bytes = bytes;
+    lit->alt_bytes = alt_bytes;
+
+    sre_literal_compile(lit);
+
+    prog->inner = lit;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Compiles all the regexes, reversed and without captures, into
+ * prog->reverse, which is run backward from the end of a match by
+ * sre_vm_bounds_exec to find where the match starts. The regexes with
+ * counter loops are left out.
+ */
+static sre_int_t
+sre_program_get_reverse(sre_pool_t *pool, sre_regex_t *re,
+    sre_program_t *prog)
+{
+    sre_regex_t         *r;
 
-    n = sre_program_len(re);
+    /* the regexes follow the ".*?" part, see sre_program_get_multi */
 
-    multi_ncaps_size = (re->nregexes - 1) * sizeof(sre_uint_t);
+    if (re->type != SRE_REGEX_TYPE_CAT || sre_regex_has_repeat(re->right)) {
+        return SRE_OK;
+    }
 
-    p = sre_pnalloc(pool,
-                    sizeof(sre_program_t) + multi_ncaps_size
-                    + n * sizeof(sre_instruction_t));
+    r = sre_regex_reverse_regexes(pool, re->right);
+    if (r == NULL) {
+        return SRE_ERROR;
+    }
 
-    if (p == NULL) {
-        return NULL;
+    prog->reverse = sre_regex_compile_anchored(pool, r);
+    if (prog->reverse == NULL) {
+        return SRE_ERROR;
     }
 
-    prog = (sre_program_t *) p;
+    return SRE_OK;
+}
 
-    prog->nregexes = re->nregexes;
 
-    memcpy(prog->multi_ncaps, re->data.multi_ncaps,
-           re->nregexes * sizeof(sre_uint_t));
+static sre_regex_t *
+sre_regex_reverse_regexes(sre_pool_t *pool, sre_regex_t *r)
+{
+    sre_regex_t     *left, *right;
 
-    prog->start = (sre_instruction_t *) (p + sizeof(sre_program_t)
-                                         + multi_ncaps_size);
+    if (r->type == SRE_REGEX_TYPE_ALT) {
+        left = sre_regex_reverse_regexes(pool, r->left);
+        if (left == NULL) {
+            return NULL;
+        }
 
-    sre_memzero(prog->start, n * sizeof(sre_instruction_t));
+        right = sre_regex_reverse_regexes(pool, r->right);
+        if (right == NULL) {
+            return NULL;
+        }
 
-    pc = sre_regex_emit_bytecode(pool, prog->start, re);
-    if (pc == NULL) {
-        return NULL;
+        return sre_regex_create(pool, SRE_REGEX_TYPE_ALT, left, right);
     }
 
-    if (pc - prog->start != n) {
-        dd("buffer error: %d != %d", (int) (pc - prog->start), (int) n);
-        return NULL;
-    }
+    /* SRE_REGEX_TYPE_TOPLEVEL */
 
-    prog->len = pc - prog->start;
-    prog->tag = 0;
-    prog->lookahead_asserts = 0;
-    prog->dup_threads = 0;
-    prog->uniq_threads = 0;
-    prog->nullable = 0;
-    prog->leading_bytes = NULL;
-    prog->leading_byte = -1;
+    return sre_regex_reverse(pool, r->left);
+}
 
-    prog->ovecsize = 0;
-    for (i = 0; i < prog->nregexes; i++) {
-        prog->ovecsize += prog->multi_ncaps[i] + 1;
-    }
-    prog->ovecsize *= 2 * sizeof(sre_uint_t);
 
-    if (sre_program_get_leading_bytes(pool, prog, &prog->leading_bytes)
-        == SRE_ERROR)
-    {
-        return NULL;
+/* collects the operands of nested concatenations, looking into captures */
+static sre_uint_t
+sre_regex_flatten_cat(sre_regex_t *r, sre_regex_t **items)
+{
+    sre_uint_t      n;
+
+    switch (r->type) {
+    case SRE_REGEX_TYPE_CAT:
+        n = sre_regex_flatten_cat(r->left, items);
+        return n + sre_regex_flatten_cat(r->right, items + n);
+
+    case SRE_REGEX_TYPE_PAREN:
+        return sre_regex_flatten_cat(r->left, items);
+
+    case SRE_REGEX_TYPE_NIL:
+        return 0;
+
+    default:
+        items[0] = r;
+        return 1;
     }
+}
+
+
+/* a literal byte, or a class of two bytes like a caseless letter */
+static sre_int_t
+sre_regex_get_literal_byte(sre_regex_t *r, sre_char *ch, sre_char *alt)
+{
+    sre_regex_range_t       *range;
+
+    switch (r->type) {
+    case SRE_REGEX_TYPE_LIT:
+        *ch = r->data.ch;
+        *alt = r->data.ch;
+        return SRE_OK;
+
+    case SRE_REGEX_TYPE_CLASS:
+        range = r->data.range;
 
-    if (prog->leading_bytes && prog->leading_bytes->next == NULL) {
-        pc = prog->leading_bytes->data;
-        if (pc->opcode == SRE_OPCODE_CHAR) {
-            prog->leading_byte = pc->v.ch;
+        if (range->next == NULL && range->to - range->from <= 1) {
+            *ch = range->from;
+            *alt = range->to;
+            return SRE_OK;
+        }
+
+        if (range->next && range->next->next == NULL
+            && range->from == range->to
+            && range->next->from == range->next->to)
+        {
+            *ch = range->from;
+            *alt = range->next->from;
+            return SRE_OK;
         }
+
+        return SRE_DECLINED;
+
+    default:
+        return SRE_DECLINED;
     }
+}
 
-    dd("nullable: %u", prog->nullable);
 
-#if (DDEBUG)
-    {
-        sre_chain_t         *cl;
+/* adds all the bytes the regex may consume to the set */
+static void
+sre_regex_add_byteset(sre_regex_t *r, sre_byteset_t *set)
+{
+    unsigned                 i;
+    sre_byteset_t            nclass;
+    sre_regex_range_t       *range;
 
-        for (cl = prog->leading_bytes; cl; cl = cl->next) {
-            pc = cl->data;
-            fprintf(stderr, "[");
-            sre_dump_instruction(stderr, pc, prog->start);
-            fprintf(stderr, "]");
+    switch (r->type) {
+    case SRE_REGEX_TYPE_ALT:
+    case SRE_REGEX_TYPE_CAT:
+        sre_regex_add_byteset(r->left, set);
+        sre_regex_add_byteset(r->right, set);
+        break;
+
+    case SRE_REGEX_TYPE_PAREN:
+    case SRE_REGEX_TYPE_QUEST:
+    case SRE_REGEX_TYPE_STAR:
+    case SRE_REGEX_TYPE_PLUS:
+    case SRE_REGEX_TYPE_REPEAT:
+        sre_regex_add_byteset(r->left, set);
+        break;
+
+    case SRE_REGEX_TYPE_LIT:
+        sre_byteset_add_range(set, r->data.ch, r->data.ch);
+        break;
+
+    case SRE_REGEX_TYPE_CLASS:
+        for (range = r->data.range; range; range = range->next) {
+            sre_byteset_add_range(set, range->from, range->to);
         }
-        if (prog->leading_bytes) {
-            fprintf(stderr, "\n");
+
+        break;
+
+    case SRE_REGEX_TYPE_NCLASS:
+        sre_memzero(&nclass, sizeof(sre_byteset_t));
+
+        for (range = r->data.range; range; range = range->next) {
+            sre_byteset_add_range(&nclass, range->from, range->to);
+        }
+
+        sre_byteset_negate(&nclass);
+
+        for (i = 0; i < sizeof(set->bits); i++) {
+            set->bits[i] |= nclass.bits[i];
         }
+
+        break;
+
+    case SRE_REGEX_TYPE_DOT:
+        sre_byteset_add_range(set, 0, 255);
+        break;
+
+    default:
+        break;
     }
-#endif
+}
 
-    return prog;
+
+/*
+ * Returns a regex matching the reversed strings of the given one.
+ * Captures are dropped.
+ */
+static sre_regex_t *
+sre_regex_reverse(sre_pool_t *pool, sre_regex_t *r)
+{
+    sre_regex_t     *left, *right, *rev;
+
+    switch (r->type) {
+    case SRE_REGEX_TYPE_ALT:
+    case SRE_REGEX_TYPE_CAT:
+        left = sre_regex_reverse(pool, r->left);
+        if (left == NULL) {
+            return NULL;
+        }
+
+        right = sre_regex_reverse(pool, r->right);
+        if (right == NULL) {
+            return NULL;
+        }
+
+        if (r->type == SRE_REGEX_TYPE_CAT) {
+            return sre_regex_create(pool, r->type, right, left);
+        }
+
+        return sre_regex_create(pool, r->type, left, right);
+
+    case SRE_REGEX_TYPE_PAREN:
+        return sre_regex_reverse(pool, r->left);
+
+    case SRE_REGEX_TYPE_QUEST:
+    case SRE_REGEX_TYPE_STAR:
+    case SRE_REGEX_TYPE_PLUS:
+        left = sre_regex_reverse(pool, r->left);
+        if (left == NULL) {
+            return NULL;
+        }
+
+        rev = sre_regex_create(pool, r->type, left, NULL);
+        if (rev == NULL) {
+            return NULL;
+        }
+
+        rev->data.greedy = r->data.greedy;
+        return rev;
+
+    default:
+        return r;
+    }
 }
 
 
-static sre_int_t
-sre_program_get_leading_bytes(sre_pool_t *pool, sre_program_t *prog,
-    sre_chain_t **res)
+/* compiles a regex without the ".*?" prefix and the $0 capture */
+static sre_program_t *
+sre_regex_compile_anchored(sre_pool_t *pool, sre_regex_t *re)
 {
-    unsigned             tag;
-    sre_int_t            rc;
+    sre_uint_t            n;
+    sre_program_t        *prog;
+    sre_instruction_t    *pc;
+    sre_regex_compiler_t  c;
 
-    tag = prog->tag + 1;
+    re = sre_regex_create(pool, SRE_REGEX_TYPE_TOPLEVEL, re, NULL);
+    if (re == NULL) {
+        return NULL;
+    }
 
-    rc = sre_program_get_leading_bytes_helper(pool, prog->start, prog, res,
-                                              tag);
-    prog->tag = tag;
+    re->data.regex_id = 0;
 
-    if (rc == SRE_ERROR) {
-        return SRE_ERROR;
+    n = sre_program_len(re);
+
+    prog = sre_pcalloc(pool, sizeof(sre_program_t));
+    if (prog == NULL) {
+        return NULL;
     }
 
-    if (rc == SRE_DECLINED || prog->nullable) {
-        *res = NULL;
-        return SRE_DECLINED;
+    prog->start = sre_pcalloc(pool, n * sizeof(sre_instruction_t));
+    if (prog->start == NULL) {
+        return NULL;
     }
 
-    return rc;
+    c.pool = pool;
+    c.program = prog;
+    c.data_size = 0;
+
+    pc = sre_regex_emit_bytecode(&c, prog->start, re);
+    if (pc == NULL) {
+        return NULL;
+    }
+
+    prog->len = pc - prog->start;
+
+    if (sre_program_optimize(pool, prog) != SRE_OK) {
+        return NULL;
+    }
+
+    prog->nslots = prog->len;
+    prog->nregexes = 1;
+
+    return prog;
 }
 
 
 static sre_int_t
 sre_program_get_leading_bytes_helper(sre_pool_t *pool, sre_instruction_t *pc,
-    sre_program_t *prog, sre_chain_t **res, unsigned tag)
+    sre_program_t *prog, sre_chain_t **res, uint8_t *visited)
 {
     sre_int_t            rc;
     sre_chain_t         *cl, *ncl;
     sre_instruction_t   *bc;
 
-    if (pc->tag == tag) {
+    if (visited[pc - prog->start]) {
         return SRE_OK;
     }
 
@@ -163,22 +1354,26 @@ sre_program_get_leading_bytes_helper(sre_pool_t *pool, sre_instruction_t *pc,
         return SRE_OK;
     }
 
-    pc->tag = tag;
+    visited[pc - prog->start] = 1;
 
     switch (pc->opcode) {
     case SRE_OPCODE_SPLIT:
-        rc = sre_program_get_leading_bytes_helper(pool, pc->x, prog, res,
-                                                  tag);
+    case SRE_OPCODE_COUNT:
+        rc = sre_program_get_leading_bytes_helper(pool,
+                                                  sre_program_x(prog, pc),
+                                                  prog, res, visited);
         if (rc != SRE_OK) {
             return rc;
         }
 
-        return sre_program_get_leading_bytes_helper(pool, pc->y, prog, res,
-                                                    tag);
+        return sre_program_get_leading_bytes_helper(pool,
+                                                    sre_program_y(prog, pc),
+                                                    prog, res, visited);
 
     case SRE_OPCODE_JMP:
-        return sre_program_get_leading_bytes_helper(pool, pc->x, prog, res,
-                                                    tag);
+        return sre_program_get_leading_bytes_helper(pool,
+                                                    sre_program_x(prog, pc),
+                                                    prog, res, visited);
 
     case SRE_OPCODE_SAVE:
         if (++pc == prog->start + prog->len) {
@@ -186,7 +1381,7 @@ sre_program_get_leading_bytes_helper(sre_pool_t *pool, sre_instruction_t *pc,
         }
 
         return sre_program_get_leading_bytes_helper(pool, pc, prog, res,
-                                                    tag);
+                                                    visited);
 
     case SRE_OPCODE_MATCH:
         prog->nullable = 1;
@@ -197,13 +1392,14 @@ sre_program_get_leading_bytes_helper(sre_pool_t *pool, sre_instruction_t *pc,
             return SRE_OK;
         }
 
-        return sre_program_get_leading_bytes_helper(pool, pc, prog, res, tag);
+        return sre_program_get_leading_bytes_helper(pool, pc, prog, res,
+                                                    visited);
 
     case SRE_OPCODE_ANY:
         return SRE_DECLINED;
 
     default:
-        /* CHAR, ANY, IN, NOTIN */
+        /* CHAR, IN, NOTIN, BITMAP */
 
         ncl = sre_palloc(pool, sizeof(sre_chain_t));
         if (ncl == NULL) {
@@ -275,6 +1471,7 @@ sre_program_len(sre_regex_t *r)
         return 1;
 
     case SRE_REGEX_TYPE_TOPLEVEL:
+    case SRE_REGEX_TYPE_REPEAT:
         return 1 + sre_program_len(r->left);
 
     case SRE_REGEX_TYPE_NIL:
@@ -286,9 +1483,14 @@ sre_program_len(sre_regex_t *r)
 
 
 static sre_instruction_t *
-sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
+sre_regex_emit_bytecode(sre_regex_compiler_t *c, sre_instruction_t *pc,
+    sre_regex_t *r)
 {
-    sre_instruction_t    *p1, *p2, *t;
+    uint32_t              t;
+    sre_vm_repeat_t       repeat;
+    sre_instruction_t    *p1, *p2, *start;
+
+    start = c->program->start;
 
     dd("program emit bytecode on node: %d", (int) r->type);
 
@@ -296,33 +1498,33 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
     case SRE_REGEX_TYPE_ALT:
         pc->opcode = SRE_OPCODE_SPLIT;
         p1 = pc++;
-        p1->x = pc;
+        p1->x = pc - start;
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
 
         pc->opcode = SRE_OPCODE_JMP;
         p2 = pc++;
-        p1->y = pc;
+        p1->y = pc - start;
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->right);
+        pc = sre_regex_emit_bytecode(c, pc, r->right);
         if (pc == NULL) {
             return NULL;
         }
 
-        p2->x = pc;
+        p2->x = pc - start;
 
         break;
 
     case SRE_REGEX_TYPE_CAT:
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->right);
+        pc = sre_regex_emit_bytecode(c, pc, r->right);
         if (pc == NULL) {
             return NULL;
         }
@@ -338,7 +1540,7 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
     case SRE_REGEX_TYPE_CLASS:
         pc->opcode = SRE_OPCODE_IN;
 
-        if (sre_regex_compiler_add_char_class(pool, pc, r->data.range)
+        if (sre_regex_compiler_add_char_class(c, pc, r->data.range)
             != SRE_OK)
         {
             return NULL;
@@ -350,7 +1552,7 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
     case SRE_REGEX_TYPE_NCLASS:
         pc->opcode = SRE_OPCODE_NOTIN;
 
-        if (sre_regex_compiler_add_char_class(pool, pc, r->data.range)
+        if (sre_regex_compiler_add_char_class(c, pc, r->data.range)
             != SRE_OK)
         {
             return NULL;
@@ -369,7 +1571,7 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
         pc->v.group = 2 * r->data.group;
         pc++;
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
@@ -384,14 +1586,14 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
     case SRE_REGEX_TYPE_QUEST:
         pc->opcode = SRE_OPCODE_SPLIT;
         p1 = pc++;
-        p1->x = pc;
+        p1->x = pc - start;
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
 
-        p1->y = pc;
+        p1->y = pc - start;
 
         if (!r->data.greedy) { /* non-greedy */
             t = p1->x;
@@ -404,18 +1606,18 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
     case SRE_REGEX_TYPE_STAR:
         pc->opcode = SRE_OPCODE_SPLIT;
         p1 = pc++;
-        p1->x = pc;
+        p1->x = pc - start;
 
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
 
         pc->opcode = SRE_OPCODE_JMP;
-        pc->x = p1;
+        pc->x = p1 - start;
         pc++;
 
-        p1->y = pc;
+        p1->y = pc - start;
 
         if (!r->data.greedy) { /* non-greedy */
             t = p1->x;
@@ -427,17 +1629,17 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
 
     case SRE_REGEX_TYPE_PLUS:
         p1 = pc;
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
 
         pc->opcode = SRE_OPCODE_SPLIT;
-        pc->x = p1;
+        pc->x = p1 - start;
         p2 = pc;
 
         pc++;
-        p2->y = pc;
+        p2->y = pc - start;
 
         if (!r->data.greedy) { /* non-greedy */
             t = p2->x;
@@ -447,6 +1649,32 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
 
         break;
 
+    case SRE_REGEX_TYPE_REPEAT:
+        repeat.min = r->data.cquant.from;
+        repeat.max = r->data.cquant.to == -1 ? 0 : r->data.cquant.to;
+        repeat.greedy = r->data.cquant.greedy;
+
+        p1 = pc;
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
+        if (pc == NULL) {
+            return NULL;
+        }
+
+        pc->opcode = SRE_OPCODE_COUNT;
+
+        if (sre_regex_compiler_add_data(c, &repeat, sizeof(sre_vm_repeat_t),
+                                        &pc->v.data)
+            != SRE_OK)
+        {
+            return NULL;
+        }
+
+        pc->x = p1 - start;
+        pc->y = pc + 1 - start;
+        pc++;
+
+        break;
+
     case SRE_REGEX_TYPE_ASSERT:
         pc->opcode = SRE_OPCODE_ASSERT;
         pc->v.assertion = r->data.assertion;
@@ -455,7 +1683,7 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
         break;
 
     case SRE_REGEX_TYPE_TOPLEVEL:
-        pc = sre_regex_emit_bytecode(pool, pc, r->left);
+        pc = sre_regex_emit_bytecode(c, pc, r->left);
         if (pc == NULL) {
             return NULL;
         }
@@ -482,36 +1710,123 @@ sre_regex_emit_bytecode(sre_pool_t *pool, sre_instruction_t *pc, sre_regex_t *r)
 }
 
 
+/*
+ * Emits a class as a char, "any", a bitmap, or the IN or NOTIN of its one
+ * or two ranges when they take at most two comparisons.
+ */
 static sre_int_t
-sre_regex_compiler_add_char_class(sre_pool_t *pool, sre_instruction_t *pc,
-    sre_regex_range_t *range)
+sre_regex_compiler_add_char_class(sre_regex_compiler_t *c,
+    sre_instruction_t *pc, sre_regex_range_t *range)
 {
-    sre_char             *p;
-    sre_uint_t            i, n;
-    sre_regex_range_t    *r;
+    unsigned             ch, n, cost, nranges;
+    sre_uint_t           i;
+    sre_byteset_t        set;
+    sre_regex_range_t   *r;
+
+    sre_memzero(&set, sizeof(sre_byteset_t));
+
+    cost = 0;
+    nranges = 0;
 
-    n = 0;
     for (r = range; r; r = r->next) {
-        n++;
+        sre_byteset_add_range(&set, r->from, r->to);
+        cost += (r->from == r->to) ? 1 : 2;
+        nranges++;
     }
 
-    p = sre_pnalloc(pool,
-                    sizeof(sre_vm_ranges_t) + n * sizeof(sre_vm_range_t));
-    if (p == NULL) {
-        return SRE_ERROR;
+    if (pc->opcode == SRE_OPCODE_NOTIN) {
+        sre_byteset_negate(&set);
+    }
+
+    for (ch = 0, n = 0, i = 0; i < 256; i++) {
+        if (sre_byteset_test(&set, i)) {
+            ch = (unsigned) i;
+            n++;
+        }
+    }
+
+    if (n == 256) {
+        pc->opcode = SRE_OPCODE_ANY;
+        c->program->simplified_classes++;
+        return SRE_OK;
     }
 
-    pc->v.ranges = (sre_vm_ranges_t *) p;
+    if (n == 1) {
+        pc->opcode = SRE_OPCODE_CHAR;
+        pc->v.ch = (sre_char) ch;
+        c->program->simplified_classes++;
+        return SRE_OK;
+    }
+
+    if (nranges && cost <= 2) {
+        r = range->next ? range->next : range;
+
+        pc->v.ranges[0].from = range->from;
+        pc->v.ranges[0].to = range->to;
+        pc->v.ranges[1].from = r->from;
+        pc->v.ranges[1].to = r->to;
+
+        return SRE_OK;
+    }
+
+    pc->opcode = SRE_OPCODE_BITMAP;
+    c->program->simplified_classes++;
+
+    for (i = 0; i < SRE_PROGRAM_NCLASS_BITMAPS; i++) {
+        if (memcmp(sre_program_class_bitmaps[i], set.bits, sizeof(set.bits))
+            == 0)
+        {
+            pc->v.data = SRE_PROGRAM_CLASS_BITMAP | (uint32_t) i;
+            return SRE_OK;
+        }
+    }
+
+    return sre_regex_compiler_add_data(c, set.bits, sizeof(set.bits),
+                                       &pc->v.data);
+}
 
-    p += sizeof(sre_vm_ranges_t);
-    pc->v.ranges->head = (sre_vm_range_t *) p;
 
-    pc->v.ranges->count = n;
+/*
+ * Appends the data of an instruction to the data of the program, at an
+ * offset aligned for the counter loop bounds, growing it as needed.
+ */
+static sre_int_t
+sre_regex_compiler_add_data(sre_regex_compiler_t *c, const void *data,
+    size_t size, uint32_t *offset)
+{
+    size_t               len, n;
+    uint8_t             *p;
+    sre_program_t       *prog;
+
+    prog = c->program;
+
+    len = sre_align(prog->data_len, sizeof(sre_uint_t));
+
+    if (len + size > c->data_size) {
+        n = c->data_size ? 2 * c->data_size : 256;
+        while (n < len + size) {
+            n *= 2;
+        }
+
+        p = sre_palloc(c->pool, n);
+        if (p == NULL) {
+            return SRE_ERROR;
+        }
 
-    for (i = 0, r = range; r; i++, r = r->next) {
-        pc->v.ranges->head[i].from = r->from;
-        pc->v.ranges->head[i].to = r->to;
+        if (prog->data) {
+            memcpy(p, prog->data, prog->data_len);
+            (void) sre_pfree(c->pool, prog->data);
+        }
+
+        prog->data = p;
+        c->data_size = n;
     }
 
+    sre_memzero(prog->data + prog->data_len, len - prog->data_len);
+    memcpy(prog->data + len, data, size);
+
+    *offset = (uint32_t) len;
+    prog->data_len = len + size;
+
     return SRE_OK;
 }
@@ -0,0 +1,681 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_backtrack.h>
+#include <sregex/sre_vm_pike.h>
+
+
+#define sre_vm_backtrack_is_lookahead(pc)                                   \
+    ((pc)->opcode == SRE_OPCODE_ASSERT                                       \
+     && (pc)->v.assertion != SRE_REGEX_ASSERT_BIG_A                          \
+     && (pc)->v.assertion != SRE_REGEX_ASSERT_CARET)
+
+
+static sre_int_t sre_vm_backtrack_check_region(sre_program_t *prog,
+    uint8_t *region, uint8_t *deferred);
+static void sre_vm_backtrack_closure(sre_program_t *prog,
+    sre_instruction_t *pc, uint8_t *marks, unsigned deferred);
+static sre_vm_backtrack_ctx_t *sre_vm_backtrack_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog);
+static sre_int_t sre_vm_backtrack_run(sre_vm_pike_ctx_t *ctx,
+    sre_vm_backtrack_ctx_t *bt, sre_char *input, size_t size, sre_int_t start,
+    sre_instruction_t **matched);
+static void sre_vm_backtrack_push_starts(sre_vm_pike_ctx_t *ctx,
+    sre_vm_backtrack_ctx_t *bt, sre_char *input, size_t size, sre_int_t pos);
+static sre_int_t sre_vm_backtrack_grow_jobs(sre_pool_t *pool,
+    sre_vm_backtrack_ctx_t *bt, sre_uint_t n);
+
+
+/*
+ * Decides if the Pike VM may backtrack on small subjects instead, and sets
+ * prog->backtrack_size accordingly. The Pike VM runs the continuation of
+ * a look-ahead assertion only after the closure the assertion is added
+ * in, while a backtracker runs it right away, so they visit the
+ * instructions in the same order only when the continuation cannot reach
+ * that closure. Counter loops are not supported either.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_backtrack_compile(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_uint_t               i, n;
+    uint8_t                 *region, *deferred;
+    sre_instruction_t       *pc;
+
+    prog->backtrack_size = 0;
+
+    if (prog->slots || prog->len > SRE_VM_BACKTRACK_MAX_BITS) {
+        return SRE_DECLINED;
+    }
+
+    n = 0;
+
+    for (i = 0; i < prog->len; i++) {
+        if (sre_vm_backtrack_is_lookahead(&prog->start[i])) {
+            n++;
+        }
+    }
+
+    if (n > SRE_VM_BACKTRACK_MAX_ASSERTIONS) {
+        return SRE_DECLINED;
+    }
+
+    region = sre_pnalloc(pool, 2 * prog->len);
+    if (region == NULL) {
+        return SRE_ERROR;
+    }
+
+    deferred = region + prog->len;
+
+    /* the closures the Pike VM adds to its thread lists */
+
+    sre_memzero(region, prog->len);
+    sre_vm_backtrack_closure(prog, prog->start, region, 0);
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            sre_vm_backtrack_closure(prog, pc + 1, region, 0);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (sre_vm_backtrack_check_region(prog, region, deferred) != SRE_OK) {
+        return SRE_DECLINED;
+    }
+
+    /* the closures of the continuations of the look-ahead assertions */
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (!sre_vm_backtrack_is_lookahead(pc)) {
+            continue;
+        }
+
+        sre_memzero(region, prog->len);
+        sre_vm_backtrack_closure(prog, pc + 1, region, 0);
+
+        if (sre_vm_backtrack_check_region(prog, region, deferred) != SRE_OK) {
+            return SRE_DECLINED;
+        }
+    }
+
+    prog->backtrack_size = SRE_VM_BACKTRACK_MAX_BITS / prog->len;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Checks that the continuations of the look-ahead assertions in a closure,
+ * including the ones of the assertions they reach in turn, cannot reach
+ * the instructions of the closure.
+ */
+static sre_int_t
+sre_vm_backtrack_check_region(sre_program_t *prog, uint8_t *region,
+    uint8_t *deferred)
+{
+    sre_uint_t           i, j;
+    sre_instruction_t   *pc;
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (!region[i] || !sre_vm_backtrack_is_lookahead(pc)) {
+            continue;
+        }
+
+        sre_memzero(deferred, prog->len);
+        sre_vm_backtrack_closure(prog, pc + 1, deferred, 1);
+
+        for (j = 0; j < prog->len; j++) {
+            if (region[j] && deferred[j]) {
+                dd("pc %d reached by the continuation of pc %d", (int) j,
+                   (int) i);
+                return SRE_DECLINED;
+            }
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+/*
+ * Marks the instructions the Pike VM's add_thread visits from pc, going
+ * on after the look-ahead assertions as well if "deferred" is set.
+ */
+static void
+sre_vm_backtrack_closure(sre_program_t *prog, sre_instruction_t *pc,
+    uint8_t *marks, unsigned deferred)
+{
+    sre_uint_t           i;
+
+    if (marks[pc - prog->start]) {
+        return;
+    }
+
+    marks[pc - prog->start] = 1;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_JMP:
+        sre_vm_backtrack_closure(prog, sre_program_x(prog, pc), marks,
+                                 deferred);
+        break;
+
+    case SRE_OPCODE_SPLIT:
+        if (pc == prog->start && prog->multi) {
+            for (i = 0; i < prog->nregexes; i++) {
+                sre_vm_backtrack_closure(prog,
+                                         sre_program_regex_start(prog, i),
+                                         marks, deferred);
+            }
+
+        } else {
+            sre_vm_backtrack_closure(prog, sre_program_x(prog, pc), marks,
+                                     deferred);
+        }
+
+        sre_vm_backtrack_closure(prog, sre_program_y(prog, pc), marks,
+                                 deferred);
+        break;
+
+    case SRE_OPCODE_SAVE:
+        sre_vm_backtrack_closure(prog, pc + 1, marks, deferred);
+        break;
+
+    case SRE_OPCODE_ASSERT:
+        if (deferred || !sre_vm_backtrack_is_lookahead(pc)) {
+            sre_vm_backtrack_closure(prog, pc + 1, marks, deferred);
+        }
+
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+static sre_vm_backtrack_ctx_t *
+sre_vm_backtrack_create_ctx(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_vm_backtrack_ctx_t      *bt;
+
+    bt = sre_palloc(pool, sizeof(sre_vm_backtrack_ctx_t));
+    if (bt == NULL) {
+        return NULL;
+    }
+
+    bt->capture = sre_palloc(pool, prog->ovecsize);
+    if (bt->capture == NULL) {
+        return NULL;
+    }
+
+    bt->visited = NULL;
+    bt->visited_size = 0;
+
+    bt->njobs = 0;
+    bt->jobs_size = 0;
+    bt->jobs = NULL;
+
+    if (sre_vm_backtrack_grow_jobs(pool, bt, sre_max(64, prog->nregexes))
+        != SRE_OK)
+    {
+        return NULL;
+    }
+
+    return bt;
+}
+
+
+/*
+ * Runs the Pike VM on the whole subject by backtracking with the pairs of
+ * instructions and positions already visited recorded, and returns
+ * exactly what sre_vm_pike_exec would.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_backtrack_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size)
+{
+    size_t                       len, n;
+    sre_int_t                    rc, pos, *ovector;
+    sre_char                    *p;
+    sre_uint_t                   i, ofs;
+    sre_program_t               *prog;
+    sre_instruction_t           *pc;
+    sre_vm_backtrack_ctx_t      *bt;
+
+    if (ctx->eof) {
+        dd("eof found");
+        return SRE_ERROR;
+    }
+
+    prog = ctx->program;
+    bt = ctx->backtrack;
+
+    if (bt == NULL) {
+        bt = sre_vm_backtrack_create_ctx(ctx->pool, prog);
+        if (bt == NULL) {
+            return SRE_ERROR;
+        }
+
+        ctx->backtrack = bt;
+    }
+
+    ctx->buffer = input;
+    ctx->last = input + size;
+
+    if (ctx->empty_capture) {
+        dd("found empty capture");
+        ctx->empty_capture = 0;
+
+        if (size == 0) {
+            ctx->eof = 1;
+            return SRE_DECLINED;
+        }
+
+        pos = 1;
+
+    } else {
+        pos = 0;
+    }
+
+    n = ((size + 1) * prog->len + 7) / 8;
+
+    if (n > bt->visited_size) {
+        if (bt->visited) {
+            sre_pfree(ctx->pool, bt->visited);
+        }
+
+        bt->visited = sre_pnalloc(ctx->pool, n);
+        if (bt->visited == NULL) {
+            bt->visited_size = 0;
+            return SRE_ERROR;
+        }
+
+        bt->visited_size = n;
+    }
+
+    sre_memzero(bt->visited, n);
+
+    for (i = 0; i < prog->ovecsize / sizeof(sre_int_t); i++) {
+        bt->capture[i] = -1;
+    }
+
+    rc = sre_vm_backtrack_run(ctx, bt, input, size, pos, &pc);
+
+    if (rc == SRE_ERROR) {
+        return SRE_ERROR;
+    }
+
+    if (rc == SRE_DECLINED) {
+        ctx->eof = 1;
+        return SRE_DECLINED;
+    }
+
+    /* the same as the Pike VM does with its last matched position */
+
+    if (bt->capture[1] >= 0) {
+        p = input + bt->capture[1] - ctx->processed_bytes;
+        if (p > input) {
+            ctx->seen_newline = (p[-1] == '\n');
+            ctx->seen_word = sre_isword(p[-1]);
+        }
+    }
+
+    for (ofs = 0, i = 0; i < (sre_uint_t) pc->v.regex_id; i++) {
+        ofs += 2 * (prog->multi_ncaps[i] + 1);
+    }
+
+    ovector = ctx->ovector;
+    len = 2 * (prog->multi_ncaps[i] + 1) * sizeof(sre_int_t);
+
+    if (len > ctx->ovecsize) {
+        /* the caller does not want all the captures */
+        len = ctx->ovecsize;
+    }
+
+    memcpy(ovector, &bt->capture[ofs], len);
+
+    if (ctx->ovecsize > len) {
+        memset((char *) ovector + len, -1, ctx->ovecsize - len);
+    }
+
+    ctx->processed_bytes = ovector[1];
+    ctx->empty_capture = (ovector[0] == ovector[1]);
+
+    return pc->v.regex_id;
+}
+
+
+/*
+ * Visits the threads in the order of their priority, so the first match
+ * found is the one the Pike VM returns. Like the Pike VM's add_thread, a
+ * split already visited at the position still tries its second branch if
+ * it has not been visited yet. The ".*?" loop of the program is run by
+ * trying the start positions one after another.
+ */
+static sre_int_t
+sre_vm_backtrack_run(sre_vm_pike_ctx_t *ctx, sre_vm_backtrack_ctx_t *bt,
+    sre_char *input, size_t size, sre_int_t start,
+    sre_instruction_t **matched)
+{
+    unsigned                     in, seen_word;
+    uint8_t                     *visited;
+    sre_uint_t                   i, bit, base, len;
+    sre_int_t                    pos, end;
+    sre_int_t                   *capture;
+    sre_program_t               *prog;
+    sre_vm_range_t              *range;
+    sre_instruction_t           *pc;
+    sre_vm_backtrack_job_t      *job;
+
+    prog = ctx->program;
+    visited = bt->visited;
+    capture = bt->capture;
+    len = prog->len;
+    end = (sre_int_t) size;
+
+next_start:
+
+    if (prog->multi) {
+        sre_vm_backtrack_push_starts(ctx, bt, input, size, start);
+
+    } else {
+        bt->jobs[0].pc = sre_program_x(prog, prog->start);
+        bt->jobs[0].pos = start;
+        bt->njobs = 1;
+    }
+
+    while (bt->njobs) {
+        job = &bt->jobs[--bt->njobs];
+        pc = job->pc;
+
+        if (pc == NULL) {
+            capture[job->pos] = job->value;
+            continue;
+        }
+
+        pos = job->pos;
+        base = pos * len;
+
+        for ( ;; ) {
+            bit = base + (pc - prog->start);
+
+            if (visited[bit >> 3] & (1 << (bit & 7))) {
+                if (pc->opcode == SRE_OPCODE_SPLIT) {
+                    bit = base + pc->y;
+
+                    if (!(visited[bit >> 3] & (1 << (bit & 7)))) {
+                        pc = sre_program_y(prog, pc);
+                        continue;
+                    }
+                }
+
+                break;
+            }
+
+            visited[bit >> 3] |= 1 << (bit & 7);
+
+            switch (pc->opcode) {
+            case SRE_OPCODE_CHAR:
+                if (pos == end || input[pos] != pc->v.ch) {
+                    goto fail;
+                }
+
+                pc++;
+                pos++;
+                base += len;
+                continue;
+
+            case SRE_OPCODE_ANY:
+                if (pos == end) {
+                    goto fail;
+                }
+
+                pc++;
+                pos++;
+                base += len;
+                continue;
+
+            case SRE_OPCODE_BITMAP:
+                if (pos == end
+                    || !sre_vm_bitmap_test(sre_program_bitmap(prog, pc),
+                                           input[pos]))
+                {
+                    goto fail;
+                }
+
+                pc++;
+                pos++;
+                base += len;
+                continue;
+
+            case SRE_OPCODE_IN:
+            case SRE_OPCODE_NOTIN:
+                if (pos == end) {
+                    goto fail;
+                }
+
+                in = 0;
+                for (i = 0; i < sre_vm_nranges(pc); i++) {
+                    range = &pc->v.ranges[i];
+
+                    if (input[pos] >= range->from && input[pos] <= range->to) {
+                        in = 1;
+                        break;
+                    }
+                }
+
+                if (in ^ (pc->opcode == SRE_OPCODE_IN)) {
+                    goto fail;
+                }
+
+                pc++;
+                pos++;
+                base += len;
+                continue;
+
+            case SRE_OPCODE_JMP:
+                pc = sre_program_x(prog, pc);
+                continue;
+
+            case SRE_OPCODE_SPLIT:
+                if (bt->njobs == bt->jobs_size
+                    && sre_vm_backtrack_grow_jobs(ctx->pool, bt,
+                                                  2 * bt->jobs_size)
+                       != SRE_OK)
+                {
+                    return SRE_ERROR;
+                }
+
+                job = &bt->jobs[bt->njobs++];
+                job->pc = sre_program_y(prog, pc);
+                job->pos = pos;
+
+                pc = sre_program_x(prog, pc);
+                continue;
+
+            case SRE_OPCODE_SAVE:
+                if (bt->njobs == bt->jobs_size
+                    && sre_vm_backtrack_grow_jobs(ctx->pool, bt,
+                                                  2 * bt->jobs_size)
+                       != SRE_OK)
+                {
+                    return SRE_ERROR;
+                }
+
+                job = &bt->jobs[bt->njobs++];
+                job->pc = NULL;
+                job->pos = pc->v.group;
+                job->value = capture[pc->v.group];
+
+                capture[pc->v.group] = ctx->processed_bytes + pos;
+
+                pc++;
+                continue;
+
+            case SRE_OPCODE_ASSERT:
+                switch (pc->v.assertion) {
+                case SRE_REGEX_ASSERT_BIG_A:
+                    if (pos || ctx->processed_bytes) {
+                        goto fail;
+                    }
+
+                    break;
+
+                case SRE_REGEX_ASSERT_CARET:
+                    if (pos == 0) {
+                        if (ctx->processed_bytes && !ctx->seen_newline) {
+                            goto fail;
+                        }
+
+                    } else if (input[pos - 1] != '\n') {
+                        goto fail;
+                    }
+
+                    break;
+
+                case SRE_REGEX_ASSERT_SMALL_Z:
+                    if (pos != end) {
+                        goto fail;
+                    }
+
+                    break;
+
+                case SRE_REGEX_ASSERT_DOLLAR:
+                    if (pos != end && input[pos] != '\n') {
+                        goto fail;
+                    }
+
+                    break;
+
+                default:
+                    /* SRE_REGEX_ASSERT_SMALL_B, SRE_REGEX_ASSERT_BIG_B */
+
+                    seen_word = pos ? sre_isword(input[pos - 1])
+                                    : ctx->seen_word;
+
+                    in = seen_word ^ (pos != end && sre_isword(input[pos]));
+
+                    if (in ^ (pc->v.assertion == SRE_REGEX_ASSERT_SMALL_B)) {
+                        goto fail;
+                    }
+
+                    break;
+                }
+
+                pc++;
+                continue;
+
+            case SRE_OPCODE_MATCH:
+                *matched = pc;
+                return SRE_OK;
+
+            default:
+                /* impossible to reach here */
+                goto fail;
+            }
+        }
+
+fail:
+        continue;
+    }
+
+    if (start < end) {
+        start++;
+        goto next_start;
+    }
+
+    return SRE_DECLINED;
+}
+
+
+/*
+ * Pushes the starts of the regexes a multi-regex program tries at pos,
+ * the same ones the Pike VM's add_start_threads adds.
+ */
+static void
+sre_vm_backtrack_push_starts(sre_vm_pike_ctx_t *ctx,
+    sre_vm_backtrack_ctx_t *bt, sre_char *input, size_t size, sre_int_t pos)
+{
+    sre_int_t                    n;
+    sre_uint_t                   i, j, id, *hits;
+    sre_program_t               *prog;
+    sre_program_multi_t         *multi;
+    sre_vm_backtrack_job_t      *job;
+
+    prog = ctx->program;
+    multi = prog->multi;
+    hits = ctx->prefix_hits;
+
+    n = sre_multi_literal_match(&multi->prefixes, input + pos, input + size,
+                                hits);
+    if (n == SRE_AGAIN) {
+        hits = multi->gated;
+        n = (sre_int_t) multi->ngated;
+    }
+
+    /* the first regex is to be popped first */
+
+    bt->njobs = multi->nalways + (sre_uint_t) n;
+    job = &bt->jobs[bt->njobs];
+
+    for (i = 0, j = 0; i < multi->nalways || j < (sre_uint_t) n; /* void */) {
+        if (j == (sre_uint_t) n
+            || (i < multi->nalways && multi->always[i] < hits[j]))
+        {
+            id = multi->always[i++];
+
+        } else {
+            id = hits[j++];
+        }
+
+        job--;
+        job->pc = sre_program_regex_start(prog, id);
+        job->pos = pos;
+    }
+}
+
+
+static sre_int_t
+sre_vm_backtrack_grow_jobs(sre_pool_t *pool, sre_vm_backtrack_ctx_t *bt,
+    sre_uint_t n)
+{
+    sre_vm_backtrack_job_t      *jobs;
+
+    jobs = sre_palloc(pool, n * sizeof(sre_vm_backtrack_job_t));
+    if (jobs == NULL) {
+        return SRE_ERROR;
+    }
+
+    if (bt->jobs) {
+        memcpy(jobs, bt->jobs, bt->njobs * sizeof(sre_vm_backtrack_job_t));
+        sre_pfree(pool, bt->jobs);
+    }
+
+    bt->jobs = jobs;
+    bt->jobs_size = n;
+
+    return SRE_OK;
+}
@@ -0,0 +1,49 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_BACKTRACK_H_INCLUDED_
+#define _SRE_VM_BACKTRACK_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_vm_bytecode.h>
+
+
+/* the size of the bitmap of the visited (instruction, position) pairs */
+#define SRE_VM_BACKTRACK_MAX_BITS  (256 * 1024)
+
+/* the programs with more look-ahead assertions are left to the threads */
+#define SRE_VM_BACKTRACK_MAX_ASSERTIONS  32
+
+
+typedef struct {
+    sre_instruction_t           *pc;    /* NULL to restore a capture */
+    sre_int_t                    pos;   /* or the group to restore */
+    sre_int_t                    value; /* the value to restore */
+} sre_vm_backtrack_job_t;
+
+
+typedef struct {
+    uint8_t                     *visited;
+    size_t                       visited_size;  /* in bytes */
+    sre_vm_backtrack_job_t      *jobs;
+    sre_uint_t                   njobs;
+    sre_uint_t                   jobs_size;
+    sre_int_t                   *capture;
+} sre_vm_backtrack_ctx_t;
+
+
+SRE_NOAPI sre_int_t sre_vm_backtrack_compile(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_int_t sre_vm_backtrack_exec(sre_vm_pike_ctx_t *ctx,
+    sre_char *input, size_t size);
+
+
+#endif /* _SRE_VM_BACKTRACK_H_INCLUDED_ */
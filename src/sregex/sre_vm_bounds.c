@@ -0,0 +1,841 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_bounds.h>
+#include <sregex/sre_vm_pike.h>
+
+
+static sre_vm_bounds_ctx_t *sre_vm_bounds_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog);
+static void sre_vm_bounds_forward(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_int_t pos);
+static sre_int_t sre_vm_bounds_run(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_int_t pos, unsigned eof, unsigned locate);
+static void sre_vm_bounds_step(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_int_t pos);
+static sre_int_t sre_vm_bounds_add_thread(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_vm_bounds_list_t *l, sre_instruction_t *pc,
+    sre_int_t pos, unsigned done_on_match);
+static sre_int_t sre_vm_bounds_add_start_threads(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_vm_bounds_list_t *l, sre_int_t pos,
+    unsigned done_on_match);
+static void sre_vm_bounds_backward(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_int_t pos);
+static void sre_vm_bounds_add_reverse(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_vm_bounds_list_t *l, sre_instruction_t *pc,
+    sre_int_t pos);
+static unsigned sre_vm_bounds_accepts(sre_program_t *prog,
+    sre_instruction_t *pc, sre_char c);
+static unsigned sre_vm_bounds_assertion_holds(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_uint_t assertion, sre_int_t pos);
+
+
+static sre_vm_bounds_ctx_t *
+sre_vm_bounds_create_ctx(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_uint_t                   n, rn;
+    sre_uint_t                  *p;
+    sre_vm_bounds_ctx_t         *bd;
+
+    bd = sre_pcalloc(pool, sizeof(sre_vm_bounds_ctx_t));
+    if (bd == NULL) {
+        return NULL;
+    }
+
+    n = prog->len;
+    rn = prog->reverse ? prog->reverse->len : 0;
+
+    /*
+     * the current threads hold every instruction at most once, and so do
+     * the ones added by look-ahead assertions in a step
+     */
+
+    p = sre_palloc(pool, (7 * n + 3 * rn) * sizeof(sre_uint_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    bd->clist.pcs = p;
+    bd->nlist.pcs = p + 2 * n;
+    bd->sublist.pcs = p + 4 * n;
+    bd->initial_states = p + 5 * n;
+    bd->rlist.pcs = p + 6 * n;
+    bd->rnext.pcs = p + 6 * n + rn;
+    bd->branches.pcs = p + 6 * n + 2 * rn;
+
+    bd->tags = sre_pcalloc(pool, (2 * n + rn) * sizeof(unsigned));
+    if (bd->tags == NULL) {
+        return NULL;
+    }
+
+    bd->held_tags = bd->tags + n;
+    bd->rtags = bd->tags + 2 * n;
+
+    return bd;
+}
+
+
+static sre_vm_bounds_ctx_t *
+sre_vm_bounds_get_ctx(sre_vm_pike_ctx_t *ctx)
+{
+    if (ctx->bounds == NULL) {
+        ctx->bounds = sre_vm_bounds_create_ctx(ctx->pool, ctx->program);
+    }
+
+    return ctx->bounds;
+}
+
+
+/*
+ * Finds the whole match of the Pike VM on the whole subject without
+ * tracking any captures: the thread lists of the Pike VM, with its thread
+ * priorities and the way it cuts the threads after a match, are run
+ * forward to find the end of the match and the regex matched, and then
+ * prog->reverse is run backward from that end to find the start, which
+ * is the smallest position it can reach a match at, since the leftmost
+ * start of all the matches is the one the Pike VM takes.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_bounds_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size)
+{
+    sre_int_t                    pos, *ovector;
+    sre_char                    *p;
+    sre_vm_bounds_ctx_t         *bd;
+
+    if (ctx->eof) {
+        dd("eof found");
+        return SRE_ERROR;
+    }
+
+    bd = sre_vm_bounds_get_ctx(ctx);
+    if (bd == NULL) {
+        return SRE_ERROR;
+    }
+
+    ctx->buffer = input;
+    ctx->last = input + size;
+
+    bd->input = input;
+    bd->last = input + size;
+
+    if (ctx->empty_capture) {
+        dd("found empty capture");
+        ctx->empty_capture = 0;
+
+        if (size == 0) {
+            ctx->eof = 1;
+            return SRE_DECLINED;
+        }
+
+        pos = 1;
+
+    } else {
+        pos = 0;
+    }
+
+    sre_vm_bounds_forward(ctx, bd, pos);
+
+    if (bd->matched_id < 0) {
+        ctx->eof = 1;
+        return SRE_DECLINED;
+    }
+
+    sre_vm_bounds_backward(ctx, bd, pos);
+
+    if (bd->start < 0) {
+        /* impossible to reach here */
+        return SRE_ERROR;
+    }
+
+    dd("matched regex %d at [%d, %d)", (int) bd->matched_id,
+       (int) bd->start, (int) bd->end);
+
+    /*
+     * the same as the Pike VM does with its last matched position, which
+     * it takes from the end of $0 of the first regex only
+     */
+
+    p = input + bd->end;
+    if (bd->matched_id == 0 && p > input) {
+        ctx->seen_newline = (p[-1] == '\n');
+        ctx->seen_word = sre_isword(p[-1]);
+    }
+
+    ovector = ctx->ovector;
+
+    ovector[0] = ctx->processed_bytes + bd->start;
+    ovector[1] = ctx->processed_bytes + bd->end;
+
+    if (ctx->ovecsize > 2 * sizeof(sre_int_t)) {
+        memset(&ovector[2], -1, ctx->ovecsize - 2 * sizeof(sre_int_t));
+    }
+
+    ctx->processed_bytes = ovector[1];
+    ctx->empty_capture = (ovector[0] == ovector[1]);
+
+    return bd->matched_id;
+}
+
+
+/*
+ * Called by sre_vm_pike_exec_helper when its current threads at "sp" are
+ * just like the start ones: replays them without any captures up to the
+ * first match or the end of the buffer, and returns the last position
+ * before that at which only the threads started there are left. The
+ * Pike VM can jump there and start over, since the threads it drops die
+ * without a match. Returns NULL on errors.
+ */
+SRE_NOAPI sre_char *
+sre_vm_bounds_locate(sre_vm_pike_ctx_t *ctx, sre_vm_pike_thread_t *threads,
+    sre_uint_t nthreads, sre_char *sp, sre_char *last, unsigned eof)
+{
+    sre_int_t                    pos;
+    sre_uint_t                   i;
+    sre_program_t               *prog;
+    sre_vm_bounds_ctx_t         *bd;
+    sre_vm_pike_thread_t        *t;
+
+    bd = sre_vm_bounds_get_ctx(ctx);
+    if (bd == NULL) {
+        return NULL;
+    }
+
+    if (ctx->processed_bytes + (sp - ctx->buffer) < bd->until) {
+        /* no thread is started over before the match or the end seen */
+        return sp;
+    }
+
+    prog = ctx->program;
+
+    bd->input = ctx->buffer;
+    bd->last = last;
+
+    bd->clist.count = 0;
+    for (t = threads; t < threads + nthreads; t++) {
+        if (sp == bd->input && t->seen_word && !ctx->seen_word) {
+            /*
+             * the thread was added at the end of the previous buffer and
+             * knows better than ctx->seen_word for \b and \B here
+             */
+            return sp;
+        }
+
+        bd->clist.pcs[bd->clist.count++] = t->pc - prog->start;
+    }
+
+    bd->initial_states_count = ctx->initial_states_count;
+    for (i = 0; i + 1 < ctx->initial_states_count; i++) {
+        bd->initial_states[i] = ctx->initial_states[i] - prog->start;
+    }
+
+    pos = sre_vm_bounds_run(ctx, bd, sp - bd->input, eof, 1);
+
+    dd("located threads to run from %d to %d", (int) bd->fresh, (int) pos);
+
+    /* the replay is only redone after all it has seen */
+    bd->until = ctx->processed_bytes + pos;
+
+    return bd->input + bd->fresh;
+}
+
+
+/* see sre_vm_pike_exec_helper */
+static void
+sre_vm_bounds_forward(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_int_t pos)
+{
+    sre_program_t               *prog;
+    sre_vm_bounds_list_t        *clist;
+
+    prog = ctx->program;
+    clist = &bd->clist;
+
+    bd->no_prefix_hits = (prog->multi != NULL);
+
+    bd->tag++;
+    clist->count = 0;
+    (void) sre_vm_bounds_add_thread(ctx, bd, clist, prog->start, pos, 0);
+
+    memcpy(bd->initial_states, clist->pcs, clist->count * sizeof(sre_uint_t));
+    bd->initial_states_count = clist->count;
+
+    if (bd->no_prefix_hits) {
+        bd->no_prefix_hits = 0;
+
+        bd->tag++;
+        clist->count = 0;
+        (void) sre_vm_bounds_add_thread(ctx, bd, clist, prog->start, pos, 0);
+    }
+
+    (void) sre_vm_bounds_run(ctx, bd, pos, 1, 0);
+}
+
+
+/*
+ * Runs the threads in bd->clist from "pos" on, just like
+ * sre_vm_pike_exec_helper does, until none is left or the end of the
+ * buffer is reached, or else until the first match when "locate" is set.
+ * Returns the position it stops at, and saves in bd->fresh the last
+ * position the threads are just the start ones at.
+ */
+static sre_int_t
+sre_vm_bounds_run(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_int_t pos, unsigned eof, unsigned locate)
+{
+    sre_int_t                    size;
+    sre_char                    *p, *sp;
+    sre_uint_t                   i;
+    sre_program_t               *prog;
+    sre_vm_bounds_list_t        *clist, *nlist, tmp;
+
+    prog = ctx->program;
+    size = bd->last - bd->input;
+
+    clist = &bd->clist;
+    nlist = &bd->nlist;
+
+    bd->matched_id = -1;
+    bd->seen_start_state = 0;
+    bd->fresh = pos;
+
+    for ( ;; pos++) {
+        if (clist->count == 0 || (pos == size && !eof)) {
+            break;
+        }
+
+        if ((prog->leading_set || prog->inner
+             || (prog->multi && prog->multi->nalways == 0))
+            && bd->seen_start_state)
+        {
+            bd->seen_start_state = 0;
+
+            if (pos == size || clist->count != bd->initial_states_count) {
+                goto run_cur_threads;
+            }
+
+            /* the last thread is always the ".*?" one */
+
+            for (i = 0; i + 1 < clist->count; i++) {
+                if (clist->pcs[i] != bd->initial_states[i]) {
+                    goto run_cur_threads;
+                }
+            }
+
+            sp = bd->input + pos;
+
+            if (prog->prefix) {
+                p = sre_literal_find(prog->prefix, sp, bd->last);
+
+            } else if (ctx->inner) {
+                p = sre_vm_inner_find(ctx->inner, sp, bd->last, eof);
+
+            } else if (prog->multi && prog->multi->nalways == 0) {
+                p = sre_multi_literal_find(&prog->multi->prefixes, sp,
+                                           bd->last);
+
+            } else {
+                p = sre_byteset_find(prog->leading_set, sp, bd->last);
+            }
+
+            if (p > sp) {
+                dd("skipped %d bytes", (int) (p - sp));
+
+                pos = p - bd->input;
+
+                bd->tag++;
+                clist->count = 0;
+                (void) sre_vm_bounds_add_thread(ctx, bd, clist, prog->start,
+                                                pos, 0);
+
+                bd->seen_start_state = 0;
+                bd->fresh = pos;
+
+                if (pos == size) {
+                    break;
+                }
+            }
+        }
+
+run_cur_threads:
+
+        bd->tag++;
+        nlist->count = 0;
+
+        bd->started = 0;
+        bd->continued = 0;
+
+        sre_vm_bounds_step(ctx, bd, pos);
+
+        tmp = *clist;
+        *clist = *nlist;
+        *nlist = tmp;
+
+        if (bd->matched_id >= 0) {
+            if (locate) {
+                break;
+            }
+
+        } else if (bd->started && !bd->continued) {
+            /* only the ".*?" thread moved on */
+            bd->fresh = pos + 1;
+        }
+
+        if (pos == size) {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+
+/* see sre_vm_pike_step_thread */
+static void
+sre_vm_bounds_step(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_int_t pos)
+{
+    unsigned                    *tags;
+    sre_uint_t                   i, n;
+    sre_program_t               *prog;
+    sre_instruction_t           *pc;
+    sre_vm_bounds_list_t        *clist, *sub;
+
+    prog = ctx->program;
+    clist = &bd->clist;
+    sub = &bd->sublist;
+
+    for (i = 0; i < clist->count; i++) {
+        pc = &prog->start[clist->pcs[i]];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_MATCH:
+            bd->matched_id = pc->v.regex_id;
+            bd->end = pos;
+            return;
+
+        case SRE_OPCODE_ASSERT:
+            if (!sre_vm_bounds_assertion_holds(ctx, bd, pc->v.assertion, pos))
+            {
+                break;
+            }
+
+            /*
+             * the threads added run right after the assertion, so they
+             * only skip the ones added by assertions in this step
+             */
+
+            tags = bd->tags;
+            bd->tags = bd->held_tags;
+
+            sub->count = 0;
+            (void) sre_vm_bounds_add_thread(ctx, bd, sub, pc + 1, pos, 0);
+
+            bd->tags = tags;
+
+            n = sub->count;
+
+            memmove(&clist->pcs[i + 1 + n], &clist->pcs[i + 1],
+                    (clist->count - i - 1) * sizeof(sre_uint_t));
+            memcpy(&clist->pcs[i + 1], sub->pcs, n * sizeof(sre_uint_t));
+            clist->count += n;
+
+            break;
+
+        default:
+            /* CHAR, ANY, IN, NOTIN, BITMAP */
+
+            if (bd->input + pos == bd->last
+                || !sre_vm_bounds_accepts(prog, pc, bd->input[pos]))
+            {
+                break;
+            }
+
+            if (clist->pcs[i] == 1) {
+                /* the "any" of the ".*?" prologue */
+                bd->started = 1;
+
+            } else {
+                bd->continued = 1;
+            }
+
+            if (sre_vm_bounds_add_thread(ctx, bd, &bd->nlist, pc + 1, pos + 1,
+                                         1)
+                == SRE_DONE)
+            {
+                return;
+            }
+
+            break;
+        }
+    }
+}
+
+
+/* see sre_vm_pike_add_thread */
+static sre_int_t
+sre_vm_bounds_add_thread(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_vm_bounds_list_t *l, sre_instruction_t *pc, sre_int_t pos,
+    unsigned done_on_match)
+{
+    sre_int_t                    rc;
+    sre_uint_t                   i, base;
+    sre_program_t               *prog;
+
+    prog = ctx->program;
+    base = bd->branches.count;
+
+    for ( ;; ) {
+        i = pc - prog->start;
+
+        if (bd->tags[i] == bd->tag) {
+            if (pc->opcode == SRE_OPCODE_SPLIT
+                && bd->tags[pc->y] != bd->tag)
+            {
+                if (pc == prog->start) {
+                    bd->seen_start_state = 1;
+                }
+
+                pc = sre_program_y(prog, pc);
+                continue;
+            }
+
+            goto next;
+        }
+
+        bd->tags[i] = bd->tag;
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_JMP:
+            pc = sre_program_x(prog, pc);
+            continue;
+
+        case SRE_OPCODE_SPLIT:
+            if (pc == prog->start) {
+                bd->seen_start_state = 1;
+
+                if (prog->multi) {
+                    rc = sre_vm_bounds_add_start_threads(ctx, bd, l, pos,
+                                                         done_on_match);
+                    if (rc != SRE_OK) {
+                        goto failed;
+                    }
+
+                    goto next;
+                }
+            }
+
+            bd->branches.pcs[bd->branches.count++] = pc->y;
+
+            pc = sre_program_x(prog, pc);
+            continue;
+
+        case SRE_OPCODE_SAVE:
+            pc++;
+            continue;
+
+        case SRE_OPCODE_ASSERT:
+            switch (pc->v.assertion) {
+            case SRE_REGEX_ASSERT_BIG_A:
+            case SRE_REGEX_ASSERT_CARET:
+                if (!sre_vm_bounds_assertion_holds(ctx, bd, pc->v.assertion,
+                                                   pos))
+                {
+                    goto next;
+                }
+
+                pc++;
+                continue;
+
+            default:
+                /* postpone look-ahead assertions */
+                break;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+            if (done_on_match) {
+                bd->matched_id = pc->v.regex_id;
+                bd->end = pos;
+                rc = SRE_DONE;
+                goto failed;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+
+        l->pcs[l->count++] = i;
+
+next:
+
+        if (bd->branches.count == base) {
+            return SRE_OK;
+        }
+
+        pc = prog->start + bd->branches.pcs[--bd->branches.count];
+    }
+
+failed:
+
+    bd->branches.count = base;
+
+    return rc;
+}
+
+
+/* see sre_vm_pike_add_start_threads */
+static sre_int_t
+sre_vm_bounds_add_start_threads(sre_vm_pike_ctx_t *ctx,
+    sre_vm_bounds_ctx_t *bd, sre_vm_bounds_list_t *l, sre_int_t pos,
+    unsigned done_on_match)
+{
+    sre_int_t                rc, n;
+    sre_uint_t               i, j, id, *hits;
+    sre_program_t           *prog;
+    sre_program_multi_t     *multi;
+
+    prog = ctx->program;
+    multi = prog->multi;
+    hits = ctx->prefix_hits;
+
+    if (bd->no_prefix_hits) {
+        n = 0;
+
+    } else {
+        n = sre_multi_literal_match(&multi->prefixes, bd->input + pos,
+                                    bd->last, hits);
+        if (n == SRE_AGAIN) {
+            hits = multi->gated;
+            n = (sre_int_t) multi->ngated;
+        }
+    }
+
+    for (i = 0, j = 0; i < multi->nalways || j < (sre_uint_t) n; /* void */) {
+        if (j == (sre_uint_t) n
+            || (i < multi->nalways && multi->always[i] < hits[j]))
+        {
+            id = multi->always[i++];
+
+        } else {
+            id = hits[j++];
+        }
+
+        rc = sre_vm_bounds_add_thread(ctx, bd, l,
+                                      sre_program_regex_start(prog, id), pos,
+                                      done_on_match);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+    }
+
+    return sre_vm_bounds_add_thread(ctx, bd, l,
+                                    sre_program_y(prog, prog->start), pos,
+                                    done_on_match);
+}
+
+
+/*
+ * Runs prog->reverse backward from the end of the match down to "pos" as
+ * a plain NFA, since any start it reaches will do, and saves the smallest
+ * one in bd->start. The assertions are evaluated on the subject at their
+ * positions, just like the forward pass does.
+ */
+static void
+sre_vm_bounds_backward(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_int_t pos)
+{
+    sre_int_t                    sp;
+    sre_char                     c;
+    sre_uint_t                   i;
+    sre_program_t               *rprog;
+    sre_instruction_t           *pc;
+    sre_vm_bounds_list_t        *clist, *nlist, *tmp;
+
+    rprog = ctx->program->reverse;
+
+    clist = &bd->rlist;
+    nlist = &bd->rnext;
+
+    bd->start = -1;
+
+    bd->rtag++;
+    clist->count = 0;
+    sre_vm_bounds_add_reverse(ctx, bd, clist, rprog->start, bd->end);
+
+    for (sp = bd->end; clist->count && sp > pos; sp--) {
+        c = bd->input[sp - 1];
+
+        bd->rtag++;
+        nlist->count = 0;
+
+        for (i = 0; i < clist->count; i++) {
+            pc = &rprog->start[clist->pcs[i]];
+
+            if (sre_vm_bounds_accepts(rprog, pc, c)) {
+                sre_vm_bounds_add_reverse(ctx, bd, nlist, pc + 1, sp - 1);
+            }
+        }
+
+        tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+    }
+}
+
+
+static void
+sre_vm_bounds_add_reverse(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_vm_bounds_list_t *l, sre_instruction_t *pc, sre_int_t pos)
+{
+    sre_uint_t                   i;
+    sre_program_t               *rprog;
+
+    rprog = ctx->program->reverse;
+
+    for ( ;; ) {
+        i = pc - rprog->start;
+
+        if (bd->rtags[i] == bd->rtag) {
+            goto next;
+        }
+
+        bd->rtags[i] = bd->rtag;
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_JMP:
+            pc = sre_program_x(rprog, pc);
+            continue;
+
+        case SRE_OPCODE_SPLIT:
+            bd->branches.pcs[bd->branches.count++] = pc->y;
+
+            pc = sre_program_x(rprog, pc);
+            continue;
+
+        case SRE_OPCODE_SAVE:
+            pc++;
+            continue;
+
+        case SRE_OPCODE_ASSERT:
+            if (sre_vm_bounds_assertion_holds(ctx, bd, pc->v.assertion, pos)) {
+                pc++;
+                continue;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+            bd->start = pos;
+            break;
+
+        default:
+            l->pcs[l->count++] = i;
+            break;
+        }
+
+next:
+
+        if (bd->branches.count == 0) {
+            return;
+        }
+
+        pc = rprog->start + bd->branches.pcs[--bd->branches.count];
+    }
+}
+
+
+static unsigned
+sre_vm_bounds_accepts(sre_program_t *prog, sre_instruction_t *pc, sre_char c)
+{
+    sre_uint_t           i;
+    sre_vm_range_t      *range;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_CHAR:
+        return c == pc->v.ch;
+
+    case SRE_OPCODE_ANY:
+        return 1;
+
+    case SRE_OPCODE_BITMAP:
+        return sre_vm_bitmap_test(sre_program_bitmap(prog, pc), c) != 0;
+
+    case SRE_OPCODE_IN:
+    case SRE_OPCODE_NOTIN:
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            if (c >= range->from && c <= range->to) {
+                return pc->opcode == SRE_OPCODE_IN;
+            }
+        }
+
+        return pc->opcode == SRE_OPCODE_NOTIN;
+
+    default:
+        return 0;
+    }
+}
+
+
+/*
+ * Tells whether an assertion holds at the position "pos" of the subject,
+ * with the byte before the subject told by the Pike VM context, just as
+ * the Pike VM does.
+ */
+static unsigned
+sre_vm_bounds_assertion_holds(sre_vm_pike_ctx_t *ctx, sre_vm_bounds_ctx_t *bd,
+    sre_uint_t assertion, sre_int_t pos)
+{
+    unsigned         seen_word;
+    sre_char        *sp;
+
+    sp = bd->input + pos;
+
+    switch (assertion) {
+    case SRE_REGEX_ASSERT_BIG_A:
+        return pos == 0 && ctx->processed_bytes == 0;
+
+    case SRE_REGEX_ASSERT_CARET:
+        if (pos == 0) {
+            return ctx->processed_bytes == 0 || ctx->seen_newline;
+        }
+
+        return sp[-1] == '\n';
+
+    case SRE_REGEX_ASSERT_SMALL_Z:
+        return sp == bd->last;
+
+    case SRE_REGEX_ASSERT_DOLLAR:
+        return sp == bd->last || *sp == '\n';
+
+    case SRE_REGEX_ASSERT_SMALL_B:
+    case SRE_REGEX_ASSERT_BIG_B:
+        seen_word = pos ? sre_isword(sp[-1]) : ctx->seen_word;
+        seen_word ^= (sp != bd->last && sre_isword(*sp));
+
+        if (assertion == SRE_REGEX_ASSERT_SMALL_B) {
+            return seen_word;
+        }
+
+        return !seen_word;
+
+    default:
+        /* impossible to reach here */
+        return 0;
+    }
+}
@@ -0,0 +1,76 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_BOUNDS_H_INCLUDED_
+#define _SRE_VM_BOUNDS_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_vm_bytecode.h>
+
+
+struct sre_vm_pike_thread_s;
+
+
+typedef struct {
+    sre_uint_t                   count;
+    sre_uint_t                  *pcs;       /* instruction indices */
+} sre_vm_bounds_list_t;
+
+
+typedef struct {
+    /* the forward pass, over the program */
+    sre_vm_bounds_list_t         clist;
+    sre_vm_bounds_list_t         nlist;
+    sre_vm_bounds_list_t         sublist;   /* the threads added when a
+                                               look-ahead assertion holds */
+    sre_vm_bounds_list_t         branches;  /* the "y" of the SPLITs left to
+                                               follow, over the program or
+                                               prog->reverse */
+    unsigned                    *tags;
+    unsigned                    *held_tags; /* the same, for the threads
+                                               added by look-ahead
+                                               assertions */
+    unsigned                     tag;
+    sre_uint_t                  *initial_states;
+    sre_uint_t                   initial_states_count;
+
+    /* the backward pass, over prog->reverse */
+    sre_vm_bounds_list_t         rlist;
+    sre_vm_bounds_list_t         rnext;
+    unsigned                    *rtags;
+    unsigned                     rtag;
+
+    sre_char                    *input;
+    sre_char                    *last;
+    sre_int_t                    matched_id;    /* -1 when not matched */
+    sre_int_t                    start;
+    sre_int_t                    end;
+    sre_int_t                    fresh;     /* the last position with
+                                               only the start threads */
+    sre_int_t                    until;     /* the offset the last replay
+                                               of sre_vm_bounds_locate
+                                               stopped at */
+
+    unsigned                     seen_start_state:1;
+    unsigned                     no_prefix_hits:1;
+    unsigned                     started:1;     /* the ".*?" moved on */
+    unsigned                     continued:1;   /* other threads did */
+} sre_vm_bounds_ctx_t;
+
+
+SRE_NOAPI sre_int_t sre_vm_bounds_exec(sre_vm_pike_ctx_t *ctx,
+    sre_char *input, size_t size);
+
+SRE_NOAPI sre_char *sre_vm_bounds_locate(sre_vm_pike_ctx_t *ctx,
+    struct sre_vm_pike_thread_s *threads, sre_uint_t nthreads, sre_char *sp,
+    sre_char *last, unsigned eof);
+
+
+#endif /* _SRE_VM_BOUNDS_H_INCLUDED_ */
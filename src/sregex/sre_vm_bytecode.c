@@ -11,36 +11,113 @@
 #include <stdio.h>
 
 
+/*
+ * the bitmaps of the predefined classes shared by all the programs (\d and
+ * \D are single ranges and never turned into bitmaps)
+ */
+const uint8_t  sre_program_class_bitmaps[SRE_PROGRAM_NCLASS_BITMAPS][32] = {
+    /* \w */
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x03,
+        0xfe, 0xff, 0xff, 0x87, 0xfe, 0xff, 0xff, 0x07,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    /* \W */
+    {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0xfc,
+        0x01, 0x00, 0x00, 0x78, 0x01, 0x00, 0x00, 0xf8,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    },
+    /* \s */
+    {
+        0x00, 0x36, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    /* \S */
+    {
+        0xff, 0xc9, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    },
+    /* \h */
+    {
+        0x00, 0x02, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    /* \H */
+    {
+        0xff, 0xfd, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    },
+    /* \v */
+    {
+        0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    /* \V */
+    {
+        0xff, 0xc3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xdf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    },
+};
+
+
 SRE_API void
 sre_program_dump(sre_program_t *prog)
 {
-    sre_instruction_t      *pc, *start, *end;
+    sre_instruction_t      *pc, *end;
 
-    start = prog->start;
     end = prog->start + prog->len;
 
-    for (pc = start; pc < end; pc++) {
-        sre_dump_instruction(stdout, pc, start);
+    for (pc = prog->start; pc < end; pc++) {
+        sre_dump_instruction(stdout, pc, prog);
         printf("\n");
     }
+
+    if (prog->emitted_len > prog->len || prog->threaded_jumps
+        || prog->simplified_classes)
+    {
+        printf("optimized: %d -> %d instructions, %d jumps threaded, "
+               "%d classes simplified\n", (int) prog->emitted_len,
+               (int) prog->len, (int) prog->threaded_jumps,
+               (int) prog->simplified_classes);
+    }
 }
 
 
 void
-sre_dump_instruction(FILE *f, sre_instruction_t *pc,
-    sre_instruction_t *start)
+sre_dump_instruction(FILE *f, sre_instruction_t *pc, sre_program_t *prog)
 {
+    unsigned                c, from;
     sre_uint_t              i;
+    const uint8_t          *bitmap;
     sre_vm_range_t         *range;
+    sre_vm_repeat_t        *repeat;
+    sre_instruction_t      *start;
+
+    start = prog->start;
 
     switch (pc->opcode) {
     case SRE_OPCODE_SPLIT:
         fprintf(f, "%2d. split %d, %d", (int) (pc - start),
-               (int) (pc->x - start), (int) (pc->y - start));
+               (int) pc->x, (int) pc->y);
         break;
 
     case SRE_OPCODE_JMP:
-        fprintf(f, "%2d. jmp %d", (int) (pc - start), (int) (pc->x - start));
+        fprintf(f, "%2d. jmp %d", (int) (pc - start), (int) pc->x);
         break;
 
     case SRE_OPCODE_CHAR:
@@ -50,8 +127,8 @@ sre_dump_instruction(FILE *f, sre_instruction_t *pc,
     case SRE_OPCODE_IN:
         fprintf(f, "%2d. in", (int) (pc - start));
 
-        for (i = 0; i < pc->v.ranges->count; i++) {
-            range = &pc->v.ranges->head[i];
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
             if (i > 0) {
                 fputc(',', f);
             }
@@ -63,8 +140,8 @@ sre_dump_instruction(FILE *f, sre_instruction_t *pc,
     case SRE_OPCODE_NOTIN:
         fprintf(f, "%2d. notin", (int) (pc - start));
 
-        for (i = 0; i < pc->v.ranges->count; i++) {
-            range = &pc->v.ranges->head[i];
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
             if (i > 0) {
                 fputc(',', f);
             }
@@ -73,6 +150,30 @@ sre_dump_instruction(FILE *f, sre_instruction_t *pc,
 
         break;
 
+    case SRE_OPCODE_BITMAP:
+        fprintf(f, "%2d. bitmap", (int) (pc - start));
+
+        bitmap = sre_program_bitmap(prog, pc);
+
+        for (i = 0, c = 0; c < 256; c++) {
+            if (!sre_vm_bitmap_test(bitmap, c)) {
+                continue;
+            }
+
+            for (from = c; c < 255; c++) {
+                if (!sre_vm_bitmap_test(bitmap, c + 1)) {
+                    break;
+                }
+            }
+
+            if (i++ > 0) {
+                fputc(',', f);
+            }
+            fprintf(f, " %d-%d", (int) from, (int) c);
+        }
+
+        break;
+
     case SRE_OPCODE_ANY:
         fprintf(f, "%2d. any", (int) (pc - start));
         break;
@@ -121,6 +222,19 @@ sre_dump_instruction(FILE *f, sre_instruction_t *pc,
 
         break;
 
+    case SRE_OPCODE_COUNT:
+        repeat = sre_program_repeat(prog, pc);
+
+        fprintf(f, "%2d. count %d, %d, %d, %d", (int) (pc - start),
+                (int) pc->x, (int) pc->y, (int) repeat->min,
+                (int) repeat->max);
+
+        if (!repeat->greedy) {
+            fprintf(f, " ng");
+        }
+
+        break;
+
     default:
         fprintf(f, "%2d. unknown", (int) (pc - start));
         break;
@@ -12,6 +12,9 @@
 
 
 #include <sregex/sre_regex.h>
+#include <sregex/sre_byteset.h>
+#include <sregex/sre_literal.h>
+#include <sregex/sre_multi_literal.h>
 #include <stdio.h>
 
 
@@ -24,62 +27,177 @@ typedef enum {
     SRE_OPCODE_SAVE     = 6,
     SRE_OPCODE_IN       = 7,
     SRE_OPCODE_NOTIN    = 8,
-    SRE_OPCODE_ASSERT   = 9
+    SRE_OPCODE_ASSERT   = 9,
+    SRE_OPCODE_COUNT    = 10,
+    SRE_OPCODE_BITMAP   = 11
 } sre_opcode_t;
 
 
+/*
+ * SRE_OPCODE_BITMAP tests the byte against a 256-bit membership table
+ * (32 bytes, the bit (c & 7) of the byte (c >> 3) for the byte c). It
+ * replaces SRE_OPCODE_IN and SRE_OPCODE_NOTIN when the ranges take more
+ * comparisons than a single table lookup.
+ */
+#define sre_vm_bitmap_test(bitmap, c)                                       \
+    ((bitmap)[(sre_char) (c) >> 3] & (1 << ((sre_char) (c) & 7)))
+
+
 typedef struct {
     sre_char      from;
     sre_char      to;
 } sre_vm_range_t;
 
 
+/*
+ * The bounds of a counter loop. The loop body runs from the instruction
+ * "x" of its SRE_OPCODE_COUNT up to the COUNT itself, which counts the
+ * iterations done and either jumps back to "x" or leaves the loop through
+ * "y".
+ */
 typedef struct {
-    sre_uint_t          count;
-    sre_vm_range_t     *head;
-} sre_vm_ranges_t;
+    sre_uint_t          min;
+    sre_uint_t          max;        /* 0 for no upper bound */
+    sre_uint_t          greedy;
+} sre_vm_repeat_t;
 
 
 typedef struct sre_instruction_s  sre_instruction_t;
 
+/*
+ * The instructions take 16 bytes each: "x" and "y" are the indices of the
+ * instructions jumped to, SRE_OPCODE_IN and SRE_OPCODE_NOTIN hold their
+ * one or two ranges inline (the second one repeating the first one when
+ * there is only one), and the bitmaps and the counter loop bounds live in
+ * the data of the program, at the offset "data", but for the shared
+ * bitmaps below. The larger classes always become bitmaps.
+ */
 struct sre_instruction_s {
-    sre_opcode_t             opcode;
-
-    sre_instruction_t       *x;
-    sre_instruction_t       *y;
+    uint8_t                  opcode;    /* sre_opcode_t */
 
-    unsigned                 tag;
+    uint32_t                 x;
+    uint32_t                 y;
 
     union {
         sre_char                ch;
-        sre_vm_ranges_t        *ranges;
-        sre_uint_t              group; /* capture group */
-        sre_uint_t              greedy;
-        sre_uint_t              assertion;
-        sre_int_t               regex_id;
+        sre_vm_range_t          ranges[2];
+        uint32_t                group; /* capture group */
+        uint32_t                greedy;
+        uint32_t                assertion;
+        int32_t                 regex_id;
+        uint32_t                data;
     } v;
 };
 
 
+#define sre_vm_nranges(pc)                                                   \
+    ((pc)->v.ranges[1].from == (pc)->v.ranges[0].from                        \
+     && (pc)->v.ranges[1].to == (pc)->v.ranges[0].to ? 1 : 2)
+
+
+/* the instructions jumped to */
+#define sre_program_x(prog, pc)  (&(prog)->start[(pc)->x])
+#define sre_program_y(prog, pc)  (&(prog)->start[(pc)->y])
+
+/* the entry of the regex "id" in a multi-regex program */
+#define sre_program_regex_start(prog, id)                                    \
+    (&(prog)->start[(prog)->multi->starts[id]])
+
+/*
+ * the bitmaps of \w, \s, \h, \v and their negations are shared by all
+ * the programs: the "data" of their instructions is their index in
+ * sre_program_class_bitmaps plus SRE_PROGRAM_CLASS_BITMAP
+ */
+#define SRE_PROGRAM_CLASS_BITMAP    0x80000000
+#define SRE_PROGRAM_NCLASS_BITMAPS  8
+
+#define sre_program_bitmap(prog, pc)                                         \
+    ((pc)->v.data & SRE_PROGRAM_CLASS_BITMAP                                 \
+     ? sre_program_class_bitmaps[(pc)->v.data & ~SRE_PROGRAM_CLASS_BITMAP]   \
+     : (const uint8_t *) ((prog)->data + (pc)->v.data))
+
+#define sre_program_repeat(prog, pc)                                         \
+    ((sre_vm_repeat_t *) ((prog)->data + (pc)->v.data))
+
+
 typedef struct sre_chain_s  sre_chain_t;
 
+typedef struct sre_vm_glushkov_s  sre_vm_glushkov_t;
+
+typedef struct sre_vm_onepass_s  sre_vm_onepass_t;
+typedef struct sre_vm_tdfa_s  sre_vm_tdfa_t;
+typedef struct sre_vm_closure_s  sre_vm_closure_t;
+
 struct sre_chain_s {
     void            *data;
     sre_chain_t     *next;
 };
 
 
+/*
+ * The literal prefixes of the regexes in a multi-regex program. The VMs
+ * only start the regexes without one and those whose prefix is seen.
+ */
+typedef struct {
+    uint32_t                *starts;    /* the entry of every regex */
+    sre_uint_t              *always;    /* the regexes without a prefix */
+    sre_uint_t               nalways;
+    sre_uint_t              *gated;     /* the regexes with a prefix */
+    sre_uint_t               ngated;
+    sre_multi_literal_t      prefixes;  /* indexed by the regex ids */
+} sre_program_multi_t;
+
+
+/*
+ * The state of a VM thread is its instruction plus, inside a counter loop,
+ * the number of iterations done (from 0 to max - 1, or to min for loops
+ * without an upper bound). Each state has a slot numbered from 0 to
+ * nslots - 1, for the "already on list" tags and the thread lists of the
+ * VMs. The programs with counter loops are limited to
+ * SRE_PROGRAM_MAX_SLOTS slots, which bounds the size of the VM contexts.
+ */
+#define SRE_PROGRAM_MAX_SLOTS  (1 << 18)
+
+#define sre_program_slot(prog, pc, counter)                                  \
+    ((prog)->slots ? (prog)->slots[(pc) - (prog)->start] + (counter)         \
+                   : (sre_uint_t) ((pc) - (prog)->start))
+
+
 struct sre_program_s {
     sre_instruction_t   *start;
     sre_uint_t           len;
 
-    unsigned             tag;
+    uint8_t             *data;         /* the bitmaps and the counter loop
+                                          bounds of the instructions */
+    sre_uint_t           data_len;
+
+    sre_uint_t          *slots;        /* per instruction, the slot for
+                                          counter 0; NULL without counter
+                                          loops */
+    sre_uint_t           nslots;
+
+    sre_uint_t           emitted_len;  /* len before the optimization */
+    sre_uint_t           threaded_jumps;
+    sre_uint_t           simplified_classes;
+
     unsigned             uniq_threads; /* unique thread count */
     unsigned             dup_threads;  /* duplicatable thread count */
     unsigned             lookahead_asserts;
     unsigned             nullable;
     sre_chain_t         *leading_bytes;
-    int                  leading_byte;
+    sre_byteset_t       *leading_set;  /* leading_bytes as a byte set */
+    sre_literal_t       *prefix;       /* literal prefix of all matches */
+    sre_literal_t       *inner;        /* literal inside all matches */
+    sre_program_t       *inner_prefix; /* the part before inner, reversed */
+    sre_program_t       *reverse;      /* all the regexes reversed, or NULL */
+    sre_program_multi_t *multi;        /* NULL if no regex has a prefix */
+    sre_vm_closure_t    *closure;      /* NULL if declined */
+    sre_vm_glushkov_t   *glushkov;     /* NULL if declined */
+    sre_vm_onepass_t    *onepass;      /* NULL if declined */
+    sre_vm_tdfa_t       *tdfa;         /* NULL if declined or one-pass */
+    sre_uint_t           backtrack_size;   /* the Pike VM backtracks on
+                                              the subjects smaller than
+                                              this; 0 if declined */
 
     sre_uint_t           ovecsize;
     sre_uint_t           nregexes;
@@ -87,8 +205,11 @@ struct sre_program_s {
 };
 
 
+extern const uint8_t  sre_program_class_bitmaps[SRE_PROGRAM_NCLASS_BITMAPS][32];
+
+
 void sre_dump_instruction(FILE *f, sre_instruction_t *pc,
-    sre_instruction_t *start);
+    sre_program_t *prog);
 
 
 #endif /* _SRE_BYTECODE_H_INCLUDED_ */
@@ -0,0 +1,396 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_closure.h>
+
+
+typedef struct {
+    sre_pool_t                  *pool;
+    sre_program_t               *program;
+    unsigned                    *tags;
+    unsigned                     tag;
+    sre_vm_closure_entry_t      *entries;
+    uint32_t                     nentries;
+    uint32_t                     nalloc;
+
+    unsigned                     newline:1;     /* ^ holds */
+    unsigned                     pike:1;        /* makes SPLIT_Y entries */
+    unsigned                     anchored:1;    /* a ^ was reached */
+    unsigned                     split_y:1;     /* a SPLIT_Y entry was
+                                                   made */
+} sre_vm_closure_compiler_t;
+
+
+static sre_int_t sre_vm_closure_build(sre_vm_closure_compiler_t *c,
+    uint8_t *roots, uint32_t **tables);
+static sre_int_t sre_vm_closure_add(sre_vm_closure_compiler_t *c,
+    sre_instruction_t *pc, uint32_t *index);
+static sre_int_t sre_vm_closure_follow(sre_vm_closure_compiler_t *c,
+    sre_instruction_t *pc, unsigned depth);
+static sre_int_t sre_vm_closure_grow(sre_vm_closure_compiler_t *c);
+
+
+/*
+ * Builds prog->closure, the instructions reached from every instruction
+ * threads are added at, with the SAVEs and the assertions on the way, in
+ * the very order of sre_vm_pike_add_thread and
+ * sre_vm_thompson_add_thread, so that the VMs run through flat arrays
+ * instead of recursing over the program for every thread. Returns
+ * SRE_DECLINED for counter loops, whose closures depend on the counters,
+ * and for closures too large or too deep.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_closure_compile(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_int_t                    rc;
+    sre_uint_t                   i, n;
+    uint8_t                     *roots;
+    sre_instruction_t           *pc;
+    sre_vm_closure_t            *cl;
+    sre_vm_closure_compiler_t    c;
+
+    prog->closure = NULL;
+
+    if (prog->slots) {
+        return SRE_DECLINED;
+    }
+
+    n = prog->len;
+
+    cl = sre_palloc(pool, sizeof(sre_vm_closure_t));
+    roots = sre_pcalloc(pool, n);
+    cl->pike[0] = sre_pcalloc(pool, 2 * n * sizeof(uint32_t));
+
+    sre_memzero(&c, sizeof(sre_vm_closure_compiler_t));
+
+    c.pool = pool;
+    c.program = prog;
+    c.tags = sre_pcalloc(pool, n * sizeof(unsigned));
+
+    if (cl == NULL || roots == NULL || cl->pike[0] == NULL
+        || c.tags == NULL)
+    {
+        return SRE_ERROR;
+    }
+
+    cl->pike[1] = cl->pike[0] + n;
+
+    /*
+     * threads are added after the consuming instructions and the
+     * look-ahead assertions holding, and at the start ones
+     */
+
+    for (i = 0; i + 1 < n; i++) {
+        pc = &prog->start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            roots[i + 1] = 1;
+            break;
+
+        case SRE_OPCODE_ASSERT:
+            if (pc->v.assertion & SRE_REGEX_ASSERT_LOOKAHEAD) {
+                roots[i + 1] = 1;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    roots[0] = 1;
+    roots[prog->start->y] = 1;
+
+    if (prog->multi) {
+        for (i = 0; i < prog->nregexes; i++) {
+            roots[prog->multi->starts[i]] = 1;
+        }
+    }
+
+    if (sre_vm_closure_grow(&c) != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    /* entries[0] tells the instructions without a closure */
+    c.nentries = 1;
+
+    c.pike = 1;
+
+    rc = sre_vm_closure_build(&c, roots, cl->pike);
+    if (rc != SRE_OK) {
+        goto failed;
+    }
+
+    if (c.split_y) {
+        cl->thompson[0] = sre_pcalloc(pool, 2 * n * sizeof(uint32_t));
+        if (cl->thompson[0] == NULL) {
+            return SRE_ERROR;
+        }
+
+        cl->thompson[1] = cl->thompson[0] + n;
+
+        c.pike = 0;
+
+        rc = sre_vm_closure_build(&c, roots, cl->thompson);
+        if (rc != SRE_OK) {
+            goto failed;
+        }
+
+    } else {
+        cl->thompson[0] = cl->pike[0];
+        cl->thompson[1] = cl->pike[1];
+    }
+
+    dd("%u closure entries for %u instructions", (unsigned) c.nentries,
+       (unsigned) n);
+
+    cl->entries = c.entries;
+    prog->closure = cl;
+
+    return SRE_OK;
+
+failed:
+
+    if (c.entries) {
+        (void) sre_pfree(pool, c.entries);
+    }
+
+    return rc;
+}
+
+
+static sre_int_t
+sre_vm_closure_build(sre_vm_closure_compiler_t *c, uint8_t *roots,
+    uint32_t **tables)
+{
+    sre_int_t                    rc;
+    sre_uint_t                   i;
+    sre_program_t               *prog;
+
+    prog = c->program;
+
+    for (i = 0; i < prog->len; i++) {
+        if (!roots[i]) {
+            continue;
+        }
+
+        c->newline = 0;
+        c->anchored = 0;
+        c->tag++;
+
+        rc = sre_vm_closure_add(c, &prog->start[i], &tables[0][i]);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+
+        if (!c->anchored) {
+            tables[1][i] = tables[0][i];
+            continue;
+        }
+
+        c->newline = 1;
+        c->tag++;
+
+        rc = sre_vm_closure_add(c, &prog->start[i], &tables[1][i]);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_closure_add(sre_vm_closure_compiler_t *c, sre_instruction_t *pc,
+    uint32_t *index)
+{
+    sre_int_t                    rc;
+    uint32_t                     k;
+
+    k = c->nentries;
+
+    rc = sre_vm_closure_follow(c, pc, 0);
+    if (rc != SRE_OK) {
+        return rc;
+    }
+
+    if (c->nentries - k == 1) {
+        /* a thread added right away: no faster than the VMs themselves */
+        c->nentries = k;
+        *index = 0;
+        return SRE_OK;
+    }
+
+    *index = k;
+
+    return SRE_OK;
+}
+
+
+/* see sre_vm_pike_add_thread */
+static sre_int_t
+sre_vm_closure_follow(sre_vm_closure_compiler_t *c, sre_instruction_t *pc,
+    unsigned depth)
+{
+    uint8_t                      type, n;
+    uint32_t                     k, i;
+    sre_int_t                    rc;
+    sre_program_t               *prog;
+    sre_instruction_t           *end;
+    sre_vm_closure_entry_t      *e;
+
+    prog = c->program;
+    end = prog->start + prog->len;
+
+    if (c->tags[pc - prog->start] == c->tag) {
+        if (!c->pike || pc->opcode != SRE_OPCODE_SPLIT
+            || c->tags[pc->y] == c->tag)
+        {
+            return SRE_OK;
+        }
+
+        type = SRE_VM_CLOSURE_SPLIT_Y;
+        c->split_y = 1;
+
+    } else {
+        c->tags[pc - prog->start] = c->tag;
+        type = SRE_VM_CLOSURE_FOLLOW;
+    }
+
+    if (depth >= SRE_VM_CLOSURE_MAX_DEPTH) {
+        return SRE_DECLINED;
+    }
+
+    if (c->nentries == c->nalloc) {
+        rc = sre_vm_closure_grow(c);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+    }
+
+    k = c->nentries++;
+
+    e = &c->entries[k];
+    e->pc = pc;
+    e->depth = (uint16_t) depth;
+    e->type = type;
+
+    rc = SRE_OK;
+
+    if (type == SRE_VM_CLOSURE_SPLIT_Y) {
+        rc = sre_vm_closure_follow(c, sre_program_y(prog, pc), depth + 1);
+
+    } else {
+        switch (pc->opcode) {
+        case SRE_OPCODE_JMP:
+            if (pc->x < prog->len) {
+                rc = sre_vm_closure_follow(c, sre_program_x(prog, pc),
+                                           depth + 1);
+            }
+
+            break;
+
+        case SRE_OPCODE_SPLIT:
+            if (pc == prog->start && prog->multi) {
+                /* left to the add_start_threads functions of the VMs */
+                break;
+            }
+
+            rc = sre_vm_closure_follow(c, sre_program_x(prog, pc), depth + 1);
+            if (rc != SRE_OK) {
+                break;
+            }
+
+            rc = sre_vm_closure_follow(c, sre_program_y(prog, pc), depth + 1);
+            break;
+
+        case SRE_OPCODE_SAVE:
+            if (pc + 1 < end) {
+                rc = sre_vm_closure_follow(c, pc + 1, depth + 1);
+            }
+
+            break;
+
+        case SRE_OPCODE_ASSERT:
+            if (pc->v.assertion != SRE_REGEX_ASSERT_CARET) {
+                /* \A never holds, and look-ahead ones become threads */
+                break;
+            }
+
+            c->anchored = 1;
+
+            if (c->newline && pc + 1 < end) {
+                rc = sre_vm_closure_follow(c, pc + 1, depth + 1);
+            }
+
+            break;
+
+        default:
+            /* the threads */
+            break;
+        }
+    }
+
+    c->entries[k].skip = c->nentries - k;
+
+    n = 0;
+    for (i = k + 1; i < c->nentries; i += c->entries[i].skip) {
+        n++;
+    }
+
+    c->entries[k].children = n;
+
+    return rc;
+}
+
+
+static sre_int_t
+sre_vm_closure_grow(sre_vm_closure_compiler_t *c)
+{
+    uint32_t                     n;
+    sre_vm_closure_entry_t      *entries;
+
+    if (c->nalloc == SRE_VM_CLOSURE_MAX_ENTRIES) {
+        return SRE_DECLINED;
+    }
+
+    n = c->nalloc ? 2 * c->nalloc : 4 * c->program->len + 64;
+    if (n > SRE_VM_CLOSURE_MAX_ENTRIES) {
+        n = SRE_VM_CLOSURE_MAX_ENTRIES;
+    }
+
+    entries = sre_palloc(c->pool, n * sizeof(sre_vm_closure_entry_t));
+    if (entries == NULL) {
+        return SRE_ERROR;
+    }
+
+    if (c->nalloc) {
+        memcpy(entries, c->entries,
+               c->nentries * sizeof(sre_vm_closure_entry_t));
+
+        (void) sre_pfree(c->pool, c->entries);
+    }
+
+    c->entries = entries;
+    c->nalloc = n;
+
+    return SRE_OK;
+}
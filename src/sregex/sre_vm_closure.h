@@ -0,0 +1,65 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_CLOSURE_H_INCLUDED_
+#define _SRE_VM_CLOSURE_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_vm_bytecode.h>
+
+
+/* the limits beyond which the VMs follow the instructions at run time */
+#define SRE_VM_CLOSURE_MAX_ENTRIES  (256 * 1024)
+#define SRE_VM_CLOSURE_MAX_DEPTH    256
+
+
+enum {
+    SRE_VM_CLOSURE_FOLLOW = 0,  /* the instruction is reached first */
+    SRE_VM_CLOSURE_SPLIT_Y      /* a SPLIT reached again, whose "y" the
+                                   Pike VM still follows */
+};
+
+
+/*
+ * An instruction reached when adding a thread, followed by the entries of
+ * the instructions reached from it, in the order sre_vm_pike_add_thread
+ * reaches them.
+ */
+typedef struct {
+    sre_instruction_t           *pc;
+    uint32_t                     skip;      /* 1 + the entries reached
+                                               from pc */
+    uint16_t                     depth;     /* of the tree of entries */
+    uint8_t                      type;      /* SRE_VM_CLOSURE_* */
+    uint8_t                      children;  /* the entries right below
+                                               it */
+} sre_vm_closure_entry_t;
+
+
+/*
+ * The closures of the instructions threads are added at, per instruction
+ * and by whether ^ holds (the byte before is a newline), as the indices
+ * of their first entry. entries[0] is unused, so 0 tells the instructions
+ * without a closure. \A never holds in a closure: threads are added at
+ * the start of a buffer the slow way.
+ */
+struct sre_vm_closure_s {
+    sre_vm_closure_entry_t      *entries;
+    uint32_t                    *pike[2];
+    uint32_t                    *thompson[2];   /* without the SPLIT_Y
+                                                   entries */
+};
+
+
+SRE_NOAPI sre_int_t sre_vm_closure_compile(sre_pool_t *pool,
+    sre_program_t *prog);
+
+
+#endif /* _SRE_VM_CLOSURE_H_INCLUDED_ */
@@ -0,0 +1,927 @@
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_dfa.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+
+#define sre_vm_dfa_set_has(set, i)                                           \
+    ((set)->sparse[i] < (set)->count                                         \
+     && (set)->dense[(set)->sparse[i]] == (i))
+
+#define sre_vm_dfa_set_add(set, i)                                           \
+    (set)->sparse[i] = (set)->count;                                         \
+    (set)->dense[(set)->count++] = (i)
+
+#define sre_vm_dfa_push(set, stack, n, i)                                    \
+    if (!sre_vm_dfa_set_has(set, i)) {                                       \
+        sre_vm_dfa_set_add(set, i);                                          \
+        (stack)[(n)++] = (i);                                                \
+    }
+
+
+static sre_int_t sre_vm_dfa_init_set(sre_pool_t *pool, sre_vm_dfa_set_t *set,
+    sre_uint_t size);
+static void sre_vm_dfa_add_closure(sre_vm_dfa_builder_t *b,
+    sre_vm_dfa_set_t *set, unsigned idx, unsigned flags, int c);
+static unsigned sre_vm_dfa_assertion_holds(unsigned assertion, unsigned flags,
+    int c);
+static unsigned sre_vm_dfa_collect_insts(sre_vm_dfa_builder_t *b,
+    unsigned flags, unsigned *pflags);
+static int sre_vm_dfa_cmp_insts(const void *one, const void *two);
+static sre_vm_dfa_state_t *sre_vm_dfa_find_state(sre_vm_dfa_ctx_t *ctx,
+    unsigned *insts, unsigned ninsts, unsigned flags);
+static sre_vm_dfa_state_t *sre_vm_dfa_start_state(sre_vm_dfa_ctx_t *ctx);
+static sre_vm_dfa_state_t *sre_vm_dfa_next_state(sre_vm_dfa_ctx_t *ctx,
+    sre_vm_dfa_state_t *s, int c);
+static void sre_vm_dfa_reset_cache(sre_vm_dfa_ctx_t *ctx);
+static sre_int_t sre_vm_dfa_fall_back(sre_vm_dfa_ctx_t *ctx, unsigned *insts,
+    unsigned ninsts, unsigned flags);
+
+
+SRE_API sre_vm_dfa_ctx_t *
+sre_vm_dfa_create_ctx(sre_pool_t *pool, sre_program_t *prog,
+    size_t cache_size)
+{
+    size_t                   size;
+    unsigned                 nbuckets;
+    sre_vm_dfa_ctx_t        *ctx;
+
+    ctx = sre_pcalloc(pool, sizeof(sre_vm_dfa_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->pool = pool;
+
+    if (prog->slots) {
+        /* the states of counter loops are left to the Thompson VM */
+
+        ctx->nfa = sre_vm_thompson_create_ctx(pool, prog);
+        if (ctx->nfa == NULL) {
+            return NULL;
+        }
+
+        return ctx;
+    }
+
+    if (sre_vm_dfa_init_builder(pool, &ctx->builder, prog) != SRE_OK) {
+        return NULL;
+    }
+
+    if (cache_size == 0) {
+        cache_size = SRE_VM_DFA_DEFAULT_CACHE_SIZE;
+
+    } else if (cache_size < SRE_VM_DFA_MIN_CACHE_SIZE) {
+        cache_size = SRE_VM_DFA_MIN_CACHE_SIZE;
+    }
+
+    /* we expect an average state to take no less than 256 bytes */
+
+    for (nbuckets = 64; nbuckets * 256 < cache_size; nbuckets <<= 1) {
+        /* void */
+    }
+
+    ctx->nbuckets = nbuckets;
+    ctx->buckets = sre_pcalloc(pool, nbuckets * sizeof(sre_vm_dfa_state_t *));
+    if (ctx->buckets == NULL) {
+        return NULL;
+    }
+
+    size = cache_size - nbuckets * sizeof(sre_vm_dfa_state_t *);
+
+    ctx->cache = sre_palloc(pool, size);
+    if (ctx->cache == NULL) {
+        return NULL;
+    }
+
+    ctx->cache_last = ctx->cache;
+    ctx->cache_end = ctx->cache + size;
+
+    dd("dfa cache: %d bytes, %u buckets, %u byte classes", (int) size,
+       nbuckets, ctx->builder.nclasses);
+
+    return ctx;
+}
+
+
+SRE_API sre_int_t
+sre_vm_dfa_exec(sre_vm_dfa_ctx_t *ctx, sre_char *input, size_t size,
+    unsigned eof)
+{
+    unsigned                 flags;
+    sre_char                *sp, *last, *p, *classes;
+    sre_vm_dfa_state_t      *s, *ns;
+
+    if (ctx->nfa) {
+        return sre_vm_thompson_exec(ctx->nfa, input, size, eof);
+    }
+
+    s = ctx->state;
+
+    if (s == NULL) {
+        s = sre_vm_dfa_start_state(ctx);
+        if (s == NULL) {
+            if (ctx->nfa) {
+                return sre_vm_thompson_exec(ctx->nfa, input, size, eof);
+            }
+
+            return SRE_ERROR;
+        }
+
+        ctx->state = s;
+    }
+
+    if (s->flags & SRE_VM_DFA_MATCH) {
+        return SRE_OK;
+    }
+
+    classes = ctx->builder.classes;
+    last = input + size;
+
+    for (p = sp = input; sp < last; sp++) {
+        ns = s->next[classes[*sp]];
+
+        if (ns == NULL) {
+            ctx->scanned += sp - p;
+            p = sp;
+
+            ns = sre_vm_dfa_next_state(ctx, s, *sp);
+            if (ns == NULL) {
+                ctx->state = NULL;
+
+                if (ctx->nfa) {
+                    dd("falling back to the nfa at offset %d",
+                       (int) (sp - input));
+
+                    return sre_vm_thompson_exec(ctx->nfa, sp + 1,
+                                                last - sp - 1, eof);
+                }
+
+                return SRE_ERROR;
+            }
+        }
+
+        s = ns;
+
+        if (s->flags & SRE_VM_DFA_MATCH) {
+            ctx->state = s;
+            return SRE_OK;
+        }
+    }
+
+    ctx->scanned += sp - p;
+    ctx->state = s;
+
+    if (!eof) {
+        return SRE_AGAIN;
+    }
+
+    /* resolve the pending look-ahead assertions at the end of the stream */
+
+    flags = s->flags;
+    (void) sre_vm_dfa_step_insts(&ctx->builder, s->insts, s->ninsts,
+                                 SRE_VM_DFA_EOF, &flags);
+
+    if (flags & SRE_VM_DFA_MATCH) {
+        return SRE_OK;
+    }
+
+    return SRE_DECLINED;
+}
+
+
+SRE_API sre_vm_dfa_table_ctx_t *
+sre_vm_dfa_table_create_ctx(sre_pool_t *pool, sre_vm_dfa_table_t *table)
+{
+    sre_vm_dfa_table_ctx_t      *ctx;
+
+    ctx = sre_palloc(pool, sizeof(sre_vm_dfa_table_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->table = table;
+    ctx->state = table->start;
+
+    return ctx;
+}
+
+
+SRE_API sre_int_t
+sre_vm_dfa_table_exec(sre_vm_dfa_table_ctx_t *ctx, sre_char *input,
+    size_t size, unsigned eof)
+{
+    unsigned                 s, *trans;
+    sre_char                *sp, *last, *classes;
+    sre_vm_dfa_table_t      *table;
+
+    s = ctx->state;
+
+    if (s == 0) {
+        return SRE_OK;
+    }
+
+    table = ctx->table;
+    trans = table->trans;
+    classes = table->classes;
+    last = input + size;
+
+    for (sp = input; sp < last; sp++) {
+        s = trans[s + classes[*sp]];
+
+        if (s == 0) {
+            ctx->state = 0;
+            return SRE_OK;
+        }
+    }
+
+    ctx->state = s;
+
+    if (!eof) {
+        return SRE_AGAIN;
+    }
+
+    if (table->accept_eof[s / table->nclasses]) {
+        return SRE_OK;
+    }
+
+    return SRE_DECLINED;
+}
+
+
+SRE_NOAPI unsigned
+sre_vm_dfa_get_byte_classes(sre_program_t *prog, sre_char *classes)
+{
+    unsigned                 c, n;
+    uint8_t                  split[257];
+    sre_uint_t               i, j;
+    const uint8_t           *bitmap;
+    sre_vm_range_t          *range;
+    sre_instruction_t       *pc;
+
+    sre_memzero(split, sizeof(split));
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+            split[pc->v.ch] = 1;
+            split[pc->v.ch + 1] = 1;
+            break;
+
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+            for (j = 0; j < sre_vm_nranges(pc); j++) {
+                range = &pc->v.ranges[j];
+                split[range->from] = 1;
+                split[range->to + 1] = 1;
+            }
+
+            break;
+
+        case SRE_OPCODE_BITMAP:
+            bitmap = sre_program_bitmap(prog, pc);
+
+            for (c = 1; c < 256; c++) {
+                if (!sre_vm_bitmap_test(bitmap, c)
+                    != !sre_vm_bitmap_test(bitmap, c - 1))
+                {
+                    split[c] = 1;
+                }
+            }
+
+            break;
+
+        case SRE_OPCODE_ASSERT:
+            if (pc->v.assertion & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
+                split['0'] = 1;
+                split['9' + 1] = 1;
+                split['A'] = 1;
+                split['Z' + 1] = 1;
+                split['_'] = 1;
+                split['_' + 1] = 1;
+                split['a'] = 1;
+                split['z' + 1] = 1;
+            }
+
+            if (pc->v.assertion
+                & (SRE_REGEX_ASSERT_CARET|SRE_REGEX_ASSERT_DOLLAR))
+            {
+                split['\n'] = 1;
+                split['\n' + 1] = 1;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    n = 0;
+    for (c = 0; c < 256; c++) {
+        if (c && split[c]) {
+            n++;
+        }
+
+        classes[c] = (sre_char) n;
+    }
+
+    return n + 1;
+}
+
+
+SRE_NOAPI sre_int_t
+sre_vm_dfa_init_builder(sre_pool_t *pool, sre_vm_dfa_builder_t *b,
+    sre_program_t *prog)
+{
+    int                  c;
+    sre_uint_t           i;
+    sre_instruction_t   *pc;
+
+    b->program = prog;
+    b->nclasses = sre_vm_dfa_get_byte_classes(prog, b->classes);
+
+    for (c = 255; c >= 0; c--) {
+        b->class_bytes[b->classes[c]] = (sre_char) c;
+    }
+
+    b->flag_mask = 0;
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (pc->opcode != SRE_OPCODE_ASSERT) {
+            continue;
+        }
+
+        switch (pc->v.assertion) {
+        case SRE_REGEX_ASSERT_SMALL_B:
+        case SRE_REGEX_ASSERT_BIG_B:
+            b->flag_mask |= SRE_VM_DFA_SEEN_WORD;
+            break;
+
+        case SRE_REGEX_ASSERT_CARET:
+            b->flag_mask |= SRE_VM_DFA_SEEN_NEWLINE|SRE_VM_DFA_BEGIN;
+            break;
+
+        case SRE_REGEX_ASSERT_BIG_A:
+            b->flag_mask |= SRE_VM_DFA_BEGIN;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (sre_vm_dfa_init_set(pool, &b->cur, prog->len) != SRE_OK
+        || sre_vm_dfa_init_set(pool, &b->next, prog->len) != SRE_OK)
+    {
+        return SRE_ERROR;
+    }
+
+    b->stack = sre_palloc(pool, prog->len * sizeof(unsigned));
+    if (b->stack == NULL) {
+        return SRE_ERROR;
+    }
+
+    return SRE_OK;
+}
+
+
+SRE_NOAPI unsigned
+sre_vm_dfa_start_insts(sre_vm_dfa_builder_t *b, unsigned *pflags)
+{
+    unsigned        flags;
+
+    flags = SRE_VM_DFA_BEGIN & b->flag_mask;
+
+    b->next.count = 0;
+    sre_vm_dfa_add_closure(b, &b->next, 0, flags, -1);
+
+    return sre_vm_dfa_collect_insts(b, flags, pflags);
+}
+
+
+/*
+ * Computes the state reached from the instruction set "insts" (with the
+ * state flags in *pflags) after seeing the input byte "c" (or
+ * SRE_VM_DFA_EOF). The resulting instruction set is left in b->next.dense
+ * and its length is returned. The flags of the new state are saved into
+ * *pflags, and SRE_VM_DFA_MATCH is set there when a match is found before
+ * or right after consuming "c".
+ */
+SRE_NOAPI unsigned
+sre_vm_dfa_step_insts(sre_vm_dfa_builder_t *b, unsigned *insts,
+    unsigned ninsts, int c, unsigned *pflags)
+{
+    unsigned             i, j, idx, flags, nflags, in;
+    sre_vm_range_t      *range;
+    sre_vm_dfa_set_t    *cur, *next;
+    sre_instruction_t   *start, *pc;
+
+    start = b->program->start;
+    flags = *pflags;
+
+    cur = &b->cur;
+    next = &b->next;
+
+    cur->count = 0;
+    next->count = 0;
+
+    for (i = 0; i < ninsts; i++) {
+        sre_vm_dfa_set_add(cur, insts[i]);
+    }
+
+    nflags = 0;
+
+    if (c != SRE_VM_DFA_EOF) {
+        if (sre_isword(c)) {
+            nflags |= SRE_VM_DFA_SEEN_WORD;
+        }
+
+        if (c == '\n') {
+            nflags |= SRE_VM_DFA_SEEN_NEWLINE;
+        }
+
+        nflags &= b->flag_mask;
+    }
+
+    /* cur->count may grow in this loop when look-ahead assertions hold */
+
+    for (i = 0; i < cur->count; i++) {
+        idx = cur->dense[i];
+        pc = &start[idx];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_MATCH:
+            *pflags = SRE_VM_DFA_MATCH;
+            return 0;
+
+        case SRE_OPCODE_CHAR:
+            if (c == SRE_VM_DFA_EOF || c != pc->v.ch) {
+                break;
+            }
+
+            sre_vm_dfa_add_closure(b, next, idx + 1, nflags, -1);
+            break;
+
+        case SRE_OPCODE_ANY:
+            if (c == SRE_VM_DFA_EOF) {
+                break;
+            }
+
+            sre_vm_dfa_add_closure(b, next, idx + 1, nflags, -1);
+            break;
+
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+            if (c == SRE_VM_DFA_EOF) {
+                break;
+            }
+
+            in = 0;
+            for (j = 0; j < sre_vm_nranges(pc); j++) {
+                range = &pc->v.ranges[j];
+
+                if (c >= range->from && c <= range->to) {
+                    in = 1;
+                    break;
+                }
+            }
+
+            if (in ^ (pc->opcode == SRE_OPCODE_IN)) {
+                break;
+            }
+
+            sre_vm_dfa_add_closure(b, next, idx + 1, nflags, -1);
+            break;
+
+        case SRE_OPCODE_BITMAP:
+            if (c == SRE_VM_DFA_EOF
+                || !sre_vm_bitmap_test(sre_program_bitmap(b->program, pc), c))
+            {
+                break;
+            }
+
+            sre_vm_dfa_add_closure(b, next, idx + 1, nflags, -1);
+            break;
+
+        case SRE_OPCODE_ASSERT:
+            if (!(pc->v.assertion & SRE_REGEX_ASSERT_LOOKAHEAD)) {
+                break;
+            }
+
+            if (sre_vm_dfa_assertion_holds(pc->v.assertion, flags, c)) {
+                sre_vm_dfa_add_closure(b, cur, idx + 1, flags, c);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (c == SRE_VM_DFA_EOF) {
+        *pflags = 0;
+        return 0;
+    }
+
+    return sre_vm_dfa_collect_insts(b, nflags, pflags);
+}
+
+
+static sre_int_t
+sre_vm_dfa_init_set(sre_pool_t *pool, sre_vm_dfa_set_t *set, sre_uint_t size)
+{
+    set->count = 0;
+
+    set->dense = sre_palloc(pool, size * sizeof(unsigned));
+    if (set->dense == NULL) {
+        return SRE_ERROR;
+    }
+
+    set->sparse = sre_pcalloc(pool, size * sizeof(unsigned));
+    if (set->sparse == NULL) {
+        return SRE_ERROR;
+    }
+
+    return SRE_OK;
+}
+
+
+/*
+ * Adds the instruction at "idx" and all the instructions reachable from it
+ * without consuming any input into "set". The next input byte "c" is -1
+ * when it is still unknown, in which case the look-ahead assertions are
+ * postponed (just like what the Thompson VM does).
+ */
+static void
+sre_vm_dfa_add_closure(sre_vm_dfa_builder_t *b, sre_vm_dfa_set_t *set,
+    unsigned idx, unsigned flags, int c)
+{
+    unsigned                n, *stack;
+    sre_instruction_t      *start, *pc;
+
+    if (sre_vm_dfa_set_has(set, idx)) {
+        return;
+    }
+
+    start = b->program->start;
+    stack = b->stack;
+
+    n = 0;
+    sre_vm_dfa_set_add(set, idx);
+    stack[n++] = idx;
+
+    while (n) {
+        idx = stack[--n];
+        pc = &start[idx];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_JMP:
+            idx = pc->x;
+            sre_vm_dfa_push(set, stack, n, idx);
+            break;
+
+        case SRE_OPCODE_SPLIT:
+            idx = pc->y;
+            sre_vm_dfa_push(set, stack, n, idx);
+
+            idx = pc->x;
+            sre_vm_dfa_push(set, stack, n, idx);
+            break;
+
+        case SRE_OPCODE_SAVE:
+            idx++;
+            sre_vm_dfa_push(set, stack, n, idx);
+            break;
+
+        case SRE_OPCODE_ASSERT:
+            if ((pc->v.assertion & SRE_REGEX_ASSERT_LOOKAHEAD) && c == -1) {
+                /* postpone look-ahead assertions */
+                break;
+            }
+
+            if (!sre_vm_dfa_assertion_holds(pc->v.assertion, flags, c)) {
+                break;
+            }
+
+            idx++;
+            sre_vm_dfa_push(set, stack, n, idx);
+            break;
+
+        default:
+            /* CHAR, ANY, IN, NOTIN, MATCH */
+            break;
+        }
+    }
+}
+
+
+static unsigned
+sre_vm_dfa_assertion_holds(unsigned assertion, unsigned flags, int c)
+{
+    unsigned        word;
+
+    switch (assertion) {
+    case SRE_REGEX_ASSERT_BIG_A:
+        return flags & SRE_VM_DFA_BEGIN;
+
+    case SRE_REGEX_ASSERT_CARET:
+        return flags & (SRE_VM_DFA_BEGIN|SRE_VM_DFA_SEEN_NEWLINE);
+
+    case SRE_REGEX_ASSERT_SMALL_Z:
+        return c == SRE_VM_DFA_EOF;
+
+    case SRE_REGEX_ASSERT_DOLLAR:
+        return c == SRE_VM_DFA_EOF || c == '\n';
+
+    case SRE_REGEX_ASSERT_SMALL_B:
+    case SRE_REGEX_ASSERT_BIG_B:
+        word = ((flags & SRE_VM_DFA_SEEN_WORD) != 0)
+               ^ (c != SRE_VM_DFA_EOF && sre_isword(c));
+
+        if (assertion == SRE_REGEX_ASSERT_SMALL_B) {
+            return word;
+        }
+
+        return !word;
+
+    default:
+        /* impossible to reach here */
+        return 0;
+    }
+}
+
+
+/*
+ * Turns b->next into the sorted instruction set of a DFA state. Only the
+ * instructions that may run on the next input byte are kept, that is,
+ * the consuming instructions and the pending look-ahead assertions.
+ */
+static unsigned
+sre_vm_dfa_collect_insts(sre_vm_dfa_builder_t *b, unsigned flags,
+    unsigned *pflags)
+{
+    unsigned             i, n, idx, lookahead;
+    sre_vm_dfa_set_t    *set;
+    sre_instruction_t   *pc;
+
+    set = &b->next;
+    lookahead = 0;
+    n = 0;
+
+    for (i = 0; i < set->count; i++) {
+        idx = set->dense[i];
+        pc = &b->program->start[idx];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_MATCH:
+            *pflags = SRE_VM_DFA_MATCH;
+            return 0;
+
+        case SRE_OPCODE_ASSERT:
+            if (!(pc->v.assertion & SRE_REGEX_ASSERT_LOOKAHEAD)) {
+                continue;
+            }
+
+            lookahead = 1;
+            break;
+
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            break;
+
+        default:
+            continue;
+        }
+
+        set->dense[n++] = idx;
+    }
+
+    qsort(set->dense, n, sizeof(unsigned), sre_vm_dfa_cmp_insts);
+
+    /* the flags only matter to pending look-ahead assertions */
+
+    *pflags = lookahead ? flags : 0;
+
+    return n;
+}
+
+
+static int
+sre_vm_dfa_cmp_insts(const void *one, const void *two)
+{
+    unsigned    a = *(const unsigned *) one;
+    unsigned    b = *(const unsigned *) two;
+
+    return (a > b) - (a < b);
+}
+
+
+static sre_vm_dfa_state_t *
+sre_vm_dfa_find_state(sre_vm_dfa_ctx_t *ctx, unsigned *insts,
+    unsigned ninsts, unsigned flags)
+{
+    size_t                   size, ofs;
+    unsigned                 i, hash;
+    sre_char                *p;
+    sre_vm_dfa_state_t      *s, **bucket;
+
+    hash = 2166136261u ^ flags;
+    for (i = 0; i < ninsts; i++) {
+        hash = (hash ^ insts[i]) * 16777619u;
+    }
+
+    bucket = &ctx->buckets[hash & (ctx->nbuckets - 1)];
+
+    for (s = *bucket; s; s = s->hash_next) {
+        if (s->hash == hash && s->flags == flags && s->ninsts == ninsts
+            && memcmp(s->insts, insts, ninsts * sizeof(unsigned)) == 0)
+        {
+            return s;
+        }
+    }
+
+    ofs = offsetof(sre_vm_dfa_state_t, next)
+          + ctx->builder.nclasses * sizeof(sre_vm_dfa_state_t *);
+
+    size = ofs + ninsts * sizeof(unsigned);
+
+    p = sre_align_ptr(ctx->cache_last, sizeof(void *));
+    if (p + size > ctx->cache_end) {
+        dd("dfa cache full: %u states", ctx->nstates);
+        return NULL;
+    }
+
+    ctx->cache_last = p + size;
+
+    s = (sre_vm_dfa_state_t *) p;
+
+    s->hash = hash;
+    s->flags = flags;
+    s->ninsts = ninsts;
+    s->insts = (unsigned *) (p + ofs);
+
+    sre_memzero(s->next, ctx->builder.nclasses * sizeof(sre_vm_dfa_state_t *));
+    memcpy(s->insts, insts, ninsts * sizeof(unsigned));
+
+    s->hash_next = *bucket;
+    *bucket = s;
+
+    ctx->nstates++;
+
+    return s;
+}
+
+
+static sre_vm_dfa_state_t *
+sre_vm_dfa_start_state(sre_vm_dfa_ctx_t *ctx)
+{
+    unsigned                 n, flags;
+    sre_vm_dfa_state_t      *s;
+
+    n = sre_vm_dfa_start_insts(&ctx->builder, &flags);
+
+    s = sre_vm_dfa_find_state(ctx, ctx->builder.next.dense, n, flags);
+    if (s) {
+        return s;
+    }
+
+    sre_vm_dfa_reset_cache(ctx);
+
+    s = sre_vm_dfa_find_state(ctx, ctx->builder.next.dense, n, flags);
+    if (s) {
+        return s;
+    }
+
+    /* the start state alone does not fit into the cache */
+
+    ctx->nfa = sre_vm_thompson_create_ctx(ctx->pool, ctx->builder.program);
+    return NULL;
+}
+
+
+static sre_vm_dfa_state_t *
+sre_vm_dfa_next_state(sre_vm_dfa_ctx_t *ctx, sre_vm_dfa_state_t *s, int c)
+{
+    unsigned                 n, flags;
+    sre_vm_dfa_state_t      *ns;
+    sre_vm_dfa_builder_t    *b;
+
+    b = &ctx->builder;
+    flags = s->flags;
+
+    n = sre_vm_dfa_step_insts(b, s->insts, s->ninsts, c, &flags);
+
+    ns = sre_vm_dfa_find_state(ctx, b->next.dense, n, flags);
+    if (ns) {
+        s->next[b->classes[c]] = ns;
+        return ns;
+    }
+
+    /*
+     * the cache is full; give up on the DFA when it gets thrashed, that is,
+     * when we scan less than 10 bytes per state created.
+     */
+
+    if (ctx->scanned < 10 * (size_t) ctx->nstates) {
+        (void) sre_vm_dfa_fall_back(ctx, b->next.dense, n, flags);
+        return NULL;
+    }
+
+    sre_vm_dfa_reset_cache(ctx);
+
+    ns = sre_vm_dfa_find_state(ctx, b->next.dense, n, flags);
+    if (ns) {
+        return ns;
+    }
+
+    (void) sre_vm_dfa_fall_back(ctx, b->next.dense, n, flags);
+    return NULL;
+}
+
+
+static void
+sre_vm_dfa_reset_cache(sre_vm_dfa_ctx_t *ctx)
+{
+    dd("resetting dfa cache: %u states, %d bytes scanned", ctx->nstates,
+       (int) ctx->scanned);
+
+    sre_memzero(ctx->buckets, ctx->nbuckets * sizeof(sre_vm_dfa_state_t *));
+
+    ctx->cache_last = ctx->cache;
+    ctx->nstates = 0;
+    ctx->scanned = 0;
+}
+
+
+/*
+ * Continues the current stream with the Thompson VM, whose thread list is
+ * seeded by the instruction set of the DFA state we failed to cache.
+ */
+static sre_int_t
+sre_vm_dfa_fall_back(sre_vm_dfa_ctx_t *ctx, unsigned *insts, unsigned ninsts,
+    unsigned flags)
+{
+    unsigned                         i;
+    sre_program_t                   *prog;
+    sre_vm_thompson_ctx_t           *nfa;
+    sre_vm_thompson_thread_t        *t;
+    sre_vm_thompson_thread_list_t   *clist;
+
+    prog = ctx->builder.program;
+
+    nfa = sre_vm_thompson_create_ctx(ctx->pool, prog);
+    if (nfa == NULL) {
+        return SRE_ERROR;
+    }
+
+    clist = nfa->current_threads;
+
+    for (i = 0; i < ninsts; i++) {
+        t = &clist->threads[i];
+        t->pc = prog->start + insts[i];
+        t->asserts_handler = NULL;
+        t->seen_word = (flags & SRE_VM_DFA_SEEN_WORD) != 0;
+        t->counter = 0;
+    }
+
+    clist->count = ninsts;
+
+    if (flags & SRE_VM_DFA_MATCH) {
+        /* a dummy thread that matches right away */
+
+        t = &clist->threads[0];
+        t->pc = prog->start + prog->len - 1;
+        t->asserts_handler = NULL;
+        t->seen_word = 0;
+        t->counter = 0;
+
+        clist->count = 1;
+    }
+
+    nfa->first_buf = 0;
+    nfa->glushkov = NULL;   /* runs the threads seeded above */
+    ctx->nfa = nfa;
+
+    return SRE_OK;
+}
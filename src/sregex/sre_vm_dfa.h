@@ -0,0 +1,119 @@
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_DFA_H_INCLUDED_
+#define _SRE_VM_DFA_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_thompson.h>
+
+
+#define SRE_VM_DFA_DEFAULT_CACHE_SIZE  (256 * 1024)
+#define SRE_VM_DFA_MIN_CACHE_SIZE      (4 * 1024)
+#define SRE_VM_DFA_DEFAULT_MAX_STATES  10000
+
+/* the pseudo input byte standing for the end of the stream */
+#define SRE_VM_DFA_EOF                 256
+
+
+enum {
+    SRE_VM_DFA_SEEN_WORD     = 0x01,  /* the previous byte is a word char */
+    SRE_VM_DFA_SEEN_NEWLINE  = 0x02,  /* the previous byte is "\n" */
+    SRE_VM_DFA_BEGIN         = 0x04,  /* at the beginning of the stream */
+    SRE_VM_DFA_MATCH         = 0x08
+};
+
+
+typedef struct {
+    unsigned         count;
+    unsigned        *dense;
+    unsigned        *sparse;
+} sre_vm_dfa_set_t;
+
+
+typedef struct sre_vm_dfa_state_s  sre_vm_dfa_state_t;
+
+struct sre_vm_dfa_state_s {
+    sre_vm_dfa_state_t      *hash_next;
+    unsigned                 hash;
+    unsigned                 flags;
+    unsigned                 ninsts;
+    unsigned                *insts;   /* sorted instruction indices */
+    sre_vm_dfa_state_t      *next[1]; /* one slot for each byte class */
+};
+
+
+typedef struct {
+    sre_program_t           *program;
+    unsigned                 nclasses;
+    unsigned                 flag_mask;
+    sre_char                 classes[256];
+    sre_char                 class_bytes[256]; /* representative bytes */
+
+    sre_vm_dfa_set_t         cur;
+    sre_vm_dfa_set_t         next;
+    unsigned                *stack;
+} sre_vm_dfa_builder_t;
+
+
+struct sre_vm_dfa_ctx_s {
+    sre_pool_t              *pool;
+    sre_vm_dfa_builder_t     builder;
+
+    sre_vm_dfa_state_t      *state;     /* current state */
+
+    sre_vm_dfa_state_t     **buckets;
+    unsigned                 nbuckets;
+
+    sre_char                *cache;
+    sre_char                *cache_last;
+    sre_char                *cache_end;
+
+    unsigned                 nstates;   /* states in the current cache */
+    size_t                   scanned;   /* bytes scanned since last reset */
+
+    sre_vm_thompson_ctx_t   *nfa;       /* the fallback NFA */
+};
+
+
+/*
+ * The fully determinized and minimized DFA. The state numbers saved in
+ * "start" and "trans" are premultiplied by "nclasses", and the state 0 is
+ * always the (absorbing) matched state.
+ */
+struct sre_vm_dfa_table_s {
+    unsigned                 nstates;
+    unsigned                 nclasses;
+    unsigned                 start;
+    unsigned                *trans;
+    uint8_t                 *accept_eof;    /* indexed by state numbers */
+    sre_char                 classes[256];
+};
+
+
+struct sre_vm_dfa_table_ctx_s {
+    sre_vm_dfa_table_t      *table;
+    unsigned                 state;
+};
+
+
+SRE_NOAPI unsigned sre_vm_dfa_get_byte_classes(sre_program_t *prog,
+    sre_char *classes);
+
+SRE_NOAPI sre_int_t sre_vm_dfa_init_builder(sre_pool_t *pool,
+    sre_vm_dfa_builder_t *b, sre_program_t *prog);
+
+SRE_NOAPI unsigned sre_vm_dfa_start_insts(sre_vm_dfa_builder_t *b,
+    unsigned *pflags);
+
+SRE_NOAPI unsigned sre_vm_dfa_step_insts(sre_vm_dfa_builder_t *b,
+    unsigned *insts, unsigned ninsts, int c, unsigned *pflags);
+
+
+#endif /* _SRE_VM_DFA_H_INCLUDED_ */
@@ -0,0 +1,558 @@
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_dfa.h>
+
+
+typedef struct {
+    unsigned             hash;
+    unsigned             flags;
+    unsigned             ninsts;
+    unsigned            *insts;
+    sre_int_t            hash_next;
+} sre_vm_dfa_node_t;
+
+
+typedef struct {
+    sre_pool_t              *pool;      /* for temporary data */
+    sre_vm_dfa_builder_t     builder;
+
+    sre_vm_dfa_node_t       *nodes;
+    unsigned                *trans;
+    uint8_t                 *accept_eof;
+    unsigned                 nnodes;
+    unsigned                 nalloc;
+    unsigned                 max_nodes;
+
+    sre_int_t               *buckets;
+    unsigned                 nbuckets;
+} sre_vm_dfa_compiler_t;
+
+
+static sre_int_t sre_vm_dfa_compile_helper(sre_pool_t *pool,
+    sre_vm_dfa_compiler_t *dc, sre_program_t *prog,
+    sre_vm_dfa_table_t **ptable);
+static sre_int_t sre_vm_dfa_add_node(sre_vm_dfa_compiler_t *dc,
+    unsigned *insts, unsigned ninsts, unsigned flags);
+static sre_int_t sre_vm_dfa_grow_nodes(sre_vm_dfa_compiler_t *dc);
+static sre_int_t sre_vm_dfa_minimize(sre_vm_dfa_compiler_t *dc,
+    unsigned *block, unsigned *pnblocks);
+
+
+SRE_API sre_int_t
+sre_vm_dfa_compile(sre_pool_t *pool, sre_program_t *prog,
+    sre_uint_t max_states, sre_vm_dfa_table_t **ptable)
+{
+    sre_int_t                rc;
+    sre_vm_dfa_compiler_t    dc;
+
+    if (prog->slots) {
+        /* counter loops would need a state per counter value */
+        return SRE_DECLINED;
+    }
+
+    sre_memzero(&dc, sizeof(sre_vm_dfa_compiler_t));
+
+    if (max_states == 0) {
+        max_states = SRE_VM_DFA_DEFAULT_MAX_STATES;
+    }
+
+    dc.max_nodes = (unsigned) max_states;
+
+    dc.pool = sre_create_pool(1024);
+    if (dc.pool == NULL) {
+        return SRE_ERROR;
+    }
+
+    rc = sre_vm_dfa_compile_helper(pool, &dc, prog, ptable);
+
+    sre_destroy_pool(dc.pool);
+
+    return rc;
+}
+
+
+SRE_API sre_uint_t
+sre_vm_dfa_table_nstates(sre_vm_dfa_table_t *table)
+{
+    return table->nstates;
+}
+
+
+static sre_int_t
+sre_vm_dfa_compile_helper(sre_pool_t *pool, sre_vm_dfa_compiler_t *dc,
+    sre_program_t *prog, sre_vm_dfa_table_t **ptable)
+{
+    unsigned                 i, a, k, n, flags, nblocks, id;
+    unsigned                *block, *ids, *reps;
+    sre_int_t                rc, start;
+    sre_vm_dfa_node_t       *node;
+    sre_vm_dfa_table_t      *table;
+    sre_vm_dfa_builder_t    *b;
+
+    b = &dc->builder;
+
+    if (sre_vm_dfa_init_builder(dc->pool, b, prog) != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    k = b->nclasses;
+
+    for (dc->nbuckets = 64;
+         dc->nbuckets < dc->max_nodes && dc->nbuckets < 65536;
+         dc->nbuckets <<= 1)
+    {
+        /* void */
+    }
+
+    dc->buckets = sre_palloc(dc->pool, dc->nbuckets * sizeof(sre_int_t));
+    if (dc->buckets == NULL) {
+        return SRE_ERROR;
+    }
+
+    for (i = 0; i < dc->nbuckets; i++) {
+        dc->buckets[i] = -1;
+    }
+
+    /* the node 0 is always the matched state */
+
+    rc = sre_vm_dfa_add_node(dc, NULL, 0, SRE_VM_DFA_MATCH);
+    if (rc < 0) {
+        return rc;
+    }
+
+    n = sre_vm_dfa_start_insts(b, &flags);
+
+    start = sre_vm_dfa_add_node(dc, b->next.dense, n, flags);
+    if (start < 0) {
+        return start;
+    }
+
+    /* the subset construction in the breadth-first order */
+
+    for (i = 0; i < dc->nnodes; i++) {
+        if (i == 0) {
+            for (a = 0; a < k; a++) {
+                dc->trans[a] = 0;
+            }
+
+            dc->accept_eof[0] = 1;
+            continue;
+        }
+
+        for (a = 0; a < k; a++) {
+            node = &dc->nodes[i];
+            flags = node->flags;
+
+            n = sre_vm_dfa_step_insts(b, node->insts, node->ninsts,
+                                      b->class_bytes[a], &flags);
+
+            rc = sre_vm_dfa_add_node(dc, b->next.dense, n, flags);
+            if (rc < 0) {
+                dd("too many dfa states: %u", dc->nnodes);
+                return rc;
+            }
+
+            dc->trans[i * k + a] = (unsigned) rc;
+        }
+
+        node = &dc->nodes[i];
+        flags = node->flags;
+
+        (void) sre_vm_dfa_step_insts(b, node->insts, node->ninsts,
+                                     SRE_VM_DFA_EOF, &flags);
+
+        dc->accept_eof[i] = (flags & SRE_VM_DFA_MATCH) != 0;
+    }
+
+    dd("dfa: %u states before minimization", dc->nnodes);
+
+    block = sre_palloc(dc->pool, dc->nnodes * sizeof(unsigned));
+    if (block == NULL) {
+        return SRE_ERROR;
+    }
+
+    if (sre_vm_dfa_minimize(dc, block, &nblocks) != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    dd("dfa: %u states after minimization", nblocks);
+
+    ids = sre_palloc(dc->pool, nblocks * sizeof(unsigned));
+    reps = sre_palloc(dc->pool, nblocks * sizeof(unsigned));
+    if (ids == NULL || reps == NULL) {
+        return SRE_ERROR;
+    }
+
+    /* renumber the blocks so that the matched state stays 0 */
+
+    ids[block[0]] = 0;
+    id = 1;
+
+    for (i = 0; i < nblocks; i++) {
+        if (i != block[0]) {
+            ids[i] = id++;
+        }
+    }
+
+    for (i = 0; i < dc->nnodes; i++) {
+        reps[ids[block[i]]] = i;
+    }
+
+    table = sre_palloc(pool, sizeof(sre_vm_dfa_table_t));
+    if (table == NULL) {
+        return SRE_ERROR;
+    }
+
+    table->trans = sre_palloc(pool, nblocks * k * sizeof(unsigned));
+    if (table->trans == NULL) {
+        return SRE_ERROR;
+    }
+
+    table->accept_eof = sre_palloc(pool, nblocks);
+    if (table->accept_eof == NULL) {
+        return SRE_ERROR;
+    }
+
+    table->nstates = nblocks;
+    table->nclasses = k;
+    table->start = ids[block[start]] * k;
+    memcpy(table->classes, b->classes, sizeof(table->classes));
+
+    for (id = 0; id < nblocks; id++) {
+        i = reps[id];
+
+        for (a = 0; a < k; a++) {
+            table->trans[id * k + a] = ids[block[dc->trans[i * k + a]]] * k;
+        }
+
+        table->accept_eof[id] = dc->accept_eof[i];
+    }
+
+    *ptable = table;
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_dfa_add_node(sre_vm_dfa_compiler_t *dc, unsigned *insts,
+    unsigned ninsts, unsigned flags)
+{
+    unsigned                 i, hash;
+    sre_int_t                idx;
+    sre_vm_dfa_node_t       *node;
+
+    hash = 2166136261u ^ flags;
+    for (i = 0; i < ninsts; i++) {
+        hash = (hash ^ insts[i]) * 16777619u;
+    }
+
+    for (idx = dc->buckets[hash & (dc->nbuckets - 1)];
+         idx >= 0;
+         idx = node->hash_next)
+    {
+        node = &dc->nodes[idx];
+
+        if (node->hash == hash && node->flags == flags
+            && node->ninsts == ninsts
+            && (ninsts == 0
+                || memcmp(node->insts, insts, ninsts * sizeof(unsigned)) == 0))
+        {
+            return idx;
+        }
+    }
+
+    if (dc->nnodes == dc->max_nodes) {
+        return SRE_DECLINED;
+    }
+
+    if (dc->nnodes == dc->nalloc) {
+        if (sre_vm_dfa_grow_nodes(dc) != SRE_OK) {
+            return SRE_ERROR;
+        }
+    }
+
+    node = &dc->nodes[dc->nnodes];
+
+    node->hash = hash;
+    node->flags = flags;
+    node->ninsts = ninsts;
+
+    if (ninsts) {
+        node->insts = sre_palloc(dc->pool, ninsts * sizeof(unsigned));
+        if (node->insts == NULL) {
+            return SRE_ERROR;
+        }
+
+        memcpy(node->insts, insts, ninsts * sizeof(unsigned));
+
+    } else {
+        node->insts = NULL;
+    }
+
+    node->hash_next = dc->buckets[hash & (dc->nbuckets - 1)];
+    dc->buckets[hash & (dc->nbuckets - 1)] = dc->nnodes;
+
+    return dc->nnodes++;
+}
+
+
+static sre_int_t
+sre_vm_dfa_grow_nodes(sre_vm_dfa_compiler_t *dc)
+{
+    unsigned                 n, k;
+    uint8_t                 *accept_eof;
+    unsigned                *trans;
+    sre_vm_dfa_node_t       *nodes;
+
+    n = dc->nalloc ? 2 * dc->nalloc : 64;
+    if (n > dc->max_nodes) {
+        n = dc->max_nodes;
+    }
+
+    k = dc->builder.nclasses;
+
+    nodes = sre_palloc(dc->pool, n * sizeof(sre_vm_dfa_node_t));
+    trans = sre_palloc(dc->pool, n * k * sizeof(unsigned));
+    accept_eof = sre_palloc(dc->pool, n);
+
+    if (nodes == NULL || trans == NULL || accept_eof == NULL) {
+        return SRE_ERROR;
+    }
+
+    if (dc->nalloc) {
+        memcpy(nodes, dc->nodes, dc->nnodes * sizeof(sre_vm_dfa_node_t));
+        memcpy(trans, dc->trans, dc->nnodes * k * sizeof(unsigned));
+        memcpy(accept_eof, dc->accept_eof, dc->nnodes);
+
+        (void) sre_pfree(dc->pool, dc->nodes);
+        (void) sre_pfree(dc->pool, dc->trans);
+        (void) sre_pfree(dc->pool, dc->accept_eof);
+    }
+
+    dc->nodes = nodes;
+    dc->trans = trans;
+    dc->accept_eof = accept_eof;
+    dc->nalloc = n;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Hopcroft's partition refinement. The blocks are saved as ranges in the
+ * "elems" array, and the (block, byte class) splitters pending are kept in
+ * a stack. Because we always push the smaller half of a split block, no
+ * splitter can be pushed twice and the stack never exceeds n * k entries.
+ */
+static sre_int_t
+sre_vm_dfa_minimize(sre_vm_dfa_compiler_t *dc, unsigned *block,
+    unsigned *pnblocks)
+{
+    unsigned         i, j, p, q, m, a, s, t, x, n, k, nw, nx, ntouched;
+    unsigned         blk, y, z, nblocks, largest, key;
+    unsigned         counts[3];
+    unsigned        *inv_start, *inv, *fill, *elems, *loc, *first, *end;
+    unsigned        *marked, *touched, *preds, *wl;
+    uint8_t         *in_preds;
+    sre_pool_t      *pool;
+
+    pool = dc->pool;
+    n = dc->nnodes;
+    k = dc->builder.nclasses;
+
+    inv_start = sre_pcalloc(pool, (n * k + 1) * sizeof(unsigned));
+    inv = sre_palloc(pool, n * k * sizeof(unsigned));
+    fill = sre_palloc(pool, n * k * sizeof(unsigned));
+    wl = sre_palloc(pool, n * k * sizeof(unsigned));
+
+    elems = sre_palloc(pool, n * sizeof(unsigned));
+    loc = sre_palloc(pool, n * sizeof(unsigned));
+    first = sre_palloc(pool, n * sizeof(unsigned));
+    end = sre_palloc(pool, n * sizeof(unsigned));
+    marked = sre_pcalloc(pool, n * sizeof(unsigned));
+    touched = sre_palloc(pool, n * sizeof(unsigned));
+    preds = sre_palloc(pool, n * sizeof(unsigned));
+    in_preds = sre_pcalloc(pool, n);
+
+    if (inv_start == NULL || inv == NULL || fill == NULL || wl == NULL
+        || elems == NULL || loc == NULL || first == NULL || end == NULL
+        || marked == NULL || touched == NULL || preds == NULL
+        || in_preds == NULL)
+    {
+        return SRE_ERROR;
+    }
+
+    /* build the inverse transitions, grouped by (byte class, target) */
+
+    for (s = 0; s < n; s++) {
+        for (a = 0; a < k; a++) {
+            t = dc->trans[s * k + a];
+            inv_start[a * n + t + 1]++;
+        }
+    }
+
+    for (i = 0; i < n * k; i++) {
+        inv_start[i + 1] += inv_start[i];
+        fill[i] = inv_start[i];
+    }
+
+    for (s = 0; s < n; s++) {
+        for (a = 0; a < k; a++) {
+            t = dc->trans[s * k + a];
+            inv[fill[a * n + t]++] = s;
+        }
+    }
+
+    /*
+     * the initial partition: the matched state, the states accepting
+     * at the end of the stream, and the rest.
+     */
+
+#define sre_vm_dfa_initial_block(s)                                          \
+    ((s) == 0 ? 0 : dc->accept_eof[s] ? 1 : 2)
+
+    counts[0] = counts[1] = counts[2] = 0;
+
+    for (s = 0; s < n; s++) {
+        counts[sre_vm_dfa_initial_block(s)]++;
+    }
+
+    nblocks = 0;
+    p = 0;
+
+    for (key = 0; key < 3; key++) {
+        if (counts[key] == 0) {
+            continue;
+        }
+
+        first[nblocks] = p;
+        end[nblocks] = p;
+
+        for (s = 0; s < n; s++) {
+            if (sre_vm_dfa_initial_block(s) == key) {
+                block[s] = nblocks;
+                loc[s] = end[nblocks];
+                elems[end[nblocks]++] = s;
+            }
+        }
+
+        p = end[nblocks++];
+    }
+
+#undef sre_vm_dfa_initial_block
+
+    /* all the initial blocks but the largest one serve as splitters */
+
+    largest = 0;
+    for (blk = 1; blk < nblocks; blk++) {
+        if (end[blk] - first[blk] > end[largest] - first[largest]) {
+            largest = blk;
+        }
+    }
+
+    nw = 0;
+    for (blk = 0; blk < nblocks; blk++) {
+        if (blk == largest) {
+            continue;
+        }
+
+        for (a = 0; a < k; a++) {
+            wl[nw++] = blk * k + a;
+        }
+    }
+
+    while (nw) {
+        x = wl[--nw];
+        blk = x / k;
+        a = x % k;
+
+        /* collect all the states leading into the splitter block */
+
+        nx = 0;
+
+        for (p = first[blk]; p < end[blk]; p++) {
+            t = elems[p];
+
+            for (q = inv_start[a * n + t]; q < inv_start[a * n + t + 1]; q++) {
+                s = inv[q];
+
+                if (!in_preds[s]) {
+                    in_preds[s] = 1;
+                    preds[nx++] = s;
+                }
+            }
+        }
+
+        /* move the predecessors to the front of their own blocks */
+
+        ntouched = 0;
+
+        for (i = 0; i < nx; i++) {
+            s = preds[i];
+            in_preds[s] = 0;
+
+            y = block[s];
+            j = first[y] + marked[y];
+            p = loc[s];
+
+            elems[p] = elems[j];
+            loc[elems[p]] = p;
+            elems[j] = s;
+            loc[s] = j;
+
+            if (marked[y]++ == 0) {
+                touched[ntouched++] = y;
+            }
+        }
+
+        /* split the touched blocks */
+
+        for (i = 0; i < ntouched; i++) {
+            y = touched[i];
+            m = first[y] + marked[y];
+            marked[y] = 0;
+
+            if (m == end[y]) {
+                continue;
+            }
+
+            z = nblocks++;
+            marked[z] = 0;
+
+            if (m - first[y] <= end[y] - m) {
+                first[z] = first[y];
+                end[z] = m;
+                first[y] = m;
+
+            } else {
+                first[z] = m;
+                end[z] = end[y];
+                end[y] = m;
+            }
+
+            for (p = first[z]; p < end[z]; p++) {
+                block[elems[p]] = z;
+            }
+
+            for (a = 0; a < k; a++) {
+                wl[nw++] = z * k + a;
+            }
+        }
+    }
+
+    *pnblocks = nblocks;
+
+    return SRE_OK;
+}
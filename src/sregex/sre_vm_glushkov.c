@@ -0,0 +1,363 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_glushkov.h>
+
+
+static unsigned sre_vm_glushkov_accepts(sre_program_t *prog,
+    sre_instruction_t *pc, unsigned c);
+static void sre_vm_glushkov_closure(sre_program_t *prog, sre_instruction_t *pc,
+    sre_uint_t *positions, uint8_t *visited, sre_vm_glushkov_set_t *set,
+    unsigned *matched);
+static sre_char *sre_vm_glushkov_skip(sre_vm_glushkov_ctx_t *ctx,
+    sre_char *sp, sre_char *last, unsigned eof);
+
+
+/*
+ * Builds the automaton in prog->glushkov for the yes-or-no matching of
+ * the Thompson VM. Returns SRE_DECLINED when the program has too many
+ * positions, or assertions or counter loops, whose follow sets are not
+ * fixed.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_glushkov_compile(sre_pool_t *pool, sre_program_t *prog)
+{
+    unsigned                 matched;
+    sre_uint_t               i, k, n, b, c, v, *positions;
+    uint8_t                 *visited;
+    sre_instruction_t       *pc;
+    sre_vm_glushkov_t       *g;
+    sre_vm_glushkov_set_t   *follow;
+
+    prog->glushkov = NULL;
+
+    n = 0;
+
+    for (i = 0; i < prog->len; i++) {
+        switch (prog->start[i].opcode) {
+        case SRE_OPCODE_ASSERT:
+        case SRE_OPCODE_COUNT:
+            return SRE_DECLINED;
+
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            n++;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (n > SRE_VM_GLUSHKOV_MAX_POSITIONS) {
+        dd("%d positions", (int) n);
+        return SRE_DECLINED;
+    }
+
+    g = sre_pcalloc(pool, sizeof(sre_vm_glushkov_t));
+    if (g == NULL) {
+        return SRE_ERROR;
+    }
+
+    g->npositions = n;
+
+    g->follow = sre_pcalloc(pool, (n + 7) / 8 * sizeof(*g->follow));
+    if (g->follow == NULL) {
+        return SRE_ERROR;
+    }
+
+    positions = sre_palloc(pool, prog->len * sizeof(sre_uint_t));
+    if (positions == NULL) {
+        return SRE_ERROR;
+    }
+
+    visited = sre_pnalloc(pool, prog->len);
+    if (visited == NULL) {
+        return SRE_ERROR;
+    }
+
+    follow = sre_palloc(pool, (n + 1) * sizeof(sre_vm_glushkov_set_t));
+    if (follow == NULL) {
+        return SRE_ERROR;
+    }
+
+    for (n = 0, i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+        positions[i] = n;
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            for (c = 0; c < 256; c++) {
+                if (sre_vm_glushkov_accepts(prog, pc, c)) {
+                    g->masks[c] |= (sre_vm_glushkov_set_t) 1 << n;
+                }
+            }
+
+            n++;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    matched = 0;
+    sre_memzero(visited, prog->len);
+    sre_vm_glushkov_closure(prog, prog->start, positions, visited,
+                            &g->initial, &matched);
+    g->nullable = matched;
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            n = positions[i];
+            follow[n] = 0;
+            matched = 0;
+
+            sre_memzero(visited, prog->len);
+            sre_vm_glushkov_closure(prog, pc + 1, positions, visited,
+                                    &follow[n], &matched);
+
+            if (matched) {
+                g->accept |= (sre_vm_glushkov_set_t) 1 << n;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /* the follow sets of the subsets of every 8 positions */
+
+    follow[g->npositions] = 0;
+
+    for (k = 0; k < (g->npositions + 7) / 8; k++) {
+        for (v = 1; v < 256; v++) {
+            b = 0;
+            while (!(v & (1 << b))) {
+                b++;
+            }
+
+            n = sre_min(8 * k + b, g->npositions);
+            g->follow[k][v] = g->follow[k][v & (v - 1)] | follow[n];
+        }
+    }
+
+    prog->glushkov = g;
+
+    return SRE_OK;
+}
+
+
+static unsigned
+sre_vm_glushkov_accepts(sre_program_t *prog, sre_instruction_t *pc, unsigned c)
+{
+    unsigned             in;
+    sre_uint_t           i;
+    sre_vm_range_t      *range;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_CHAR:
+        return c == pc->v.ch;
+
+    case SRE_OPCODE_BITMAP:
+        return sre_vm_bitmap_test(sre_program_bitmap(prog, pc), c) != 0;
+
+    case SRE_OPCODE_IN:
+    case SRE_OPCODE_NOTIN:
+        in = 0;
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            if (c >= range->from && c <= range->to) {
+                in = 1;
+                break;
+            }
+        }
+
+        return in ^ (pc->opcode == SRE_OPCODE_NOTIN);
+
+    default:
+        /* SRE_OPCODE_ANY */
+        return 1;
+    }
+}
+
+
+/* adds the positions reachable from pc without consuming a byte to set */
+static void
+sre_vm_glushkov_closure(sre_program_t *prog, sre_instruction_t *pc,
+    sre_uint_t *positions, uint8_t *visited, sre_vm_glushkov_set_t *set,
+    unsigned *matched)
+{
+    if (visited[pc - prog->start]) {
+        return;
+    }
+
+    visited[pc - prog->start] = 1;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_JMP:
+        sre_vm_glushkov_closure(prog, sre_program_x(prog, pc), positions,
+                                visited, set, matched);
+        break;
+
+    case SRE_OPCODE_SPLIT:
+        sre_vm_glushkov_closure(prog, sre_program_x(prog, pc), positions,
+                                visited, set, matched);
+        sre_vm_glushkov_closure(prog, sre_program_y(prog, pc), positions,
+                                visited, set, matched);
+        break;
+
+    case SRE_OPCODE_SAVE:
+        sre_vm_glushkov_closure(prog, pc + 1, positions, visited, set,
+                                matched);
+        break;
+
+    case SRE_OPCODE_MATCH:
+        *matched = 1;
+        break;
+
+    default:
+        /* CHAR, ANY, IN, NOTIN, BITMAP */
+        *set |= (sre_vm_glushkov_set_t) 1 << positions[pc - prog->start];
+        break;
+    }
+}
+
+
+SRE_NOAPI sre_vm_glushkov_ctx_t *
+sre_vm_glushkov_create_ctx(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_vm_glushkov_ctx_t       *ctx;
+
+    ctx = sre_palloc(pool, sizeof(sre_vm_glushkov_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->program = prog;
+
+    if (prog->inner) {
+        ctx->inner = sre_vm_inner_create_ctx(pool, prog);
+        if (ctx->inner == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->inner = NULL;
+    }
+
+    ctx->enabled = prog->glushkov->initial;
+    ctx->first_buf = 1;
+    ctx->skip = prog->prefix || prog->inner || prog->leading_set
+                || (prog->multi && prog->multi->nalways == 0);
+
+    return ctx;
+}
+
+
+SRE_NOAPI sre_int_t
+sre_vm_glushkov_exec(sre_vm_glushkov_ctx_t *ctx, sre_char *input, size_t size,
+    unsigned eof)
+{
+    sre_uint_t                   k;
+    sre_char                    *sp, *last;
+    sre_program_t               *prog;
+    sre_vm_glushkov_t           *g;
+    sre_vm_glushkov_set_t        enabled, accepted, next;
+
+    prog = ctx->program;
+    g = prog->glushkov;
+
+    if (ctx->first_buf) {
+        ctx->first_buf = 0;
+
+        if (g->nullable) {
+            return SRE_OK;
+        }
+    }
+
+    enabled = ctx->enabled;
+    last = input + size;
+
+    for (sp = input; sp < last; sp++) {
+        if (enabled == g->initial && ctx->skip) {
+            sp = sre_vm_glushkov_skip(ctx, sp, last, eof);
+            if (sp == last) {
+                break;
+            }
+        }
+
+        accepted = enabled & g->masks[*sp];
+
+        if (accepted & g->accept) {
+            return SRE_OK;
+        }
+
+        for (next = 0, k = 0; accepted; k++, accepted >>= 8) {
+            next |= g->follow[k][accepted & 0xff];
+        }
+
+        enabled = next;
+    }
+
+    ctx->enabled = enabled;
+
+    return eof ? SRE_DECLINED : SRE_AGAIN;
+}
+
+
+/* only the start state is alive, so no match can start before the result */
+static sre_char *
+sre_vm_glushkov_skip(sre_vm_glushkov_ctx_t *ctx, sre_char *sp, sre_char *last,
+    unsigned eof)
+{
+    sre_program_t       *prog;
+
+    prog = ctx->program;
+
+    if (prog->prefix) {
+        return sre_literal_find(prog->prefix, sp, last);
+    }
+
+    if (ctx->inner) {
+        return sre_vm_inner_find(ctx->inner, sp, last, eof);
+    }
+
+    if (prog->multi && prog->multi->nalways == 0) {
+        return sre_multi_literal_find(&prog->multi->prefixes, sp, last);
+    }
+
+    if (prog->leading_set) {
+        return sre_byteset_find(prog->leading_set, sp, last);
+    }
+
+    return sp;
+}
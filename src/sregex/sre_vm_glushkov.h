@@ -0,0 +1,64 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_GLUSHKOV_H_INCLUDED_
+#define _SRE_VM_GLUSHKOV_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_inner.h>
+
+
+/* the positions of a program must fit into a set */
+#define SRE_VM_GLUSHKOV_MAX_POSITIONS  64
+
+
+typedef uint64_t  sre_vm_glushkov_set_t;
+
+
+/*
+ * The Glushkov automaton of a program whose states are sets of positions,
+ * the instructions consuming a byte, stored as the bits of a machine word.
+ * A position is enabled when its instruction may consume the next byte.
+ * After a byte, the enabled positions accepting it are replaced by the
+ * union of their follow sets, which is looked up 8 positions at a time.
+ */
+struct sre_vm_glushkov_s {
+    sre_uint_t                   npositions;
+    unsigned                     nullable;
+    sre_vm_glushkov_set_t        initial;   /* enabled at the start */
+    sre_vm_glushkov_set_t        accept;    /* followed by a match */
+    sre_vm_glushkov_set_t        masks[256];    /* per byte, the positions
+                                                   accepting it */
+    sre_vm_glushkov_set_t      (*follow)[256];  /* per group of 8 positions
+                                                   and their subset, the union
+                                                   of their follow sets */
+};
+
+
+typedef struct {
+    sre_program_t               *program;
+    sre_vm_inner_ctx_t          *inner;
+    sre_vm_glushkov_set_t        enabled;
+    uint8_t                      first_buf;     /* :1 */
+    uint8_t                      skip;          /* :1 */
+} sre_vm_glushkov_ctx_t;
+
+
+SRE_NOAPI sre_int_t sre_vm_glushkov_compile(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_vm_glushkov_ctx_t *sre_vm_glushkov_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_int_t sre_vm_glushkov_exec(sre_vm_glushkov_ctx_t *ctx,
+    sre_char *input, size_t size, unsigned eof);
+
+
+#endif /* _SRE_VM_GLUSHKOV_H_INCLUDED_ */
@@ -0,0 +1,276 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_inner.h>
+
+
+static sre_vm_inner_state_list_t *
+    sre_vm_inner_create_state_list(sre_pool_t *pool, sre_uint_t size);
+static sre_char *sre_vm_inner_reverse(sre_vm_inner_ctx_t *ctx,
+    sre_char *first, sre_char *sp);
+static void sre_vm_inner_add_state(sre_vm_inner_ctx_t *ctx,
+    sre_vm_inner_state_list_t *l, sre_instruction_t *pc);
+
+
+SRE_NOAPI sre_vm_inner_ctx_t *
+sre_vm_inner_create_ctx(sre_pool_t *pool, sre_program_t *prog)
+{
+    sre_uint_t               len;
+    sre_vm_inner_ctx_t      *ctx;
+
+    ctx = sre_palloc(pool, sizeof(sre_vm_inner_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->program = prog;
+    ctx->hit = NULL;
+
+    len = prog->inner_prefix->len;
+
+    ctx->current_states = sre_vm_inner_create_state_list(pool, len);
+    if (ctx->current_states == NULL) {
+        return NULL;
+    }
+
+    ctx->next_states = sre_vm_inner_create_state_list(pool, len);
+    if (ctx->next_states == NULL) {
+        return NULL;
+    }
+
+    ctx->tags = sre_pcalloc(pool, len * sizeof(unsigned));
+    if (ctx->tags == NULL) {
+        return NULL;
+    }
+
+    ctx->tag = 0;
+    ctx->matched = 0;
+
+    return ctx;
+}
+
+
+/*
+ * Called by the VMs when only the start state is alive at "pos". Every
+ * match must contain prog->inner, and no occurrence of it can start
+ * inside the part of a match before it (see sre_program_get_inner), so a
+ * match starting in [pos, hit] must use the first literal hit found from
+ * pos. Running the reversed prefix program backward from the hit (but
+ * never before pos, so previous stream chunks are never needed) gives the
+ * leftmost position such a match can start at. The VM still verifies the
+ * match forward from there.
+ *
+ * Returns the position the VM can safely skip to.
+ */
+SRE_NOAPI sre_char *
+sre_vm_inner_find(sre_vm_inner_ctx_t *ctx, sre_char *pos, sre_char *last,
+    unsigned eof)
+{
+    sre_char            *hit, *start;
+    sre_literal_t       *lit;
+
+    lit = ctx->program->inner;
+
+    for ( ;; ) {
+        hit = sre_literal_find(lit, pos, last);
+
+        if (hit == last || (eof && (sre_uint_t) (last - hit) < lit->len)) {
+            /*
+             * without eof, a match may still start here and use a
+             * literal in the next data chunk
+             */
+            return eof ? last : pos;
+        }
+
+        if (hit == ctx->hit) {
+            /* we have already skipped to the start for this hit */
+            return pos;
+        }
+
+        ctx->hit = hit;
+
+        start = sre_vm_inner_reverse(ctx, pos, hit);
+        if (start) {
+            dd("literal hit at %d, match start at %d", (int) (hit - pos),
+               (int) (start - pos));
+            return start;
+        }
+
+        pos = hit + 1;
+    }
+
+    /* impossible to reach here */
+}
+
+
+/*
+ * Returns the smallest position in [first, sp] from which the prefix
+ * program matches up to sp, or NULL. Assertions are taken as always
+ * true, which may only yield an earlier position.
+ */
+static sre_char *
+sre_vm_inner_reverse(sre_vm_inner_ctx_t *ctx, sre_char *first, sre_char *sp)
+{
+    sre_char                    *p, *start;
+    sre_uint_t                   i, j;
+    sre_program_t               *prog;
+    sre_vm_range_t              *range;
+    sre_instruction_t           *pc;
+    sre_vm_inner_state_list_t   *clist, *nlist, *tmp;
+
+    prog = ctx->program->inner_prefix;
+
+    clist = ctx->current_states;
+    nlist = ctx->next_states;
+
+    clist->count = 0;
+    ctx->matched = 0;
+    ctx->tag++;
+
+    sre_vm_inner_add_state(ctx, clist, prog->start);
+
+    start = ctx->matched ? sp : NULL;
+
+    for (p = sp; p != first && clist->count; /* void */) {
+        p--;
+
+        nlist->count = 0;
+        ctx->matched = 0;
+        ctx->tag++;
+
+        for (i = 0; i < clist->count; i++) {
+            pc = clist->pcs[i];
+
+            switch (pc->opcode) {
+            case SRE_OPCODE_CHAR:
+                if (*p != pc->v.ch) {
+                    continue;
+                }
+
+                break;
+
+            case SRE_OPCODE_IN:
+                for (j = 0; j < sre_vm_nranges(pc); j++) {
+                    range = &pc->v.ranges[j];
+                    if (*p >= range->from && *p <= range->to) {
+                        break;
+                    }
+                }
+
+                if (j == sre_vm_nranges(pc)) {
+                    continue;
+                }
+
+                break;
+
+            case SRE_OPCODE_NOTIN:
+                for (j = 0; j < sre_vm_nranges(pc); j++) {
+                    range = &pc->v.ranges[j];
+                    if (*p >= range->from && *p <= range->to) {
+                        break;
+                    }
+                }
+
+                if (j < sre_vm_nranges(pc)) {
+                    continue;
+                }
+
+                break;
+
+            case SRE_OPCODE_BITMAP:
+                if (!sre_vm_bitmap_test(sre_program_bitmap(prog, pc), *p)) {
+                    continue;
+                }
+
+                break;
+
+            default:    /* SRE_OPCODE_ANY */
+                break;
+            }
+
+            sre_vm_inner_add_state(ctx, nlist, pc + 1);
+        }
+
+        if (ctx->matched) {
+            start = p;
+        }
+
+        tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+    }
+
+    return start;
+}
+
+
+static void
+sre_vm_inner_add_state(sre_vm_inner_ctx_t *ctx, sre_vm_inner_state_list_t *l,
+    sre_instruction_t *pc)
+{
+    sre_uint_t       idx;
+    sre_program_t   *prog;
+
+    prog = ctx->program->inner_prefix;
+
+    idx = pc - prog->start;
+
+    if (ctx->tags[idx] == ctx->tag) {  /* already on list */
+        return;
+    }
+
+    ctx->tags[idx] = ctx->tag;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_JMP:
+        sre_vm_inner_add_state(ctx, l, sre_program_x(prog, pc));
+        return;
+
+    case SRE_OPCODE_SPLIT:
+        sre_vm_inner_add_state(ctx, l, sre_program_x(prog, pc));
+        sre_vm_inner_add_state(ctx, l, sre_program_y(prog, pc));
+        return;
+
+    case SRE_OPCODE_SAVE:
+    case SRE_OPCODE_ASSERT:
+        sre_vm_inner_add_state(ctx, l, pc + 1);
+        return;
+
+    case SRE_OPCODE_MATCH:
+        ctx->matched = 1;
+        return;
+
+    default:
+        break;
+    }
+
+    l->pcs[l->count++] = pc;
+}
+
+
+static sre_vm_inner_state_list_t *
+sre_vm_inner_create_state_list(sre_pool_t *pool, sre_uint_t size)
+{
+    sre_vm_inner_state_list_t       *l;
+
+    l = sre_palloc(pool, sizeof(sre_vm_inner_state_list_t)
+                   + (size - 1) * sizeof(sre_instruction_t *));
+    if (l == NULL) {
+        return NULL;
+    }
+
+    l->count = 0;
+
+    return l;
+}
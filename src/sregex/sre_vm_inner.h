@@ -0,0 +1,44 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_INNER_H_INCLUDED_
+#define _SRE_VM_INNER_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_vm_bytecode.h>
+
+
+typedef struct {
+    sre_uint_t               count;
+    sre_instruction_t       *pcs[1];
+} sre_vm_inner_state_list_t;
+
+
+/* the per-context state of the inner literal search */
+typedef struct {
+    sre_program_t                   *program;
+    sre_char                        *hit;   /* the last literal hit tried */
+
+    sre_vm_inner_state_list_t       *current_states;
+    sre_vm_inner_state_list_t       *next_states;
+
+    unsigned                        *tags;
+    unsigned                         tag;
+    unsigned                         matched;   /* :1 */
+} sre_vm_inner_ctx_t;
+
+
+SRE_NOAPI sre_vm_inner_ctx_t *sre_vm_inner_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_char *sre_vm_inner_find(sre_vm_inner_ctx_t *ctx, sre_char *pos,
+    sre_char *last, unsigned eof);
+
+
+#endif /* _SRE_VM_INNER_H_INCLUDED_ */
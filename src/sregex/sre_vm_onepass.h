@@ -0,0 +1,138 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_ONEPASS_H_INCLUDED_
+#define _SRE_VM_ONEPASS_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_vm_bytecode.h>
+
+
+/* the limits beyond which a program is left to the Pike VM */
+#define SRE_VM_ONEPASS_MAX_INSTRUCTIONS  512
+#define SRE_VM_ONEPASS_MAX_STATES        256
+
+
+/* how a transition changes the capture of the surviving thread */
+enum {
+    SRE_VM_ONEPASS_KEEP = 0,
+    SRE_VM_ONEPASS_UPDATE,      /* applies the saves to it */
+    SRE_VM_ONEPASS_RESET        /* applies the saves to a fresh one */
+};
+
+
+/* where the Pike VM would take its last matched position from */
+enum {
+    SRE_VM_ONEPASS_LAST_NONE = 0,
+    SRE_VM_ONEPASS_LAST_UNSET,  /* -1 */
+    SRE_VM_ONEPASS_LAST_BASE,   /* $0's end in the capture */
+    SRE_VM_ONEPASS_LAST_POS,    /* the current position */
+    SRE_VM_ONEPASS_LAST_NEXT    /* the position after the current byte */
+};
+
+
+enum {
+    SRE_VM_ONEPASS_SKIP_NONE = 0,
+    SRE_VM_ONEPASS_SKIP_BYTE,   /* to the next skip_byte */
+    SRE_VM_ONEPASS_SKIP_ALL     /* to the end of the input */
+};
+
+
+typedef struct sre_vm_onepass_state_s  sre_vm_onepass_state_t;
+
+
+typedef struct {
+    sre_uint_t                   count;
+    sre_uint_t                  *groups;
+} sre_vm_onepass_saves_t;
+
+
+/*
+ * The outcome of a Pike VM step on a byte class: the next state and the
+ * changes to the only capture that can be alive, and the match found,
+ * if any, which is built from the capture before the change.
+ */
+typedef struct {
+    sre_vm_onepass_state_t      *next;      /* NULL when no thread is left */
+    sre_vm_onepass_saves_t       saves;     /* at the current position */
+    sre_vm_onepass_saves_t       match_saves;       /* at the current
+                                                       position */
+    sre_vm_onepass_saves_t       match_next_saves;  /* at the next
+                                                       position */
+    sre_int_t                    regex_id;  /* -1 when nothing matched */
+    uint8_t                      capture;   /* SRE_VM_ONEPASS_KEEP, ... */
+    uint8_t                      match_fresh;   /* :1 */
+    uint8_t                      last_matched;  /* SRE_VM_ONEPASS_LAST_* */
+    uint8_t                      actions;   /* :1 anything besides next */
+} sre_vm_onepass_trans_t;
+
+
+/*
+ * A thread of the Pike VM thread list a state stands for. Its capture is
+ * a fresh one or the one alive, with the saves done at the position of
+ * the state on top.
+ */
+typedef struct {
+    sre_uint_t                   pc;
+    uint8_t                      fresh;     /* :1 */
+    sre_vm_onepass_saves_t       saves;
+} sre_vm_onepass_thread_t;
+
+
+struct sre_vm_onepass_state_s {
+    sre_vm_onepass_trans_t     **trans;     /* per byte class, and the end
+                                               of the input last */
+    sre_uint_t                   nthreads;
+    sre_vm_onepass_thread_t     *threads;
+    uint8_t                      skip;      /* SRE_VM_ONEPASS_SKIP_* */
+    uint8_t                      skip_byte;
+};
+
+
+struct sre_vm_onepass_s {
+    sre_uint_t                   nclasses;
+    sre_uint_t                   nstates;
+    uint8_t                      classes[256];  /* the class of a byte */
+    sre_vm_onepass_trans_t      *initial[3];    /* by the anchors holding:
+                                                   none, ^ only, and \A */
+};
+
+
+typedef struct {
+    sre_pool_t                  *pool;
+    sre_program_t               *program;
+    sre_vm_onepass_state_t      *state;
+    sre_int_t                   *capture;   /* the one updated in place */
+    sre_int_t                   *matched;
+    sre_int_t                    matched_id;    /* -1 when not matched */
+    sre_int_t                    processed_bytes;
+
+    sre_int_t                   *pending_ovector;
+    sre_int_t                   *ovector;
+    size_t                       ovecsize;
+
+    unsigned                     first_buf:1;
+    unsigned                     eof:1;
+    unsigned                     empty_capture:1;
+    unsigned                     seen_newline:1;
+} sre_vm_onepass_ctx_t;
+
+
+SRE_NOAPI sre_int_t sre_vm_onepass_compile(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_vm_onepass_ctx_t *sre_vm_onepass_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog, sre_int_t *ovector, size_t ovecsize);
+
+SRE_NOAPI sre_int_t sre_vm_onepass_exec(sre_vm_onepass_ctx_t *ctx,
+    sre_char *input, size_t size, unsigned eof, sre_int_t **pending_matched);
+
+
+#endif /* _SRE_VM_ONEPASS_H_INCLUDED_ */
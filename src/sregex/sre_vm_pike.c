@@ -15,80 +15,34 @@
 
 #include <sregex/sre_capture.h>
 #include <sregex/sre_vm_bytecode.h>
-
-
-#define sre_vm_pike_free_thread(ctx, t)                                     \
-    (t)->next = (ctx)->free_threads;                                        \
-    (ctx)->free_threads = t;
-
-
-enum {
-    SRE_VM_PIKE_SEEN_WORD = 1
-};
-
-
-typedef struct sre_vm_pike_thread_s  sre_vm_pike_thread_t;
-
-struct sre_vm_pike_thread_s {
-    sre_instruction_t       *pc;
-    sre_capture_t           *capture;
-    sre_vm_pike_thread_t    *next;
-    unsigned                 seen_word; /* :1 */
-};
-
-
-typedef struct {
-    sre_uint_t                count;
-    sre_vm_pike_thread_t     *head;
-    sre_vm_pike_thread_t    **next;
-} sre_vm_pike_thread_list_t;
-
-
-struct sre_vm_pike_ctx_s {
-    unsigned                 tag;
-    sre_int_t                processed_bytes;
-    sre_char                *buffer;
-    sre_pool_t              *pool;
-    sre_program_t           *program;
-    sre_capture_t           *matched;
-    sre_capture_t           *free_capture;
-    sre_vm_pike_thread_t    *free_threads;
-
-    sre_int_t               *pending_ovector;
-    sre_int_t               *ovector;
-    size_t                   ovecsize;
-
-    sre_vm_pike_thread_list_t       *current_threads;
-    sre_vm_pike_thread_list_t       *next_threads;
-
-    sre_int_t                last_matched_pos; /* the pos for the last
-                                                  (partial) match */
-
-    sre_instruction_t      **initial_states;
-    sre_uint_t               initial_states_count;
-
-    unsigned                 first_buf:1;
-    unsigned                 seen_start_state:1;
-    unsigned                 eof:1;
-    unsigned                 empty_capture:1;
-    unsigned                 seen_newline:1;
-    unsigned                 seen_word:1;
-} ;
+#include <sregex/sre_vm_pike.h>
+#include <sregex/sre_vm_closure.h>
 
 
 static sre_vm_pike_thread_list_t *
-    sre_vm_pike_thread_list_create(sre_pool_t *pool);
+    sre_vm_pike_thread_list_create(sre_pool_t *pool, sre_uint_t n,
+    sre_uint_t room);
 static sre_int_t sre_vm_pike_add_thread(sre_vm_pike_ctx_t *ctx,
-    sre_vm_pike_thread_list_t *l, sre_instruction_t *pc, sre_capture_t *capture,
-    sre_int_t pos, sre_capture_t **pcap);
+    sre_vm_pike_thread_list_t *l, sre_instruction_t *pc, unsigned counter,
+    sre_capture_t *capture, sre_int_t pos, sre_capture_t **pcap);
+static sre_int_t sre_vm_pike_add_start_threads(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *l, sre_capture_t *capture, sre_int_t pos,
+    sre_capture_t **pcap);
+static sre_int_t sre_vm_pike_add_closure(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *l, sre_vm_closure_entry_t *root,
+    sre_capture_t *capture, sre_int_t pos, sre_capture_t **pcap);
+static void sre_vm_pike_append_thread(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *l, sre_instruction_t *pc, unsigned counter,
+    sre_capture_t *capture, unsigned seen_word);
 static void sre_vm_pike_prepare_temp_captures(sre_program_t *prog,
     sre_vm_pike_ctx_t *ctx);
 static sre_int_t sre_vm_pike_prepare_matched_captures(sre_vm_pike_ctx_t *ctx,
     sre_capture_t *matched, sre_int_t *ovector, sre_int_t complete);
-static sre_char *sre_vm_pike_find_first_byte(sre_char *pos, sre_char *last,
-    int leading_byte, sre_chain_t *leading_bytes);
 static void sre_vm_pike_clear_thread_list(sre_vm_pike_ctx_t *ctx,
     sre_vm_pike_thread_list_t *list);
+static sre_int_t sre_vm_pike_step(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *clist, sre_vm_pike_thread_list_t *nlist,
+    sre_char *sp, sre_char *last);
 
 
 SRE_API sre_vm_pike_ctx_t *
@@ -108,24 +62,47 @@ sre_vm_pike_create_ctx(sre_pool_t *pool, sre_program_t *prog,
     ctx->processed_bytes = 0;
     ctx->pending_ovector = NULL;
 
-    clist = sre_vm_pike_thread_list_create(pool);
+    clist = sre_vm_pike_thread_list_create(pool, prog->nslots, prog->nslots);
     if (clist == NULL) {
         return NULL;
     }
 
     ctx->current_threads = clist;
 
-    nlist = sre_vm_pike_thread_list_create(pool);
+    nlist = sre_vm_pike_thread_list_create(pool, prog->nslots, prog->nslots);
     if (nlist == NULL) {
         return NULL;
     }
 
     ctx->next_threads = nlist;
 
+    ctx->held_threads = sre_vm_pike_thread_list_create(pool, prog->nslots, 0);
+    if (ctx->held_threads == NULL) {
+        return NULL;
+    }
+
+    ctx->branches = sre_palloc(pool,
+                               prog->nslots * sizeof(sre_vm_pike_branch_t));
+    if (ctx->branches == NULL) {
+        return NULL;
+    }
+
+    ctx->nbranches = 0;
+
+    ctx->tags = sre_pcalloc(pool, 2 * prog->nslots * sizeof(unsigned));
+    if (ctx->tags == NULL) {
+        return NULL;
+    }
+
+    ctx->current_tags = ctx->tags + prog->nslots;
+
+    ctx->tag = 0;
+    ctx->matched_tag = 0;
+
     ctx->program = prog;
     ctx->pool = pool;
-    ctx->free_capture = NULL;
-    ctx->free_threads = NULL;
+    ctx->free_captures.vectors = NULL;
+    ctx->free_captures.records = NULL;
     ctx->matched = NULL;
 
     ctx->ovecsize = ovecsize;
@@ -135,11 +112,58 @@ sre_vm_pike_create_ctx(sre_pool_t *pool, sre_program_t *prog,
     ctx->seen_start_state = 0;
     ctx->initial_states_count = 0;
     ctx->initial_states = NULL;
+
+    if (prog->inner) {
+        ctx->inner = sre_vm_inner_create_ctx(pool, prog);
+        if (ctx->inner == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->inner = NULL;
+    }
+
+    if (prog->onepass) {
+        ctx->onepass = sre_vm_onepass_create_ctx(pool, prog, ovector,
+                                                 ovecsize);
+        if (ctx->onepass == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->onepass = NULL;
+    }
+
+    if (prog->tdfa) {
+        ctx->tdfa = sre_vm_tdfa_create_ctx(pool, prog, ovector, ovecsize);
+        if (ctx->tdfa == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->tdfa = NULL;
+    }
+
+    ctx->backtrack = NULL;
+    ctx->bounds = NULL;
+
+    if (prog->multi) {
+        ctx->prefix_hits = sre_palloc(pool,
+                                      prog->nregexes * sizeof(sre_uint_t));
+        if (ctx->prefix_hits == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->prefix_hits = NULL;
+    }
+
     ctx->first_buf = 1;
     ctx->eof = 0;
     ctx->empty_capture = 0;
     ctx->seen_newline = 0;
     ctx->seen_word = 0;
+    ctx->no_prefix_hits = 0;
 
     return ctx;
 }
@@ -148,19 +172,54 @@ sre_vm_pike_create_ctx(sre_pool_t *pool, sre_program_t *prog,
 SRE_API sre_int_t
 sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
     unsigned eof, sre_int_t **pending_matched)
+{
+    if (ctx->eof) {
+        dd("eof found");
+        return SRE_ERROR;
+    }
+
+    if (ctx->onepass) {
+        return sre_vm_onepass_exec(ctx->onepass, input, size, eof,
+                                   pending_matched);
+    }
+
+    if (ctx->tdfa) {
+        return sre_vm_tdfa_exec(ctx->tdfa, input, size, eof, pending_matched);
+    }
+
+    if (eof && ctx->first_buf && size < ctx->program->backtrack_size) {
+        return sre_vm_backtrack_exec(ctx, input, size);
+    }
+
+    if (eof && ctx->first_buf && ctx->program->reverse
+        && ctx->ovecsize <= 2 * sizeof(sre_int_t))
+    {
+        return sre_vm_bounds_exec(ctx, input, size);
+    }
+
+    return sre_vm_pike_exec_helper(ctx, input, size, eof, pending_matched,
+                                   sre_vm_pike_step);
+}
+
+
+/*
+ * The common driver shared by the Pike VM interpreter and the JIT-compiled
+ * code. The "step" function runs all the threads in the current thread
+ * list on a single input position.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_pike_exec_helper(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
+    unsigned eof, sre_int_t **pending_matched, sre_vm_pike_step_pt step)
 {
     sre_char                  *sp, *last, *p;
     sre_int_t                  rc;
     sre_uint_t                 i;
-    unsigned                   seen_word, in;
+    unsigned                   located, *tags;
     sre_pool_t                *pool;
     sre_program_t             *prog;
     sre_capture_t             *cap, *matched;
-    sre_vm_range_t            *range;
-    sre_instruction_t         *pc;
     sre_vm_pike_thread_t      *t;
     sre_vm_pike_thread_list_t *clist, *nlist, *tmp;
-    sre_vm_pike_thread_list_t  list;
 
     if (ctx->eof) {
         dd("eof found");
@@ -171,7 +230,6 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
     prog = ctx->program;
     clist = ctx->current_threads;
     nlist = ctx->next_threads;
-    matched = ctx->matched;
 
     ctx->buffer = input;
     ctx->last_matched_pos = -1;
@@ -196,22 +254,30 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
     }
 
     last = input + size;
+    ctx->last = last;
 
     dd("processing buffer size %d", (int) size);
 
     if (ctx->first_buf) {
         ctx->first_buf = 0;
 
-        cap = sre_capture_create(pool, prog->ovecsize, 1, &ctx->free_capture);
+        /*
+         * the initial states of a multi-regex program only include the
+         * regexes always started, so the start threads are added again
+         * after recording them
+         */
+        ctx->no_prefix_hits = (prog->multi != NULL);
+
+        cap = sre_capture_create(pool, prog->ovecsize, 1,
+                                 &ctx->free_captures);
         if (cap == NULL) {
             return SRE_ERROR;
         }
 
-        ctx->tag = prog->tag + 1;
-        rc = sre_vm_pike_add_thread(ctx, clist, prog->start, cap,
+        ctx->tag++;
+        rc = sre_vm_pike_add_thread(ctx, clist, prog->start, 0, cap,
                                    (sre_int_t) (sp - input), NULL);
         if (rc != SRE_OK) {
-            prog->tag = ctx->tag;
             return SRE_ERROR;
         }
 
@@ -224,12 +290,27 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
         }
 
         /* we skip the last thread because it must always be .*? */
-        for (i = 0, t = clist->head; t && t->next; i++, t = t->next) {
-            ctx->initial_states[i] = t->pc;
+        for (i = 0; i + 1 < clist->count; i++) {
+            ctx->initial_states[i] = clist->head[i].pc;
         }
 
-    } else {
-        ctx->tag = prog->tag;
+        if (ctx->no_prefix_hits) {
+            ctx->no_prefix_hits = 0;
+            sre_vm_pike_clear_thread_list(ctx, clist);
+
+            cap = sre_capture_create(pool, prog->ovecsize, 1,
+                                     &ctx->free_captures);
+            if (cap == NULL) {
+                return SRE_ERROR;
+            }
+
+            ctx->tag++;
+            rc = sre_vm_pike_add_thread(ctx, clist, prog->start, 0, cap,
+                                       (sre_int_t) (sp - input), NULL);
+            if (rc != SRE_OK) {
+                return SRE_ERROR;
+            }
+        }
     }
 
     for (; sp < last || (eof && sp == last); sp++) {
@@ -238,22 +319,26 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
            (int)(sp - input),
            sp < last ? *sp : '?', sp < last ? *sp : 0);
 
-        if (clist->head == NULL) {
+        if (clist->count == 0) {
             dd("clist empty. abort.");
             break;
         }
 
 #if (DDEBUG)
         fprintf(stderr, "sregex: cur list:");
-        for (t = clist->head; t; t = t->next) {
-            fprintf(stderr, " %d", (int) (t->pc - prog->start));
+        for (i = 0; i < clist->count; i++) {
+            fprintf(stderr, " %d", (int) (clist->head[i].pc - prog->start));
         }
         fprintf(stderr, "\n");
 #endif
 
         dd("seen start state: %d", (int) ctx->seen_start_state);
 
-        if (prog->leading_bytes && ctx->seen_start_state) {
+        if ((prog->leading_set || prog->inner
+             || (prog->multi && prog->multi->nalways == 0)
+             || prog->slots == NULL)
+            && ctx->seen_start_state)
+        {
             dd("resetting seen start state");
             ctx->seen_start_state = 0;
 
@@ -263,8 +348,10 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
                 goto run_cur_threads;
             }
 
-            for (i = 0, t = clist->head; t && t->next; i++, t = t->next) {
-                if (t->pc != ctx->initial_states[i]) {
+            for (i = 0; i + 1 < clist->count; i++) {
+                t = &clist->head[i];
+
+                if (t->pc != ctx->initial_states[i] || t->counter) {
                     dd("skip because pc %d unmatched: %d != %d", (int) i,
                        (int) (t->pc - prog->start),
                        (int) (ctx->initial_states[i] - prog->start));
@@ -274,8 +361,33 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
 
 #if 1
             dd("XXX found initial state to do first byte search!");
-            p = sre_vm_pike_find_first_byte(sp, last, prog->leading_byte,
-                                            prog->leading_bytes);
+            if (prog->prefix) {
+                p = sre_literal_find(prog->prefix, sp, last);
+
+            } else if (ctx->inner) {
+                p = sre_vm_inner_find(ctx->inner, sp, last, eof);
+
+            } else if (prog->multi && prog->multi->nalways == 0) {
+                p = sre_multi_literal_find(&prog->multi->prefixes, sp, last);
+
+            } else if (prog->leading_set) {
+                p = sre_byteset_find(prog->leading_set, sp, last);
+
+            } else {
+                p = sp;
+            }
+
+            located = 0;
+
+            if (p == sp && prog->slots == NULL && ctx->matched == NULL) {
+                p = sre_vm_bounds_locate(ctx, clist->head, clist->count, sp,
+                                         last, eof);
+                if (p == NULL) {
+                    return SRE_ERROR;
+                }
+
+                located = 1;
+            }
 
             if (p > sp) {
                 dd("XXX moved sp by %d bytes", (int) (p - sp));
@@ -288,20 +400,26 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
                 sre_vm_pike_clear_thread_list(ctx, clist);
 
                 cap = sre_capture_create(pool, prog->ovecsize, 1,
-                                         &ctx->free_capture);
+                                         &ctx->free_captures);
                 if (cap == NULL) {
                     return SRE_ERROR;
                 }
 
                 ctx->tag++;
-                rc = sre_vm_pike_add_thread(ctx, clist, prog->start, cap,
+                rc = sre_vm_pike_add_thread(ctx, clist, prog->start, 0, cap,
                                            (sre_int_t) (sp - input), NULL);
                 if (rc != SRE_OK) {
-                    prog->tag = ctx->tag;
                     return SRE_ERROR;
                 }
 
-                if (sp == last) {
+                /*
+                 * the ".*?" thread may be discarded by a match in this
+                 * step, so only the next step can tell if the start
+                 * state is still alive
+                 */
+                ctx->seen_start_state = 0;
+
+                if (sp == last && !(located && eof)) {
                     break;
                 }
             }
@@ -309,270 +427,37 @@ sre_vm_pike_exec(sre_vm_pike_ctx_t *ctx, sre_char *input, size_t size,
         }
 
 run_cur_threads:
-        ctx->tag++;
-
-        while (clist->head) {
-            t = clist->head;
-            clist->head = t->next;
-            clist->count--;
-
-            pc = t->pc;
-            cap = t->capture;
-
-#if DDEBUG
-            fprintf(stderr, "--- #%u", ctx->tag);
-            sre_dump_instruction(stderr, pc, prog->start);
-            fprintf(stderr, "\n");
-#endif
-
-            switch (pc->opcode) {
-            case SRE_OPCODE_IN:
-                if (sp == last) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                in = 0;
-                for (i = 0; i < pc->v.ranges->count; i++) {
-                    range = &pc->v.ranges->head[i];
-
-                    dd("testing %d for [%d, %d] (%u)", *sp,
-                       (int) range->from, (int) range->to, (unsigned) i);
-
-                    if (*sp >= range->from && *sp <= range->to) {
-                        in = 1;
-                        break;
-                    }
-                }
-
-                if (!in) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, cap,
-                                           (sre_int_t) (sp - input + 1), &cap);
-
-                if (rc == SRE_DONE) {
-                    goto matched;
-                }
-
-                if (rc != SRE_OK) {
-                    prog->tag = ctx->tag;
-                    return SRE_ERROR;
-                }
-
-                break;
-
-            case SRE_OPCODE_NOTIN:
-                if (sp == last) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                in = 0;
-                for (i = 0; i < pc->v.ranges->count; i++) {
-                    range = &pc->v.ranges->head[i];
+        /*
+         * the current threads keep their own tags, which the threads
+         * added by look-ahead assertions holding are tagged in
+         */
+        tags = ctx->current_tags;
+        ctx->current_tags = ctx->tags;
+        ctx->tags = tags;
 
-                    dd("testing %d for [%d, %d] (%u)", *sp, (int) range->from,
-                       (int) range->to, (unsigned) i);
-
-                    if (*sp >= range->from && *sp <= range->to) {
-                        in = 1;
-                        break;
-                    }
-                }
-
-                if (in) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, cap,
-                                           (sre_int_t) (sp - input + 1), &cap);
-
-                if (rc == SRE_DONE) {
-                    goto matched;
-                }
-
-                if (rc != SRE_OK) {
-                    prog->tag = ctx->tag;
-                    return SRE_ERROR;
-                }
-
-                break;
-
-            case SRE_OPCODE_CHAR:
-
-                dd("matching char '%c' (%d) against %d",
-                   sp != last ? *sp : '?', sp != last ? *sp : 0, pc->v.ch);
-
-                if (sp == last || *sp != pc->v.ch) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, cap,
-                                            (sre_int_t) (sp - input + 1), &cap);
-
-                if (rc == SRE_DONE) {
-                    goto matched;
-                }
-
-                if (rc != SRE_OK) {
-                    prog->tag = ctx->tag;
-                    return SRE_ERROR;
-                }
-
-                break;
-
-            case SRE_OPCODE_ANY:
-
-                if (sp == last) {
-                    sre_capture_decr_ref(ctx, cap);
-                    break;
-                }
-
-                rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, cap,
-                                           (sre_int_t) (sp - input + 1), &cap);
-
-                if (rc == SRE_DONE) {
-                    goto matched;
-                }
-
-                if (rc != SRE_OK) {
-                    prog->tag = ctx->tag;
-                    return SRE_ERROR;
-                }
-
-                break;
-
-            case SRE_OPCODE_ASSERT:
-                switch (pc->v.assertion) {
-                case SRE_REGEX_ASSERT_SMALL_Z:
-                    if (sp != last) {
-                        break;
-                    }
-
-                    goto assertion_hold;
-
-                case SRE_REGEX_ASSERT_DOLLAR:
-
-                    if (sp != last && *sp != '\n') {
-                        break;
-                    }
-
-                    dd("dollar $ assertion hold: pos=%d",
-                       (int)(sp - input + ctx->processed_bytes));
-
-                    goto assertion_hold;
-
-                case SRE_REGEX_ASSERT_BIG_B:
-
-                    seen_word = (t->seen_word
-                                 || (sp == input && ctx->seen_word));
-                    if (seen_word ^ (sp != last && sre_isword(*sp))) {
-                        break;
-                    }
-
-                    dd("\\B assertion passed: %u %c", t->seen_word, *sp);
-
-                    goto assertion_hold;
-
-                case SRE_REGEX_ASSERT_SMALL_B:
-
-                    seen_word = (t->seen_word
-                                 || (sp == input && ctx->seen_word));
-                    if ((seen_word ^ (sp != last && sre_isword(*sp))) == 0) {
-                        break;
-                    }
-
-#if (DDEBUG)
-                    if (sp) {
-                        dd("\\b assertion passed: t:%u, ctx:%u, %c",
-                           t->seen_word, ctx->seen_word, *sp);
-                    }
-#endif
-
-                    goto assertion_hold;
-
-                default:
-                    /* impossible to reach here */
-                    break;
-                }
-
-                break;
-
-assertion_hold:
-                ctx->tag--;
-
-                list.head = NULL;
-                list.count = 0;
-                rc = sre_vm_pike_add_thread(ctx, &list, pc + 1, cap,
-                                           (sre_int_t) (sp - input), NULL);
-
-                if (rc != SRE_OK) {
-                    prog->tag = ctx->tag + 1;
-                    return SRE_ERROR;
-                }
-
-                if (list.head) {
-                    *list.next = clist->head;
-                    clist->head = list.head;
-                    clist->count += list.count;
-                }
-
-                ctx->tag++;
-
-                dd("sp + 1 == last: %d, eof: %u", sp + 1 == last, eof);
-                break;
-
-            case SRE_OPCODE_MATCH:
-
-                ctx->last_matched_pos = cap->vector[1];
-                cap->regex_id = pc->v.regex_id;
-
-matched:
-                if (matched) {
-
-                    dd("discarding match: ");
-#if (DDEBUG)
-                    sre_capture_dump(matched);
-#endif
-                    sre_capture_decr_ref(ctx, matched);
-                }
-
-                dd("set matched, regex id: %d", (int) pc->v.regex_id);
-
-                matched = cap;
-
-                sre_vm_pike_free_thread(ctx, t);
-
-                sre_vm_pike_clear_thread_list(ctx, clist);
+        ctx->tag++;
 
-                goto step_done;
+        cap = ctx->matched;
 
-                /*
-                 * Jmp, Split, Save handled in addthread, so that
-                 * machine execution matches what a backtracker would do.
-                 * This is discussed (but not shown as code) in
-                 * Regular Expression Matching: the Virtual Machine Approach.
-                 */
-            default:
-                /* impossible to reach here */
-                break;
-            }
+        rc = step(ctx, clist, nlist, sp, last);
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
 
-            sre_vm_pike_free_thread(ctx, t);
-        } /* while */
+        if (ctx->matched != cap) {
+            /* the match may cut the threads added with this tag short */
+            ctx->matched_tag = ctx->tag;
+        }
 
-step_done:
         tmp = clist;
         clist = nlist;
         nlist = tmp;
 
-        if (nlist->head) {
+        if (nlist->count) {
             sre_vm_pike_clear_thread_list(ctx, nlist);
+
+        } else {
+            nlist->head = nlist->threads;
         }
 
         if (sp == last) {
@@ -580,7 +465,9 @@ step_done:
         }
     } /* for */
 
-    dd("matched: %p, clist: %p, pos: %d", matched, clist->head,
+    matched = ctx->matched;
+
+    dd("matched: %p, clist: %d, pos: %d", matched, (int) clist->count,
        (int) (ctx->processed_bytes + (sp - input)));
 
     if (ctx->last_matched_pos >= 0) {
@@ -600,12 +487,11 @@ step_done:
         ctx->last_matched_pos = -1;
     }
 
-    prog->tag = ctx->tag;
     ctx->current_threads = clist;
     ctx->next_threads = nlist;
 
     if (matched) {
-        if (eof || clist->head == NULL) {
+        if (eof || clist->count == 0) {
             if (sre_vm_pike_prepare_matched_captures(ctx, matched,
                                                      ctx->ovector, 1)
                 != SRE_OK)
@@ -613,10 +499,8 @@ step_done:
                 return SRE_ERROR;
             }
 
-            if (clist->head) {
-                *clist->next = ctx->free_threads;
-                ctx->free_threads = clist->head;
-                clist->head = NULL;
+            if (clist->count) {
+                clist->head = clist->threads;
                 clist->count = 0;
                 ctx->eof = 1;
             }
@@ -635,7 +519,7 @@ step_done:
             return rc;
         }
 
-        dd("clist head cap == matched: %d", clist->head->capture == matched);
+        dd("clist head cap == matched: %d", clist->head[0].capture == matched);
 
         if (pending_matched) {
 #if 1
@@ -689,42 +573,389 @@ step_done:
 }
 
 
-static void
-sre_vm_pike_prepare_temp_captures(sre_program_t *prog, sre_vm_pike_ctx_t *ctx)
+/*
+ * Runs a single thread popped from the current thread list "clist" on the
+ * current input position "sp". It frees the thread and returns SRE_OK in
+ * the common case, or returns SRE_DONE when a match is found (in which case
+ * all the remaining threads in "clist" are also discarded).
+ *
+ * This is also the slow path of the JIT-compiled step functions.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_pike_step_thread(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *clist, sre_vm_pike_thread_list_t *nlist,
+    sre_vm_pike_thread_t *t, sre_char *sp, sre_char *last)
 {
-    sre_int_t                a, b;
-    sre_uint_t               i, j, ofs;
-    sre_capture_t           *cap;
-    sre_vm_pike_thread_t    *t;
+    sre_int_t                  rc;
+    sre_uint_t                 i, room;
+    unsigned                   seen_word, in, *tags;
+    sre_char                  *input;
+    sre_capture_t             *cap;
+    sre_vm_range_t            *range;
+    sre_instruction_t         *pc;
+    sre_vm_pike_thread_t      *p;
+    sre_vm_pike_thread_list_t *held;
 
-    ctx->ovector[0] = -1;
-    ctx->ovector[1] = -1;
+    input = ctx->buffer;
+    pc = t->pc;
+    cap = t->capture;
 
-    for (t = ctx->current_threads->head; t; t = t->next) {
-        cap = t->capture;
+#if DDEBUG
+    fprintf(stderr, "--- #%u", ctx->tag);
+    sre_dump_instruction(stderr, pc, ctx->program);
+    fprintf(stderr, "\n");
+#endif
 
-        ofs = 0;
-        for (i = 0; i < prog->nregexes; i++) {
+    switch (pc->opcode) {
+    case SRE_OPCODE_IN:
+        if (sp == last) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        in = 0;
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            dd("testing %d for [%d, %d] (%u)", *sp,
+               (int) range->from, (int) range->to, (unsigned) i);
+
+            if (*sp >= range->from && *sp <= range->to) {
+                in = 1;
+                break;
+            }
+        }
+
+        if (!in) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input + 1), &cap);
+
+        if (rc == SRE_DONE) {
+            goto matched;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        break;
+
+    case SRE_OPCODE_NOTIN:
+        if (sp == last) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        in = 0;
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            dd("testing %d for [%d, %d] (%u)", *sp, (int) range->from,
+               (int) range->to, (unsigned) i);
+
+            if (*sp >= range->from && *sp <= range->to) {
+                in = 1;
+                break;
+            }
+        }
+
+        if (in) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input + 1), &cap);
+
+        if (rc == SRE_DONE) {
+            goto matched;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        break;
+
+    case SRE_OPCODE_BITMAP:
+        if (sp == last
+            || !sre_vm_bitmap_test(sre_program_bitmap(ctx->program, pc), *sp))
+        {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input + 1), &cap);
+
+        if (rc == SRE_DONE) {
+            goto matched;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        break;
+
+    case SRE_OPCODE_CHAR:
+
+        dd("matching char '%c' (%d) against %d",
+           sp != last ? *sp : '?', sp != last ? *sp : 0, pc->v.ch);
+
+        if (sp == last || *sp != pc->v.ch) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input + 1), &cap);
+
+        if (rc == SRE_DONE) {
+            goto matched;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        break;
+
+    case SRE_OPCODE_ANY:
+
+        if (sp == last) {
+            sre_capture_decr_ref(ctx, cap);
+            break;
+        }
+
+        rc = sre_vm_pike_add_thread(ctx, nlist, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input + 1), &cap);
+
+        if (rc == SRE_DONE) {
+            goto matched;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        break;
+
+    case SRE_OPCODE_ASSERT:
+        switch (pc->v.assertion) {
+        case SRE_REGEX_ASSERT_SMALL_Z:
+            if (sp != last) {
+                break;
+            }
+
+            goto assertion_hold;
+
+        case SRE_REGEX_ASSERT_DOLLAR:
+
+            if (sp != last && *sp != '\n') {
+                break;
+            }
+
+            dd("dollar $ assertion hold: pos=%d",
+               (int)(sp - input + ctx->processed_bytes));
+
+            goto assertion_hold;
+
+        case SRE_REGEX_ASSERT_BIG_B:
+
+            seen_word = (t->seen_word || (sp == input && ctx->seen_word));
+            if (seen_word ^ (sp != last && sre_isword(*sp))) {
+                break;
+            }
+
+            dd("\\B assertion passed: %u %c", t->seen_word, *sp);
+
+            goto assertion_hold;
+
+        case SRE_REGEX_ASSERT_SMALL_B:
+
+            seen_word = (t->seen_word || (sp == input && ctx->seen_word));
+            if ((seen_word ^ (sp != last && sre_isword(*sp))) == 0) {
+                break;
+            }
+
+#if (DDEBUG)
+            if (sp) {
+                dd("\\b assertion passed: t:%u, ctx:%u, %c",
+                   t->seen_word, ctx->seen_word, *sp);
+            }
+#endif
+
+            goto assertion_hold;
+
+        default:
+            /* impossible to reach here */
+            break;
+        }
+
+        break;
+
+assertion_hold:
+        /*
+         * the threads added run before the threads left, so they only skip
+         * the ones added by assertions in this step, which are tagged in
+         * the tags of the current threads to keep the next ones intact
+         */
+        tags = ctx->tags;
+        ctx->tags = ctx->current_tags;
+
+        held = ctx->held_threads;
+
+        rc = sre_vm_pike_add_thread(ctx, held, pc + 1, t->counter, cap,
+                                    (sre_int_t) (sp - input), NULL);
+
+        ctx->tags = tags;
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+
+        if (held->count) {
+            /* run them next, over the room left by the threads run */
+
+            room = (sre_uint_t) (clist->head
+                                 - (clist->threads - ctx->program->nslots));
+
+            if (held->count > room) {
+                /* the threads left go to the end of the array */
+                p = clist->threads + ctx->program->nslots - clist->count;
+
+                memmove(p, clist->head,
+                        clist->count * sizeof(sre_vm_pike_thread_t));
+
+                clist->head = p;
+                room = 2 * ctx->program->nslots - clist->count;
+
+                if (held->count > room) {
+                    /*
+                     * impossible: the threads left hold every slot at most
+                     * once, and so do the ones added in a step
+                     */
+                    return SRE_ERROR;
+                }
+            }
+
+            clist->head -= held->count;
+            clist->count += held->count;
+
+            memcpy(clist->head, held->head,
+                   held->count * sizeof(sre_vm_pike_thread_t));
+
+            held->count = 0;
+        }
+
+        dd("sp + 1 == last: %d", sp + 1 == last);
+        break;
+
+    case SRE_OPCODE_MATCH:
+
+        ctx->last_matched_pos = sre_capture_get(cap, 1);
+        cap->regex_id = pc->v.regex_id;
+
+matched:
+        if (ctx->matched) {
+
+            dd("discarding match: ");
+#if (DDEBUG)
+            sre_capture_dump(ctx->matched);
+#endif
+            sre_capture_decr_ref(ctx, ctx->matched);
+        }
+
+        dd("set matched, regex id: %d", (int) pc->v.regex_id);
+
+        ctx->matched = cap;
+
+        sre_vm_pike_clear_thread_list(ctx, clist);
+
+        return SRE_DONE;
+
+        /*
+         * Jmp, Split, Save handled in addthread, so that
+         * machine execution matches what a backtracker would do.
+         * This is discussed (but not shown as code) in
+         * Regular Expression Matching: the Virtual Machine Approach.
+         */
+    default:
+        /* impossible to reach here */
+        break;
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_pike_step(sre_vm_pike_ctx_t *ctx, sre_vm_pike_thread_list_t *clist,
+    sre_vm_pike_thread_list_t *nlist, sre_char *sp, sre_char *last)
+{
+    sre_int_t                  rc;
+    sre_vm_pike_thread_t      *t;
+
+    while (clist->count) {
+        t = clist->head++;
+        clist->count--;
+
+        rc = sre_vm_pike_step_thread(ctx, clist, nlist, t, sp, last);
+
+        if (rc == SRE_DONE) {
+            break;
+        }
+
+        if (rc != SRE_OK) {
+            return SRE_ERROR;
+        }
+    }
+
+    return SRE_OK;
+}
+
+static void
+sre_vm_pike_prepare_temp_captures(sre_program_t *prog, sre_vm_pike_ctx_t *ctx)
+{
+    sre_int_t                a, b;
+    sre_uint_t               i, j, k, ofs;
+    sre_capture_t           *cap;
+    sre_vm_pike_thread_list_t   *l;
+
+    ctx->ovector[0] = -1;
+    ctx->ovector[1] = -1;
+
+    l = ctx->current_threads;
+
+    for (k = 0; k < l->count; k++) {
+        cap = l->head[k].capture;
+
+        ofs = 0;
+        for (i = 0; i < prog->nregexes; i++) {
 
             for (j = 0; j < 2; j += 2) {
                 a = ctx->ovector[j];
-                b = cap->vector[ofs + j];
+                b = sre_capture_get(cap, ofs + j);
 
                 dd("%d: %d -> %d", (int) j, (int) b, (int) a);
 
                 if (b != -1 && (a == -1 || b < a)) {
-                    dd("setting group %d to %d", (int) j, (int) cap->vector[j]);
+                    dd("setting group %d to %d", (int) j, (int) b);
                     ctx->ovector[j] = b;
                 }
 
                 a = ctx->ovector[j + 1];
-                b = cap->vector[j + 1];
+                b = sre_capture_get(cap, j + 1);
 
                 dd("%d: %d -> %d", (int) (j + 1), (int) b, (int) a);
 
                 if (b != -1 && (a == -1 || b > a)) {
-                    dd("setting group %d to %d", (int) (j + 1),
-                       (int) cap->vector[j + 1]);
+                    dd("setting group %d to %d", (int) (j + 1), (int) b);
                     ctx->ovector[j + 1] = b;
                 }
             }
@@ -736,8 +967,10 @@ sre_vm_pike_prepare_temp_captures(sre_program_t *prog, sre_vm_pike_ctx_t *ctx)
 
 
 static sre_vm_pike_thread_list_t *
-sre_vm_pike_thread_list_create(sre_pool_t *pool)
+sre_vm_pike_thread_list_create(sre_pool_t *pool, sre_uint_t n,
+    sre_uint_t room)
 {
+    sre_vm_pike_thread_t            *threads;
     sre_vm_pike_thread_list_t       *l;
 
     l = sre_palloc(pool, sizeof(sre_vm_pike_thread_list_t));
@@ -745,200 +978,504 @@ sre_vm_pike_thread_list_create(sre_pool_t *pool)
         return NULL;
     }
 
-    l->head = NULL;
-    l->next = &l->head;
+    threads = sre_palloc(pool, (room + n) * sizeof(sre_vm_pike_thread_t));
+    if (threads == NULL) {
+        return NULL;
+    }
+
+    l->threads = threads + room;
+    l->head = l->threads;
     l->count = 0;
 
     return l;
 }
 
 
+/*
+ * Adds the threads reached from "pc" to "l" in priority order, like a
+ * backtracker would run them. The branches of the SPLITs and the COUNTs
+ * left for later are kept on ctx->branches instead of the C stack, so
+ * the stack depth does not depend on the shape of the regexes. Each of
+ * them holds a reference to its capture, given back if a match cuts the
+ * closure short.
+ */
 static sre_int_t
 sre_vm_pike_add_thread(sre_vm_pike_ctx_t *ctx, sre_vm_pike_thread_list_t *l,
-    sre_instruction_t *pc, sre_capture_t *capture, sre_int_t pos,
-    sre_capture_t **pcap)
+    sre_instruction_t *pc, unsigned counter, sre_capture_t *capture,
+    sre_int_t pos, sre_capture_t **pcap)
 {
     sre_int_t                    rc;
-    sre_vm_pike_thread_t        *t;
-    sre_capture_t               *cap;
-    unsigned                     seen_word = 0;
+    uint32_t                     i;
+    unsigned                     seen_word;
+    sre_uint_t                   slot, base;
+    sre_program_t               *prog;
+    sre_vm_repeat_t             *repeat;
+    sre_vm_pike_branch_t        *b;
+
+    prog = ctx->program;
+
+    if (prog->closure && pos && ctx->tag != ctx->matched_tag) {
+        i = prog->closure->pike[ctx->buffer[pos - 1] == '\n']
+                               [pc - prog->start];
+        if (i) {
+            return sre_vm_pike_add_closure(ctx, l, &prog->closure->entries[i],
+                                           capture, pos, pcap);
+        }
+    }
+
+    /* the branches of the callers, like sre_vm_pike_add_start_threads */
+    base = ctx->nbranches;
+
+    for ( ;; ) {
+        slot = sre_program_slot(prog, pc, counter);
 
 #if 0
-    dd("pc tag: %u, ctx tag: %u", pc->tag, ctx->tag);
+        dd("pc tag: %u, ctx tag: %u", ctx->tags[slot], ctx->tag);
 #endif
 
-    if (pc->tag == ctx->tag) {
-        dd("pc %d: already on list: %d", (int) (pc - ctx->program->start),
-           pc->tag);
+        if (ctx->tags[slot] == ctx->tag) {
+            dd("pc %d: already on list: %d", (int) (pc - prog->start),
+               ctx->tags[slot]);
 
-        if (pc->opcode == SRE_OPCODE_SPLIT) {
-            if (pc->y->tag != ctx->tag) {
-                if (pc == ctx->program->start) {
+            if (pc->opcode == SRE_OPCODE_SPLIT
+                && ctx->tags[sre_program_slot(prog, sre_program_y(prog, pc),
+                                              counter)]
+                   != ctx->tag)
+            {
+                if (pc == prog->start) {
                     dd("setting seen start state");
                     ctx->seen_start_state = 1;
                 }
 
-                return sre_vm_pike_add_thread(ctx, l, pc->y, capture, pos,
-                                              pcap);
+                pc = sre_program_y(prog, pc);
+                continue;
             }
+
+            goto dead;
         }
 
-        return SRE_OK;
-    }
+        dd("adding thread: pc %d, bytecode %d", (int) (pc - prog->start),
+           pc->opcode);
 
-    dd("adding thread: pc %d, bytecode %d", (int) (pc - ctx->program->start),
-       pc->opcode);
+        ctx->tags[slot] = ctx->tag;
 
-    pc->tag = ctx->tag;
+        switch (pc->opcode) {
+        case SRE_OPCODE_JMP:
+            pc = sre_program_x(prog, pc);
+            continue;
 
-    switch (pc->opcode) {
-    case SRE_OPCODE_JMP:
-        return sre_vm_pike_add_thread(ctx, l, pc->x, capture, pos, pcap);
+        case SRE_OPCODE_COUNT:
+            repeat = sre_program_repeat(prog, pc);
+            counter++;
 
-    case SRE_OPCODE_SPLIT:
-        if (pc == ctx->program->start) {
-            dd("setting seen start state");
-            ctx->seen_start_state = 1;
-        }
+            if (counter < repeat->min) {
+                pc = sre_program_x(prog, pc);
+                continue;
+            }
 
-        capture->ref++;
+            if (counter == repeat->max) {
+                pc = sre_program_y(prog, pc);
+                counter = 0;
+                continue;
+            }
 
-        rc = sre_vm_pike_add_thread(ctx, l, pc->x, capture, pos, pcap);
-        if (rc != SRE_OK) {
-            capture->ref--;
-            return rc;
-        }
+            if (repeat->max == 0) {
+                /* no more iterations need to be told apart */
+                counter = repeat->min;
+            }
 
-        return sre_vm_pike_add_thread(ctx, l, pc->y, capture, pos, pcap);
+            capture->ref++;
 
-    case SRE_OPCODE_SAVE:
+            b = &ctx->branches[ctx->nbranches++];
+            b->capture = capture;
 
-#if 0
-        dd("pc %d: cap %p: save %d as group %d",
-           (int) (pc - ctx->program->start), capture, pos,
-           pc->v.group);
-#endif
+            if (repeat->greedy) {
+                b->pc = sre_program_y(prog, pc);
+                b->counter = 0;
 
-        dd("save %u: processed bytes: %u, pos: %u",
-           (unsigned) pc->v.group,
-           (unsigned) ctx->processed_bytes, (unsigned) pos);
+                pc = sre_program_x(prog, pc);
 
-        cap = sre_capture_update(ctx->pool, capture, pc->v.group,
-                                 ctx->processed_bytes + pos,
-                                 &ctx->free_capture);
-        if (cap == NULL) {
-            return SRE_ERROR;
-        }
+            } else {
+                b->pc = sre_program_x(prog, pc);
+                b->counter = counter;
 
-#if 0
-        dd("new cap: %p", cap);
-#endif
+                pc = sre_program_y(prog, pc);
+                counter = 0;
+            }
 
-        return sre_vm_pike_add_thread(ctx, l, pc + 1, cap, pos, pcap);
+            continue;
 
-    case SRE_OPCODE_ASSERT:
-        switch (pc->v.assertion) {
-        case SRE_REGEX_ASSERT_BIG_A:
-            if (pos || ctx->processed_bytes) {
-                break;
+        case SRE_OPCODE_SPLIT:
+            if (pc == prog->start) {
+                dd("setting seen start state");
+                ctx->seen_start_state = 1;
+
+                if (prog->multi) {
+                    rc = sre_vm_pike_add_start_threads(ctx, l, capture, pos,
+                                                       pcap);
+                    if (rc != SRE_OK) {
+                        goto failed;
+                    }
+
+                    goto next;
+                }
             }
 
-            return sre_vm_pike_add_thread(ctx, l, pc + 1, capture, pos, pcap);
+            capture->ref++;
 
-        case SRE_REGEX_ASSERT_CARET:
-            dd("seen newline: %u", ctx->seen_newline);
+            b = &ctx->branches[ctx->nbranches++];
+            b->pc = sre_program_y(prog, pc);
+            b->capture = capture;
+            b->counter = counter;
 
-            if (pos == 0) {
-                if (ctx->processed_bytes && !ctx->seen_newline) {
-                    break;
-                }
+            pc = sre_program_x(prog, pc);
+            continue;
 
-            } else {
-                if (ctx->buffer[pos - 1] != '\n') {
-                    break;
-                }
+        case SRE_OPCODE_SAVE:
+
+            dd("save %u: processed bytes: %u, pos: %u",
+               (unsigned) pc->v.group,
+               (unsigned) ctx->processed_bytes, (unsigned) pos);
+
+            capture = sre_capture_update(ctx->pool, capture, pc->v.group,
+                                         ctx->processed_bytes + pos,
+                                         &ctx->free_captures);
+            if (capture == NULL) {
+                rc = SRE_ERROR;
+                goto failed;
             }
 
-            dd("newline assertion hold");
+            pc++;
+            continue;
 
-            return sre_vm_pike_add_thread(ctx, l, pc + 1, capture, pos, pcap);
+        case SRE_OPCODE_ASSERT:
+            switch (pc->v.assertion) {
+            case SRE_REGEX_ASSERT_BIG_A:
+                if (pos || ctx->processed_bytes) {
+                    goto dead;
+                }
 
-        case SRE_REGEX_ASSERT_SMALL_B:
-        case SRE_REGEX_ASSERT_BIG_B:
-            {
-                sre_char c;
+                pc++;
+                continue;
+
+            case SRE_REGEX_ASSERT_CARET:
+                dd("seen newline: %u", ctx->seen_newline);
 
                 if (pos == 0) {
-                    seen_word = 0;
+                    if (ctx->processed_bytes && !ctx->seen_newline) {
+                        goto dead;
+                    }
 
                 } else {
-                    c = ctx->buffer[pos - 1];
-                    seen_word = sre_isword(c);
+                    if (ctx->buffer[pos - 1] != '\n') {
+                        goto dead;
+                    }
                 }
 
-                goto add;
+                dd("newline assertion hold");
+
+                pc++;
+                continue;
+
+            case SRE_REGEX_ASSERT_SMALL_B:
+            case SRE_REGEX_ASSERT_BIG_B:
+                seen_word = pos && sre_isword(ctx->buffer[pos - 1]);
+                break;
+
+            default:
+                /* postpone look-ahead assertions */
+                seen_word = 0;
+                break;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+
+            ctx->last_matched_pos = sre_capture_get(capture, 1);
+            capture->regex_id = pc->v.regex_id;
+
+            if (pcap) {
+                *pcap = capture;
+                rc = SRE_DONE;
+                goto failed;
             }
 
+            /* fall through */
+
         default:
-            /* postpone look-ahead assertions */
-            goto add;
+            seen_word = 0;
+            break;
         }
 
-        break;
+        sre_vm_pike_append_thread(ctx, l, pc, counter, capture, seen_word);
+        goto next;
 
-    case SRE_OPCODE_MATCH:
+dead:
 
-        ctx->last_matched_pos = capture->vector[1];
-        capture->regex_id = pc->v.regex_id;
+        /* no thread is left to hold its reference */
+        sre_capture_decr_ref(ctx, capture);
 
-#if 1
-        if (pcap) {
-            *pcap = capture;
-            return SRE_DONE;
+next:
+
+        if (ctx->nbranches == base) {
+            return SRE_OK;
         }
-#endif
 
-    default:
+        b = &ctx->branches[--ctx->nbranches];
+
+        pc = b->pc;
+        capture = b->capture;
+        counter = b->counter;
+    }
 
-add:
-        if (ctx->free_threads) {
-            /* fprintf(stderr, "reusing free thread\n"); */
+failed:
 
-            t = ctx->free_threads;
-            ctx->free_threads = t->next;
-            t->next = NULL;
+    /* the branches left give back the references taken for them */
 
-        } else {
-            /* fprintf(stderr, "creating new thread\n"); */
+    while (ctx->nbranches > base) {
+        b = &ctx->branches[--ctx->nbranches];
+        sre_capture_decr_ref(ctx, b->capture);
+    }
 
-            t = sre_palloc(ctx->pool, sizeof(sre_vm_pike_thread_t));
-            if (t == NULL) {
-                return SRE_ERROR;
+    return rc;
+}
+
+
+/*
+ * Adds the threads of the closure "root" of the instruction "pc" for
+ * sre_vm_pike_add_thread, in the same order and with the same captures
+ * and tags, without recursing over the program. Every entry holds a
+ * reference to its capture, taken for it by the entry above.
+ */
+static sre_int_t
+sre_vm_pike_add_closure(sre_vm_pike_ctx_t *ctx, sre_vm_pike_thread_list_t *l,
+    sre_vm_closure_entry_t *root, sre_capture_t *capture, sre_int_t pos,
+    sre_capture_t **pcap)
+{
+    sre_int_t                    rc;
+    unsigned                     seen_word;
+    sre_program_t               *prog;
+    sre_capture_t               *cap, *caps[SRE_VM_CLOSURE_MAX_DEPTH + 1];
+    sre_instruction_t           *pc;
+    sre_vm_closure_entry_t      *e, *end, *a, *child, *next;
+
+    prog = ctx->program;
+
+    caps[0] = capture;
+    end = root + root->skip;
+
+    for (e = root; e < end; e++) {
+        pc = e->pc;
+        cap = caps[e->depth];
+
+        if (e->type == SRE_VM_CLOSURE_SPLIT_Y) {
+            if (ctx->tags[pc->y] == ctx->tag) {
+                e += e->skip - 1;
+                goto dead;
+            }
+
+            if (pc == prog->start) {
+                dd("setting seen start state");
+                ctx->seen_start_state = 1;
             }
+
+            goto follow;
         }
 
-        t->pc = pc;
-        t->capture = capture;
-        t->next = NULL;
-        t->seen_word = seen_word;
+        if (ctx->tags[pc - prog->start] == ctx->tag) {
+            /* all the instructions reached from pc are tagged as well */
+            e += e->skip - 1;
+            goto dead;
+        }
 
-        if (l->head == NULL) {
-            l->head = t;
+        ctx->tags[pc - prog->start] = ctx->tag;
 
-        } else {
-            *l->next = t;
+        switch (pc->opcode) {
+        case SRE_OPCODE_SPLIT:
+            if (pc == prog->start) {
+                dd("setting seen start state");
+                ctx->seen_start_state = 1;
+
+                if (prog->multi) {
+                    rc = sre_vm_pike_add_start_threads(ctx, l, cap, pos,
+                                                       pcap);
+                    if (rc != SRE_OK) {
+                        goto failed;
+                    }
+
+                    continue;
+                }
+            }
+
+            goto follow;
+
+        case SRE_OPCODE_SAVE:
+            cap = sre_capture_update(ctx->pool, cap, pc->v.group,
+                                     ctx->processed_bytes + pos,
+                                     &ctx->free_captures);
+            if (cap == NULL) {
+                return SRE_ERROR;
+            }
+
+            goto follow;
+
+        case SRE_OPCODE_JMP:
+            goto follow;
+
+        case SRE_OPCODE_ASSERT:
+            switch (pc->v.assertion) {
+            case SRE_REGEX_ASSERT_BIG_A:
+            case SRE_REGEX_ASSERT_CARET:
+                /* the entries follow only when it holds */
+                goto follow;
+
+            case SRE_REGEX_ASSERT_SMALL_B:
+            case SRE_REGEX_ASSERT_BIG_B:
+                seen_word = sre_isword(ctx->buffer[pos - 1]);
+                break;
+
+            default:
+                /* postpone look-ahead assertions */
+                seen_word = 0;
+                break;
+            }
+
+            break;
+
+        case SRE_OPCODE_MATCH:
+            ctx->last_matched_pos = sre_capture_get(cap, 1);
+            cap->regex_id = pc->v.regex_id;
+
+            if (pcap) {
+                *pcap = cap;
+                rc = SRE_DONE;
+                goto failed;
+            }
+
+            /* fall through */
+
+        default:
+            seen_word = 0;
+            break;
         }
 
-        l->count++;
-        l->next = &t->next;
+        sre_vm_pike_append_thread(ctx, l, pc, 0, cap, seen_word);
+        continue;
 
-        dd("added thread: pc %d, bytecode %d", (int) (pc - ctx->program->start),
-           pc->opcode);
+follow:
 
-        break;
+        if (e->children) {
+            cap->ref += e->children - 1;
+            caps[e->depth + 1] = cap;
+            continue;
+        }
+
+dead:
+
+        /* no thread is left to hold its reference */
+        sre_capture_decr_ref(ctx, cap);
     }
 
     return SRE_OK;
+
+failed:
+
+    if (rc == SRE_DONE) {
+        /* the entries not reached yet give back their references */
+
+        for (a = root; a < e; a = child) {
+            for (child = a + 1; child + child->skip <= e; /* void */) {
+                child += child->skip;
+            }
+
+            for (next = child + child->skip; next < a + a->skip;
+                 next += next->skip)
+            {
+                sre_capture_decr_ref(ctx, caps[a->depth + 1]);
+            }
+        }
+    }
+
+    return rc;
+}
+
+
+static void
+sre_vm_pike_append_thread(sre_vm_pike_ctx_t *ctx, sre_vm_pike_thread_list_t *l,
+    sre_instruction_t *pc, unsigned counter, sre_capture_t *capture,
+    unsigned seen_word)
+{
+    sre_vm_pike_thread_t        *t;
+
+    t = &l->head[l->count++];
+
+    t->pc = pc;
+    t->capture = capture;
+    t->seen_word = seen_word;
+    t->counter = counter;
+
+    dd("added thread: pc %d, bytecode %d", (int) (pc - ctx->program->start),
+       pc->opcode);
+}
+
+
+/*
+ * Replaces the tree of alternations of the regexes in a multi-regex
+ * program: only the regexes whose literal prefix matches at "pos" (or
+ * may match with the next data chunk) and the ones without a prefix are
+ * started, still in the order of the regexes, before the ".*?" thread.
+ */
+static sre_int_t
+sre_vm_pike_add_start_threads(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *l, sre_capture_t *capture, sre_int_t pos,
+    sre_capture_t **pcap)
+{
+    sre_int_t                rc, n;
+    sre_uint_t               i, j, id, *hits;
+    sre_program_t           *prog;
+    sre_program_multi_t     *multi;
+
+    prog = ctx->program;
+    multi = prog->multi;
+    hits = ctx->prefix_hits;
+
+    if (ctx->no_prefix_hits) {
+        n = 0;
+
+    } else {
+        n = sre_multi_literal_match(&multi->prefixes, ctx->buffer + pos,
+                                    ctx->last, hits);
+        if (n == SRE_AGAIN) {
+            hits = multi->gated;
+            n = (sre_int_t) multi->ngated;
+        }
+    }
+
+    dd("%d prefix hits at pos %d", (int) n, (int) pos);
+
+    for (i = 0, j = 0; i < multi->nalways || j < (sre_uint_t) n; /* void */) {
+        if (j == (sre_uint_t) n
+            || (i < multi->nalways && multi->always[i] < hits[j]))
+        {
+            id = multi->always[i++];
+
+        } else {
+            id = hits[j++];
+        }
+
+        capture->ref++;
+
+        rc = sre_vm_pike_add_thread(ctx, l, sre_program_regex_start(prog, id),
+                                    0, capture, pos, pcap);
+        if (rc != SRE_OK) {
+            sre_capture_decr_ref(ctx, capture);
+            return rc;
+        }
+    }
+
+    return sre_vm_pike_add_thread(ctx, l, sre_program_y(prog, prog->start), 0,
+                                  capture, pos, pcap);
 }
 
 
@@ -975,7 +1512,12 @@ sre_vm_pike_prepare_matched_captures(sre_vm_pike_ctx_t *ctx,
     dd("matched captures: ofs: %d, len: %d", (int) ofs,
        (int) (len / sizeof(sre_int_t)));
 
-    memcpy(ovector, &matched->vector[ofs], len);
+    if (len > ctx->ovecsize) {
+        /* the caller does not want all the captures */
+        len = ctx->ovecsize;
+    }
+
+    sre_capture_copy(ovector, matched, ofs, len);
 
     if (!complete) {
         return SRE_OK;
@@ -989,92 +1531,16 @@ sre_vm_pike_prepare_matched_captures(sre_vm_pike_ctx_t *ctx,
 }
 
 
-static sre_char *
-sre_vm_pike_find_first_byte(sre_char *pos, sre_char *last,
-    int leading_byte, sre_chain_t *leading_bytes)
-{
-#if 1
-    int                  in;
-    sre_uint_t           i;
-    sre_chain_t         *cl;
-    sre_instruction_t   *pc;
-    sre_vm_range_t      *range;
-
-    /* optimize for single CHAR bc */
-    if (leading_byte != -1) {
-        pos = memchr(pos, leading_byte, last - pos);
-        if (pos == NULL) {
-            return last;
-        }
-
-        return pos;
-    }
-
-    for ( ; pos != last; pos++) {
-        for (cl = leading_bytes; cl; cl = cl->next) {
-            pc = cl->data;
-            switch (pc->opcode) {
-            case SRE_OPCODE_CHAR:
-                if (*pos == pc->v.ch) {
-                    return pos;
-                }
-
-                break;
-
-            case SRE_OPCODE_IN:
-                for (i = 0; i < pc->v.ranges->count; i++) {
-                    range = &pc->v.ranges->head[i];
-
-                    if (*pos >= range->from && *pos <= range->to) {
-                        return pos;
-                    }
-                }
-
-                break;
-
-            case SRE_OPCODE_NOTIN:
-                in = 0;
-                for (i = 0; i < pc->v.ranges->count; i++) {
-                    range = &pc->v.ranges->head[i];
-
-                    if (*pos >= range->from && *pos <= range->to) {
-                        in = 1;
-                        break;
-                    }
-                }
-
-                if (in == 0) {
-                    return pos;
-                }
-
-                break;
-
-            default:
-                sre_assert(pc->opcode);
-                break;
-            }
-        }
-    }
-#endif
-
-    return pos;
-}
-
-
 static void
 sre_vm_pike_clear_thread_list(sre_vm_pike_ctx_t *ctx,
     sre_vm_pike_thread_list_t *list)
 {
-    sre_vm_pike_thread_t      *t;
-
-    while (list->head) {
-        t = list->head;
-        list->head = t->next;
-        list->count--;
+    sre_uint_t                 i;
 
-        sre_capture_decr_ref(ctx, t->capture);
-        sre_vm_pike_free_thread(ctx, t);
+    for (i = 0; i < list->count; i++) {
+        sre_capture_decr_ref(ctx, list->head[i].capture);
     }
 
-    sre_assert(list->count == 0);
+    list->head = list->threads;
+    list->count = 0;
 }
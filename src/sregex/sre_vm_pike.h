@@ -0,0 +1,141 @@
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Copyright 2007-2009 Russ Cox.  All Rights Reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_PIKE_H_INCLUDED_
+#define _SRE_VM_PIKE_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_capture.h>
+#include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_inner.h>
+#include <sregex/sre_vm_onepass.h>
+#include <sregex/sre_vm_tdfa.h>
+#include <sregex/sre_vm_backtrack.h>
+#include <sregex/sre_vm_bounds.h>
+
+
+enum {
+    SRE_VM_PIKE_SEEN_WORD = 1
+};
+
+
+typedef struct sre_vm_pike_thread_s  sre_vm_pike_thread_t;
+
+struct sre_vm_pike_thread_s {
+    sre_instruction_t       *pc;
+    sre_capture_t           *capture;
+    unsigned                 seen_word; /* :1 */
+    unsigned                 counter;   /* the iterations of the current
+                                           counter loop */
+};
+
+
+/*
+ * A thread list holds at most one thread per slot (see sre_program_slot),
+ * so it is a dense array of prog->nslots threads starting at "threads".
+ * The threads left to run start at "head", and the ones added when a
+ * look-ahead assertion holds are put right before it, in the room for
+ * another prog->nslots threads before "threads" (the threads left are
+ * moved to the end of the array when the threads run leave too little).
+ */
+typedef struct {
+    sre_uint_t                count;    /* the threads from head on */
+    sre_vm_pike_thread_t     *head;
+    sre_vm_pike_thread_t     *threads;
+} sre_vm_pike_thread_list_t;
+
+
+/* a branch of a SPLIT or COUNT left for sre_vm_pike_add_thread to follow */
+typedef struct {
+    sre_instruction_t       *pc;
+    sre_capture_t           *capture;
+    unsigned                 counter;
+} sre_vm_pike_branch_t;
+
+
+struct sre_vm_pike_ctx_s {
+    unsigned                 tag;
+    unsigned                *tags;  /* per-slot tags, see sre_program_slot */
+    unsigned                *current_tags;  /* the tags of the threads
+                                               added to the current ones
+                                               while a step adds the next
+                                               ones with "tags" */
+    unsigned                 matched_tag;   /* of the last step finding a
+                                               match, which may cut its
+                                               closures short */
+    sre_int_t                processed_bytes;
+    sre_char                *buffer;
+    sre_char                *last;
+    sre_pool_t              *pool;
+    sre_program_t           *program;
+    sre_capture_t           *matched;
+    sre_capture_free_t       free_captures;
+
+    sre_int_t               *pending_ovector;
+    sre_int_t               *ovector;
+    size_t                   ovecsize;
+
+    sre_vm_pike_thread_list_t       *current_threads;
+    sre_vm_pike_thread_list_t       *next_threads;
+    sre_vm_pike_thread_list_t       *held_threads;  /* added when a
+                                                       look-ahead assertion
+                                                       holds */
+
+    sre_vm_pike_branch_t    *branches;  /* the work stack of
+                                           sre_vm_pike_add_thread, with
+                                           room for prog->nslots ones */
+    sre_uint_t               nbranches;
+
+    sre_int_t                last_matched_pos; /* the pos for the last
+                                                  (partial) match */
+
+    sre_instruction_t      **initial_states;
+    sre_uint_t               initial_states_count;
+
+    sre_vm_inner_ctx_t      *inner;
+
+    sre_vm_onepass_ctx_t    *onepass;   /* used instead of the threads if
+                                           the program is one-pass */
+
+    sre_vm_tdfa_ctx_t       *tdfa;      /* or else if it has a tagged
+                                           DFA */
+
+    sre_vm_backtrack_ctx_t  *backtrack; /* created when first used */
+
+    sre_vm_bounds_ctx_t     *bounds;    /* the same */
+
+    sre_uint_t              *prefix_hits;   /* the regexes whose literal
+                                               prefix matches */
+
+    uint8_t                  seen_start_state;  /* :1 */
+
+    unsigned                 first_buf:1;
+    unsigned                 eof:1;
+    unsigned                 empty_capture:1;
+    unsigned                 seen_newline:1;
+    unsigned                 seen_word:1;
+    unsigned                 no_prefix_hits:1;
+} ;
+
+
+typedef sre_int_t (*sre_vm_pike_step_pt)(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *clist, sre_vm_pike_thread_list_t *nlist,
+    sre_char *sp, sre_char *last);
+
+
+SRE_NOAPI sre_int_t sre_vm_pike_exec_helper(sre_vm_pike_ctx_t *ctx,
+    sre_char *input, size_t size, unsigned eof, sre_int_t **pending_matched,
+    sre_vm_pike_step_pt step);
+
+SRE_NOAPI sre_int_t sre_vm_pike_step_thread(sre_vm_pike_ctx_t *ctx,
+    sre_vm_pike_thread_list_t *clist, sre_vm_pike_thread_list_t *nlist,
+    sre_vm_pike_thread_t *t, sre_char *sp, sre_char *last);
+
+
+#endif /* _SRE_VM_PIKE_H_INCLUDED_ */
@@ -0,0 +1,208 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+/* keep a private copy of the DynASM runtime used by the Thompson VM JIT */
+#define DASM_FDEF  static
+
+#include <dynasm/dasm_proto.h>
+#include <dynasm/dasm_x86.h>
+
+#include <sregex/sre_vm_pike.h>
+
+#if (SRE_TARGET == SRE_ARCH_X64)
+#include <sregex/sre_vm_pike_x64.h>
+#endif
+
+#include <sregex/sre_capture.h>
+#include <sregex/sre_vm_bytecode.h>
+#if (SRE_TARGET != SRE_ARCH_UNKNOWN)
+#include <sys/mman.h>
+#include <stdio.h>
+#endif
+
+
+/*
+ * The memory layout of a JIT compiled program is
+ *
+ *     | sre_vm_pike_code_t | thread handler table | machine code |
+ *
+ * The thread handler table is indexed by the byte offset of a thread's pc
+ * relative to prog->start, so only every
+ * sizeof(sre_instruction_t) / sizeof(void *) slot is used.
+ */
+struct sre_vm_pike_code_s {
+    size_t          size;
+
+    sre_vm_pike_exec_pt     handler;
+};
+
+
+SRE_API sre_int_t
+sre_vm_pike_jit_compile(sre_pool_t *pool, sre_program_t *prog,
+    sre_vm_pike_code_t **pcode)
+{
+#if (SRE_TARGET != SRE_ARCH_X64)
+    return SRE_DECLINED;
+#else
+    int              status;
+    size_t           codesz, tblsz;
+    size_t           size;
+    sre_uint_t       i;
+    int32_t          ofs;
+    unsigned char   *mem;
+    dasm_State      *dasm;
+    void           **glob, **handlers;
+    unsigned         nglobs = SRE_VM_PIKE_GLOB__MAX;
+
+    sre_vm_pike_code_t      *code;
+
+    if (prog->slots) {
+        /* the threads of counter loops are left to the interpreter */
+        return SRE_DECLINED;
+    }
+
+    glob = sre_pcalloc(pool, nglobs * sizeof(void *));
+    if (glob == NULL) {
+        return SRE_ERROR;
+    }
+
+    dasm_init(&dasm, 1);
+    dasm_setupglobal(&dasm, glob, nglobs);
+    dasm_setup(&dasm, sre_vm_pike_jit_actions);
+
+    dd("thread size: %d", (int) sizeof(sre_vm_pike_thread_t));
+
+    if (sre_vm_pike_jit_do_compile(&dasm, pool, prog) != SRE_OK) {
+        dasm_free(&dasm);
+        return SRE_ERROR;
+    }
+
+    status = dasm_link(&dasm, &codesz);
+    if (status != DASM_S_OK) {
+        dasm_free(&dasm);
+        return SRE_ERROR;
+    }
+
+    tblsz = prog->len * sizeof(sre_instruction_t);
+    size = sizeof(sre_vm_pike_code_t) + tblsz + codesz;
+
+    dd("size: %d, tblsz: %d, codesz: %d", (int) size, (int) tblsz,
+       (int) codesz);
+
+    mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        dasm_free(&dasm);
+        return SRE_ERROR;
+    }
+
+    code = (sre_vm_pike_code_t *) mem;
+
+    code->size = size;
+    code->handler = (sre_vm_pike_exec_pt)
+        (mem + sizeof(sre_vm_pike_code_t) + tblsz);
+
+    *pcode = code;
+
+    dasm_encode(&dasm, code->handler);
+
+    handlers = (void **) (mem + sizeof(sre_vm_pike_code_t));
+
+    for (i = 0; i < prog->len; i++) {
+        ofs = dasm_getpclabel(&dasm, i);
+
+        handlers[i * (sizeof(sre_instruction_t) / sizeof(void *))] =
+            ofs >= 0 ? (unsigned char *) code->handler + ofs
+                     : glob[SRE_VM_PIKE_GLOB_slow_thread];
+    }
+
+#if (DDEBUG)
+    {
+        int              len;
+        FILE            *f;
+        const char      *gl;
+
+        /*
+         * write generated machine code to a temporary file.
+         * wiew with objdump or ndisasm
+         */
+        f = fopen("/tmp/pike-jit.bin", "wb");
+        fwrite(code->handler, codesz, 1, f);
+        fclose(f);
+
+        f = fopen("/tmp/pike-jit.txt", "w");
+        fprintf(f, "code section: start=%p len=%lu\n", code->handler,
+                (unsigned long) codesz);
+
+        fprintf(f, "global names:\n");
+
+        for (i = 0; i < nglobs; i++) {
+            gl = sre_vm_pike_jit_global_names[i];
+            len = (int) strlen(gl);
+            if (!glob[i]) {
+                continue;
+            }
+            /* Skip the _Z symbols. */
+            if (!(len >= 2 && gl[len-2] == '_' && gl[len-1] == 'Z')) {
+                fprintf(f, "  %s => %p\n", gl, glob[i]);
+            }
+        }
+
+        fprintf(f, "\npc labels:\n");
+        for (i = 0; i < dasm->pcsize; i++) {
+            ofs = dasm_getpclabel(&dasm, i);
+            if (ofs >= 0) {
+                fprintf(f, "  %d => %ld\n", (int) i, (long) ofs);
+            }
+        }
+
+        fclose(f);
+    }
+#endif
+
+    dasm_free(&dasm);
+
+    if (mprotect(mem, size, PROT_EXEC | PROT_READ) != 0) {
+        (void) munmap(code, code->size);
+        return SRE_ERROR;
+    }
+
+    dd("code start addr: %p", code->handler);
+
+    return SRE_OK;
+#endif /* SRE_TARGET == SRE_ARCH_X64 */
+}
+
+
+SRE_API sre_int_t
+sre_vm_pike_jit_free(sre_vm_pike_code_t *code)
+{
+#if (SRE_TARGET != SRE_ARCH_UNKNOWN)
+    if (munmap(code, code->size) != 0) {
+        return SRE_ERROR;
+    }
+#endif
+    return SRE_OK;
+}
+
+
+SRE_API sre_vm_pike_exec_pt
+sre_vm_pike_jit_get_handler(sre_vm_pike_code_t *code)
+{
+    if (code == NULL) {
+        return NULL;
+    }
+
+    return code->handler;
+}
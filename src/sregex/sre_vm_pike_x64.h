@@ -0,0 +1,823 @@
+/*
+** This file has been pre-processed with DynASM.
+** http://luajit.org/dynasm.html
+** DynASM version 1.3.0, DynASM x64 version 1.3.0
+** DO NOT EDIT! The original file is in "src/sregex/sre_vm_pike_x64.dasc".
+*/
+
+#if DASM_VERSION != 10300
+#error "Version mismatch between DynASM and included encoding engine"
+#endif
+
+# 1 "src/sregex/sre_vm_pike_x64.dasc"
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+//|.arch x64
+//|.actionlist sre_vm_pike_jit_actions
+static const unsigned char sre_vm_pike_jit_actions[1000] = {
+  249,72,139,170,233,252,247,195,0,0,1,0,15,133,244,10,255,128,252,251,235,
+  15,133,244,10,255,128,252,251,235,15,132,244,248,255,128,252,251,235,15,130,
+  244,249,255,252,233,244,248,255,128,252,251,235,15,134,244,248,255,248,3,
+  255,252,233,244,10,248,2,255,128,252,251,235,15,132,244,10,255,128,252,251,
+  235,15,130,244,248,255,252,233,244,10,255,128,252,251,235,15,134,244,10,255,
+  15,182,203,72,184,237,237,15,163,8,15,131,244,10,255,232,245,72,133,192,15,
+  133,244,11,252,233,244,12,255,249,73,139,132,253,36,233,68,57,168,233,255,
+  15,133,244,247,73,139,132,253,36,233,68,57,168,233,15,132,244,13,255,65,198,
+  132,253,36,233,1,255,252,233,245,248,1,255,68,137,168,233,255,252,233,244,
+  13,255,252,233,245,255,131,133,233,1,85,232,245,89,72,133,192,15,133,244,
+  248,72,137,205,252,233,245,248,2,80,131,169,233,1,15,133,244,255,72,137,207,
+  232,244,14,248,9,88,195,255,131,189,233,1,15,133,244,247,72,139,133,233,72,
+  133,192,15,132,244,247,76,137,176,233,252,233,245,248,1,73,139,188,253,36,
+  233,72,137,252,238,72,199,194,237,76,137,252,241,77,141,132,253,36,233,72,
+  131,252,236,8,72,184,237,237,252,255,208,72,131,196,8,72,133,192,15,132,244,
+  15,72,137,197,252,233,245,255,128,252,251,235,15,133,244,13,252,233,245,255,
+  15,182,207,72,186,237,237,252,233,244,16,255,49,201,72,186,237,237,252,233,
+  244,16,255,72,137,232,248,1,72,139,136,233,72,133,201,15,133,244,249,72,131,
+  184,233,1,15,132,244,248,72,139,128,233,252,233,244,1,248,2,72,139,128,233,
+  252,233,244,250,248,3,72,139,129,233,248,4,73,137,132,253,36,233,72,199,133,
+  233,237,255,72,199,192,237,195,255,248,17,76,141,13,244,18,72,184,237,237,
+  252,255,224,248,18,83,85,65,84,65,85,65,86,65,87,72,131,252,236,40,73,137,
+  252,252,73,137,215,72,137,180,253,36,233,72,137,140,253,36,233,76,137,132,
+  253,36,233,69,139,172,253,36,233,73,137,206,77,43,180,253,36,233,77,3,180,
+  253,36,233,73,131,198,1,76,57,193,15,133,244,247,187,0,0,1,0,252,233,244,
+  19,248,1,15,182,25,128,252,251,235,15,130,244,19,255,128,252,251,235,15,134,
+  244,248,128,252,251,235,15,130,244,19,128,252,251,235,15,134,244,248,128,
+  252,251,235,15,132,244,248,128,252,251,235,15,130,244,19,128,252,251,235,
+  15,135,244,19,248,2,183,1,248,19,255,72,139,132,253,36,233,72,131,184,233,
+  0,15,132,244,20,72,139,144,233,72,141,138,233,72,137,136,233,72,131,168,233,
+  1,72,137,20,36,72,139,130,233,72,185,237,237,72,41,200,72,141,13,244,17,72,
+  129,252,233,239,252,255,36,1,248,21,76,137,231,72,139,180,253,36,233,76,137,
+  252,250,72,139,12,36,76,139,132,253,36,233,76,139,140,253,36,233,72,184,237,
+  237,255,252,255,208,72,133,192,15,132,244,19,72,129,252,248,239,15,132,244,
+  20,252,233,244,22,248,10,131,173,233,1,15,133,244,255,72,137,252,239,232,
+  244,14,248,9,248,12,252,233,244,19,248,11,72,129,252,248,239,15,133,244,22,
+  255,73,139,132,253,36,233,72,133,192,15,132,244,247,131,168,233,1,15,133,
+  244,255,72,137,199,232,244,14,248,9,248,1,73,137,172,253,36,233,248,2,72,
+  139,132,253,36,233,72,131,184,233,0,15,132,244,20,72,139,144,233,72,141,138,
+  233,72,137,136,233,72,131,168,233,1,255,72,139,138,233,131,169,233,1,15,133,
+  244,255,72,137,207,232,244,14,248,9,252,233,244,2,248,20,49,192,252,233,244,
+  249,248,22,72,199,192,237,248,3,72,131,196,40,65,95,65,94,65,93,65,92,93,
+  91,195,248,16,73,139,135,233,72,105,192,239,73,3,135,233,72,137,144,233,255,
+  72,137,168,233,137,136,233,199,128,233,0,0,0,0,73,131,135,233,1,248,23,49,
+  192,195,248,13,131,173,233,1,15,133,244,255,72,137,252,239,232,244,14,248,
+  9,49,192,195,248,15,72,199,192,237,195,248,14,72,131,191,233,0,15,132,244,
+  247,73,139,132,253,36,233,72,137,135,233,255,73,137,188,253,36,233,195,248,
+  1,73,139,132,253,36,233,72,137,135,233,73,137,188,253,36,233,72,139,191,233,
+  131,175,233,1,15,132,244,14,195,255
+};
+
+# 11 "src/sregex/sre_vm_pike_x64.dasc"
+
+//|.globals SRE_VM_PIKE_GLOB_
+enum {
+  SRE_VM_PIKE_GLOB_thread_failed,
+  SRE_VM_PIKE_GLOB_thread_added,
+  SRE_VM_PIKE_GLOB_thread_done,
+  SRE_VM_PIKE_GLOB_add_dead,
+  SRE_VM_PIKE_GLOB_free_capture,
+  SRE_VM_PIKE_GLOB_add_error,
+  SRE_VM_PIKE_GLOB_add_thread,
+  SRE_VM_PIKE_GLOB_exec,
+  SRE_VM_PIKE_GLOB_step,
+  SRE_VM_PIKE_GLOB_next_thread,
+  SRE_VM_PIKE_GLOB_step_done,
+  SRE_VM_PIKE_GLOB_slow_thread,
+  SRE_VM_PIKE_GLOB_step_error,
+  SRE_VM_PIKE_GLOB_add_ok,
+  SRE_VM_PIKE_GLOB__MAX
+};
+# 13 "src/sregex/sre_vm_pike_x64.dasc"
+
+#if (DDEBUG)
+//|.globalnames sre_vm_pike_jit_global_names
+static const char *const sre_vm_pike_jit_global_names[] = {
+  "thread_failed",
+  "thread_added",
+  "thread_done",
+  "add_dead",
+  "free_capture",
+  "add_error",
+  "add_thread",
+  "exec",
+  "step",
+  "next_thread",
+  "step_done",
+  "slow_thread",
+  "step_error",
+  "add_ok",
+  (const char *)0
+};
+# 16 "src/sregex/sre_vm_pike_x64.dasc"
+#endif
+
+/* current input byte (CHR_C), whether it is a word char (CHR_W), and
+ * whether we are at the end of the input (CHR_EOI) */
+//|.define CHR,     ebx  // callee-save
+//|.define CHR_C,   bl
+//|.define CHR_W,   bh
+//|.define CHR_EOI, 0x10000
+
+/* the tag of the current step */
+//|.define TAG,   r13d  // callee-save
+
+/* the absolute input position right after the current byte */
+//|.define POS,   r14   // callee-save
+
+//|.type CTX, sre_vm_pike_ctx_t,          r12  // callee-save
+#define Dt1(_V) (int)(ptrdiff_t)&(((sre_vm_pike_ctx_t *)0)_V)
+# 32 "src/sregex/sre_vm_pike_x64.dasc"
+//|.type NL,  sre_vm_pike_thread_list_t,  r15  // callee-save
+#define Dt2(_V) (int)(ptrdiff_t)&(((sre_vm_pike_thread_list_t *)0)_V)
+# 33 "src/sregex/sre_vm_pike_x64.dasc"
+//|.type CAP, sre_capture_t,              rbp  // callee-save
+#define Dt3(_V) (int)(ptrdiff_t)&(((sre_capture_t *)0)_V)
+# 34 "src/sregex/sre_vm_pike_x64.dasc"
+//|.type T,   sre_vm_pike_thread_t,       rdx
+#define Dt4(_V) (int)(ptrdiff_t)&(((sre_vm_pike_thread_t *)0)_V)
+# 35 "src/sregex/sre_vm_pike_x64.dasc"
+//|.type CL,  sre_vm_pike_thread_list_t
+#define Dt5(_V) (int)(ptrdiff_t)&(((sre_vm_pike_thread_list_t *)0)_V)
+# 36 "src/sregex/sre_vm_pike_x64.dasc"
+
+/* slots in the stack frame of the step function */
+//|.define SAVED_T,     aword [rsp]
+//|.define SAVED_CL,    aword [rsp + 8]
+//|.define SAVED_SP,    aword [rsp + 16]
+//|.define SAVED_LAST,  aword [rsp + 24]
+
+
+/* clobbers rax and rdi */
+//|.macro decrCaptureRef, cap
+//|  sub dword CAP:cap->ref, 1
+//|  jnz >9
+//|  mov rdi, cap
+//|  call ->free_capture
+//|9:
+//|.endmacro
+
+
+/* leaves the address of ctx->tags in rax */
+//|.macro checkTag, bc
+//|  mov rax, CTX->tags
+//|  cmp dword [rax + ((bc) - start) * sizeof(unsigned)], TAG
+//|.endmacro
+
+
+/* This affects the "|" DynASM lines. */
+#define Dst  dasm
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_regex.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_capture.h>
+#include <sregex/sre_vm_pike.h>
+
+
+typedef struct {
+    sre_pool_t      *pool;
+    sre_program_t   *program;
+    dasm_State     **dasm;
+} sre_vm_pike_jit_t;
+
+
+static sre_int_t sre_vm_pike_jit_prologue(sre_vm_pike_jit_t *jit);
+static sre_int_t sre_vm_pike_jit_compile_thread(sre_vm_pike_jit_t *jit,
+    sre_instruction_t *pc);
+static sre_int_t sre_vm_pike_jit_compile_add_thread(sre_vm_pike_jit_t *jit,
+    sre_instruction_t *pc);
+
+
+/*
+ * The pc labels [0, len) are the thread handlers of the consuming
+ * bytecodes (CHAR, ANY, IN and NOTIN), which run a thread on the current
+ * input byte. The pc labels [len, 2 * len) are the compiled forms of
+ * sre_vm_pike_add_thread() for every bytecode, specialized for adding
+ * the successor threads to the next thread list.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_pike_jit_do_compile(dasm_State **dasm, sre_pool_t *pool,
+    sre_program_t *prog)
+{
+    sre_uint_t              i;
+    sre_instruction_t      *pc;
+    sre_vm_pike_jit_t       jit;
+
+    jit.pool = pool;
+    jit.program = prog;
+    jit.dasm = dasm;
+
+    dd("prog len: %d", (int) prog->len);
+
+    dasm_growpc(dasm, 2 * prog->len);
+
+    if (sre_vm_pike_jit_prologue(&jit) != SRE_OK) {
+        return SRE_ERROR;
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        pc = prog->start + i;
+
+        if (prog->multi && i == prog->start->y) {
+            /*
+             * the ".*?" thread is left to sre_vm_pike_step_thread() for
+             * sre_vm_pike_add_thread() to start only the regexes whose
+             * literal prefix is seen
+             */
+            continue;
+        }
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_CHAR:
+        case SRE_OPCODE_ANY:
+        case SRE_OPCODE_IN:
+        case SRE_OPCODE_NOTIN:
+        case SRE_OPCODE_BITMAP:
+            if (sre_vm_pike_jit_compile_thread(&jit, pc) != SRE_OK) {
+                return SRE_ERROR;
+            }
+
+            break;
+
+        default:
+            /* left to sre_vm_pike_step_thread() */
+            break;
+        }
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        if (sre_vm_pike_jit_compile_add_thread(&jit, prog->start + i)
+            != SRE_OK)
+        {
+            return SRE_ERROR;
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_pike_jit_compile_thread(sre_vm_pike_jit_t *jit, sre_instruction_t *pc)
+{
+    sre_char             c;
+    sre_uint_t           i, len;
+    sre_int_t            ofs;
+    dasm_State         **dasm;
+    sre_vm_range_t      *range;
+
+    dasm = jit->dasm;
+    len = jit->program->len;
+    ofs = pc - jit->program->start;
+
+    dd("compiling thread handler at pc %d", (int) ofs);
+
+    //|=>(ofs):
+    //|  mov CAP, T->capture
+    //|  test CHR, CHR_EOI
+    //|  jnz ->thread_failed
+    dasm_put(Dst, 0, (ofs), Dt4(->capture));
+# 174 "src/sregex/sre_vm_pike_x64.dasc"
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_CHAR:
+        c = pc->v.ch;
+
+        //|  cmp CHR_C, byte (c)
+        //|  jne ->thread_failed
+        dasm_put(Dst, 17, (c));
+# 181 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    case SRE_OPCODE_IN:
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            if (range->from == range->to) {
+                //|  cmp CHR_C, byte (range->from)
+                //|  je >2
+                dasm_put(Dst, 26, (range->from));
+# 191 "src/sregex/sre_vm_pike_x64.dasc"
+
+            } else {
+                if (range->from != 0x00) {
+                    //|  cmp CHR_C, byte (range->from)
+                    //|  jb >3
+                    dasm_put(Dst, 35, (range->from));
+# 196 "src/sregex/sre_vm_pike_x64.dasc"
+                }
+
+                if (range->to == 0xff) {
+                    //|  jmp >2
+                    dasm_put(Dst, 44);
+# 200 "src/sregex/sre_vm_pike_x64.dasc"
+
+                } else {
+                    //|  cmp CHR_C, byte (range->to)
+                    //|  jbe >2
+                    dasm_put(Dst, 49, (range->to));
+# 204 "src/sregex/sre_vm_pike_x64.dasc"
+                }
+
+                //|3:
+                dasm_put(Dst, 58);
+# 207 "src/sregex/sre_vm_pike_x64.dasc"
+            }
+        }
+
+        //|  jmp ->thread_failed
+        //|2:
+        dasm_put(Dst, 61);
+# 212 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    case SRE_OPCODE_NOTIN:
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            if (range->from == range->to) {
+                //|  cmp CHR_C, byte (range->from)
+                //|  je ->thread_failed
+                dasm_put(Dst, 68, (range->from));
+# 222 "src/sregex/sre_vm_pike_x64.dasc"
+
+            } else {
+                if (range->from != 0x00) {
+                    //|  cmp CHR_C, byte (range->from)
+                    //|  jb >2
+                    dasm_put(Dst, 77, (range->from));
+# 227 "src/sregex/sre_vm_pike_x64.dasc"
+                }
+
+                if (range->to == 0xff) {
+                    //|  jmp ->thread_failed
+                    dasm_put(Dst, 86);
+# 231 "src/sregex/sre_vm_pike_x64.dasc"
+
+                } else {
+                    //|  cmp CHR_C, byte (range->to)
+                    //|  jbe ->thread_failed
+                    dasm_put(Dst, 91, (range->to));
+# 235 "src/sregex/sre_vm_pike_x64.dasc"
+                }
+
+                if (range->from != 0x00) {
+                    //|2:
+                    dasm_put(Dst, 65);
+# 239 "src/sregex/sre_vm_pike_x64.dasc"
+                }
+            }
+        }
+
+        break;
+
+    case SRE_OPCODE_BITMAP:
+        //|  movzx ecx, CHR_C
+        //|  mov64 rax, ((uintptr_t) sre_program_bitmap(jit->program, pc))
+        //|  bt dword [rax], ecx
+        //|  jnc ->thread_failed
+        dasm_put(Dst, 100, (unsigned int)(((uintptr_t) sre_program_bitmap(jit->program, pc))), (unsigned int)((((uintptr_t) sre_program_bitmap(jit->program, pc)))>>32));
+# 250 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    default:
+        /* SRE_OPCODE_ANY */
+        break;
+    }
+
+    if (ofs + 1 >= (sre_int_t) len) {
+        /* impossible for the programs generated by sre_regex_compile() */
+        //|  jmp ->thread_failed
+        dasm_put(Dst, 86);
+# 261 "src/sregex/sre_vm_pike_x64.dasc"
+        return SRE_OK;
+    }
+
+    //|  call =>(len + ofs + 1)
+    //|  test rax, rax
+    //|  jnz ->thread_added
+    //|  jmp ->thread_done
+    dasm_put(Dst, 115, (len + ofs + 1));
+# 268 "src/sregex/sre_vm_pike_x64.dasc"
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_pike_jit_compile_add_thread(sre_vm_pike_jit_t *jit,
+    sre_instruction_t *pc)
+{
+    sre_uint_t           len;
+    sre_int_t            ofs;
+    dasm_State         **dasm;
+    sre_instruction_t   *start;
+
+    dasm = jit->dasm;
+    start = jit->program->start;
+    len = jit->program->len;
+    ofs = pc - start;
+
+    dd("compiling add thread at pc %d", (int) ofs);
+
+    //|=>(len + ofs):
+    //|  checkTag pc
+    dasm_put(Dst, 129, (len + ofs), Dt1(->tags), ((pc) - start) * sizeof(unsigned));
+# 291 "src/sregex/sre_vm_pike_x64.dasc"
+
+    if (pc->opcode == SRE_OPCODE_SPLIT) {
+        //|  jne >1
+        //|  checkTag (start + pc->y)
+        //|  je ->add_dead
+        dasm_put(Dst, 141, Dt1(->tags), (((start + pc->y)) - start) * sizeof(unsigned));
+# 296 "src/sregex/sre_vm_pike_x64.dasc"
+
+        if (pc == start) {
+            //|  mov byte CTX->seen_start_state, 1
+            dasm_put(Dst, 160, Dt1(->seen_start_state));
+# 299 "src/sregex/sre_vm_pike_x64.dasc"
+        }
+
+        //|  jmp =>(len + pc->y)
+        //|1:
+        dasm_put(Dst, 168, (len + pc->y));
+# 303 "src/sregex/sre_vm_pike_x64.dasc"
+
+    } else {
+        //|  je ->add_dead
+        dasm_put(Dst, 155);
+# 306 "src/sregex/sre_vm_pike_x64.dasc"
+    }
+
+    //|  mov dword [rax + ofs * sizeof(unsigned)], TAG
+    dasm_put(Dst, 174, ofs * sizeof(unsigned));
+# 309 "src/sregex/sre_vm_pike_x64.dasc"
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_JMP:
+        if (pc->x >= len) {
+            /* the jump right after the last regex in a multi-regex program */
+            //|  jmp ->add_dead
+            dasm_put(Dst, 179);
+# 315 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+        }
+
+        //|  jmp =>(len + pc->x)
+        dasm_put(Dst, 184, (len + pc->x));
+# 319 "src/sregex/sre_vm_pike_x64.dasc"
+        break;
+
+    case SRE_OPCODE_SPLIT:
+        if (pc == start) {
+            //|  mov byte CTX->seen_start_state, 1
+            dasm_put(Dst, 160, Dt1(->seen_start_state));
+# 324 "src/sregex/sre_vm_pike_x64.dasc"
+        }
+
+        //|  add dword CAP->ref, 1
+        //|  push CAP
+        //|  call =>(len + pc->x)
+        //|  pop rcx
+        //|  test rax, rax
+        //|  jnz >2
+        //|  mov CAP, rcx
+        //|  jmp =>(len + pc->y)
+        //|2:
+        //|  push rax
+        //|  decrCaptureRef rcx
+        //|  pop rax
+        //|  ret
+        dasm_put(Dst, 188, Dt3(->ref), (len + pc->x), (len + pc->y), Dt3(->ref));
+# 339 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    case SRE_OPCODE_SAVE:
+        if (ofs + 1 >= (sre_int_t) len) {
+            //|  jmp ->add_dead
+            dasm_put(Dst, 179);
+# 345 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+        }
+
+        /* update the capture in place when we own it exclusively */
+
+        //|  cmp dword CAP->ref, 1
+        //|  jne >1
+        //|  mov rax, CAP->vector
+        //|  test rax, rax
+        //|  jz >1
+        //|  mov [rax + (pc->v.group * sizeof(sre_int_t))], POS
+        //|  jmp =>(len + ofs + 1)
+        //|1:
+        //|  mov rdi, CTX->pool
+        //|  mov rsi, CAP
+        //|  mov rdx, (pc->v.group)
+        //|  mov rcx, POS
+        //|  lea r8, CTX->free_captures
+        //|  sub rsp, 8
+        //|  mov64 rax, ((uintptr_t) sre_capture_update)
+        //|  call rax
+        //|  add rsp, 8
+        //|  test rax, rax
+        //|  jz ->add_error
+        //|  mov CAP, rax
+        //|  jmp =>(len + ofs + 1)
+        dasm_put(Dst, 231, Dt3(->ref), Dt3(->vector), (pc->v.group * sizeof(sre_int_t)), (len + ofs + 1), Dt1(->pool), (pc->v.group), Dt1(->free_captures), (unsigned int)(((uintptr_t) sre_capture_update)), (unsigned int)((((uintptr_t) sre_capture_update))>>32), (len + ofs + 1));
+# 371 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    case SRE_OPCODE_ASSERT:
+        switch (pc->v.assertion) {
+        case SRE_REGEX_ASSERT_BIG_A:
+            /* never holds after consuming a byte */
+            //|  jmp ->add_dead
+            dasm_put(Dst, 179);
+# 379 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+
+        case SRE_REGEX_ASSERT_CARET:
+            if (ofs + 1 >= (sre_int_t) len) {
+                //|  jmp ->add_dead
+                dasm_put(Dst, 179);
+# 384 "src/sregex/sre_vm_pike_x64.dasc"
+                break;
+            }
+
+            //|  cmp CHR_C, byte '\n'
+            //|  jne ->add_dead
+            //|  jmp =>(len + ofs + 1)
+            dasm_put(Dst, 313, '\n', (len + ofs + 1));
+# 390 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+
+        case SRE_REGEX_ASSERT_SMALL_B:
+        case SRE_REGEX_ASSERT_BIG_B:
+            //|  movzx ecx, CHR_W
+            //|  mov64 rdx, ((uintptr_t) pc)
+            //|  jmp ->add_thread
+            dasm_put(Dst, 325, (unsigned int)(((uintptr_t) pc)), (unsigned int)((((uintptr_t) pc))>>32));
+# 397 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+
+        default:
+            /* postpone look-ahead assertions */
+            //|  xor ecx, ecx
+            //|  mov64 rdx, ((uintptr_t) pc)
+            //|  jmp ->add_thread
+            dasm_put(Dst, 337, (unsigned int)(((uintptr_t) pc)), (unsigned int)((((uintptr_t) pc))>>32));
+# 404 "src/sregex/sre_vm_pike_x64.dasc"
+            break;
+        }
+
+        break;
+
+    case SRE_OPCODE_MATCH:
+        /* $0's end, from the latest record of it or the ovector */
+
+        //|  mov rax, CAP
+        //|1:
+        //|  mov rcx, CAP:rax->vector
+        //|  test rcx, rcx
+        //|  jnz >3
+        //|  cmp aword CAP:rax->group, 1
+        //|  je >2
+        //|  mov rax, CAP:rax->parent
+        //|  jmp <1
+        //|2:
+        //|  mov rax, CAP:rax->pos
+        //|  jmp >4
+        //|3:
+        //|  mov rax, [rcx + sizeof(sre_int_t)]
+        //|4:
+        //|  mov CTX->last_matched_pos, rax
+        //|  mov aword CAP->regex_id, (pc->v.regex_id)
+        //|  mov rax, (SRE_DONE)
+        dasm_put(Dst, 348, Dt3(->vector), Dt3(->group), Dt3(->parent), Dt3(->pos), sizeof(sre_int_t), Dt1(->last_matched_pos), Dt3(->regex_id), (pc->v.regex_id));
+# 430 "src/sregex/sre_vm_pike_x64.dasc"
+        //|  ret
+        dasm_put(Dst, 411, (SRE_DONE));
+# 431 "src/sregex/sre_vm_pike_x64.dasc"
+
+        break;
+
+    default:
+        /* CHAR, ANY, IN, NOTIN, BITMAP */
+        //|  xor ecx, ecx
+        //|  mov64 rdx, ((uintptr_t) pc)
+        //|  jmp ->add_thread
+        dasm_put(Dst, 337, (unsigned int)(((uintptr_t) pc)), (unsigned int)((((uintptr_t) pc))>>32));
+# 439 "src/sregex/sre_vm_pike_x64.dasc"
+        break;
+    }
+
+    return SRE_OK;
+}
+
+
+static sre_int_t
+sre_vm_pike_jit_prologue(sre_vm_pike_jit_t *jit)
+{
+    dasm_State **dasm;
+
+    dasm = jit->dasm;
+
+    /*
+     * The exec entry must stay at the very beginning of the machine code
+     * since the thread handler table is placed right before it.
+     */
+
+    //|->exec:
+    //|  lea r9, [->step]
+    //|  mov64 rax, ((uintptr_t) sre_vm_pike_exec_helper)
+    //|  jmp rax
+    //|
+    //|  // sre_vm_pike_step_pt: rdi = ctx, rsi = clist, rdx = nlist,
+    //|  // rcx = sp, r8 = last
+    //|->step:
+    //|  push rbx; push rbp; push r12; push r13; push r14; push r15
+    //|  sub rsp, 40
+    //|
+    //|  mov CTX, rdi
+    //|  mov NL, rdx
+    //|  mov SAVED_CL, rsi
+    //|  mov SAVED_SP, rcx
+    //|  mov SAVED_LAST, r8
+    //|  mov TAG, CTX->tag
+    //|
+    //|  // POS = ctx->processed_bytes + (sp - ctx->buffer) + 1
+    //|  mov POS, rcx
+    //|  sub POS, CTX->buffer
+    //|  add POS, CTX->processed_bytes
+    //|  add POS, 1
+    //|
+    //|  cmp rcx, r8
+    //|  jne >1
+    //|  mov CHR, CHR_EOI
+    //|  jmp ->next_thread
+    //|
+    //|1:
+    //|  movzx CHR, byte [rcx]
+    //|  cmp CHR_C, byte '0'
+    //|  jb ->next_thread
+    //|  cmp CHR_C, byte '9'
+    dasm_put(Dst, 417, (unsigned int)(((uintptr_t) sre_vm_pike_exec_helper)), (unsigned int)((((uintptr_t) sre_vm_pike_exec_helper))>>32), 8, 16, 24, Dt1(->tag), Dt1(->buffer), Dt1(->processed_bytes), '0');
+# 492 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  jbe >2
+    //|  cmp CHR_C, byte 'A'
+    //|  jb ->next_thread
+    //|  cmp CHR_C, byte 'Z'
+    //|  jbe >2
+    //|  cmp CHR_C, byte '_'
+    //|  je >2
+    //|  cmp CHR_C, byte 'a'
+    //|  jb ->next_thread
+    //|  cmp CHR_C, byte 'z'
+    //|  ja ->next_thread
+    //|2:
+    //|  mov CHR_W, 1
+    //|
+    //|->next_thread:
+    //|  mov rax, SAVED_CL
+    dasm_put(Dst, 528, '9', 'A', 'Z', '_', 'a', 'z');
+# 508 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  cmp aword CL:rax->count, 0
+    //|  je ->step_done
+    //|  mov T, CL:rax->head
+    //|  lea rcx, [rdx + #T]
+    //|  mov CL:rax->head, rcx
+    //|  sub aword CL:rax->count, 1
+    //|  mov SAVED_T, T
+    //|
+    //|  // dispatch on the byte offset of t->pc in the sparse handler table
+    //|  mov rax, T->pc
+    //|  mov64 rcx, ((uintptr_t) jit->program->start)
+    //|  sub rax, rcx
+    //|  lea rcx, [->exec]
+    //|  sub rcx, (jit->program->len * sizeof(sre_instruction_t))
+    //|  jmp aword [rcx + rax]
+    //|
+    //|->slow_thread:
+    //|  mov rdi, CTX
+    //|  mov rsi, SAVED_CL
+    //|  mov rdx, NL
+    //|  mov rcx, SAVED_T
+    //|  mov r8, SAVED_SP
+    //|  mov r9, SAVED_LAST
+    //|  mov64 rax, ((uintptr_t) sre_vm_pike_step_thread)
+    //|  call rax
+    dasm_put(Dst, 583, 8, Dt5(->count), Dt5(->head), sizeof(sre_vm_pike_thread_t), Dt5(->head), Dt5(->count), Dt4(->pc), (unsigned int)(((uintptr_t) jit->program->start)), (unsigned int)((((uintptr_t) jit->program->start))>>32), (jit->program->len * sizeof(sre_instruction_t)), 8, 16, 24, (unsigned int)(((uintptr_t) sre_vm_pike_step_thread)), (unsigned int)((((uintptr_t) sre_vm_pike_step_thread))>>32));
+# 533 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  test rax, rax
+    //|  jz ->next_thread
+    //|  cmp rax, (SRE_DONE)
+    //|  je ->step_done
+    //|  jmp ->step_error
+    //|
+    //|->thread_failed:
+    //|  decrCaptureRef rbp
+    //|
+    //|->thread_done:
+    //|  jmp ->next_thread
+    //|
+    //|->thread_added:
+    //|  cmp rax, (SRE_DONE)
+    //|  jne ->step_error
+    //|
+    //|  // we have a match and all the remaining threads are discarded
+    //|  mov rax, CTX->matched
+    dasm_put(Dst, 680, (SRE_DONE), Dt3(->ref), (SRE_DONE));
+# 551 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  test rax, rax
+    //|  jz >1
+    //|  decrCaptureRef rax
+    //|1:
+    //|  mov CTX->matched, CAP
+    //|
+    //|2:
+    //|  mov rax, SAVED_CL
+    //|  cmp aword CL:rax->count, 0
+    //|  je ->step_done
+    //|  mov T, CL:rax->head
+    //|  lea rcx, [rdx + #T]
+    //|  mov CL:rax->head, rcx
+    //|  sub aword CL:rax->count, 1
+    //|  mov rcx, T->capture
+    dasm_put(Dst, 740, Dt1(->matched), Dt3(->ref), Dt1(->matched), 8, Dt5(->count), Dt5(->head), sizeof(sre_vm_pike_thread_t), Dt5(->head), Dt5(->count));
+# 566 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  decrCaptureRef rcx
+    //|  jmp <2
+    //|
+    //|->step_done:
+    //|  xor eax, eax
+    //|  jmp >3
+    //|
+    //|->step_error:
+    //|  mov rax, (SRE_ERROR)
+    //|
+    //|3:
+    //|  add rsp, 40
+    //|  pop r15; pop r14; pop r13; pop r12; pop rbp; pop rbx
+    //|  ret
+    //|
+    //|  // rdx = pc, ecx = seen_word
+    //|->add_thread:
+    //|  mov rax, NL->count
+    //|  imul rax, rax, #T
+    //|  add rax, NL->head
+    //|  mov T:rax->pc, rdx
+    //|  mov T:rax->capture, CAP
+    dasm_put(Dst, 812, Dt4(->capture), Dt3(->ref), (SRE_ERROR), Dt2(->count), sizeof(sre_vm_pike_thread_t), Dt2(->head), Dt4(->pc));
+# 588 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  mov T:rax->seen_word, ecx
+    //|  mov dword T:rax->counter, 0
+    //|  add aword NL->count, 1
+    //|
+    //|->add_ok:
+    //|  xor eax, eax
+    //|  ret
+    //|
+    //|  // no thread is left to hold the reference to CAP
+    //|->add_dead:
+    //|  decrCaptureRef rbp
+    //|  xor eax, eax
+    //|  ret
+    //|
+    //|->add_error:
+    //|  mov rax, (SRE_ERROR)
+    //|  ret
+    //|
+    //|  // rdi = a capture nobody holds, like sre_capture_free
+    //|->free_capture:
+    //|  cmp aword CAP:rdi->vector, 0
+    //|  je >1
+    //|  mov rax, CTX->free_captures.vectors
+    //|  mov CAP:rdi->next, rax
+    //|  mov CTX->free_captures.vectors, rdi
+    dasm_put(Dst, 886, Dt4(->capture), Dt4(->seen_word), Dt4(->counter), Dt2(->count), Dt3(->ref), (SRE_ERROR), Dt3(->vector), Dt1(->free_captures.vectors), Dt3(->next));
+# 613 "src/sregex/sre_vm_pike_x64.dasc"
+    //|  ret
+    //|1:
+    //|  mov rax, CTX->free_captures.records
+    //|  mov CAP:rdi->next, rax
+    //|  mov CTX->free_captures.records, rdi
+    //|  mov rdi, CAP:rdi->parent
+    //|  sub dword CAP:rdi->ref, 1
+    //|  jz ->free_capture
+    //|  ret
+    dasm_put(Dst, 961, Dt1(->free_captures.vectors), Dt1(->free_captures.records), Dt3(->next), Dt1(->free_captures.records), Dt3(->parent), Dt3(->ref));
+# 622 "src/sregex/sre_vm_pike_x64.dasc"
+
+    return SRE_OK;
+}
@@ -0,0 +1,1612 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include <sregex/ddebug.h>
+
+
+#include <sregex/sre_vm_tdfa.h>
+
+
+/* the tags of the instructions visited while simulating a step */
+enum {
+    SRE_VM_TDFA_TAG_NONE = 0,
+    SRE_VM_TDFA_TAG_CURRENT,    /* when building the current list */
+    SRE_VM_TDFA_TAG_NEXT,       /* when building the next list */
+    SRE_VM_TDFA_TAG_HELD        /* when adding the threads of look-ahead
+                                   assertions, in "held" */
+};
+
+
+typedef struct {
+    sre_uint_t                   count;
+    sre_vm_tdfa_thread_t        *threads;
+} sre_vm_tdfa_list_t;
+
+
+typedef struct {
+    sre_pool_t                  *pool;
+    sre_program_t               *program;
+    sre_vm_tdfa_t               *tdfa;
+
+    uint8_t                     *tags;      /* per instruction */
+    uint8_t                     *held;      /* the same, for the threads
+                                               added by look-ahead
+                                               assertions */
+
+    sre_uint_t                  *path;      /* the saves on the way */
+    sre_uint_t                   npath;
+    uint8_t                      path_last; /* SRE_VM_TDFA_LAST_POS or
+                                               SRE_VM_TDFA_LAST_NEXT */
+
+    /* the thread whose closure is being added */
+    sre_int_t                    reg;       /* its register, or -1 for a
+                                               fresh capture */
+    sre_int_t                    leaf_reg;  /* the same for the threads
+                                               added */
+    uint8_t                      caret;     /* whether ^ holds */
+    uint8_t                      big_a;     /* whether \A holds */
+    uint8_t                      lookahead; /* :1 after a look-ahead
+                                               assertion */
+    sre_vm_tdfa_saves_t          lead;      /* done before the path, at
+                                               the current position */
+
+    sre_uint_t                  *arena;     /* the saves of a step */
+    sre_uint_t                   narena;
+    sre_uint_t                   arena_size;
+
+    sre_vm_tdfa_list_t           clist;
+    sre_vm_tdfa_list_t           nlist;
+    sre_vm_tdfa_list_t           sublist;
+
+    /* the threads of clist whose captures the threads of nlist take */
+    sre_vm_tdfa_reg_t           *survivors;
+    sre_uint_t                   nsurvivors;
+    sre_int_t                   *renames;   /* per survivor */
+
+    sre_vm_tdfa_reg_t           *regs;      /* the registers of a step */
+    uint8_t                     *moved;     /* per register of the state */
+    sre_uint_t                  *release;
+
+    sre_vm_tdfa_trans_t          trans;     /* the step being simulated */
+
+    sre_uint_t                   nstates;
+    sre_vm_tdfa_state_t        **states;
+    uint32_t                    *hashes;
+} sre_vm_tdfa_compiler_t;
+
+
+static void sre_vm_tdfa_get_classes(sre_program_t *prog, sre_vm_tdfa_t *tdfa,
+                                    int *reprs);
+static unsigned sre_vm_tdfa_accepts(sre_program_t *prog,
+    sre_instruction_t *pc, unsigned c);
+static sre_int_t sre_vm_tdfa_initial(sre_vm_tdfa_compiler_t *c,
+    unsigned anchors, sre_vm_tdfa_trans_t **res);
+static sre_int_t sre_vm_tdfa_step(sre_vm_tdfa_compiler_t *c, sre_uint_t k,
+    int byte, sre_vm_tdfa_trans_t **res);
+static sre_int_t sre_vm_tdfa_add_thread(sre_vm_tdfa_compiler_t *c,
+    sre_vm_tdfa_list_t *l, sre_instruction_t *pc, uint8_t tag,
+    unsigned done_on_match);
+static uint8_t sre_vm_tdfa_last_matched(sre_vm_tdfa_compiler_t *c);
+static sre_int_t sre_vm_tdfa_copy_path(sre_vm_tdfa_compiler_t *c,
+    sre_vm_tdfa_saves_t *saves);
+static sre_int_t sre_vm_tdfa_get_regs(sre_vm_tdfa_compiler_t *c,
+    sre_uint_t nregs);
+static sre_int_t sre_vm_tdfa_add_state(sre_vm_tdfa_compiler_t *c,
+    sre_vm_tdfa_list_t *l, sre_vm_tdfa_state_t **res);
+static sre_vm_tdfa_trans_t *sre_vm_tdfa_add_trans(sre_vm_tdfa_compiler_t *c,
+    sre_vm_tdfa_state_t *state, sre_uint_t n);
+static unsigned sre_vm_tdfa_trans_eq(sre_vm_tdfa_trans_t *a,
+    sre_vm_tdfa_trans_t *b);
+static sre_int_t sre_vm_tdfa_copy_saves(sre_pool_t *pool,
+    sre_vm_tdfa_saves_t *dst, sre_vm_tdfa_saves_t *src);
+static unsigned sre_vm_tdfa_saves_eq(sre_vm_tdfa_saves_t *a,
+    sre_vm_tdfa_saves_t *b);
+static void sre_vm_tdfa_get_skip(sre_vm_tdfa_t *tdfa,
+    sre_vm_tdfa_state_t *state);
+static sre_char *sre_vm_tdfa_find(sre_vm_tdfa_ctx_t *ctx, sre_char *sp,
+    sre_char *last, unsigned eof);
+static void sre_vm_tdfa_reset(sre_vm_tdfa_ctx_t *ctx);
+static void sre_vm_tdfa_apply(sre_vm_tdfa_ctx_t *ctx, sre_vm_tdfa_trans_t *t,
+    sre_int_t pos, sre_int_t *last_matched);
+static void sre_vm_tdfa_update(sre_vm_tdfa_ctx_t *ctx, sre_vm_tdfa_trans_t *t,
+    sre_int_t pos);
+static void sre_vm_tdfa_prepare_matched_captures(sre_vm_tdfa_ctx_t *ctx,
+    sre_int_t *ovector, unsigned complete);
+static void sre_vm_tdfa_prepare_temp_captures(sre_vm_tdfa_ctx_t *ctx);
+
+
+/*
+ * Builds the tagged DFA in prog->tdfa, which runs the programs whose
+ * thread lists hold more than one capture in use, like a one-pass
+ * automaton with registers: the SAVE instructions are its tags, and the
+ * captures of the threads its registers.
+ *
+ * Its states are the thread lists of the Pike VM, with the capture of
+ * every thread told by a register and its saves at the current position,
+ * and its transitions make the registers of the next state from the ones
+ * of the state, by copying, moving and saving, the way the threads
+ * surviving a step pass their captures on. They are found by simulating
+ * the steps of the Pike VM on every byte class, so that the matches, the
+ * pending matches and the temporary captures are exactly the ones of
+ * sre_vm_pike_exec. Returns SRE_DECLINED for counter loops, word
+ * boundaries, and programs with too many instructions, states, or
+ * registers.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_tdfa_compile(sre_pool_t *pool, sre_program_t *prog)
+{
+    int                          reprs[257];
+    sre_int_t                    rc;
+    sre_uint_t                   i, k, n;
+    sre_instruction_t           *pc;
+    sre_vm_tdfa_t               *tdfa;
+    sre_vm_tdfa_state_t         *state;
+    sre_vm_tdfa_trans_t         *t;
+    sre_vm_tdfa_compiler_t       c;
+
+    prog->tdfa = NULL;
+
+    if (prog->slots || prog->len > SRE_VM_TDFA_MAX_INSTRUCTIONS) {
+        return SRE_DECLINED;
+    }
+
+    for (i = 0; i < prog->len; i++) {
+        pc = &prog->start[i];
+
+        if (pc->opcode == SRE_OPCODE_ASSERT
+            && (pc->v.assertion & SRE_REGEX_ASSERT_WORD_BOUNDARY))
+        {
+            return SRE_DECLINED;
+        }
+    }
+
+    tdfa = sre_pcalloc(pool, sizeof(sre_vm_tdfa_t));
+    if (tdfa == NULL) {
+        return SRE_ERROR;
+    }
+
+    sre_vm_tdfa_get_classes(prog, tdfa, reprs);
+
+    sre_memzero(&c, sizeof(sre_vm_tdfa_compiler_t));
+
+    c.pool = pool;
+    c.program = prog;
+    c.tdfa = tdfa;
+
+    n = prog->len;
+
+    c.tags = sre_pnalloc(pool, 2 * n + SRE_VM_TDFA_MAX_REGISTERS);
+    c.path = sre_palloc(pool, (2 * n + 1) * sizeof(sre_uint_t));
+    c.arena_size = 8 * n + 64;
+    c.arena = sre_palloc(pool, c.arena_size * sizeof(sre_uint_t));
+    c.clist.threads = sre_palloc(pool, (4 * n + 2)
+                                       * sizeof(sre_vm_tdfa_thread_t));
+    c.survivors = sre_palloc(pool, (2 * n + 1 + SRE_VM_TDFA_MAX_REGISTERS)
+                                   * sizeof(sre_vm_tdfa_reg_t));
+    c.renames = sre_palloc(pool, (2 * n + 1) * sizeof(sre_int_t));
+    c.release = sre_palloc(pool, SRE_VM_TDFA_MAX_REGISTERS
+                                 * sizeof(sre_uint_t));
+    c.states = sre_palloc(pool, SRE_VM_TDFA_MAX_STATES
+                                * sizeof(sre_vm_tdfa_state_t *));
+    c.hashes = sre_palloc(pool, SRE_VM_TDFA_MAX_STATES * sizeof(uint32_t));
+
+    if (c.tags == NULL || c.path == NULL || c.arena == NULL
+        || c.clist.threads == NULL || c.survivors == NULL
+        || c.renames == NULL || c.release == NULL || c.states == NULL
+        || c.hashes == NULL)
+    {
+        return SRE_ERROR;
+    }
+
+    c.held = c.tags + n;
+    c.moved = c.held + n;
+    c.nlist.threads = c.clist.threads + 2 * n + 1;
+    c.sublist.threads = c.nlist.threads + n + 1;
+    c.regs = c.survivors + 2 * n + 1;
+
+    for (i = 0; i < 3; i++) {
+        rc = sre_vm_tdfa_initial(&c, i, &tdfa->initial[i]);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+    }
+
+    /* the start thread lists the Pike VM skips ahead from */
+
+    tdfa->initial[0]->next->start = 1;
+    tdfa->initial[1]->next->start = 1;
+
+    for (k = 0; k < c.nstates; k++) {
+        state = c.states[k];
+
+        for (i = 0; i <= tdfa->nclasses; i++) {
+            rc = sre_vm_tdfa_step(&c, k, i < tdfa->nclasses ? reprs[i] : -1,
+                                  &t);
+            if (rc != SRE_OK) {
+                dd("declined at state %d, class %d", (int) k, (int) i);
+                return rc;
+            }
+
+            state->trans[i] = t;
+        }
+
+        sre_vm_tdfa_get_skip(tdfa, state);
+
+        tdfa->nregs = sre_max(tdfa->nregs, state->nregs);
+    }
+
+    dd("%d states, %d byte classes, %d registers", (int) c.nstates,
+       (int) tdfa->nclasses, (int) tdfa->nregs);
+
+    tdfa->nstates = c.nstates;
+    prog->tdfa = tdfa;
+
+    return SRE_OK;
+}
+
+
+/* splits the bytes into the classes no instruction tells apart */
+static void
+sre_vm_tdfa_get_classes(sre_program_t *prog, sre_vm_tdfa_t *tdfa, int *reprs)
+{
+    int                  map[512];
+    unsigned             b, in;
+    sre_uint_t           i, n;
+    sre_instruction_t   *pc;
+
+    sre_memzero(tdfa->classes, sizeof(tdfa->classes));
+    n = 1;
+
+    for (i = 0; i <= prog->len; i++) {
+        if (i < prog->len) {
+            pc = &prog->start[i];
+
+            switch (pc->opcode) {
+            case SRE_OPCODE_CHAR:
+            case SRE_OPCODE_IN:
+            case SRE_OPCODE_NOTIN:
+            case SRE_OPCODE_BITMAP:
+                break;
+
+            default:
+                continue;
+            }
+
+        } else {
+            /* the assertions only tell apart the newline */
+            pc = NULL;
+        }
+
+        for (b = 0; b < 512; b++) {
+            map[b] = -1;
+        }
+
+        n = 0;
+
+        for (b = 0; b < 256; b++) {
+            in = pc ? sre_vm_tdfa_accepts(prog, pc, b) : (b == '\n');
+            in += 2 * tdfa->classes[b];
+
+            if (map[in] == -1) {
+                map[in] = (int) n++;
+            }
+
+            tdfa->classes[b] = (uint8_t) map[in];
+        }
+    }
+
+    tdfa->nclasses = n;
+
+    for (i = 0; i < n; i++) {
+        reprs[i] = -1;
+    }
+
+    for (b = 0; b < 256; b++) {
+        if (reprs[tdfa->classes[b]] == -1) {
+            reprs[tdfa->classes[b]] = (int) b;
+        }
+    }
+}
+
+
+static unsigned
+sre_vm_tdfa_accepts(sre_program_t *prog, sre_instruction_t *pc, unsigned c)
+{
+    unsigned             in;
+    sre_uint_t           i;
+    sre_vm_range_t      *range;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_CHAR:
+        return c == pc->v.ch;
+
+    case SRE_OPCODE_BITMAP:
+        return sre_vm_bitmap_test(sre_program_bitmap(prog, pc), c) != 0;
+
+    case SRE_OPCODE_IN:
+    case SRE_OPCODE_NOTIN:
+        in = 0;
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
+
+            if (c >= range->from && c <= range->to) {
+                in = 1;
+                break;
+            }
+        }
+
+        return in ^ (pc->opcode == SRE_OPCODE_NOTIN);
+
+    default:
+        /* SRE_OPCODE_ANY */
+        return 1;
+    }
+}
+
+
+/*
+ * The thread list added for the first buffer, by the anchors holding at
+ * its start: 0 for none, 1 for ^ only, and 2 for both \A and ^.
+ */
+static sre_int_t
+sre_vm_tdfa_initial(sre_vm_tdfa_compiler_t *c, unsigned anchors,
+    sre_vm_tdfa_trans_t **res)
+{
+    sre_int_t                    rc;
+    sre_vm_tdfa_trans_t         *t;
+
+    sre_memzero(c->tags, c->program->len);
+    sre_memzero(&c->trans, sizeof(sre_vm_tdfa_trans_t));
+    c->trans.regex_id = -1;
+
+    c->narena = 0;
+    c->nlist.count = 0;
+    c->nsurvivors = 0;
+
+    c->reg = -1;
+    c->leaf_reg = -1;
+    c->caret = (anchors >= 1);
+    c->big_a = (anchors == 2);
+    c->lookahead = 0;
+    c->lead.count = 0;
+    c->npath = 0;
+    c->path_last = SRE_VM_TDFA_LAST_POS;
+
+    rc = sre_vm_tdfa_add_thread(c, &c->nlist, c->program->start,
+                                SRE_VM_TDFA_TAG_CURRENT, 0);
+    if (rc != SRE_OK) {
+        return rc;
+    }
+
+    rc = sre_vm_tdfa_add_state(c, &c->nlist, &c->trans.next);
+    if (rc != SRE_OK) {
+        return rc;
+    }
+
+    c->trans.actions = (c->trans.last_matched != SRE_VM_TDFA_LAST_NONE);
+
+    t = sre_palloc(c->pool, sizeof(sre_vm_tdfa_trans_t));
+    if (t == NULL) {
+        return SRE_ERROR;
+    }
+
+    *t = c->trans;
+    *res = t;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Runs the thread list of a state on a byte, or on the end of the input
+ * when "byte" is -1, the way sre_vm_pike_step does.
+ */
+static sre_int_t
+sre_vm_tdfa_step(sre_vm_tdfa_compiler_t *c, sre_uint_t k, int byte,
+    sre_vm_tdfa_trans_t **res)
+{
+    unsigned                     holds, dynamic;
+    sre_int_t                    rc;
+    sre_uint_t                   i, n;
+    sre_program_t               *prog;
+    sre_instruction_t           *pc;
+    sre_vm_tdfa_state_t         *state;
+    sre_vm_tdfa_thread_t        *t;
+    sre_vm_tdfa_list_t          *clist;
+    sre_vm_tdfa_reg_t           *s;
+
+    prog = c->program;
+    state = c->states[k];
+    clist = &c->clist;
+
+    sre_memzero(c->tags, prog->len);
+    sre_memzero(c->held, prog->len);
+
+    sre_memzero(&c->trans, sizeof(sre_vm_tdfa_trans_t));
+    c->trans.regex_id = -1;
+
+    c->narena = 0;
+    c->nlist.count = 0;
+    c->nsurvivors = 0;
+
+    memcpy(clist->threads, state->threads,
+           state->nthreads * sizeof(sre_vm_tdfa_thread_t));
+    clist->count = state->nthreads;
+
+    for (i = 0; i < clist->count; i++) {
+        t = &clist->threads[i];
+        pc = &prog->start[t->pc];
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_MATCH:
+            c->reg = t->reg;
+            c->lead = t->saves;
+            c->npath = 0;
+
+            c->trans.last_matched = sre_vm_tdfa_last_matched(c);
+            c->trans.regex_id = pc->v.regex_id;
+            c->trans.match_reg = t->reg;
+            c->trans.match_saves = t->saves;
+            goto done;
+
+        case SRE_OPCODE_ASSERT:
+            if (pc->v.assertion == SRE_REGEX_ASSERT_SMALL_Z) {
+                holds = (byte == -1);
+
+            } else {
+                /* SRE_REGEX_ASSERT_DOLLAR */
+                holds = (byte == -1 || byte == '\n');
+            }
+
+            if (!holds) {
+                break;
+            }
+
+            c->reg = t->reg;
+            c->leaf_reg = t->reg;
+            c->lookahead = 1;
+            c->lead.count = 0;
+            c->path_last = SRE_VM_TDFA_LAST_POS;
+
+            c->npath = t->saves.count;
+
+            if (c->npath) {
+                /* the groups of a thread without saves may be NULL */
+                memcpy(c->path, t->saves.groups,
+                       c->npath * sizeof(sre_uint_t));
+            }
+
+            c->sublist.count = 0;
+
+            rc = sre_vm_tdfa_add_thread(c, &c->sublist, pc + 1,
+                                        SRE_VM_TDFA_TAG_HELD, 0);
+            if (rc != SRE_OK) {
+                return rc;
+            }
+
+            /* the threads added run right after the assertion */
+
+            n = c->sublist.count;
+
+            memmove(&clist->threads[i + 1 + n], &clist->threads[i + 1],
+                    (clist->count - i - 1) * sizeof(sre_vm_tdfa_thread_t));
+            memcpy(&clist->threads[i + 1], c->sublist.threads,
+                   n * sizeof(sre_vm_tdfa_thread_t));
+            clist->count += n;
+
+            break;
+
+        default:
+            /* CHAR, ANY, IN, NOTIN, BITMAP */
+
+            if (byte == -1
+                || !sre_vm_tdfa_accepts(prog, pc, (unsigned) byte))
+            {
+                break;
+            }
+
+            dynamic = (t->reg >= 0 || t->saves.count);
+
+            c->reg = t->reg;
+            c->leaf_reg = dynamic ? (sre_int_t) c->nsurvivors : -1;
+            c->caret = (byte == '\n');
+            c->big_a = 0;
+            c->lookahead = 0;
+            c->lead = t->saves;
+            c->npath = 0;
+            c->path_last = SRE_VM_TDFA_LAST_NEXT;
+
+            n = c->nlist.count;
+
+            rc = sre_vm_tdfa_add_thread(c, &c->nlist, pc + 1,
+                                        SRE_VM_TDFA_TAG_NEXT, 1);
+            if (rc != SRE_OK && rc != SRE_DONE) {
+                return rc;
+            }
+
+            if (dynamic && c->nlist.count > n) {
+                /* its capture with the saves becomes a new register */
+                s = &c->survivors[c->nsurvivors++];
+                s->src = t->reg;
+                s->saves = t->saves;
+            }
+
+            if (rc == SRE_DONE) {
+                goto done;
+            }
+
+            break;
+        }
+    }
+
+done:
+
+    rc = sre_vm_tdfa_get_regs(c, state->nregs);
+    if (rc != SRE_OK) {
+        return rc;
+    }
+
+    rc = sre_vm_tdfa_add_state(c, &c->nlist, &c->trans.next);
+    if (rc != SRE_OK) {
+        return rc;
+    }
+
+    c->trans.actions = (c->trans.update || c->trans.regex_id >= 0
+                        || c->trans.last_matched != SRE_VM_TDFA_LAST_NONE);
+
+    *res = sre_vm_tdfa_add_trans(c, state, byte == -1
+                                 ? c->tdfa->nclasses
+                                 : c->tdfa->classes[byte]);
+    if (*res == NULL) {
+        return SRE_ERROR;
+    }
+
+    return SRE_OK;
+}
+
+
+/* follows the epsilon transitions like sre_vm_pike_add_thread does */
+static sre_int_t
+sre_vm_tdfa_add_thread(sre_vm_tdfa_compiler_t *c, sre_vm_tdfa_list_t *l,
+    sre_instruction_t *pc, uint8_t tag, unsigned done_on_match)
+{
+    uint8_t                     *tags;
+    sre_int_t                    rc;
+    sre_uint_t                   i;
+    sre_program_t               *prog;
+    sre_vm_tdfa_thread_t        *t;
+
+    prog = c->program;
+    i = pc - prog->start;
+    tags = (tag == SRE_VM_TDFA_TAG_HELD) ? c->held : c->tags;
+
+    if (tags[i] == tag) {
+        if (pc->opcode == SRE_OPCODE_SPLIT
+            && tags[pc->y] != tag)
+        {
+            return sre_vm_tdfa_add_thread(c, l, sre_program_y(prog, pc), tag,
+                                          done_on_match);
+        }
+
+        return SRE_OK;
+    }
+
+    tags[i] = tag;
+
+    switch (pc->opcode) {
+    case SRE_OPCODE_JMP:
+        return sre_vm_tdfa_add_thread(c, l, sre_program_x(prog, pc), tag,
+                                      done_on_match);
+
+    case SRE_OPCODE_SPLIT:
+        if (pc == prog->start && prog->multi) {
+            /* see sre_vm_onepass_add_thread */
+
+            for (i = 0; i < prog->nregexes; i++) {
+                rc = sre_vm_tdfa_add_thread(c, l,
+                                            sre_program_regex_start(prog, i),
+                                            tag, done_on_match);
+                if (rc != SRE_OK) {
+                    return rc;
+                }
+            }
+
+            return sre_vm_tdfa_add_thread(c, l, sre_program_y(prog, pc), tag,
+                                          done_on_match);
+        }
+
+        rc = sre_vm_tdfa_add_thread(c, l, sre_program_x(prog, pc), tag,
+                                    done_on_match);
+        if (rc != SRE_OK) {
+            return rc;
+        }
+
+        return sre_vm_tdfa_add_thread(c, l, sre_program_y(prog, pc), tag,
+                                      done_on_match);
+
+    case SRE_OPCODE_SAVE:
+        c->path[c->npath++] = pc->v.group;
+
+        rc = sre_vm_tdfa_add_thread(c, l, pc + 1, tag, done_on_match);
+
+        c->npath--;
+
+        return rc;
+
+    case SRE_OPCODE_ASSERT:
+        switch (pc->v.assertion) {
+        case SRE_REGEX_ASSERT_BIG_A:
+        case SRE_REGEX_ASSERT_CARET:
+            if (c->lookahead) {
+                /* would depend on the previous buffer */
+                return SRE_DECLINED;
+            }
+
+            if (pc->v.assertion == SRE_REGEX_ASSERT_BIG_A ? !c->big_a
+                                                          : !c->caret)
+            {
+                return SRE_OK;
+            }
+
+            return sre_vm_tdfa_add_thread(c, l, pc + 1, tag, done_on_match);
+
+        default:
+            /* postpone look-ahead assertions */
+            break;
+        }
+
+        break;
+
+    case SRE_OPCODE_MATCH:
+        c->trans.last_matched = sre_vm_tdfa_last_matched(c);
+
+        if (done_on_match) {
+            c->trans.regex_id = pc->v.regex_id;
+            c->trans.match_reg = c->reg;
+            c->trans.match_saves = c->lead;
+
+            return sre_vm_tdfa_copy_path(c, &c->trans.match_next_saves)
+                   == SRE_OK ? SRE_DONE : SRE_DECLINED;
+        }
+
+        break;
+
+    default:
+        break;
+    }
+
+    t = &l->threads[l->count++];
+
+    t->pc = i;
+    t->reg = c->leaf_reg;
+
+    return sre_vm_tdfa_copy_path(c, &t->saves);
+}
+
+
+/*
+ * Where $0's end comes from for the capture of a match, which the Pike VM
+ * takes as its last matched position: the saves on the path, the saves
+ * before, or the capture itself.
+ */
+static uint8_t
+sre_vm_tdfa_last_matched(sre_vm_tdfa_compiler_t *c)
+{
+    sre_uint_t           i;
+
+    for (i = 0; i < c->npath; i++) {
+        if (c->path[i] == 1) {
+            return c->path_last;
+        }
+    }
+
+    for (i = 0; i < c->lead.count; i++) {
+        if (c->lead.groups[i] == 1) {
+            return SRE_VM_TDFA_LAST_POS;
+        }
+    }
+
+    if (c->reg < 0) {
+        return SRE_VM_TDFA_LAST_UNSET;
+    }
+
+    c->trans.last_reg = c->reg;
+
+    return SRE_VM_TDFA_LAST_BASE;
+}
+
+
+static sre_int_t
+sre_vm_tdfa_copy_path(sre_vm_tdfa_compiler_t *c, sre_vm_tdfa_saves_t *saves)
+{
+    if (c->narena + c->npath > c->arena_size) {
+        dd("too many saves");
+        return SRE_DECLINED;
+    }
+
+    saves->count = c->npath;
+    saves->groups = &c->arena[c->narena];
+
+    memcpy(saves->groups, c->path, c->npath * sizeof(sre_uint_t));
+    c->narena += c->npath;
+
+    return SRE_OK;
+}
+
+
+/*
+ * Numbers the registers of the next list by their first thread, and finds
+ * the operations making them from the "nregs" registers of the state: a
+ * register used by several ones is copied for all of them but the last,
+ * which takes it over, and the ones no longer used are released.
+ */
+static sre_int_t
+sre_vm_tdfa_get_regs(sre_vm_tdfa_compiler_t *c, sre_uint_t nregs)
+{
+    sre_int_t                    src;
+    sre_uint_t                   i, j, n;
+    sre_vm_tdfa_thread_t        *t;
+    sre_vm_tdfa_trans_t         *trans;
+
+    trans = &c->trans;
+
+    for (i = 0; i < c->nsurvivors; i++) {
+        c->renames[i] = -1;
+    }
+
+    n = 0;
+
+    for (i = 0; i < c->nlist.count; i++) {
+        t = &c->nlist.threads[i];
+
+        if (t->reg < 0) {
+            continue;
+        }
+
+        if (c->renames[t->reg] < 0) {
+            if (n == SRE_VM_TDFA_MAX_REGISTERS) {
+                dd("too many registers");
+                return SRE_DECLINED;
+            }
+
+            c->renames[t->reg] = (sre_int_t) n;
+            c->regs[n++] = c->survivors[t->reg];
+        }
+
+        t->reg = c->renames[t->reg];
+    }
+
+    sre_memzero(c->moved, nregs);
+
+    for (j = n; j > 0; j--) {
+        src = c->regs[j - 1].src;
+
+        if (src >= 0 && !c->moved[src]) {
+            c->moved[src] = 1;
+            c->regs[j - 1].move = 1;
+
+        } else {
+            c->regs[j - 1].move = 0;
+        }
+    }
+
+    trans->release.count = 0;
+    trans->release.groups = c->release;
+
+    for (i = 0; i < nregs; i++) {
+        if (!c->moved[i]) {
+            c->release[trans->release.count++] = i;
+        }
+    }
+
+    trans->nregs = n;
+    trans->regs = c->regs;
+    trans->update = (n != nregs);
+
+    for (j = 0; j < n; j++) {
+        if (c->regs[j].src != (sre_int_t) j || c->regs[j].saves.count) {
+            trans->update = 1;
+        }
+    }
+
+    return SRE_OK;
+}
+
+
+/* looks up the state of a thread list, or adds a new one */
+static sre_int_t
+sre_vm_tdfa_add_state(sre_vm_tdfa_compiler_t *c, sre_vm_tdfa_list_t *l,
+    sre_vm_tdfa_state_t **res)
+{
+    uint32_t                     h;
+    sre_uint_t                   i, j, nregs;
+    sre_vm_tdfa_state_t         *state;
+    sre_vm_tdfa_thread_t        *t;
+
+    if (l->count == 0) {
+        *res = NULL;
+        return SRE_OK;
+    }
+
+    /* FNV-1a */
+    h = 2166136261u;
+
+    nregs = 0;
+
+    for (i = 0; i < l->count; i++) {
+        t = &l->threads[i];
+
+        h = (h ^ (uint32_t) t->pc) * 16777619u;
+        h = (h ^ (uint32_t) t->reg) * 16777619u;
+
+        for (j = 0; j < t->saves.count; j++) {
+            h = (h ^ (uint32_t) t->saves.groups[j]) * 16777619u;
+        }
+
+        h = (h ^ (uint32_t) t->saves.count) * 16777619u;
+
+        if (t->reg >= 0) {
+            nregs = sre_max(nregs, (sre_uint_t) t->reg + 1);
+        }
+    }
+
+    for (i = 0; i < c->nstates; i++) {
+        state = c->states[i];
+
+        if (c->hashes[i] != h || state->nthreads != l->count) {
+            continue;
+        }
+
+        for (j = 0; j < l->count; j++) {
+            t = &state->threads[j];
+
+            if (t->pc != l->threads[j].pc || t->reg != l->threads[j].reg
+                || !sre_vm_tdfa_saves_eq(&t->saves, &l->threads[j].saves))
+            {
+                break;
+            }
+        }
+
+        if (j == l->count) {
+            *res = state;
+            return SRE_OK;
+        }
+    }
+
+    if (c->nstates == SRE_VM_TDFA_MAX_STATES) {
+        dd("too many states");
+        return SRE_DECLINED;
+    }
+
+    state = sre_pcalloc(c->pool, sizeof(sre_vm_tdfa_state_t));
+    if (state == NULL) {
+        return SRE_ERROR;
+    }
+
+    state->trans = sre_pcalloc(c->pool, (c->tdfa->nclasses + 1)
+                                        * sizeof(sre_vm_tdfa_trans_t *));
+    state->threads = sre_palloc(c->pool, l->count
+                                         * sizeof(sre_vm_tdfa_thread_t));
+
+    if (state->trans == NULL || state->threads == NULL) {
+        return SRE_ERROR;
+    }
+
+    state->nregs = nregs;
+    state->nthreads = l->count;
+
+    for (i = 0; i < l->count; i++) {
+        state->threads[i].pc = l->threads[i].pc;
+        state->threads[i].reg = l->threads[i].reg;
+
+        if (sre_vm_tdfa_copy_saves(c->pool, &state->threads[i].saves,
+                                   &l->threads[i].saves)
+            != SRE_OK)
+        {
+            return SRE_ERROR;
+        }
+    }
+
+    c->hashes[c->nstates] = h;
+    c->states[c->nstates++] = state;
+
+    dd("new state %d with %d threads and %d registers", (int) c->nstates,
+       (int) l->count, (int) nregs);
+
+    *res = state;
+
+    return SRE_OK;
+}
+
+
+/* shares the transition with the same outcome of another byte class */
+static sre_vm_tdfa_trans_t *
+sre_vm_tdfa_add_trans(sre_vm_tdfa_compiler_t *c, sre_vm_tdfa_state_t *state,
+    sre_uint_t n)
+{
+    sre_uint_t                   i;
+    sre_vm_tdfa_trans_t         *t, *nt;
+
+    nt = &c->trans;
+
+    for (i = 0; i < n; i++) {
+        t = state->trans[i];
+
+        if (sre_vm_tdfa_trans_eq(t, nt)) {
+            return t;
+        }
+    }
+
+    t = sre_palloc(c->pool, sizeof(sre_vm_tdfa_trans_t));
+    if (t == NULL) {
+        return NULL;
+    }
+
+    *t = *nt;
+
+    if (nt->nregs) {
+        t->regs = sre_palloc(c->pool, nt->nregs * sizeof(sre_vm_tdfa_reg_t));
+        if (t->regs == NULL) {
+            return NULL;
+        }
+
+        for (i = 0; i < nt->nregs; i++) {
+            t->regs[i] = nt->regs[i];
+
+            if (sre_vm_tdfa_copy_saves(c->pool, &t->regs[i].saves,
+                                       &nt->regs[i].saves)
+                != SRE_OK)
+            {
+                return NULL;
+            }
+        }
+
+    } else {
+        t->regs = NULL;
+    }
+
+    if (sre_vm_tdfa_copy_saves(c->pool, &t->release, &nt->release) != SRE_OK
+        || sre_vm_tdfa_copy_saves(c->pool, &t->match_saves,
+                                  &nt->match_saves) != SRE_OK
+        || sre_vm_tdfa_copy_saves(c->pool, &t->match_next_saves,
+                                  &nt->match_next_saves) != SRE_OK)
+    {
+        return NULL;
+    }
+
+    return t;
+}
+
+
+static unsigned
+sre_vm_tdfa_trans_eq(sre_vm_tdfa_trans_t *a, sre_vm_tdfa_trans_t *b)
+{
+    sre_uint_t           i;
+
+    if (a->next != b->next || a->nregs != b->nregs
+        || a->update != b->update || a->regex_id != b->regex_id
+        || a->match_reg != b->match_reg
+        || a->last_matched != b->last_matched
+        || a->last_reg != b->last_reg
+        || !sre_vm_tdfa_saves_eq(&a->release, &b->release)
+        || !sre_vm_tdfa_saves_eq(&a->match_saves, &b->match_saves)
+        || !sre_vm_tdfa_saves_eq(&a->match_next_saves, &b->match_next_saves))
+    {
+        return 0;
+    }
+
+    for (i = 0; i < a->nregs; i++) {
+        if (a->regs[i].src != b->regs[i].src
+            || a->regs[i].move != b->regs[i].move
+            || !sre_vm_tdfa_saves_eq(&a->regs[i].saves, &b->regs[i].saves))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+static sre_int_t
+sre_vm_tdfa_copy_saves(sre_pool_t *pool, sre_vm_tdfa_saves_t *dst,
+    sre_vm_tdfa_saves_t *src)
+{
+    dst->count = src->count;
+
+    if (src->count == 0) {
+        dst->groups = NULL;
+        return SRE_OK;
+    }
+
+    dst->groups = sre_palloc(pool, src->count * sizeof(sre_uint_t));
+    if (dst->groups == NULL) {
+        return SRE_ERROR;
+    }
+
+    memcpy(dst->groups, src->groups, src->count * sizeof(sre_uint_t));
+
+    return SRE_OK;
+}
+
+
+static unsigned
+sre_vm_tdfa_saves_eq(sre_vm_tdfa_saves_t *a, sre_vm_tdfa_saves_t *b)
+{
+    return a->count == b->count
+           && (a->count == 0
+               || memcmp(a->groups, b->groups,
+                         a->count * sizeof(sre_uint_t)) == 0);
+}
+
+
+/*
+ * A state staying the same without doing anything on all the bytes but
+ * one can be skipped to that byte by memchr.
+ */
+static void
+sre_vm_tdfa_get_skip(sre_vm_tdfa_t *tdfa, sre_vm_tdfa_state_t *state)
+{
+    int                          other;
+    unsigned                     b;
+    sre_uint_t                   i, n;
+    sre_vm_tdfa_trans_t         *t;
+
+    other = -1;
+    n = 0;
+
+    for (i = 0; i < tdfa->nclasses; i++) {
+        t = state->trans[i];
+
+        if (t->next != state || t->actions) {
+            other = (int) i;
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        state->skip = SRE_VM_TDFA_SKIP_ALL;
+        return;
+    }
+
+    if (n > 1) {
+        return;
+    }
+
+    n = 0;
+
+    for (b = 0; b < 256; b++) {
+        if (tdfa->classes[b] == (unsigned) other) {
+            state->skip_byte = (uint8_t) b;
+            n++;
+        }
+    }
+
+    if (n == 1) {
+        state->skip = SRE_VM_TDFA_SKIP_BYTE;
+    }
+}
+
+
+SRE_NOAPI sre_vm_tdfa_ctx_t *
+sre_vm_tdfa_create_ctx(sre_pool_t *pool, sre_program_t *prog,
+    sre_int_t *ovector, size_t ovecsize)
+{
+    sre_uint_t                   n;
+    sre_vm_tdfa_ctx_t           *ctx;
+
+    ctx = sre_palloc(pool, sizeof(sre_vm_tdfa_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    /* the registers of a state, and the copies made for the next one */
+    n = 2 * prog->tdfa->nregs;
+
+    ctx->captures = sre_palloc(pool, (n + 1) * prog->ovecsize);
+    ctx->regs = sre_palloc(pool, (2 * n + 1) * sizeof(sre_int_t *));
+
+    if (ctx->captures == NULL || ctx->regs == NULL) {
+        return NULL;
+    }
+
+    ctx->next_regs = ctx->regs + n / 2;
+    ctx->free = ctx->next_regs + n / 2;
+    ctx->ncaptures = n;
+    ctx->matched = ctx->captures + n * prog->ovecsize / sizeof(sre_int_t);
+
+    if (prog->inner) {
+        ctx->inner = sre_vm_inner_create_ctx(pool, prog);
+        if (ctx->inner == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->inner = NULL;
+    }
+
+    ctx->pool = pool;
+    ctx->program = prog;
+    ctx->state = NULL;
+    ctx->matched_id = -1;
+    ctx->processed_bytes = 0;
+    ctx->pending_ovector = NULL;
+    ctx->ovector = ovector;
+    ctx->ovecsize = ovecsize;
+
+    ctx->first_buf = 1;
+    ctx->eof = 0;
+    ctx->empty_capture = 0;
+    ctx->seen_newline = 0;
+    ctx->skip = prog->prefix || prog->inner || prog->leading_set
+                || (prog->multi && prog->multi->nalways == 0);
+
+    sre_vm_tdfa_reset(ctx);
+
+    return ctx;
+}
+
+
+/*
+ * Works like sre_vm_pike_exec_helper, with the thread list replaced by a
+ * state, and the captures by its registers.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_tdfa_exec(sre_vm_tdfa_ctx_t *ctx, sre_char *input, size_t size,
+    unsigned eof, sre_int_t **pending_matched)
+{
+    unsigned                     anchors;
+    sre_int_t                    rc, last_matched;
+    sre_char                    *sp, *last, *p;
+    sre_vm_tdfa_t               *tdfa;
+    sre_vm_tdfa_state_t         *state;
+    sre_vm_tdfa_trans_t         *t;
+
+    if (ctx->eof) {
+        dd("eof found");
+        return SRE_ERROR;
+    }
+
+    tdfa = ctx->program->tdfa;
+    last_matched = -1;
+
+    if (ctx->empty_capture) {
+        dd("found empty capture");
+        ctx->empty_capture = 0;
+
+        if (size == 0) {
+            if (eof) {
+                ctx->eof = 1;
+                return SRE_DECLINED;
+            }
+
+            return SRE_AGAIN;
+        }
+
+        sp = input + 1;
+
+    } else {
+        sp = input;
+    }
+
+    last = input + size;
+    state = ctx->state;
+
+    if (ctx->first_buf) {
+        ctx->first_buf = 0;
+
+        if (sp > input) {
+            anchors = (sp[-1] == '\n');
+
+        } else if (ctx->processed_bytes == 0) {
+            anchors = 2;
+
+        } else {
+            anchors = ctx->seen_newline;
+        }
+
+        t = tdfa->initial[anchors];
+
+        sre_vm_tdfa_reset(ctx);
+
+        if (t->actions) {
+            sre_vm_tdfa_apply(ctx, t, ctx->processed_bytes
+                                      + (sre_int_t) (sp - input),
+                              &last_matched);
+        }
+
+        state = t->next;
+    }
+
+    for ( ;; ) {
+        if (state == NULL) {
+            dd("no thread left");
+            break;
+        }
+
+        if (sp == last) {
+            if (eof) {
+                t = state->trans[tdfa->nclasses];
+
+                if (t->actions) {
+                    sre_vm_tdfa_apply(ctx, t, ctx->processed_bytes
+                                              + (sre_int_t) (sp - input),
+                                      &last_matched);
+                }
+
+                state = t->next;
+            }
+
+            break;
+        }
+
+        if (state->start && ctx->skip) {
+            p = sre_vm_tdfa_find(ctx, sp, last, eof);
+
+            if (p > sp) {
+                /*
+                 * no match starts before, so the Pike VM adds the start
+                 * threads again there
+                 */
+
+                sp = p;
+                t = tdfa->initial[p[-1] == '\n'];
+
+                if (t->actions) {
+                    sre_vm_tdfa_apply(ctx, t, ctx->processed_bytes
+                                              + (sre_int_t) (sp - input),
+                                      &last_matched);
+                }
+
+                state = t->next;
+                continue;
+            }
+        }
+
+        if (state->skip) {
+            if (state->skip == SRE_VM_TDFA_SKIP_ALL) {
+                sp = last;
+                continue;
+            }
+
+            p = memchr(sp, state->skip_byte, last - sp);
+            if (p == NULL) {
+                sp = last;
+                continue;
+            }
+
+            sp = p;
+        }
+
+        t = state->trans[tdfa->classes[*sp]];
+
+        if (t->actions) {
+            sre_vm_tdfa_apply(ctx, t, ctx->processed_bytes
+                                      + (sre_int_t) (sp - input),
+                              &last_matched);
+        }
+
+        state = t->next;
+        sp++;
+    }
+
+    if (last_matched >= 0) {
+        p = input + last_matched - ctx->processed_bytes;
+        if (p > input) {
+            ctx->seen_newline = (p[-1] == '\n');
+        }
+    }
+
+    ctx->state = state;
+
+    if (ctx->matched_id >= 0) {
+        if (eof || state == NULL) {
+            sre_vm_tdfa_prepare_matched_captures(ctx, ctx->ovector, 1);
+
+            if (state) {
+                ctx->state = NULL;
+                ctx->eof = 1;
+            }
+
+            ctx->processed_bytes = ctx->ovector[1];
+            ctx->empty_capture = (ctx->ovector[0] == ctx->ovector[1]);
+
+            rc = ctx->matched_id;
+            ctx->matched_id = -1;
+            ctx->first_buf = 1;
+
+            return rc;
+        }
+
+        if (pending_matched) {
+            if (ctx->pending_ovector == NULL) {
+                ctx->pending_ovector = sre_palloc(ctx->pool,
+                                                  2 * sizeof(sre_int_t));
+                if (ctx->pending_ovector == NULL) {
+                    return SRE_ERROR;
+                }
+            }
+
+            *pending_matched = ctx->pending_ovector;
+
+            sre_vm_tdfa_prepare_matched_captures(ctx, *pending_matched, 0);
+        }
+
+    } else {
+        if (eof) {
+            ctx->eof = 1;
+            return SRE_DECLINED;
+        }
+
+        if (pending_matched) {
+            *pending_matched = NULL;
+        }
+    }
+
+    ctx->processed_bytes += (sre_int_t) (sp - input);
+
+    sre_vm_tdfa_prepare_temp_captures(ctx);
+
+    return SRE_AGAIN;
+}
+
+
+/* see sre_vm_glushkov_skip */
+static sre_char *
+sre_vm_tdfa_find(sre_vm_tdfa_ctx_t *ctx, sre_char *sp, sre_char *last,
+    unsigned eof)
+{
+    sre_program_t       *prog;
+
+    prog = ctx->program;
+
+    if (prog->prefix) {
+        return sre_literal_find(prog->prefix, sp, last);
+    }
+
+    if (ctx->inner) {
+        return sre_vm_inner_find(ctx->inner, sp, last, eof);
+    }
+
+    if (prog->multi && prog->multi->nalways == 0) {
+        return sre_multi_literal_find(&prog->multi->prefixes, sp, last);
+    }
+
+    return sre_byteset_find(prog->leading_set, sp, last);
+}
+
+
+/* all the captures are free for the first state */
+static void
+sre_vm_tdfa_reset(sre_vm_tdfa_ctx_t *ctx)
+{
+    sre_uint_t           i;
+
+    for (i = 0; i < ctx->ncaptures; i++) {
+        ctx->free[i] = ctx->captures
+                       + i * ctx->program->ovecsize / sizeof(sre_int_t);
+    }
+
+    ctx->nfree = ctx->ncaptures;
+}
+
+
+static void
+sre_vm_tdfa_apply(sre_vm_tdfa_ctx_t *ctx, sre_vm_tdfa_trans_t *t,
+    sre_int_t pos, sre_int_t *last_matched)
+{
+    size_t               size;
+    sre_uint_t           i;
+
+    size = ctx->program->ovecsize;
+
+    switch (t->last_matched) {
+    case SRE_VM_TDFA_LAST_UNSET:
+        *last_matched = -1;
+        break;
+
+    case SRE_VM_TDFA_LAST_BASE:
+        *last_matched = ctx->regs[t->last_reg][1];
+        break;
+
+    case SRE_VM_TDFA_LAST_POS:
+        *last_matched = pos;
+        break;
+
+    case SRE_VM_TDFA_LAST_NEXT:
+        *last_matched = pos + 1;
+        break;
+
+    default:
+        break;
+    }
+
+    if (t->regex_id >= 0) {
+        if (t->match_reg < 0) {
+            memset(ctx->matched, -1, size);
+
+        } else {
+            memcpy(ctx->matched, ctx->regs[t->match_reg], size);
+        }
+
+        for (i = 0; i < t->match_saves.count; i++) {
+            ctx->matched[t->match_saves.groups[i]] = pos;
+        }
+
+        for (i = 0; i < t->match_next_saves.count; i++) {
+            ctx->matched[t->match_next_saves.groups[i]] = pos + 1;
+        }
+
+        ctx->matched_id = t->regex_id;
+    }
+
+    if (t->update) {
+        sre_vm_tdfa_update(ctx, t, pos);
+    }
+}
+
+
+/*
+ * Runs the register operations of a transition: the copies are made
+ * before the registers they copy are taken over, and the registers
+ * released after.
+ */
+static void
+sre_vm_tdfa_update(sre_vm_tdfa_ctx_t *ctx, sre_vm_tdfa_trans_t *t,
+    sre_int_t pos)
+{
+    size_t               size;
+    sre_int_t           *v, **regs;
+    sre_uint_t           i, j;
+    sre_vm_tdfa_reg_t   *r;
+
+    size = ctx->program->ovecsize;
+
+    for (j = 0; j < t->nregs; j++) {
+        r = &t->regs[j];
+
+        if (r->move) {
+            continue;
+        }
+
+        v = ctx->free[--ctx->nfree];
+
+        if (r->src < 0) {
+            memset(v, -1, size);
+
+        } else {
+            memcpy(v, ctx->regs[r->src], size);
+        }
+
+        ctx->next_regs[j] = v;
+    }
+
+    for (j = 0; j < t->nregs; j++) {
+        r = &t->regs[j];
+
+        if (r->move) {
+            ctx->next_regs[j] = ctx->regs[r->src];
+        }
+    }
+
+    for (i = 0; i < t->release.count; i++) {
+        ctx->free[ctx->nfree++] = ctx->regs[t->release.groups[i]];
+    }
+
+    for (j = 0; j < t->nregs; j++) {
+        r = &t->regs[j];
+        v = ctx->next_regs[j];
+
+        for (i = 0; i < r->saves.count; i++) {
+            v[r->saves.groups[i]] = pos;
+        }
+    }
+
+    regs = ctx->regs;
+    ctx->regs = ctx->next_regs;
+    ctx->next_regs = regs;
+}
+
+
+static void
+sre_vm_tdfa_prepare_matched_captures(sre_vm_tdfa_ctx_t *ctx,
+    sre_int_t *ovector, unsigned complete)
+{
+    size_t               len;
+    sre_uint_t           i, ofs;
+    sre_program_t       *prog;
+
+    prog = ctx->program;
+
+    for (ofs = 0, i = 0; i < (sre_uint_t) ctx->matched_id; i++) {
+        ofs += prog->multi_ncaps[i] + 1;
+    }
+
+    ofs *= 2;
+
+    if (complete) {
+        len = 2 * (prog->multi_ncaps[i] + 1) * sizeof(sre_int_t);
+
+    } else {
+        len = 2 * sizeof(sre_int_t);
+    }
+
+    if (len > ctx->ovecsize) {
+        /* the caller does not want all the captures */
+        len = ctx->ovecsize;
+    }
+
+    memcpy(ovector, &ctx->matched[ofs], len);
+
+    if (complete && ctx->ovecsize > len) {
+        memset((char *) ovector + len, -1, ctx->ovecsize - len);
+    }
+}
+
+
+/* the earliest start and the latest end of $0 among the threads */
+static void
+sre_vm_tdfa_prepare_temp_captures(sre_vm_tdfa_ctx_t *ctx)
+{
+    sre_int_t                    a, b, start, end;
+    sre_uint_t                   i, j, k, ofs;
+    sre_program_t               *prog;
+    sre_vm_tdfa_thread_t        *t;
+
+    prog = ctx->program;
+
+    ctx->ovector[0] = -1;
+    ctx->ovector[1] = -1;
+
+    if (ctx->state == NULL) {
+        return;
+    }
+
+    for (k = 0; k < ctx->state->nthreads; k++) {
+        t = &ctx->state->threads[k];
+
+        /* the Pike VM only looks at the end of the first regex */
+
+        end = t->reg < 0 ? -1 : ctx->regs[t->reg][1];
+
+        for (j = 0; j < t->saves.count; j++) {
+            if (t->saves.groups[j] == 1) {
+                end = ctx->processed_bytes;
+            }
+        }
+
+        a = ctx->ovector[1];
+
+        if (end != -1 && (a == -1 || end > a)) {
+            ctx->ovector[1] = end;
+        }
+
+        ofs = 0;
+        for (i = 0; i < prog->nregexes; i++) {
+            start = t->reg < 0 ? -1 : ctx->regs[t->reg][ofs];
+
+            for (j = 0; j < t->saves.count; j++) {
+                if (t->saves.groups[j] == ofs) {
+                    start = ctx->processed_bytes;
+                }
+            }
+
+            a = ctx->ovector[0];
+            b = start;
+
+            if (b != -1 && (a == -1 || b < a)) {
+                ctx->ovector[0] = b;
+            }
+
+            ofs += 2 * (prog->multi_ncaps[i] + 1);
+        }
+    }
+}
@@ -0,0 +1,156 @@
+
+/*
+ * Copyright 2012 Yichun "agentzh" Zhang
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+
+#ifndef _SRE_VM_TDFA_H_INCLUDED_
+#define _SRE_VM_TDFA_H_INCLUDED_
+
+
+#include <sregex/sre_core.h>
+#include <sregex/sre_palloc.h>
+#include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_inner.h>
+
+
+/* the limits beyond which a program is left to the Pike VM */
+#define SRE_VM_TDFA_MAX_INSTRUCTIONS  512
+#define SRE_VM_TDFA_MAX_STATES        512
+#define SRE_VM_TDFA_MAX_REGISTERS     16
+
+
+/* where the Pike VM would take its last matched position from */
+enum {
+    SRE_VM_TDFA_LAST_NONE = 0,
+    SRE_VM_TDFA_LAST_UNSET,     /* -1 */
+    SRE_VM_TDFA_LAST_BASE,      /* $0's end in a register */
+    SRE_VM_TDFA_LAST_POS,       /* the current position */
+    SRE_VM_TDFA_LAST_NEXT       /* the position after the current byte */
+};
+
+
+enum {
+    SRE_VM_TDFA_SKIP_NONE = 0,
+    SRE_VM_TDFA_SKIP_BYTE,      /* to the next skip_byte */
+    SRE_VM_TDFA_SKIP_ALL        /* to the end of the input */
+};
+
+
+typedef struct sre_vm_tdfa_state_s  sre_vm_tdfa_state_t;
+
+
+typedef struct {
+    sre_uint_t                   count;
+    sre_uint_t                  *groups;
+} sre_vm_tdfa_saves_t;
+
+
+/* how a register of the next state is made from the ones of the state */
+typedef struct {
+    sre_int_t                    src;       /* -1 for a fresh capture */
+    uint8_t                      move;      /* :1 takes src over instead
+                                               of copying it */
+    sre_vm_tdfa_saves_t          saves;     /* at the current position */
+} sre_vm_tdfa_reg_t;
+
+
+/*
+ * The outcome of a Pike VM step on a byte class: the next state and the
+ * register operations making its captures, and the match found, if any,
+ * which is built from the registers before the operations.
+ */
+typedef struct {
+    sre_vm_tdfa_state_t         *next;      /* NULL when no thread is left */
+    sre_uint_t                   nregs;     /* the registers of next */
+    sre_vm_tdfa_reg_t           *regs;
+    sre_vm_tdfa_saves_t          release;   /* the registers not moved */
+    sre_vm_tdfa_saves_t          match_saves;       /* at the current
+                                                       position */
+    sre_vm_tdfa_saves_t          match_next_saves;  /* at the next
+                                                       position */
+    sre_int_t                    regex_id;  /* -1 when nothing matched */
+    sre_int_t                    match_reg; /* -1 for a fresh capture */
+    sre_int_t                    last_reg;  /* for SRE_VM_TDFA_LAST_BASE */
+    uint8_t                      last_matched;  /* SRE_VM_TDFA_LAST_* */
+    uint8_t                      update;    /* :1 the registers change */
+    uint8_t                      actions;   /* :1 anything besides next */
+} sre_vm_tdfa_trans_t;
+
+
+/*
+ * A thread of the Pike VM thread list a state stands for. Its capture is
+ * a fresh one or a register, with the saves done at the position of the
+ * state on top.
+ */
+typedef struct {
+    sre_uint_t                   pc;
+    sre_int_t                    reg;       /* -1 for a fresh capture */
+    sre_vm_tdfa_saves_t          saves;
+} sre_vm_tdfa_thread_t;
+
+
+struct sre_vm_tdfa_state_s {
+    sre_vm_tdfa_trans_t        **trans;     /* per byte class, and the end
+                                               of the input last */
+    sre_uint_t                   nregs;
+    sre_uint_t                   nthreads;
+    sre_vm_tdfa_thread_t        *threads;
+    uint8_t                      skip;      /* SRE_VM_TDFA_SKIP_* */
+    uint8_t                      skip_byte;
+    uint8_t                      start;     /* :1 only the start threads
+                                               are alive */
+};
+
+
+struct sre_vm_tdfa_s {
+    sre_uint_t                   nclasses;
+    sre_uint_t                   nstates;
+    sre_uint_t                   nregs;     /* the most of a state */
+    uint8_t                      classes[256];  /* the class of a byte */
+    sre_vm_tdfa_trans_t         *initial[3];    /* by the anchors holding:
+                                                   none, ^ only, and \A */
+};
+
+
+typedef struct {
+    sre_pool_t                  *pool;
+    sre_program_t               *program;
+    sre_vm_inner_ctx_t          *inner;
+    sre_vm_tdfa_state_t         *state;
+    sre_int_t                  **regs;      /* the captures of the state */
+    sre_int_t                  **next_regs;
+    sre_int_t                  **free;      /* the captures not in use */
+    sre_uint_t                   nfree;
+    sre_int_t                   *captures;  /* all of them */
+    sre_uint_t                   ncaptures;
+    sre_int_t                   *matched;
+    sre_int_t                    matched_id;    /* -1 when not matched */
+    sre_int_t                    processed_bytes;
+
+    sre_int_t                   *pending_ovector;
+    sre_int_t                   *ovector;
+    size_t                       ovecsize;
+
+    unsigned                     first_buf:1;
+    unsigned                     eof:1;
+    unsigned                     empty_capture:1;
+    unsigned                     seen_newline:1;
+    unsigned                     skip:1;    /* literals or leading bytes
+                                               tell where matches start */
+} sre_vm_tdfa_ctx_t;
+
+
+SRE_NOAPI sre_int_t sre_vm_tdfa_compile(sre_pool_t *pool,
+    sre_program_t *prog);
+
+SRE_NOAPI sre_vm_tdfa_ctx_t *sre_vm_tdfa_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog, sre_int_t *ovector, size_t ovecsize);
+
+SRE_NOAPI sre_int_t sre_vm_tdfa_exec(sre_vm_tdfa_ctx_t *ctx,
+    sre_char *input, size_t size, unsigned eof, sre_int_t **pending_matched);
+
+
+#endif /* _SRE_VM_TDFA_H_INCLUDED_ */
@@ -16,10 +16,18 @@
 #include <sregex/sre_vm_thompson.h>
 #include <sregex/sre_capture.h>
 #include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_closure.h>
 
 
 static void sre_vm_thompson_add_thread(sre_vm_thompson_ctx_t *ctx,
-    sre_vm_thompson_thread_list_t *l, sre_instruction_t *pc, sre_char *sp);
+    sre_vm_thompson_thread_list_t *l, sre_instruction_t *pc, unsigned counter,
+    sre_char *sp);
+static void sre_vm_thompson_add_start_threads(sre_vm_thompson_ctx_t *ctx,
+    sre_vm_thompson_thread_list_t *l, sre_char *sp);
+static void sre_vm_thompson_add_closure(sre_vm_thompson_ctx_t *ctx,
+    sre_vm_thompson_thread_list_t *l, sre_vm_closure_entry_t *root,
+    sre_char *sp);
+static sre_int_t sre_vm_thompson_set_result(sre_vm_thompson_ctx_t *ctx);
 
 
 SRE_API sre_vm_thompson_ctx_t *
@@ -37,7 +45,7 @@ sre_vm_thompson_create_ctx(sre_pool_t *pool, sre_program_t *prog)
     ctx->pool = pool;
     ctx->program = prog;
 
-    len = prog->len;
+    len = prog->nslots;
 
     clist = sre_vm_thompson_create_thread_list(pool, len);
     if (clist == NULL) {
@@ -53,8 +61,111 @@ sre_vm_thompson_create_ctx(sre_pool_t *pool, sre_program_t *prog)
 
     ctx->next_threads = nlist;
 
-    ctx->tag = prog->tag + 1;
+    ctx->tags = sre_pcalloc(pool, len * sizeof(unsigned));
+    if (ctx->tags == NULL) {
+        return NULL;
+    }
+
+    ctx->initial_states = NULL;
+    ctx->initial_states_count = 0;
+
+    if (prog->inner) {
+        ctx->inner = sre_vm_inner_create_ctx(pool, prog);
+        if (ctx->inner == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->inner = NULL;
+    }
+
+    if (prog->glushkov) {
+        ctx->glushkov = sre_vm_glushkov_create_ctx(pool, prog);
+        if (ctx->glushkov == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->glushkov = NULL;
+    }
+
+    if (prog->multi) {
+        ctx->prefix_hits = sre_palloc(pool,
+                                      prog->nregexes * sizeof(sre_uint_t));
+        if (ctx->prefix_hits == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->prefix_hits = NULL;
+    }
+
+    ctx->regex_ids = NULL;
+    ctx->matched = NULL;
+    ctx->regex_of = NULL;
+    ctx->nmatched = 0;
+
+    ctx->tag = 1;
     ctx->first_buf = 1;
+    ctx->no_prefix_hits = 0;
+
+    return ctx;
+}
+
+
+/*
+ * Creates a context matching all the regexes of the program at once. The
+ * ids of the regexes matching anywhere in the whole input are stored in
+ * "regex_ids" in ascending order, which must hold prog->nregexes ids.
+ * Captures are not tracked, and a regex is no longer run once it matches.
+ */
+SRE_API sre_vm_thompson_ctx_t *
+sre_vm_thompson_create_set_ctx(sre_pool_t *pool, sre_program_t *prog,
+    sre_int_t *regex_ids)
+{
+    sre_uint_t                   i, id, loop;
+    sre_vm_thompson_ctx_t       *ctx;
+
+    ctx = sre_vm_thompson_create_ctx(pool, prog);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->regex_ids = regex_ids;
+
+    /* the automaton does not tell the regexes apart */
+    ctx->glushkov = NULL;
+
+    /* the extra flag for the ".*?" loop is never set */
+    ctx->matched = sre_pcalloc(pool, prog->nregexes + 1);
+    if (ctx->matched == NULL) {
+        return NULL;
+    }
+
+    ctx->regex_of = sre_palloc(pool, prog->len * sizeof(sre_uint_t));
+    if (ctx->regex_of == NULL) {
+        return NULL;
+    }
+
+    /*
+     * the regexes are laid out one after another behind the ".*?" loop,
+     * each ending with its own match instruction
+     */
+
+    loop = prog->start->x;
+    id = prog->nregexes;
+
+    for (i = prog->len; i > loop; i--) {
+        if (prog->start[i - 1].opcode == SRE_OPCODE_MATCH) {
+            id = prog->start[i - 1].v.regex_id;
+        }
+
+        ctx->regex_of[i - 1] = id;
+    }
+
+    for (i = 0; i < loop; i++) {
+        ctx->regex_of[i] = prog->nregexes;
+    }
 
     return ctx;
 }
@@ -64,7 +175,7 @@ SRE_API sre_int_t
 sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
     unsigned eof)
 {
-    sre_char                        *sp, *last;
+    sre_char                        *sp, *last, *p;
     sre_uint_t                       i, j;
     unsigned                         in;
     sre_program_t                   *prog;
@@ -73,17 +184,50 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
     sre_vm_thompson_thread_t        *t;
     sre_vm_thompson_thread_list_t   *clist, *nlist, *tmp;
 
+    if (ctx->glushkov) {
+        return sre_vm_glushkov_exec(ctx->glushkov, input, size, eof);
+    }
+
     prog = ctx->program;
     clist = ctx->current_threads;
     nlist = ctx->next_threads;
     ctx->buffer = input;
 
+    last = input + size;
+    ctx->last = last;
+
     if (ctx->first_buf) {
         ctx->first_buf = 0;
-        sre_vm_thompson_add_thread(ctx, clist, prog->start, input);
-    }
 
-    last = input + size;
+        /* the initial states only include the regexes always started */
+        ctx->no_prefix_hits = (prog->multi != NULL);
+
+        sre_vm_thompson_add_thread(ctx, clist, prog->start, 0, input);
+
+        if (prog->leading_set || prog->inner
+            || (prog->multi && prog->multi->nalways == 0))
+        {
+            ctx->initial_states = sre_palloc(ctx->pool,
+                                             sizeof(sre_instruction_t *)
+                                             * clist->count);
+            if (ctx->initial_states == NULL) {
+                return SRE_ERROR;
+            }
+
+            for (i = 0; i < clist->count; i++) {
+                ctx->initial_states[i] = clist->threads[i].pc;
+            }
+
+            ctx->initial_states_count = clist->count;
+        }
+
+        if (ctx->no_prefix_hits) {
+            ctx->no_prefix_hits = 0;
+            clist->count = 0;
+            ctx->tag++;
+            sre_vm_thompson_add_thread(ctx, clist, prog->start, 0, input);
+        }
+    }
 
     for (sp = input; sp < last || (eof && sp == last); sp++) {
         dd("=== pos %d (char %d).\n", (int)(sp - input),
@@ -93,6 +237,43 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
             break;
         }
 
+        if (clist->count == ctx->initial_states_count && sp != last) {
+            for (i = 0; i < clist->count; i++) {
+                if (clist->threads[i].pc != ctx->initial_states[i]
+                    || clist->threads[i].counter)
+                {
+                    break;
+                }
+            }
+
+            if (i == clist->count) {
+                /*
+                 * only the start state is alive, so no match can start
+                 * before the next leading byte. we still run the byte
+                 * right before it to set up the look-behind states.
+                 */
+
+                if (prog->prefix) {
+                    p = sre_literal_find(prog->prefix, sp, last);
+
+                } else if (ctx->inner) {
+                    p = sre_vm_inner_find(ctx->inner, sp, last, eof);
+
+                } else if (prog->multi && prog->multi->nalways == 0) {
+                    p = sre_multi_literal_find(&prog->multi->prefixes, sp,
+                                               last);
+
+                } else {
+                    p = sre_byteset_find(prog->leading_set, sp, last);
+                }
+
+                if (p - sp > 1) {
+                    dd("skipped %d bytes", (int) (p - 1 - sp));
+                    sp = p - 1;
+                }
+            }
+        }
+
         /* printf("%d(%02x).", (int)(sp - input), *sp & 0xFF); */
 
         ctx->tag++;
@@ -111,8 +292,8 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                 }
 
                 in = 0;
-                for (j = 0; j < pc->v.ranges->count; j++) {
-                    range = &pc->v.ranges->head[j];
+                for (j = 0; j < sre_vm_nranges(pc); j++) {
+                    range = &pc->v.ranges[j];
 
                     dd("testing %d for [%d, %d] (%u)", *sp, (int) range->from,
                        (int) range->to, (unsigned) j);
@@ -127,7 +308,8 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                     break;
                 }
 
-                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, sp + 1);
+                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, t->counter,
+                                           sp + 1);
                 break;
 
             case SRE_OPCODE_NOTIN:
@@ -136,8 +318,8 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                 }
 
                 in = 0;
-                for (j = 0; j < pc->v.ranges->count; j++) {
-                    range = &pc->v.ranges->head[j];
+                for (j = 0; j < sre_vm_nranges(pc); j++) {
+                    range = &pc->v.ranges[j];
 
                     dd("testing %d for [%d, %d] (%u)", *sp, (int) range->from,
                        (int) range->to, (unsigned) j);
@@ -152,7 +334,19 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                     break;
                 }
 
-                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, sp + 1);
+                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, t->counter,
+                                           sp + 1);
+                break;
+
+            case SRE_OPCODE_BITMAP:
+                if (sp == last
+                    || !sre_vm_bitmap_test(sre_program_bitmap(prog, pc), *sp))
+                {
+                    break;
+                }
+
+                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, t->counter,
+                                           sp + 1);
                 break;
 
             case SRE_OPCODE_CHAR:
@@ -160,7 +354,8 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                     break;
                 }
 
-                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, sp + 1);
+                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, t->counter,
+                                           sp + 1);
                 break;
 
             case SRE_OPCODE_ANY:
@@ -168,7 +363,8 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
                     break;
                 }
 
-                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, sp + 1);
+                sre_vm_thompson_add_thread(ctx, nlist, pc + 1, t->counter,
+                                           sp + 1);
                 break;
 
             case SRE_OPCODE_ASSERT:
@@ -226,13 +422,28 @@ sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input, size_t size,
 
 assertion_hold:
                 ctx->tag--;
-                sre_vm_thompson_add_thread(ctx, clist, pc + 1, sp);
+                sre_vm_thompson_add_thread(ctx, clist, pc + 1, t->counter, sp);
                 ctx->tag++;
                 break;
 
             case SRE_OPCODE_MATCH:
-                prog->tag = ctx->tag;
-                return SRE_OK;
+                if (ctx->matched == NULL) {
+                    return SRE_OK;
+                }
+
+                if (ctx->matched[pc->v.regex_id]) {
+                    break;
+                }
+
+                dd("regex %d matched", (int) pc->v.regex_id);
+
+                ctx->matched[pc->v.regex_id] = 1;
+
+                if (++ctx->nmatched == prog->nregexes) {
+                    return sre_vm_thompson_set_result(ctx);
+                }
+
+                break;
 
             default:
                 /*
@@ -257,12 +468,14 @@ assertion_hold:
         }
     } /* for */
 
-    prog->tag = ctx->tag;
-
     ctx->current_threads = clist;
     ctx->next_threads = nlist;
 
     if (eof) {
+        if (ctx->matched) {
+            return sre_vm_thompson_set_result(ctx);
+        }
+
         return SRE_DECLINED;
     }
 
@@ -270,31 +483,111 @@ assertion_hold:
 }
 
 
+static sre_int_t
+sre_vm_thompson_set_result(sre_vm_thompson_ctx_t *ctx)
+{
+    sre_uint_t       i, n;
+
+    if (ctx->nmatched == 0) {
+        return SRE_DECLINED;
+    }
+
+    n = 0;
+    for (i = 0; i < ctx->program->nregexes; i++) {
+        if (ctx->matched[i]) {
+            ctx->regex_ids[n++] = (sre_int_t) i;
+        }
+    }
+
+    return (sre_int_t) n;
+}
+
+
 static void
 sre_vm_thompson_add_thread(sre_vm_thompson_ctx_t *ctx,
-    sre_vm_thompson_thread_list_t *l, sre_instruction_t *pc, sre_char *sp)
+    sre_vm_thompson_thread_list_t *l, sre_instruction_t *pc, unsigned counter,
+    sre_char *sp)
 {
     uint8_t                          seen_word = 0;
+    uint32_t                         i;
+    sre_uint_t                       idx;
+    sre_program_t                   *prog;
+    sre_vm_repeat_t                 *repeat;
     sre_vm_thompson_thread_t        *t;
 
-    if (pc->tag == ctx->tag) {  /* already on list */
+    prog = ctx->program;
+
+    if (prog->closure && sp != ctx->buffer) {
+        i = prog->closure->thompson[sp[-1] == '\n'][pc - prog->start];
+        if (i) {
+            sre_vm_thompson_add_closure(ctx, l, &prog->closure->entries[i],
+                                        sp);
+            return;
+        }
+    }
+
+    idx = sre_program_slot(prog, pc, counter);
+
+    if (ctx->tags[idx] == ctx->tag) {  /* already on list */
         return;
     }
 
-    pc->tag = ctx->tag;
+    ctx->tags[idx] = ctx->tag;
+
+    if (ctx->matched
+        && ctx->matched[ctx->regex_of[pc - ctx->program->start]])
+    {
+        /* no need to run a regex already matched in a set any more */
+        return;
+    }
 
     switch (pc->opcode) {
     case SRE_OPCODE_JMP:
-        sre_vm_thompson_add_thread(ctx, l, pc->x, sp);
+        sre_vm_thompson_add_thread(ctx, l, sre_program_x(prog, pc), counter, sp);
+        return;
+
+    case SRE_OPCODE_COUNT:
+        repeat = sre_program_repeat(prog, pc);
+        counter++;
+
+        if (counter < repeat->min) {
+            sre_vm_thompson_add_thread(ctx, l, sre_program_x(prog, pc), counter, sp);
+            return;
+        }
+
+        if (counter == repeat->max) {
+            sre_vm_thompson_add_thread(ctx, l, sre_program_y(prog, pc), 0, sp);
+            return;
+        }
+
+        if (repeat->max == 0) {
+            /* no more iterations need to be told apart */
+            counter = repeat->min;
+        }
+
+        if (repeat->greedy) {
+            sre_vm_thompson_add_thread(ctx, l, sre_program_x(prog, pc), counter, sp);
+            sre_vm_thompson_add_thread(ctx, l, sre_program_y(prog, pc), 0, sp);
+
+        } else {
+            sre_vm_thompson_add_thread(ctx, l, sre_program_y(prog, pc), 0, sp);
+            sre_vm_thompson_add_thread(ctx, l, sre_program_x(prog, pc), counter, sp);
+        }
+
         return;
 
     case SRE_OPCODE_SPLIT:
-        sre_vm_thompson_add_thread(ctx, l, pc->x, sp);
-        sre_vm_thompson_add_thread(ctx, l, pc->y, sp);
+        if (pc == ctx->program->start && ctx->program->multi) {
+            sre_vm_thompson_add_start_threads(ctx, l, sp);
+            return;
+        }
+
+        sre_vm_thompson_add_thread(ctx, l, sre_program_x(prog, pc), counter, sp);
+        sre_vm_thompson_add_thread(ctx, l, sre_program_y(prog, pc), counter, sp);
         return;
 
     case SRE_OPCODE_SAVE:
-        sre_vm_thompson_add_thread(ctx, l, pc + 1, sp);
+        sre_vm_thompson_add_thread(ctx, l, pc + 1, counter, sp);
         return;
 
     case SRE_OPCODE_ASSERT:
@@ -305,7 +598,7 @@ sre_vm_thompson_add_thread(sre_vm_thompson_ctx_t *ctx,
                 return;
             }
 
-            sre_vm_thompson_add_thread(ctx, l, pc + 1, sp);
+            sre_vm_thompson_add_thread(ctx, l, pc + 1, counter, sp);
             return;
 
         case SRE_REGEX_ASSERT_CARET:
@@ -313,7 +606,7 @@ sre_vm_thompson_add_thread(sre_vm_thompson_ctx_t *ctx,
                 return;
             }
 
-            sre_vm_thompson_add_thread(ctx, l, pc + 1, sp);
+            sre_vm_thompson_add_thread(ctx, l, pc + 1, counter, sp);
             return;
 
         case SRE_REGEX_ASSERT_SMALL_B:
@@ -340,18 +633,146 @@ sre_vm_thompson_add_thread(sre_vm_thompson_ctx_t *ctx,
     t = &l->threads[l->count];
     t->pc = pc;
     t->seen_word = seen_word;
+    t->counter = counter;
 
     l->count++;
 }
 
 
+/*
+ * Adds the threads of the closure "root" for sre_vm_thompson_add_thread,
+ * in the same order and with the same tags, without recursing over the
+ * program.
+ */
+static void
+sre_vm_thompson_add_closure(sre_vm_thompson_ctx_t *ctx,
+    sre_vm_thompson_thread_list_t *l, sre_vm_closure_entry_t *root,
+    sre_char *sp)
+{
+    uint8_t                          seen_word;
+    sre_uint_t                       idx;
+    sre_program_t                   *prog;
+    sre_instruction_t               *pc;
+    sre_vm_closure_entry_t          *e, *end;
+    sre_vm_thompson_thread_t        *t;
+
+    prog = ctx->program;
+    end = root + root->skip;
+
+    for (e = root; e < end; e++) {
+        pc = e->pc;
+        idx = pc - prog->start;
+
+        if (ctx->tags[idx] == ctx->tag) {
+            /* all the instructions reached from pc are tagged as well */
+            e += e->skip - 1;
+            continue;
+        }
+
+        ctx->tags[idx] = ctx->tag;
+
+        if (ctx->matched && ctx->matched[ctx->regex_of[idx]]) {
+            e += e->skip - 1;
+            continue;
+        }
+
+        switch (pc->opcode) {
+        case SRE_OPCODE_SPLIT:
+            if (pc == prog->start && prog->multi) {
+                sre_vm_thompson_add_start_threads(ctx, l, sp);
+            }
+
+            continue;
+
+        case SRE_OPCODE_JMP:
+        case SRE_OPCODE_SAVE:
+            continue;
+
+        case SRE_OPCODE_ASSERT:
+            switch (pc->v.assertion) {
+            case SRE_REGEX_ASSERT_BIG_A:
+            case SRE_REGEX_ASSERT_CARET:
+                /* the entries follow only when it holds */
+                continue;
+
+            case SRE_REGEX_ASSERT_SMALL_B:
+            case SRE_REGEX_ASSERT_BIG_B:
+                seen_word = sre_isword(sp[-1]);
+                break;
+
+            default:
+                /* postpone look-ahead assertions */
+                seen_word = 0;
+                break;
+            }
+
+            break;
+
+        default:
+            seen_word = 0;
+            break;
+        }
+
+        t = &l->threads[l->count++];
+        t->pc = pc;
+        t->seen_word = seen_word;
+        t->counter = 0;
+    }
+}
+
+
+/*
+ * Only starts the regexes in a multi-regex program whose literal prefix
+ * matches at "sp" (or may match with the next data chunk) and the ones
+ * without a prefix.
+ */
+static void
+sre_vm_thompson_add_start_threads(sre_vm_thompson_ctx_t *ctx,
+    sre_vm_thompson_thread_list_t *l, sre_char *sp)
+{
+    sre_int_t                n;
+    sre_uint_t               i, *hits;
+    sre_program_t           *prog;
+    sre_program_multi_t     *multi;
+
+    prog = ctx->program;
+    multi = prog->multi;
+
+    for (i = 0; i < multi->nalways; i++) {
+        sre_vm_thompson_add_thread(ctx, l,
+                                   sre_program_regex_start(prog,
+                                                           multi->always[i]),
+                                   0, sp);
+    }
+
+    if (!ctx->no_prefix_hits) {
+        hits = ctx->prefix_hits;
+
+        n = sre_multi_literal_match(&multi->prefixes, sp, ctx->last, hits);
+        if (n == SRE_AGAIN) {
+            hits = multi->gated;
+            n = (sre_int_t) multi->ngated;
+        }
+
+        for (i = 0; i < (sre_uint_t) n; i++) {
+            sre_vm_thompson_add_thread(ctx, l,
+                                       sre_program_regex_start(prog, hits[i]),
+                                       0, sp);
+        }
+    }
+
+    sre_vm_thompson_add_thread(ctx, l, sre_program_y(prog, prog->start), 0,
+                               sp);
+}
+
+
 sre_vm_thompson_thread_list_t *
 sre_vm_thompson_create_thread_list(sre_pool_t *pool, sre_uint_t size)
 {
     sre_vm_thompson_thread_list_t       *l;
 
-    l = sre_pnalloc(pool, sizeof(sre_vm_thompson_thread_list_t)
-                    + (size - 1) * sizeof(sre_vm_thompson_thread_t));
+    l = sre_palloc(pool, sizeof(sre_vm_thompson_thread_list_t)
+                   + (size - 1) * sizeof(sre_vm_thompson_thread_t));
     if (l == NULL) {
         return NULL;
     }
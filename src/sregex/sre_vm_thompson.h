@@ -12,12 +12,16 @@
 
 #include <sregex/sre_core.h>
 #include <sregex/sre_vm_bytecode.h>
+#include <sregex/sre_vm_inner.h>
+#include <sregex/sre_vm_glushkov.h>
 
 
 typedef struct {
     sre_instruction_t       *pc;
     void                    *asserts_handler;
     uint8_t                  seen_word;     /* :1 */
+    unsigned                 counter;       /* the iterations of the current
+                                               counter loop */
 } sre_vm_thompson_thread_t;
 
 
@@ -31,12 +35,31 @@ struct sre_vm_thompson_ctx_s {
     sre_pool_t          *pool;
     sre_program_t       *program;
     sre_char            *buffer;
+    sre_char            *last;
 
     sre_vm_thompson_thread_list_t       *current_threads;
     sre_vm_thompson_thread_list_t       *next_threads;
 
+    sre_instruction_t  **initial_states;
+    sre_uint_t           initial_states_count;
+
+    sre_vm_inner_ctx_t  *inner;
+    sre_vm_glushkov_ctx_t   *glushkov;  /* used instead of the threads if
+                                           the program fits */
+    sre_uint_t          *prefix_hits;   /* the regexes whose literal prefix
+                                           matches */
+
+    /* only used by the contexts created by sre_vm_thompson_create_set_ctx */
+    sre_int_t           *regex_ids;     /* output, the matched regexes */
+    uint8_t             *matched;       /* per regex */
+    sre_uint_t          *regex_of;      /* per instruction, the regex it
+                                           belongs to, or nregexes */
+    sre_uint_t           nmatched;
+
+    unsigned            *tags;  /* per-slot tags, see sre_program_slot */
     unsigned             tag;
     uint8_t              first_buf;     /* :1 */
+    uint8_t              no_prefix_hits;    /* :1 */
     uint8_t              threads_added[1];  /* bit array */
 };
 
@@ -46,5 +69,7 @@ sre_vm_thompson_thread_list_t *
 
 unsigned sre_vm_thompson_jit_get_threads_added_size(sre_program_t *prog);
 
+SRE_NOAPI sre_int_t sre_vm_thompson_jit_count_threads(sre_program_t *prog);
+
 
 #endif /* _SRE_VM_THOMPSON_H_INCLUDED_ */
@@ -53,6 +53,11 @@ sre_vm_thompson_jit_compile(sre_pool_t *pool, sre_program_t *prog,
 
     sre_vm_thompson_code_t      *code;
 
+    if (prog->slots) {
+        /* the threads of counter loops are left to the interpreter */
+        return SRE_DECLINED;
+    }
+
     glob = sre_pcalloc(pool, nglobs * sizeof(void *));
     if (glob == NULL) {
         return SRE_ERROR;
@@ -155,6 +160,38 @@ sre_vm_thompson_jit_compile(sre_pool_t *pool, sre_program_t *prog,
 }
 
 
+/*
+ * Sizes the thread lists and the threads_added bit array of the contexts
+ * the JIT compiled code of "prog" runs with, so that compiling that code
+ * later only reads the program.
+ */
+SRE_NOAPI sre_int_t
+sre_vm_thompson_jit_count_threads(sre_program_t *prog)
+{
+#if (SRE_TARGET != SRE_ARCH_X64)
+    return SRE_DECLINED;
+#else
+    sre_int_t        rc;
+    sre_pool_t      *pool;
+
+    if (prog->slots) {
+        return SRE_DECLINED;
+    }
+
+    pool = sre_create_pool(1024);
+    if (pool == NULL) {
+        return SRE_ERROR;
+    }
+
+    rc = sre_vm_thompson_jit_do_count(pool, prog);
+
+    sre_destroy_pool(pool);
+
+    return rc;
+#endif
+}
+
+
 SRE_API sre_int_t
 sre_vm_thompson_jit_free(sre_vm_thompson_code_t *code)
 {
@@ -216,7 +253,23 @@ sre_vm_thompson_jit_create_ctx(sre_pool_t *pool, sre_program_t *prog)
 
     ctx->next_threads = nlist;
 
-    ctx->tag = prog->tag + 1;
+    ctx->initial_states = NULL;
+    ctx->initial_states_count = 0;
+
+    if (prog->inner) {
+        ctx->inner = sre_vm_inner_create_ctx(pool, prog);
+        if (ctx->inner == NULL) {
+            return NULL;
+        }
+
+    } else {
+        ctx->inner = NULL;
+    }
+
+    ctx->glushkov = NULL;
+
+    ctx->tags = NULL;  /* not used by the JIT compiled code */
+    ctx->tag = 0;
     ctx->first_buf = 1;
 
     return ctx;
@@ -20,42 +20,47 @@
 
 //|.arch x64
 //|.actionlist sre_vm_thompson_jit_actions
-static const unsigned char sre_vm_thompson_jit_actions[703] = {
+static const unsigned char sre_vm_thompson_jit_actions[819] = {
   249,255,132,252,255,15,133,244,247,255,132,252,255,15,133,244,247,65,128,
   252,251,235,15,133,244,247,255,65,128,252,251,235,15,132,244,248,255,65,128,
   252,251,235,15,130,244,249,255,252,233,244,248,255,65,128,252,251,235,15,
   134,244,248,255,248,3,255,252,233,244,247,248,2,255,65,128,252,251,235,15,
   132,244,247,255,65,128,252,251,235,15,130,244,248,255,252,233,244,247,255,
-  65,128,252,251,235,15,134,244,247,255,73,105,198,239,77,141,132,253,7,233,
-  255,65,128,252,251,235,15,133,244,255,255,48,192,255,132,252,255,15,133,244,
-  248,255,65,128,252,251,235,15,130,244,248,65,128,252,251,235,15,134,244,249,
-  65,128,252,251,235,15,130,244,248,65,128,252,251,235,15,134,244,249,65,128,
-  252,251,235,15,130,244,248,65,128,252,251,235,15,134,244,249,65,128,252,251,
-  235,15,132,244,249,248,2,255,48,192,252,233,244,250,248,3,176,1,248,4,255,
-  72,139,143,233,255,72,15,186,252,233,235,15,130,244,248,255,72,137,143,233,
-  255,65,136,128,233,255,72,141,5,244,10,73,137,128,233,255,72,141,5,245,73,
-  137,128,233,255,72,49,192,73,137,128,233,255,73,131,198,1,255,73,129,192,
-  239,255,184,1,0,0,0,195,255,248,9,255,248,1,49,192,195,255,65,86,65,87,65,
-  80,65,85,82,65,84,65,82,85,65,81,83,65,83,81,133,201,15,132,244,247,179,1,
-  252,233,244,248,248,1,48,219,248,2,76,139,151,233,77,139,178,233,48,252,255,
-  138,135,233,132,192,15,132,244,11,248,12,198,135,233,0,77,137,215,77,49,252,
-  237,232,245,133,192,15,132,244,11,72,49,192,252,233,244,13,248,11,255,72,
-  1,252,242,76,139,191,233,73,137,252,244,252,233,244,14,248,15,73,131,196,
-  1,248,14,73,57,212,15,132,244,16,69,138,28,36,252,233,244,17,248,16,132,219,
-  15,132,244,18,183,1,248,17,77,133,252,246,15,132,244,19,255,76,141,135,233,
-  72,49,192,72,199,193,237,248,1,73,137,0,73,131,192,8,72,252,255,201,15,133,
-  244,1,255,72,49,201,255,73,105,198,239,77,141,140,253,2,233,73,141,170,233,
-  77,49,252,246,252,233,244,20,248,21,72,129,197,239,248,20,76,57,205,15,132,
-  244,22,255,72,139,133,233,72,133,192,15,132,244,247,252,255,208,133,192,15,
-  132,244,21,248,1,255,252,255,149,233,133,192,15,132,244,21,72,49,192,252,
-  233,244,13,248,22,76,137,208,77,137,252,250,73,137,199,132,252,255,15,132,
-  244,15,248,19,132,219,15,132,244,18,72,199,192,237,252,233,244,13,248,18,
-  72,199,192,237,248,13,76,137,151,233,77,137,178,233,76,137,191,233,255,77,
-  49,252,246,77,137,183,233,89,65,91,91,65,89,93,65,90,65,92,90,65,93,65,88,
-  65,95,65,94,195,255,248,10,184,1,0,0,0,195,255,132,252,255,15,132,244,247,
-  255,65,128,252,251,235,15,133,244,247,248,2,255,138,165,233,255,48,192,252,
-  233,244,250,248,3,176,1,248,4,48,224,255,184,1,0,0,0,195,248,1,49,192,195,
-  255
+  65,128,252,251,235,15,134,244,247,255,132,252,255,15,133,244,247,69,15,182,
+  219,72,184,237,237,68,15,163,24,15,131,244,247,255,73,105,198,239,77,141,
+  132,253,7,233,255,65,128,252,251,235,15,133,244,255,255,48,192,255,132,252,
+  255,15,133,244,248,255,65,128,252,251,235,15,130,244,248,65,128,252,251,235,
+  15,134,244,249,65,128,252,251,235,15,130,244,248,65,128,252,251,235,15,134,
+  244,249,65,128,252,251,235,15,130,244,248,65,128,252,251,235,15,134,244,249,
+  65,128,252,251,235,15,132,244,249,248,2,255,48,192,252,233,244,250,248,3,
+  176,1,248,4,255,72,139,143,233,255,72,15,186,252,233,235,15,130,244,248,255,
+  72,137,143,233,255,65,136,128,233,255,72,141,5,244,10,73,137,128,233,255,
+  72,141,5,245,73,137,128,233,255,72,49,192,73,137,128,233,255,73,131,198,1,
+  255,73,129,192,239,255,184,1,0,0,0,195,255,248,9,255,248,1,49,192,195,255,
+  65,86,65,87,65,80,65,85,82,65,84,65,82,85,65,81,83,65,83,81,133,201,15,132,
+  244,247,179,1,252,233,244,248,248,1,48,219,248,2,76,139,151,233,77,139,178,
+  233,48,252,255,138,135,233,132,192,15,132,244,11,248,12,198,135,233,0,77,
+  137,215,77,49,252,237,232,245,133,192,15,132,244,11,72,49,192,252,233,244,
+  13,248,11,255,72,1,252,242,76,139,191,233,73,137,252,244,252,233,244,14,248,
+  15,73,131,196,1,248,14,73,57,212,15,132,244,16,69,138,28,36,252,233,244,17,
+  248,16,132,219,15,132,244,18,183,1,248,17,77,133,252,246,15,132,244,19,255,
+  132,252,255,15,133,244,251,73,129,252,254,239,15,133,244,251,255,72,141,5,
+  245,73,59,130,233,15,133,244,251,255,87,86,82,65,82,65,83,255,72,191,237,
+  237,255,15,182,203,72,139,191,233,255,76,137,230,72,184,237,237,252,255,208,
+  65,91,65,90,90,94,95,73,141,140,253,36,233,72,57,200,15,134,244,251,76,141,
+  160,233,69,138,28,36,248,5,255,76,141,135,233,72,49,192,72,199,193,237,248,
+  1,73,137,0,73,131,192,8,72,252,255,201,15,133,244,1,255,72,49,201,255,73,
+  105,198,239,77,141,140,253,2,233,73,141,170,233,77,49,252,246,252,233,244,
+  20,248,21,72,129,197,239,248,20,76,57,205,15,132,244,22,255,72,139,133,233,
+  72,133,192,15,132,244,247,252,255,208,133,192,15,132,244,21,248,1,255,252,
+  255,149,233,133,192,15,132,244,21,72,49,192,252,233,244,13,248,22,76,137,
+  208,77,137,252,250,73,137,199,132,252,255,15,132,244,15,248,19,132,219,15,
+  132,244,18,72,199,192,237,252,233,244,13,248,18,72,199,192,237,248,13,76,
+  137,151,233,77,137,178,233,76,137,191,233,255,77,49,252,246,77,137,183,233,
+  89,65,91,91,65,89,93,65,90,65,92,90,65,93,65,88,65,95,65,94,195,255,248,10,
+  184,1,0,0,0,195,255,132,252,255,15,132,244,247,255,65,128,252,251,235,15,
+  133,244,247,248,2,255,138,165,233,255,48,192,252,233,244,250,248,3,176,1,
+  248,4,48,224,255,184,1,0,0,0,195,248,1,49,192,195,255
 };
 
 # 11 "src/sregex/sre_vm_thompson_x64.dasc"
@@ -152,7 +157,7 @@ static const char *const sre_vm_thompson_jit_global_names[] = {
 //|  lea rax, [target]
 //|  mov T->pc, rax
 //|
-//||if (jit->program->lookahead_asserts) {
+//||if (jit->lookahead_asserts) {
 //||  if (asserts) {
 //|
 //|     lea rax, [=>(jit->program->len + asserts - 1)]
@@ -178,7 +183,7 @@ static const char *const sre_vm_thompson_jit_global_names[] = {
 //||if (jit->threads_added_in_memory) {
 //||  if (tid / 64 != prev_word) {
 //||    prev_word = tid / 64;
-//|     mov ADDED, CTX->threads_added[(tid / 64)]
+//|     mov ADDED, CTX->threads_added[(tid / 64 * 8)]
 //||  }
 //|
 //||  bofs = tid % 64;
@@ -191,7 +196,7 @@ static const char *const sre_vm_thompson_jit_global_names[] = {
 //|  jb >2  // jump if CF = 1
 //|
 //||if (jit->threads_added_in_memory) {
-//|    mov CTX->threads_added[(tid / 64)], ADDED
+//|    mov CTX->threads_added[(tid / 64 * 8)], ADDED
 //||}
 //|
 //||if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
@@ -201,7 +206,7 @@ static const char *const sre_vm_thompson_jit_global_names[] = {
 //|  lea rax, [target]
 //|  mov T->pc, rax
 //|
-//||if (jit->program->lookahead_asserts) {
+//||if (jit->lookahead_asserts) {
 //||  if (asserts) {
 //|     lea rax, [=>(jit->program->len + asserts - 1)]
 //|     mov T->asserts_handler, rax
@@ -270,6 +275,7 @@ typedef struct {
     sre_pool_t      *pool;
     sre_program_t   *program;
     dasm_State     **dasm;
+    unsigned        *tags;  /* per-instruction tags, indexed by pc */
     unsigned         tag;
     unsigned         thread_index_factor;
 
@@ -278,6 +284,9 @@ typedef struct {
     unsigned         threads_added_in_memory;  /* 1: use ctx->threads_added;
                                                   0: use the CPU register
                                                      ADDED only */
+    unsigned         uniq_threads;
+    unsigned         dup_threads;
+    unsigned         lookahead_asserts;
 
     sre_vm_thompson_path_t  *path;
 } sre_vm_thompson_jit_t;
@@ -302,6 +311,8 @@ struct sre_vm_thompson_path_s {
 };
 
 
+static sre_int_t sre_vm_thompson_jit_analyze(sre_vm_thompson_jit_t *jit,
+    sre_pool_t *pool, sre_program_t *prog);
 static sre_int_t sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
     sre_vm_thompson_path_t *path);
 static sre_int_t sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit);
@@ -316,79 +327,53 @@ static unsigned sre_vm_thompson_jit_gen_thread_index(sre_vm_thompson_jit_t *jit,
 
 
 SRE_NOAPI sre_int_t
-sre_vm_thompson_jit_do_compile(dasm_State **dasm, sre_pool_t *pool,
-    sre_program_t *prog)
+sre_vm_thompson_jit_do_count(sre_pool_t *pool, sre_program_t *prog)
 {
-    unsigned                        i, n, count;
     sre_vm_thompson_jit_t           jit;
-    sre_vm_thompson_path_t         *path, **last_path;
-
-    jit.pool = pool;
-    jit.program = prog;
-    jit.dasm = dasm;
 
-    jit.bc_accessed = sre_pcalloc(pool, prog->len);
-    if (jit.bc_accessed == NULL) {
+    if (sre_vm_thompson_jit_analyze(&jit, pool, prog) != SRE_OK) {
         return SRE_ERROR;
     }
 
-    jit.thread_index_factor = (SRE_REGEX_ASSERT_LOOKAHEAD + 1);
+    prog->uniq_threads = jit.uniq_threads;
+    prog->dup_threads = jit.dup_threads;
+    prog->lookahead_asserts = jit.lookahead_asserts;
 
-    dd("prog len: %d", (int) prog->len);
-    dd("thread index factor: %d", (int) jit.thread_index_factor);
+    return SRE_OK;
+}
 
-    count = prog->len * jit.thread_index_factor;
-    dd("thread index count: %d", (int) count);
 
-    jit.dup_thread_ids = sre_pcalloc(pool, count * sizeof(int));
-    if (jit.dup_thread_ids == NULL) {
+SRE_NOAPI sre_int_t
+sre_vm_thompson_jit_do_compile(dasm_State **dasm, sre_pool_t *pool,
+    sre_program_t *prog)
+{
+    unsigned                        n;
+    sre_vm_thompson_jit_t           jit;
+    sre_vm_thompson_path_t         *path;
+
+    if (sre_vm_thompson_jit_analyze(&jit, pool, prog) != SRE_OK) {
         return SRE_ERROR;
     }
 
-    jit.path = NULL;
-    last_path = &jit.path;
+    /* the contexts are sized by the counts the program got when compiled */
 
-    if (sre_vm_thompson_jit_build_paths(&jit, prog->start, &last_path)
-        != SRE_OK)
+    if (jit.uniq_threads != prog->uniq_threads ||
+        jit.dup_threads != prog->dup_threads ||
+        jit.lookahead_asserts != prog->lookahead_asserts)
     {
+        dd("thread counts not matching the program");
         return SRE_ERROR;
     }
 
-    dd("first path: %p, pc: %d", jit.path,
-       (int) (jit.path->from - jit.program->start));
-
-    n = 0;
-    for (i = 0; i < count; i++) {
-        if (jit.dup_thread_ids[i] > 0) {
-            dd("found unique thread at pc %d, ref count: %d",
-               (int) (i / jit.thread_index_factor), (int) jit.dup_thread_ids[i]);
-
-            prog->uniq_threads++;
-
-            if (jit.dup_thread_ids[i] > 1) {
-                dd("found duplicatable thread at pc %d, ref count: %d",
-                   (int) (i / jit.thread_index_factor), (int) jit.dup_thread_ids[i]);
-
-                jit.dup_thread_ids[i] = n++;
-                continue;
-            }
-        }
-
-        jit.dup_thread_ids[i] = -1;
-    }
-
-    prog->dup_threads = n;
-
-    dd("unique threads: %u, duplicatable threads: %u",
-       prog->uniq_threads, prog->dup_threads);
+    jit.dasm = dasm;
 
-    jit.threads_added_in_memory = (prog->dup_threads > 64);
+    jit.threads_added_in_memory = (jit.dup_threads > 64);
 
 #if 0
     jit.threads_added_in_memory = 1;
 #endif
 
-    n = prog->len + prog->lookahead_asserts;
+    n = prog->len + jit.lookahead_asserts;
 
     dd("growing pc label to %d, prog len: %d", n, (int) prog->len);
     dasm_growpc(dasm, n);
@@ -415,6 +400,116 @@ sre_vm_thompson_jit_do_compile(dasm_State **dasm, sre_pool_t *pool,
 }
 
 
+static sre_int_t
+sre_vm_thompson_jit_analyze(sre_vm_thompson_jit_t *jit, sre_pool_t *pool,
+    sre_program_t *prog)
+{
+    unsigned                        i, n, ofs, count;
+    sre_vm_thompson_path_t         *path, **last_path;
+    sre_vm_thompson_state_t        *state;
+
+    jit->pool = pool;
+    jit->program = prog;
+    jit->dasm = NULL;
+    jit->lookahead_asserts = 0;
+
+    jit->bc_accessed = sre_pcalloc(pool, prog->len);
+    if (jit->bc_accessed == NULL) {
+        return SRE_ERROR;
+    }
+
+    jit->tags = sre_pcalloc(pool, prog->len * sizeof(unsigned));
+    if (jit->tags == NULL) {
+        return SRE_ERROR;
+    }
+
+    jit->tag = 0;
+
+    jit->thread_index_factor = (SRE_REGEX_ASSERT_LOOKAHEAD + 1);
+
+    dd("prog len: %d", (int) prog->len);
+    dd("thread index factor: %d", (int) jit->thread_index_factor);
+
+    count = prog->len * jit->thread_index_factor;
+    dd("thread index count: %d", (int) count);
+
+    jit->dup_thread_ids = sre_pcalloc(pool, count * sizeof(int));
+    if (jit->dup_thread_ids == NULL) {
+        return SRE_ERROR;
+    }
+
+    jit->path = NULL;
+    last_path = &jit->path;
+
+    if (sre_vm_thompson_jit_build_paths(jit, prog->start, &last_path)
+        != SRE_OK)
+    {
+        return SRE_ERROR;
+    }
+
+    dd("first path: %p, pc: %d", jit->path,
+       (int) (jit->path->from - jit->program->start));
+
+    /*
+     * a path runs once for every thread at its bytecode, and there can be
+     * several such threads with different pending look-ahead assertions,
+     * so the threads added by the path need the duplicate check as well.
+     */
+
+    for (path = jit->path; path; path = path->next) {
+        ofs = (path->from - prog->start) * jit->thread_index_factor;
+
+        n = 0;
+        for (i = 0; i < jit->thread_index_factor; i++) {
+            if (jit->dup_thread_ids[ofs + i] > 0) {
+                n++;
+            }
+        }
+
+        if (n < 2) {
+            continue;
+        }
+
+        for (state = path->to; state; state = state->next) {
+            if (state->is_thread) {
+                jit->dup_thread_ids[state->thread_index]++;
+            }
+        }
+    }
+
+    n = 0;
+    jit->uniq_threads = 0;
+
+    for (i = 0; i < count; i++) {
+        if (jit->dup_thread_ids[i] > 0) {
+            dd("found unique thread at pc %d, ref count: %d",
+               (int) (i / jit->thread_index_factor),
+               (int) jit->dup_thread_ids[i]);
+
+            jit->uniq_threads++;
+
+            if (jit->dup_thread_ids[i] > 1) {
+                dd("found duplicatable thread at pc %d, ref count: %d",
+                   (int) (i / jit->thread_index_factor),
+                   (int) jit->dup_thread_ids[i]);
+
+                jit->dup_thread_ids[i] = n++;
+                continue;
+            }
+        }
+
+        jit->dup_thread_ids[i] = -1;
+    }
+
+    jit->dup_threads = n;
+
+    dd("unique threads: %u, duplicatable threads: %u",
+       jit->uniq_threads, jit->dup_threads);
+
+    return SRE_OK;
+}
+
+
 static sre_int_t
 sre_vm_thompson_jit_build_paths(sre_vm_thompson_jit_t *jit, sre_instruction_t *pc,
     sre_vm_thompson_path_t ***plast_path)
@@ -433,20 +528,18 @@ sre_vm_thompson_jit_build_paths(sre_vm_thompson_jit_t *jit, sre_instruction_t *p
 
     path->from = pc;
     last_state = &path->to;
-    jit->tag = jit->program->tag + 1;
+    jit->tag++;
 
     if (pc == jit->program->start) {
         if (sre_vm_thompson_jit_get_next_states(jit, pc, &last_state,
                                                 &path->nthreads, 0)
             != SRE_OK)
         {
-            jit->program->tag = jit->tag;
             return SRE_ERROR;
         }
 
     } else {
         if (pc + 1 >= jit->program->start + jit->program->len) {
-            jit->program->tag = jit->tag;
             return SRE_ERROR;
         }
 
@@ -454,13 +547,10 @@ sre_vm_thompson_jit_build_paths(sre_vm_thompson_jit_t *jit, sre_instruction_t *p
                                                 &path->nthreads, 0)
             != SRE_OK)
         {
-            jit->program->tag = jit->tag;
             return SRE_ERROR;
         }
     }
 
-    jit->program->tag = jit->tag;
-
     if (path->to == NULL) {
         return SRE_ERROR;
     }
@@ -517,14 +607,14 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
 
     //|=>(ofs):
     dasm_put(Dst, 0, (ofs));
-# 424 "src/sregex/sre_vm_thompson_x64.dasc"
+# 509 "src/sregex/sre_vm_thompson_x64.dasc"
 
     switch (pc->opcode) {
     case SRE_OPCODE_ANY:
         //|  test LB, LB
         //|  jnz >1
         dasm_put(Dst, 2);
-# 429 "src/sregex/sre_vm_thompson_x64.dasc"
+# 514 "src/sregex/sre_vm_thompson_x64.dasc"
 
         break;
 
@@ -537,7 +627,7 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
         //|  cmp C, byte (c)
         //|  jne >1
         dasm_put(Dst, 10, (c));
-# 440 "src/sregex/sre_vm_thompson_x64.dasc"
+# 525 "src/sregex/sre_vm_thompson_x64.dasc"
 
         break;
 
@@ -545,10 +635,10 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
         //|  test LB, LB
         //|  jnz >1
         dasm_put(Dst, 2);
-# 446 "src/sregex/sre_vm_thompson_x64.dasc"
+# 531 "src/sregex/sre_vm_thompson_x64.dasc"
 
-        for (i = 0; i < pc->v.ranges->count; i++) {
-            range = &pc->v.ranges->head[i];
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
 
             dd("compile opcode IN: [%d, %d] (%u)", (int) range->from,
                (int) range->to, (unsigned) i);
@@ -557,38 +647,38 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
                 //|  cmp C, byte (range->from)
                 //|  je >2
                 dasm_put(Dst, 27, (range->from));
-# 456 "src/sregex/sre_vm_thompson_x64.dasc"
+# 541 "src/sregex/sre_vm_thompson_x64.dasc"
 
             } else {
                 if (range->from != 0x00) {
                     //|  cmp C, byte (range->from)
                     //|  jb >3
                     dasm_put(Dst, 37, (range->from));
-# 461 "src/sregex/sre_vm_thompson_x64.dasc"
+# 546 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
                 if (range->to == 0xff) {
                     //|  jmp >2
                     dasm_put(Dst, 47);
-# 465 "src/sregex/sre_vm_thompson_x64.dasc"
+# 550 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 } else {
                     //|  cmp C, byte (range->to)
                     //|  jbe >2
                     dasm_put(Dst, 52, (range->to));
-# 469 "src/sregex/sre_vm_thompson_x64.dasc"
+# 554 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
                 //|3:
                 dasm_put(Dst, 62);
-# 472 "src/sregex/sre_vm_thompson_x64.dasc"
+# 557 "src/sregex/sre_vm_thompson_x64.dasc"
             }
         }
 
         //|  jmp >1
         //|2:
         dasm_put(Dst, 65);
-# 477 "src/sregex/sre_vm_thompson_x64.dasc"
+# 562 "src/sregex/sre_vm_thompson_x64.dasc"
 
         break;
 
@@ -596,10 +686,10 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
         //|  test LB, LB
         //|  jnz >1
         dasm_put(Dst, 2);
-# 483 "src/sregex/sre_vm_thompson_x64.dasc"
+# 568 "src/sregex/sre_vm_thompson_x64.dasc"
 
-        for (i = 0; i < pc->v.ranges->count; i++) {
-            range = &pc->v.ranges->head[i];
+        for (i = 0; i < sre_vm_nranges(pc); i++) {
+            range = &pc->v.ranges[i];
 
             dd("compile opcode IN: [%d, %d] (%u)", (int) range->from,
                (int) range->to, (unsigned) i);
@@ -608,38 +698,51 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
                 //|  cmp C, byte (range->from)
                 //|  je >1
                 dasm_put(Dst, 72, (range->from));
-# 493 "src/sregex/sre_vm_thompson_x64.dasc"
+# 578 "src/sregex/sre_vm_thompson_x64.dasc"
 
             } else {
                 if (range->from != 0x00) {
                     //|  cmp C, byte (range->from)
                     //|  jb >2
                     dasm_put(Dst, 82, (range->from));
-# 498 "src/sregex/sre_vm_thompson_x64.dasc"
+# 583 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
                 if (range->to == 0xff) {
                     //|  jmp >1
                     dasm_put(Dst, 92);
-# 502 "src/sregex/sre_vm_thompson_x64.dasc"
+# 587 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 } else {
                     //|  cmp C, byte (range->to)
                     //|  jbe >1
                     dasm_put(Dst, 97, (range->to));
-# 506 "src/sregex/sre_vm_thompson_x64.dasc"
+# 591 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
                 if (range->from != 0x00) {
                     //|2:
                     dasm_put(Dst, 69);
-# 510 "src/sregex/sre_vm_thompson_x64.dasc"
+# 595 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
             }
         }
 
         break;
 
+    case SRE_OPCODE_BITMAP:
+        //|  test LB, LB
+        //|  jnz >1
+        //|
+        //|  movzx r11d, C
+        //|  mov64 rax, ((uintptr_t) sre_program_bitmap(jit->program, pc))
+        //|  bt dword [rax], r11d
+        //|  jnc >1
+        dasm_put(Dst, 107, (unsigned int)(((uintptr_t) sre_program_bitmap(jit->program, pc))), (unsigned int)((((uintptr_t) sre_program_bitmap(jit->program, pc)))>>32));
+# 609 "src/sregex/sre_vm_thompson_x64.dasc"
+
+        break;
+
     default:
         /* do nothing */
         break;
@@ -657,8 +760,8 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
             if (n == 1) {
                 //|  imul rax, TC, #T  // thread index offset
                 //|  lea T, [TL + rax + offsetof(sre_vm_thompson_thread_list_t, threads)]
-                dasm_put(Dst, 107, sizeof(sre_vm_thompson_thread_t), offsetof(sre_vm_thompson_thread_list_t, threads));
-# 533 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 131, sizeof(sre_vm_thompson_thread_t), offsetof(sre_vm_thompson_thread_list_t, threads));
+# 629 "src/sregex/sre_vm_thompson_x64.dasc"
             }
         }
 
@@ -682,25 +785,25 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
                 if (pc != jit->program->start) {
                     //|  cmp C, byte '\n'
                     //|  jne >9
-                    dasm_put(Dst, 118, '\n');
-# 556 "src/sregex/sre_vm_thompson_x64.dasc"
+                    dasm_put(Dst, 142, '\n');
+# 652 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
             }
 
             if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
                 if (pc == jit->program->start) {
                     //|  xor al, al
-                    dasm_put(Dst, 128);
-# 562 "src/sregex/sre_vm_thompson_x64.dasc"
+                    dasm_put(Dst, 152);
+# 658 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 } else {
                     //|  testWordChar
                     if (!char_always_valid) {
-                    dasm_put(Dst, 131);
+                    dasm_put(Dst, 155);
                     }
-                    dasm_put(Dst, 139, '0', '9', 'A', 'Z', 'a', 'z', '_');
-                    dasm_put(Dst, 205);
-# 565 "src/sregex/sre_vm_thompson_x64.dasc"
+                    dasm_put(Dst, 163, '0', '9', 'A', 'Z', 'a', 'z', '_');
+                    dasm_put(Dst, 229);
+# 661 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
             }
         }
@@ -721,61 +824,61 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
                     if (jit->threads_added_in_memory) {
                       if (tid / 64 != prev_word) {
                         prev_word = tid / 64;
-                    dasm_put(Dst, 218, Dt1(->threads_added[(tid / 64)]));
+                    dasm_put(Dst, 242, Dt1(->threads_added[(tid / 64 * 8)]));
                       }
                       bofs = tid % 64;
                     } else {
                       bofs = tid;
                     }
-                    dasm_put(Dst, 223, (bofs));
+                    dasm_put(Dst, 247, (bofs));
                     if (jit->threads_added_in_memory) {
-                    dasm_put(Dst, 234, Dt1(->threads_added[(tid / 64)]));
+                    dasm_put(Dst, 258, Dt1(->threads_added[(tid / 64 * 8)]));
                     }
                     if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
-                    dasm_put(Dst, 239, Dt3(->seen_word));
+                    dasm_put(Dst, 263, Dt3(->seen_word));
                     }
-                    dasm_put(Dst, 244, Dt3(->pc));
-                    if (jit->program->lookahead_asserts) {
+                    dasm_put(Dst, 268, Dt3(->pc));
+                    if (jit->lookahead_asserts) {
                       if (asserts) {
-                    dasm_put(Dst, 254, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
+                    dasm_put(Dst, 278, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
                       } else {
-                    dasm_put(Dst, 263, Dt3(->asserts_handler));
+                    dasm_put(Dst, 287, Dt3(->asserts_handler));
                       }
                     }
-                    dasm_put(Dst, 271);
+                    dasm_put(Dst, 295);
                     if (n != path->nthreads) {
-                    dasm_put(Dst, 276, sizeof(sre_vm_thompson_thread_t));
+                    dasm_put(Dst, 300, sizeof(sre_vm_thompson_thread_t));
                     }
                     dasm_put(Dst, 69);
-# 582 "src/sregex/sre_vm_thompson_x64.dasc"
+# 678 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 } else {
                     dd("seen a non thread entry match at bc %d", (int) ofs);
 
                     //|  addThreadWithoutCheck ->match
                     if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
-                    dasm_put(Dst, 239, Dt3(->seen_word));
+                    dasm_put(Dst, 263, Dt3(->seen_word));
                     }
-                    dasm_put(Dst, 244, Dt3(->pc));
-                    if (jit->program->lookahead_asserts) {
+                    dasm_put(Dst, 268, Dt3(->pc));
+                    if (jit->lookahead_asserts) {
                       if (asserts) {
-                    dasm_put(Dst, 254, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
+                    dasm_put(Dst, 278, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
                       } else {
-                    dasm_put(Dst, 263, Dt3(->asserts_handler));
+                    dasm_put(Dst, 287, Dt3(->asserts_handler));
                       }
                     }
-                    dasm_put(Dst, 271);
+                    dasm_put(Dst, 295);
                     if (n != path->nthreads) {
-                    dasm_put(Dst, 276, sizeof(sre_vm_thompson_thread_t));
+                    dasm_put(Dst, 300, sizeof(sre_vm_thompson_thread_t));
                     }
-# 587 "src/sregex/sre_vm_thompson_x64.dasc"
+# 683 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
             } else {
                 //|  mov eax, 1
                 //|  ret
-                dasm_put(Dst, 281);
-# 592 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 305);
+# 688 "src/sregex/sre_vm_thompson_x64.dasc"
             }
 
         } else {
@@ -792,66 +895,66 @@ sre_vm_thompson_jit_compile_path(sre_vm_thompson_jit_t *jit,
                 if (jit->threads_added_in_memory) {
                   if (tid / 64 != prev_word) {
                     prev_word = tid / 64;
-                dasm_put(Dst, 218, Dt1(->threads_added[(tid / 64)]));
+                dasm_put(Dst, 242, Dt1(->threads_added[(tid / 64 * 8)]));
                   }
                   bofs = tid % 64;
                 } else {
                   bofs = tid;
                 }
-                dasm_put(Dst, 223, (bofs));
+                dasm_put(Dst, 247, (bofs));
                 if (jit->threads_added_in_memory) {
-                dasm_put(Dst, 234, Dt1(->threads_added[(tid / 64)]));
+                dasm_put(Dst, 258, Dt1(->threads_added[(tid / 64 * 8)]));
                 }
                 if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
-                dasm_put(Dst, 239, Dt3(->seen_word));
+                dasm_put(Dst, 263, Dt3(->seen_word));
                 }
-                dasm_put(Dst, 254, (ofs), Dt3(->pc));
-                if (jit->program->lookahead_asserts) {
+                dasm_put(Dst, 278, (ofs), Dt3(->pc));
+                if (jit->lookahead_asserts) {
                   if (asserts) {
-                dasm_put(Dst, 254, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
+                dasm_put(Dst, 278, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
                   } else {
-                dasm_put(Dst, 263, Dt3(->asserts_handler));
+                dasm_put(Dst, 287, Dt3(->asserts_handler));
                   }
                 }
-                dasm_put(Dst, 271);
+                dasm_put(Dst, 295);
                 if (n != path->nthreads) {
-                dasm_put(Dst, 276, sizeof(sre_vm_thompson_thread_t));
+                dasm_put(Dst, 300, sizeof(sre_vm_thompson_thread_t));
                 }
                 dasm_put(Dst, 69);
-# 605 "src/sregex/sre_vm_thompson_x64.dasc"
+# 701 "src/sregex/sre_vm_thompson_x64.dasc"
 
             } else {
                 dd("seen a non thread entry bc at bc %d", (int) ofs);
                 //|  addThreadWithoutCheck =>(ofs)
                 if (asserts & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
-                dasm_put(Dst, 239, Dt3(->seen_word));
+                dasm_put(Dst, 263, Dt3(->seen_word));
                 }
-                dasm_put(Dst, 254, (ofs), Dt3(->pc));
-                if (jit->program->lookahead_asserts) {
+                dasm_put(Dst, 278, (ofs), Dt3(->pc));
+                if (jit->lookahead_asserts) {
                   if (asserts) {
-                dasm_put(Dst, 254, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
+                dasm_put(Dst, 278, (jit->program->len + asserts - 1), Dt3(->asserts_handler));
                   } else {
-                dasm_put(Dst, 263, Dt3(->asserts_handler));
+                dasm_put(Dst, 287, Dt3(->asserts_handler));
                   }
                 }
-                dasm_put(Dst, 271);
+                dasm_put(Dst, 295);
                 if (n != path->nthreads) {
-                dasm_put(Dst, 276, sizeof(sre_vm_thompson_thread_t));
+                dasm_put(Dst, 300, sizeof(sre_vm_thompson_thread_t));
                 }
-# 609 "src/sregex/sre_vm_thompson_x64.dasc"
+# 705 "src/sregex/sre_vm_thompson_x64.dasc"
             }
         }
 
         //|9:
-        dasm_put(Dst, 288);
-# 613 "src/sregex/sre_vm_thompson_x64.dasc"
+        dasm_put(Dst, 312);
+# 709 "src/sregex/sre_vm_thompson_x64.dasc"
     } /* for */
 
     //|1:
     //|  xor eax, eax
     //|  ret
-    dasm_put(Dst, 291);
-# 618 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 315);
+# 714 "src/sregex/sre_vm_thompson_x64.dasc"
 
     return SRE_OK;
 }
@@ -862,29 +965,39 @@ sre_vm_thompson_jit_get_next_states(sre_vm_thompson_jit_t *jit,
     sre_instruction_t *pc, sre_vm_thompson_state_t ***plast_state,
     unsigned *nthreads, unsigned asserts)
 {
+    sre_uint_t                   idx;
+    sre_program_t               *prog;
     sre_vm_thompson_state_t     *state;
 
-    if (pc->tag == jit->tag) {
+    prog = jit->program;
+    idx = pc - prog->start;
+
+    if (jit->tags[idx] == jit->tag) {
         return SRE_OK;
     }
 
-    pc->tag = jit->tag;
+    jit->tags[idx] = jit->tag;
 
     switch (pc->opcode) {
     case SRE_OPCODE_SPLIT:
-        if (sre_vm_thompson_jit_get_next_states(jit, pc->x, plast_state,
-                                                nthreads, asserts)
+        if (sre_vm_thompson_jit_get_next_states(jit, sre_program_x(prog, pc),
+                                                plast_state, nthreads,
+                                                asserts)
             != SRE_OK)
         {
             return SRE_ERROR;
         }
 
-        return sre_vm_thompson_jit_get_next_states(jit, pc->y, plast_state,
-                                                   nthreads, asserts);
+        return sre_vm_thompson_jit_get_next_states(jit,
+                                                   sre_program_y(prog, pc),
+                                                   plast_state, nthreads,
+                                                   asserts);
 
     case SRE_OPCODE_JMP:
-        return sre_vm_thompson_jit_get_next_states(jit, pc->x, plast_state,
-                                                   nthreads, asserts);
+        return sre_vm_thompson_jit_get_next_states(jit,
+                                                   sre_program_x(prog, pc),
+                                                   plast_state, nthreads,
+                                                   asserts);
 
     case SRE_OPCODE_SAVE:
         if (++pc == jit->program->start + jit->program->len) {
@@ -925,7 +1038,7 @@ sre_vm_thompson_jit_get_next_states(sre_vm_thompson_jit_t *jit,
 
         asserts |= pc->v.assertion;
 
-        jit->program->lookahead_asserts |= (asserts & SRE_REGEX_ASSERT_LOOKAHEAD);
+        jit->lookahead_asserts |= (asserts & SRE_REGEX_ASSERT_LOOKAHEAD);
 
         if (++pc == jit->program->start + jit->program->len) {
             return SRE_OK;
@@ -935,7 +1048,7 @@ sre_vm_thompson_jit_get_next_states(sre_vm_thompson_jit_t *jit,
                                                    nthreads, asserts);
 
     default:
-        /* CHAR, ANY, IN, NOTIN */
+        /* CHAR, ANY, IN, NOTIN, BITMAP */
 
         state = sre_pcalloc(jit->pool, sizeof(sre_vm_thompson_state_t));
         if (state == NULL) {
@@ -975,10 +1088,32 @@ sre_vm_thompson_jit_gen_thread_index(sre_vm_thompson_jit_t *jit,
 static sre_int_t
 sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
 {
-    size_t       size;
-    dasm_State **dasm;
+    size_t                   size;
+    unsigned                 i, n;
+    void                    *finder;
+    uintptr_t                find;
+    dasm_State             **dasm;
+    sre_byteset_t           *set;
+    sre_instruction_t       *start;
+    sre_vm_thompson_state_t *state;
 
     dasm = jit->dasm;
+    start = jit->program->start;
+    set = jit->program->leading_set;
+
+    /* the threads added by the path from the start bytecode */
+
+    n = 0;
+    for (state = jit->path->to; state; state = state->next) {
+        if (state->bc->opcode == SRE_OPCODE_MATCH) {
+            n = 0;
+            break;
+        }
+
+        if (state->is_thread) {
+            n++;
+        }
+    }
 
     //|  push TC; push TL; push T; push SW; push LAST; push SP;
     //|  push CTL; push CT; push LT; push rbx; push r11; push ADDED
@@ -1014,8 +1149,8 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
     //|
     //|->not_first_buf:
     //|  add LAST, INPUT  // last = input + size
-    dasm_put(Dst, 297, Dt1(->current_threads), Dt5(->count), Dt1(->first_buf), Dt1(->first_buf), 0);
-# 780 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 321, Dt1(->current_threads), Dt5(->count), Dt1(->first_buf), Dt1(->first_buf), 0);
+# 908 "src/sregex/sre_vm_thompson_x64.dasc"
     //|  mov TL, CTX->next_threads
     //|  mov SP, INPUT
     //|
@@ -1041,8 +1176,81 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
     //|  test TC, TC
     //|  jz ->done
     //|
-    dasm_put(Dst, 386, Dt1(->next_threads));
-# 805 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 410, Dt1(->next_threads));
+# 933 "src/sregex/sre_vm_thompson_x64.dasc"
+
+    if ((set || jit->program->inner) && n) {
+        /*
+         * when only the start state is alive, skip to the byte right
+         * before the next possible match start (see sre_vm_thompson_exec)
+         */
+
+        finder = NULL;
+
+        if (jit->program->prefix) {
+            finder = jit->program->prefix;
+            find = (uintptr_t) jit->program->prefix->find;
+
+        } else if (jit->program->inner) {
+            find = (uintptr_t) sre_vm_inner_find;
+
+        } else {
+            finder = set;
+            find = (uintptr_t) set->find;
+        }
+
+        //|  test LB, LB
+        //|  jnz >5
+        //|  cmp TC, n
+        //|  jne >5
+        dasm_put(Dst, 470, n);
+# 958 "src/sregex/sre_vm_thompson_x64.dasc"
+
+        i = 0;
+        for (state = jit->path->to; state; state = state->next) {
+            if (state->is_thread) {
+                //|  lea rax, [=>(state->bc - start)]
+                //|  cmp rax, CTL->threads[i].pc
+                //|  jne >5
+                dasm_put(Dst, 487, (state->bc - start), Dt5(->threads[i].pc));
+# 965 "src/sregex/sre_vm_thompson_x64.dasc"
+
+                i++;
+            }
+        }
+
+        //|  // the stack is 16-byte aligned after pushing 5 registers
+        //|  push CTX; push INPUT; push LAST; push CTL; push r11
+        dasm_put(Dst, 500);
+# 972 "src/sregex/sre_vm_thompson_x64.dasc"
+
+        if (finder) {
+            //|  mov64 rdi, ((uintptr_t) finder)
+            dasm_put(Dst, 508, (unsigned int)(((uintptr_t) finder)), (unsigned int)((((uintptr_t) finder))>>32));
+# 975 "src/sregex/sre_vm_thompson_x64.dasc"
+
+        } else {
+            //|  movzx ecx, EOF
+            //|  mov rdi, CTX->inner
+            dasm_put(Dst, 513, Dt1(->inner));
+# 979 "src/sregex/sre_vm_thompson_x64.dasc"
+        }
+
+        //|  mov rsi, SP
+        //|  mov64 rax, find
+        //|  call rax
+        //|  pop r11; pop CTL; pop LAST; pop INPUT; pop CTX
+        //|
+        //|  lea rcx, [SP + 1]
+        //|  cmp rax, rcx
+        //|  jbe >5
+        //|  lea SP, [rax - 1]
+        //|  mov C, byte [SP]
+        //|5:
+        dasm_put(Dst, 521, (unsigned int)(find), (unsigned int)((find)>>32), 1, - 1);
+# 992 "src/sregex/sre_vm_thompson_x64.dasc"
+    }
+
 
     if (jit->threads_added_in_memory) {
         size = sre_vm_thompson_jit_get_threads_added_size(jit->program);
@@ -1058,13 +1266,13 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
         //|  add r8, 8
         //|  dec rcx
         //|  jnz <1
-        dasm_put(Dst, 446, Dt1(->threads_added), (size / 8));
-# 820 "src/sregex/sre_vm_thompson_x64.dasc"
+        dasm_put(Dst, 562, Dt1(->threads_added), (size / 8));
+# 1009 "src/sregex/sre_vm_thompson_x64.dasc"
 
     } else {
         //|  xor ADDED, ADDED
-        dasm_put(Dst, 475);
-# 823 "src/sregex/sre_vm_thompson_x64.dasc"
+        dasm_put(Dst, 591);
+# 1012 "src/sregex/sre_vm_thompson_x64.dasc"
     }
 
     //|  imul rax, TC, #T  // thread index offset
@@ -1080,10 +1288,10 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
     //|  cmp CT, LT
     //|  je ->run_threads_done
     //|
-    dasm_put(Dst, 479, sizeof(sre_vm_thompson_thread_t), offsetof(sre_vm_thompson_thread_list_t, threads), offsetof(sre_vm_thompson_thread_list_t, threads), sizeof(sre_vm_thompson_thread_t));
-# 838 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 595, sizeof(sre_vm_thompson_thread_t), offsetof(sre_vm_thompson_thread_list_t, threads), offsetof(sre_vm_thompson_thread_list_t, threads), sizeof(sre_vm_thompson_thread_t));
+# 1027 "src/sregex/sre_vm_thompson_x64.dasc"
 
-    if (jit->program->lookahead_asserts) {
+    if (jit->lookahead_asserts) {
         //|  mov rax, CT->asserts_handler
         //|  test rax, rax
         //|  jz >1
@@ -1092,8 +1300,8 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
         //|  jz ->run_next_thread
         //|
         //|1:
-        dasm_put(Dst, 517, Dt4(->asserts_handler));
-# 848 "src/sregex/sre_vm_thompson_x64.dasc"
+        dasm_put(Dst, 633, Dt4(->asserts_handler));
+# 1037 "src/sregex/sre_vm_thompson_x64.dasc"
     }
 
     //|  call aword CT->pc
@@ -1128,15 +1336,15 @@ sre_vm_thompson_jit_prologue(sre_vm_thompson_jit_t *jit)
     //|
     //|  mov CTX->next_threads, TL
     //|  xor TC, TC
-    dasm_put(Dst, 540, Dt4(->pc), (SRE_DECLINED), (SRE_AGAIN), Dt1(->current_threads), Dt5(->count), Dt1(->next_threads));
-# 882 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 656, Dt4(->pc), (SRE_DECLINED), (SRE_AGAIN), Dt1(->current_threads), Dt5(->count), Dt1(->next_threads));
+# 1071 "src/sregex/sre_vm_thompson_x64.dasc"
     //|  mov TL->count, TC
     //|
     //|  pop ADDED; pop r11; pop rbx; pop LT; pop CT; pop CTL;
     //|  pop SP; pop LAST; pop SW; pop T; pop TL; pop TC
     //|  ret
-    dasm_put(Dst, 613, Dt2(->count));
-# 887 "src/sregex/sre_vm_thompson_x64.dasc"
+    dasm_put(Dst, 729, Dt2(->count));
+# 1076 "src/sregex/sre_vm_thompson_x64.dasc"
 
     return SRE_OK;
 }
@@ -1149,7 +1357,7 @@ sre_vm_thompson_jit_epilogue(sre_vm_thompson_jit_t *jit)
     sre_uint_t   len;
     dasm_State **dasm;
 
-    if (jit->program->lookahead_asserts) {
+    if (jit->lookahead_asserts) {
 
         dasm = jit->dasm;
         len = jit->program->len;
@@ -1157,64 +1365,64 @@ sre_vm_thompson_jit_epilogue(sre_vm_thompson_jit_t *jit)
         //|->match:
         //|  mov eax, 1
         //|  ret
-        dasm_put(Dst, 643);
-# 907 "src/sregex/sre_vm_thompson_x64.dasc"
+        dasm_put(Dst, 759);
+# 1096 "src/sregex/sre_vm_thompson_x64.dasc"
 
         for (flags = 1; flags <= SRE_REGEX_ASSERT_LOOKAHEAD; flags++) {
 
-            if ((flags & jit->program->lookahead_asserts) != flags) {
+            if ((flags & jit->lookahead_asserts) != flags) {
                 continue;
             }
 
             //|=>(len + flags - 1):
             dasm_put(Dst, 0, (len + flags - 1));
-# 915 "src/sregex/sre_vm_thompson_x64.dasc"
+# 1104 "src/sregex/sre_vm_thompson_x64.dasc"
 
             if (flags & SRE_REGEX_ASSERT_SMALL_Z) {
                 //|  test LB, LB
                 //|  jz >1
-                dasm_put(Dst, 652);
-# 919 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 768);
+# 1108 "src/sregex/sre_vm_thompson_x64.dasc"
             }
 
             if (flags & SRE_REGEX_ASSERT_DOLLAR) {
                 if (!(flags & SRE_REGEX_ASSERT_SMALL_Z)) {
                     //|  test LB, LB
                     //|  jnz >2
-                    dasm_put(Dst, 131);
-# 925 "src/sregex/sre_vm_thompson_x64.dasc"
+                    dasm_put(Dst, 155);
+# 1114 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
 
                 //|  cmp C, '\n'
                 //|  jne >1
                 //|2:
-                dasm_put(Dst, 660, '\n');
-# 930 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 776, '\n');
+# 1119 "src/sregex/sre_vm_thompson_x64.dasc"
             }
 
             if (flags & SRE_REGEX_ASSERT_WORD_BOUNDARY) {
                 //|  mov ah, byte CT->seen_word
                 //|  testWordChar
-                dasm_put(Dst, 672, Dt4(->seen_word));
+                dasm_put(Dst, 788, Dt4(->seen_word));
                 if (!char_always_valid) {
-                dasm_put(Dst, 131);
+                dasm_put(Dst, 155);
                 }
-                dasm_put(Dst, 139, '0', '9', 'A', 'Z', 'a', 'z', '_');
-# 935 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 163, '0', '9', 'A', 'Z', 'a', 'z', '_');
+# 1124 "src/sregex/sre_vm_thompson_x64.dasc"
                 //|  xor al, ah
-                dasm_put(Dst, 676);
-# 936 "src/sregex/sre_vm_thompson_x64.dasc"
+                dasm_put(Dst, 792);
+# 1125 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 if (flags & SRE_REGEX_ASSERT_SMALL_B) {
                     //|  jz >1
                     dasm_put(Dst, 77);
-# 939 "src/sregex/sre_vm_thompson_x64.dasc"
+# 1128 "src/sregex/sre_vm_thompson_x64.dasc"
 
                 } else {
                     /* SRE_REGEX_ASSERT_BIG_B */
                     //|  jnz >1
                     dasm_put(Dst, 5);
-# 943 "src/sregex/sre_vm_thompson_x64.dasc"
+# 1132 "src/sregex/sre_vm_thompson_x64.dasc"
                 }
             }
 
@@ -1223,8 +1431,8 @@ sre_vm_thompson_jit_epilogue(sre_vm_thompson_jit_t *jit)
             //|1:
             //|  xor eax, eax
             //|  ret
-            dasm_put(Dst, 691);
-# 951 "src/sregex/sre_vm_thompson_x64.dasc"
+            dasm_put(Dst, 807);
+# 1140 "src/sregex/sre_vm_thompson_x64.dasc"
         }
     }
 
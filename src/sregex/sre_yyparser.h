@@ -1,8 +1,9 @@
-/* A Bison parser, made by GNU Bison 3.0.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015 Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
    This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
@@ -15,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -30,6 +31,10 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 #ifndef YY_SREGEX_YY_SRC_SREGEX_SRE_YYPARSER_H_INCLUDED
 # define YY_SREGEX_YY_SRC_SREGEX_SRE_YYPARSER_H_INCLUDED
 /* Debug traces.  */
@@ -40,35 +45,39 @@
 extern int sregex_yydebug;
 #endif
 
-/* Token type.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    SRE_REGEX_TOKEN_CHAR = 258,
-    SRE_REGEX_TOKEN_EOF = 259,
-    SRE_REGEX_TOKEN_BAD = 260,
-    SRE_REGEX_TOKEN_CQUANT = 261,
-    SRE_REGEX_TOKEN_CHAR_CLASS = 262,
-    SRE_REGEX_TOKEN_ASSERTION = 263
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    SRE_REGEX_TOKEN_CHAR = 258,    /* SRE_REGEX_TOKEN_CHAR  */
+    SRE_REGEX_TOKEN_EOF = 259,     /* SRE_REGEX_TOKEN_EOF  */
+    SRE_REGEX_TOKEN_BAD = 260,     /* SRE_REGEX_TOKEN_BAD  */
+    SRE_REGEX_TOKEN_CQUANT = 261,  /* SRE_REGEX_TOKEN_CQUANT  */
+    SRE_REGEX_TOKEN_CHAR_CLASS = 262, /* SRE_REGEX_TOKEN_CHAR_CLASS  */
+    SRE_REGEX_TOKEN_ASSERTION = 263 /* SRE_REGEX_TOKEN_ASSERTION  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-
 union YYSTYPE
 {
-#line 82 "src/sregex/sre_yyparser.y"
+#line 84 "src/sregex/sre_yyparser.y"
 
     sre_regex_t         *re;
     sre_char             ch;
     sre_uint_t           group;
     sre_regex_cquant_t   cquant;
 
-#line 70 "src/sregex/sre_yyparser.h"
-};
+#line 79 "src/sregex/sre_yyparser.h"
 
+};
 typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
 # define YYSTYPE_IS_DECLARED 1
@@ -90,6 +99,8 @@ struct YYLTYPE
 
 
 
+
 int sregex_yyparse (sre_pool_t *pool, sre_char **src, sre_uint_t *ncaps, int flags, sre_regex_t **parsed, sre_char **err_pos);
 
+
 #endif /* !YY_SREGEX_YY_SRC_SREGEX_SRE_YYPARSER_H_INCLUDED  */
@@ -51,8 +51,10 @@ static int yylex(YYSTYPE *lvalp, YYLTYPE *locp, sre_pool_t *pool,
 static void yyerror(YYLTYPE *locp, sre_pool_t *pool, sre_char **src,
     sre_uint_t *ncaps, int flags, sre_regex_t **parsed, sre_char **err_pos,
     char *s);
+static unsigned sre_regex_countable(sre_regex_t *subj,
+    sre_regex_cquant_t *cquant);
 static sre_regex_t *sre_regex_desugar_counted_repetition(sre_pool_t *pool,
-    sre_regex_t *subj, sre_regex_cquant_t *cquant, unsigned greedy);
+    sre_regex_t *subj, sre_regex_cquant_t *cquant);
 
 %}
 
@@ -200,8 +202,14 @@ repeat: atom
 
       | atom SRE_REGEX_TOKEN_CQUANT
         {
-            $$ = sre_regex_desugar_counted_repetition(pool, $1, &$2,
-                                                      1 /* greedy */);
+            if (!sre_regex_countable($1, &$2)) {
+                *err_pos = @2.pos;
+                YYABORT;
+            }
+
+            $2.greedy = 1;
+
+            $$ = sre_regex_desugar_counted_repetition(pool, $1, &$2);
             if ($$ == NULL) {
                 YYABORT;
             }
@@ -209,8 +217,14 @@ repeat: atom
 
       | atom SRE_REGEX_TOKEN_CQUANT '?'
         {
-            $$ = sre_regex_desugar_counted_repetition(pool, $1, &$2,
-                                                      0 /* greedy */);
+            if (!sre_regex_countable($1, &$2)) {
+                *err_pos = @2.pos;
+                YYABORT;
+            }
+
+            $2.greedy = 0;
+
+            $$ = sre_regex_desugar_counted_repetition(pool, $1, &$2);
             if ($$ == NULL) {
                 YYABORT;
             }
@@ -1730,7 +1744,7 @@ process_char:
 cquant_parsed:
         dd("from = %d, to = %d, next: %d", from, to, (*src)[0]);
 
-        if (from >= 500 || to >= 500) {
+        if (from > SRE_REGEX_MAX_COUNT || to > SRE_REGEX_MAX_COUNT) {
             dd("from or to too large: %d %d", from, to);
             locp->last = *src;
             return SRE_REGEX_TOKEN_BAD;
@@ -1967,17 +1981,66 @@ sre_regex_parse_multi(sre_pool_t *pool, sre_char **regexes,
 }
 
 
+/*
+ * Tells whether subj{from,to} can be compiled: either it is small enough to
+ * be unrolled or subj can be the body of a counter loop.
+ */
+static unsigned
+sre_regex_countable(sre_regex_t *subj, sre_regex_cquant_t *cquant)
+{
+    if (cquant->from < SRE_REGEX_MAX_UNROLLED
+        && cquant->to < SRE_REGEX_MAX_UNROLLED)
+    {
+        return 1;
+    }
+
+    return !sre_regex_nullable(subj) && !sre_regex_has_repeat(subj);
+}
+
+
 static sre_regex_t *
 sre_regex_desugar_counted_repetition(sre_pool_t *pool, sre_regex_t *subj,
-    sre_regex_cquant_t *cquant, unsigned greedy)
+    sre_regex_cquant_t *cquant)
 {
-    int                  i;
-    sre_regex_t         *concat, *quest, *star;
+    int                  i, bound;
+    sre_regex_t         *concat, *quest, *star, *repeat;
 
     if (cquant->from == 1 && cquant->to == 1) {
         return subj;
     }
 
+    bound = cquant->to == -1 ? cquant->from : cquant->to;
+
+    if (bound > SRE_REGEX_MAX_UNROLL
+        && !sre_regex_nullable(subj) && !sre_regex_has_repeat(subj))
+    {
+        /* keep subj once in a counter loop: subj{from,to} */
+
+        repeat = sre_regex_create(pool, SRE_REGEX_TYPE_REPEAT, subj, NULL);
+        if (repeat == NULL) {
+            return NULL;
+        }
+
+        repeat->data.cquant = *cquant;
+
+        if (cquant->from > 0) {
+            return repeat;
+        }
+
+        /* the loop must run at least once: (?:subj{1,to})? */
+
+        repeat->data.cquant.from = 1;
+
+        quest = sre_regex_create(pool, SRE_REGEX_TYPE_QUEST, repeat, NULL);
+        if (quest == NULL) {
+            return NULL;
+        }
+
+        quest->data.greedy = cquant->greedy;
+
+        return quest;
+    }
+
     /* generate subj{from} first */
 
     if (cquant->from == 0) {
@@ -2012,7 +2075,7 @@ sre_regex_desugar_counted_repetition(sre_pool_t *pool, sre_regex_t *subj,
             return NULL;
         }
 
-        star->data.greedy = greedy;
+        star->data.greedy = cquant->greedy;
 
         concat = sre_regex_create(pool, SRE_REGEX_TYPE_CAT, concat, star);
         if (concat == NULL) {
@@ -2030,7 +2093,7 @@ sre_regex_desugar_counted_repetition(sre_pool_t *pool, sre_regex_t *subj,
         return NULL;
     }
 
-    quest->data.greedy = greedy;
+    quest->data.greedy = cquant->greedy;
 
     for ( ; i < cquant->to; i++) {
         concat = sre_regex_create(pool, SRE_REGEX_TYPE_CAT, concat, quest);
@@ -118,6 +118,13 @@ SRE_API void sre_program_dump(sre_program_t *prog);
 
 SRE_API sre_program_t *sre_regex_compile(sre_pool_t *pool, sre_regex_t *re);
 
+SRE_API sre_program_t *sre_regex_compile_captures(sre_pool_t *pool,
+    sre_regex_t *re, sre_uint_t ncaps);
+
+SRE_API sre_int_t sre_program_save(sre_program_t *prog, const char *path);
+
+SRE_API sre_program_t *sre_program_load(sre_pool_t *pool, const char *path);
+
 
 /* the Pike VM API */
 
@@ -146,6 +153,9 @@ SRE_API sre_vm_thompson_ctx_t *sre_vm_thompson_create_ctx(sre_pool_t *pool,
 SRE_API sre_int_t sre_vm_thompson_exec(sre_vm_thompson_ctx_t *ctx, sre_char *input,
     size_t len, unsigned eof);
 
+SRE_API sre_vm_thompson_ctx_t *sre_vm_thompson_create_set_ctx(sre_pool_t *pool,
+    sre_program_t *prog, sre_int_t *regex_ids);
+
 
 /* Thompson VM JIT API */
 
@@ -170,4 +180,60 @@ SRE_API sre_vm_thompson_exec_pt
 SRE_API sre_int_t sre_vm_thompson_jit_free(sre_vm_thompson_code_t *code);
 
 
+/* Pike VM JIT API */
+
+
+struct sre_vm_pike_code_s;
+typedef struct sre_vm_pike_code_s  sre_vm_pike_code_t;
+
+
+typedef sre_int_t (*sre_vm_pike_exec_pt)(sre_vm_pike_ctx_t *ctx,
+    sre_char *input, size_t size, unsigned eof, sre_int_t **pending_matched);
+
+
+SRE_API sre_int_t sre_vm_pike_jit_compile(sre_pool_t *pool,
+    sre_program_t *prog, sre_vm_pike_code_t **pcode);
+
+SRE_API sre_vm_pike_exec_pt
+    sre_vm_pike_jit_get_handler(sre_vm_pike_code_t *code);
+
+SRE_API sre_int_t sre_vm_pike_jit_free(sre_vm_pike_code_t *code);
+
+
+/* the lazy DFA API */
+
+
+struct sre_vm_dfa_ctx_s;
+typedef struct sre_vm_dfa_ctx_s  sre_vm_dfa_ctx_t;
+
+
+SRE_API sre_vm_dfa_ctx_t *sre_vm_dfa_create_ctx(sre_pool_t *pool,
+    sre_program_t *prog, size_t cache_size);
+
+SRE_API sre_int_t sre_vm_dfa_exec(sre_vm_dfa_ctx_t *ctx, sre_char *input,
+    size_t len, unsigned eof);
+
+
+/* the full DFA API */
+
+
+struct sre_vm_dfa_table_s;
+typedef struct sre_vm_dfa_table_s  sre_vm_dfa_table_t;
+
+struct sre_vm_dfa_table_ctx_s;
+typedef struct sre_vm_dfa_table_ctx_s  sre_vm_dfa_table_ctx_t;
+
+
+SRE_API sre_int_t sre_vm_dfa_compile(sre_pool_t *pool, sre_program_t *prog,
+    sre_uint_t max_states, sre_vm_dfa_table_t **ptable);
+
+SRE_API sre_uint_t sre_vm_dfa_table_nstates(sre_vm_dfa_table_t *table);
+
+SRE_API sre_vm_dfa_table_ctx_t *sre_vm_dfa_table_create_ctx(sre_pool_t *pool,
+    sre_vm_dfa_table_t *table);
+
+SRE_API sre_int_t sre_vm_dfa_table_exec(sre_vm_dfa_table_ctx_t *ctx,
+    sre_char *input, size_t len, unsigned eof);
+
+
 #endif /* _SREGEX_H_INCLUDED_ */
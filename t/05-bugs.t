@@ -44,3 +44,16 @@ __DATA__
 --- err
 [error] syntax error at pos 0
 
+
+
+
+=== TEST 6: Thompson JIT thread list overflow with pending look-ahead assertions
+--- re: $\s+?[xy]-+
+--- s eval: "a\n \n \n1\n\n \n-x- \n\nx--"
+--- cap: (15, 20)
+
+
+
+=== TEST 7: Thompson JIT duplicate check of more than 64 threads
+--- re: ((}x+)?\B){3}a{0,23}|(($b*(a|b)?){2})
+--- s eval: "B "
@@ -0,0 +1,57 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: captures
+--- re: (\w+)=(\w+);
+--- s: hello, foo=bar; baz=quux;
+--- threads: 8
+
+
+
+=== TEST 2: no match
+--- re: a(b|c)*d
+--- s: abcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbc
+--- threads: 8
+
+
+
+=== TEST 3: leading bytes
+--- re: [xy]z+|q
+--- s: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaayzzzzz
+--- threads: 8
+
+
+
+=== TEST 4: assertions
+--- re: \bwor(l)d\b|o$|^h
+--- s: say hello world
+--- threads: 8
+
+
+
+=== TEST 5: non-greedy
+--- re: a(.*?)b(.*)c
+--- s: xxaxxxbxxbxxcxxcxx
+--- threads: 8
+
+
+
+=== TEST 6: multiple regexes
+--- re eval: ["ab(c)", "b(c+)d", "(x)"]
+--- s: abbccccdabc
+--- cap: (2, 8) (3, 7)
+--- match_id: 1
+--- threads: 8
+
+
+
+=== TEST 7: caseless
+--- re: HeL+o
+--- flags: i
+--- s: sayhELLLO
+--- threads: 8
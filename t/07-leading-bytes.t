@@ -0,0 +1,123 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: single leading byte
+--- re: x(y+)
+--- s: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaxyyy
+
+
+
+=== TEST 2: two leading bytes (caseless)
+--- re: abc
+--- s: xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxAbxaBC
+--- flags: i
+
+
+
+=== TEST 3: larger leading byte set
+--- re: [a-e]z|q\d
+--- s: ---------------------------------------------------------q1
+--- cap: (57, 59)
+
+
+
+=== TEST 4: leading byte set with a high byte
+--- re eval: "[\x{80}-\x{90}]\x{ff}|a\x{81}"
+--- s eval: "-" x 70 . "\x{85}\x{80}\x{85}\x{ff}"
+--- cap: (72, 74)
+
+
+
+=== TEST 5: negated class in the leading bytes
+--- re: [^a-z]x|ab
+--- s: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa-x
+
+
+
+=== TEST 6: word boundary right after the skipped bytes
+--- re: \bfoo
+--- s: ---------------------------------------------xfoo-foo
+--- cap: (50, 53)
+
+
+
+=== TEST 7: no word boundary right after the skipped bytes
+--- re: \Bfoo
+--- s: ---------------------------------------------xfoo
+--- cap: (46, 49)
+
+
+
+=== TEST 8: caret after a newline
+--- re: ^foo
+--- s eval: "-" x 40 . "foo\nfoo"
+--- cap: (44, 47)
+
+
+
+=== TEST 9: dollar after the skipped bytes
+--- re: o$
+--- s: ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo-
+--- no_match
+
+
+
+=== TEST 10: leading byte at the very end
+--- re: zq?
+--- s: --------------------------------------------------------------z
+--- cap: (62, 63)
+
+
+
+=== TEST 11: no leading byte at all
+--- re: [zq]foo
+--- s: -----------------------------------------------------------------
+--- no_match
+
+
+
+=== TEST 12: literal prefix
+--- re: hello(\w+)
+--- s: hell hel help hellx hello hellohello world
+--- cap: (26, 36) (31, 36)
+
+
+
+=== TEST 13: caseless literal prefix
+--- re: get /x\b
+--- s: GET /xy get /X-
+--- flags: i
+--- cap: (8, 14)
+
+
+
+=== TEST 14: literal prefix with assertions inside
+--- re: \bfoo\b-bar
+--- s: xfoo-bar foo-baz foo-bar
+--- cap: (17, 24)
+
+
+
+=== TEST 15: literal prefix followed by a loop
+--- re: ab(?:cd)+e
+--- s: abcabdabcdcdabcdcde
+--- cap: (12, 19)
+
+
+
+=== TEST 16: partial literal prefix at the very end
+--- re: abcdef
+--- s: ----------------------------------------------------------abcde
+--- no_match
+
+
+
+=== TEST 17: long literal prefix found after many false candidates
+--- re eval: "a" . ("b" x 40) . "c"
+--- s eval: ("a" . ("b" x 39) . "c") x 5 . "a" . ("b" x 40) . "c"
+--- cap: (205, 247)
@@ -0,0 +1,97 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: literal after a word run
+--- re: \w+@example\.com
+--- s: mail me at foo@bar.com, joe@example.org or joe.doe@example.com.
+--- cap: (47, 62)
+
+
+
+=== TEST 2: literal after a counted class
+--- re: [0-9]{3}-secret-[a-z]+
+--- s: 12-secret-x 4-secret-y 1234-secret-abc
+--- cap: (24, 38)
+
+
+
+=== TEST 3: the leftmost start is found before the literal
+--- re: (a|ab)(c|bcd)@(d*)
+--- s: xxabcd@dd
+--- cap: (2, 9) (2, 3) (3, 6) (7, 9)
+
+
+
+=== TEST 4: the prefix fails on the first literal hits
+--- re: \d+@x
+--- s: a@x b@x @x 12@y 34@x
+--- cap: (16, 20)
+
+
+
+=== TEST 5: caseless literal
+--- re: \d+-secret
+--- s: 1-sec 22-SeCrEt
+--- flags: i
+--- cap: (6, 15)
+
+
+
+=== TEST 6: assertions in the prefix
+--- re: \b\d+\b:x
+--- s: a1:x 12 :x 3:x
+--- cap: (11, 14)
+
+
+
+=== TEST 7: no literal at all
+--- re: [a-z]+@host
+--- s: -------------------------------------------------------------------
+--- no_match
+
+
+
+=== TEST 8: literal at the very end without a prefix match
+--- re: [a-z]+@host
+--- s: ---------------------------------------------------------------@host
+--- no_match
+
+
+
+=== TEST 9: partial literal at the very end
+--- re: [a-z]+@host
+--- s: ------------------------------------------------------------abc@hos
+--- no_match
+
+
+
+=== TEST 10: literal across the chunks
+--- re: [a-z]+@host
+--- s: ------------------------------------------------------------abc@host
+--- cap: (60, 68)
+
+
+
+=== TEST 11: the literal is matched inside the prefix (not used)
+--- re: [a-z@]+@host
+--- s: --a@@host
+--- cap: (2, 9)
+
+
+
+=== TEST 12: nullable prefix
+--- re: \d*-x-
+--- s: ab-c--x-
+--- cap: (5, 8)
+
+
+
+=== TEST 13: many literal hits
+--- re: [a-z]{3}@\d
+--- s eval: "\@1 " x 100 . "abc\@1"
+--- cap: (300, 305)
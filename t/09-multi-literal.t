@@ -0,0 +1,143 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: skip to the literal prefixes of all the regexes
+--- re eval: ['foo\d', 'bar']
+--- s: xxxxbarfoo1
+--- cap: (4, 7)
+--- match_id: 1
+
+
+
+=== TEST 2: regexes started at the same position keep their order
+--- re eval: ["ab", "a"]
+--- s: xxab
+--- cap: (2, 4)
+--- match_id: 0
+
+
+
+=== TEST 3: regexes started at the same position keep their order
+--- re eval: ["a", "ab"]
+--- s: xxab
+--- cap: (2, 3)
+--- match_id: 0
+
+
+
+=== TEST 4: a regex without a literal prefix is always started
+--- re eval: ['\d+x', 'abc']
+--- s: 12abc3x
+--- cap: (2, 5)
+--- match_id: 1
+
+
+
+=== TEST 5: a regex without a literal prefix is always started
+--- re eval: ['abc', '\d+x']
+--- s: 12abc3x
+--- cap: (2, 5)
+--- match_id: 0
+
+
+
+=== TEST 6: caseless prefix
+--- re eval: ['ABC', 'xyz']
+--- s: -xYz-aBc
+--- flags eval: "i "
+--- cap: (5, 8)
+--- match_id: 0
+
+
+
+=== TEST 7: caseless and case-sensitive prefixes sharing bytes
+--- re eval: ['abc', 'ABD', 'abd']
+--- s: ABcAbDabd
+--- flags eval: "  i"
+--- cap: (3, 6)
+--- match_id: 2
+
+
+
+=== TEST 8: a prefix is a prefix of another one
+--- re eval: ["abcd", "abc"]
+--- s: abcabcd
+--- cap: (0, 3)
+--- match_id: 1
+
+
+
+=== TEST 9: overlapping prefixes
+--- re eval: ["bcd", "abcx"]
+--- s: abcd
+--- cap: (1, 4)
+--- match_id: 0
+
+
+
+=== TEST 10: prefix cut before a class
+--- re eval: ['[xy]z1', 'q']
+--- s: yz1q
+--- cap: (0, 3)
+--- match_id: 0
+
+
+
+=== TEST 11: submatches
+--- re eval: ['(ab)c', 'x(y)']
+--- s: --xy
+--- cap: (2, 4) (3, 4)
+--- match_id: 1
+
+
+
+=== TEST 12: prefixes after assertions
+--- re eval: ['\b@-?', '@a']
+--- s: X@-
+--- cap: (1, 3)
+--- match_id: 0
+
+
+
+=== TEST 13: many regexes
+--- re eval: [map { "r${_}z" } 1 .. 40]
+--- s: r4 r40z r4z
+--- cap: (3, 7)
+--- match_id: 39
+
+
+
+=== TEST 14: many regexes, caseless
+--- re eval: [map { "r${_}z" } 1 .. 40]
+--- s: R4 R40Z r4z
+--- flags eval: join " ", ("i") x 40
+--- cap: (3, 7)
+--- match_id: 39
+
+
+
+=== TEST 15: many regexes with one always started
+--- re eval: [(map { "k${_}=" } 1 .. 40), '\d\d\d']
+--- s eval: "k1 k2 " x 20 . "k7=123"
+--- cap: (120, 123)
+--- match_id: 6
+
+
+
+=== TEST 16: long subject
+--- re eval: ['secret\d', 'token=', 'passwd']
+--- s eval: "-" x 300 . "token" . "-" x 200 . "passwd"
+--- cap: (505, 511)
+--- match_id: 2
+
+
+
+=== TEST 17: no match
+--- re eval: ['foo', 'bar']
+--- s eval: "fo ba " x 30 . "fo"
+--- no_match
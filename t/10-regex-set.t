@@ -0,0 +1,95 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: all the matching regexes
+--- re eval: ['a', 'b\d', 'c$']
+--- s: xab1c
+--- cap: (1, 2)
+--- match_id: 0
+--- match_set: match 0 1 2
+
+
+
+=== TEST 2: only some regexes match
+--- re eval: ['a', 'b\d', 'c$']
+--- s: b2b3
+--- cap: (0, 2)
+--- match_id: 1
+--- match_set: match 1
+
+
+
+=== TEST 3: the ids are in ascending order
+--- re eval: ['foo', 'bar', 'baz']
+--- s: baz bar foo
+--- cap: (0, 3)
+--- match_id: 2
+--- match_set: match 0 1 2
+
+
+
+=== TEST 4: no regex matches
+--- re eval: ['foo', 'bar']
+--- s: fo ba
+--- no_match
+--- match_set: no match
+
+
+
+=== TEST 5: matches in later data chunks
+--- re eval: ['^a', '\d{3}', 'z\b']
+--- s eval: "a" . "-" x 100 . "12z 345"
+--- cap: (0, 1)
+--- match_id: 0
+--- match_set: match 0 1 2
+
+
+
+=== TEST 6: regexes without a literal prefix
+--- re eval: ['\w+@\w+', '[0-9]+x', 'key=']
+--- s: 1 2 key=a@b
+--- cap: (4, 8)
+--- match_id: 2
+--- match_set: match 0 2
+
+
+
+=== TEST 7: a regex matching the empty string
+--- re eval: ['foo', 'x*']
+--- s: bar
+--- cap: (0, 0)
+--- match_id: 1
+--- match_set: match 1
+
+
+
+=== TEST 8: a regex still running after others matched
+--- re eval: ['a.*z', 'b']
+--- s: abcdz
+--- cap: (0, 5)
+--- match_id: 0
+--- match_set: match 0 1
+
+
+
+=== TEST 9: many regexes
+--- re eval: [map { "r${_}z" } 1 .. 40]
+--- s: r4z r40z r7 r17z
+--- cap: (0, 3)
+--- match_id: 3
+--- match_set: match 3 16 39
+
+
+
+=== TEST 10: caseless regexes
+--- re eval: ['abc', 'xyz', 'q']
+--- s: -XyZ-aBc
+--- flags eval: "i i "
+--- cap: (1, 4)
+--- match_id: 1
+--- match_set: match 0 1
@@ -0,0 +1,140 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: a large upper bound
+--- re: [^\n]{1,4096}
+--- s eval: "a" x 5000 . "\n" . "b" x 10
+
+
+
+=== TEST 2: exact count
+--- re: a{1000}
+--- s eval: "b" . "a" x 1200
+
+
+
+=== TEST 3: exact count not reached
+--- re: a{1000}
+--- s eval: "a" x 999 . "b" . "a" x 999
+
+
+
+=== TEST 4: no upper bound
+--- re: x{600,}
+--- s eval: "x" x 599 . "-" . "x" x 700
+
+
+
+=== TEST 5: no upper bound, not reached
+--- re: x{600,}y
+--- s eval: "x" x 599 . "y"
+
+
+
+=== TEST 6: submatches in the loop body
+--- re: (?:(\d{1,3})\.){3}(\d{1,3}){1,500}
+--- s: ip 10.20.30.4567 z
+
+
+
+=== TEST 7: the last iteration is captured
+--- re: (ab|c){33,}
+--- s eval: "ab" x 20 . "c" x 20 . "ab"
+
+
+
+=== TEST 8: not greedy
+--- re: (a{40,60}?)(a*)
+--- s eval: "a" x 70
+
+
+
+=== TEST 9: not greedy, no upper bound
+--- re: (.{40,}?)x
+--- s eval: "x" x 100
+
+
+
+=== TEST 10: optional loop
+--- re: ba{0,100}
+--- s eval: "b" . "a" x 120
+
+
+
+=== TEST 11: optional loop, not greedy
+--- re: b(a{0,100}?)a
+--- s eval: "b" . "a" x 120
+
+
+
+=== TEST 12: alternatives of different lengths in the loop body
+--- re: (?:a|bc){2,100}c
+--- s eval: "x" . "abc" x 50 . "c"
+
+
+
+=== TEST 13: a loop inside a star
+--- re: (?:-\d{1,40})*\$
+--- s eval: "-" . "1" x 30 . "-" . "2" x 41 . "-" . "3" x 40 . '$'
+
+
+
+=== TEST 14: a loop after an assertion
+--- re: \b\w{33}\b
+--- s eval: "a" x 34 . " " . "b" x 33
+
+
+
+=== TEST 15: multiple regexes
+--- re eval: ['\d{40}', 'b{35,}', 'x{3}']
+--- s eval: "1" x 39 . "-" . "b" x 40 . "x" x 3
+--- cap: (40, 80)
+--- match_id: 1
+
+
+
+=== TEST 16: counts beyond the old limit for bodies matching the empty string
+--- re: (?:a|){600}
+--- s: aa
+--- err
+[error] syntax error at pos 6
+
+
+
+=== TEST 17: counts beyond the old limit for nested loops
+--- re: (?:a{40}){600}
+--- s: aa
+--- err
+[error] syntax error at pos 9
+
+
+
+=== TEST 18: small counts of loops are unrolled
+--- re: (?:a{40}b){3}
+--- s eval: ("a" x 40 . "b") x 2 . "a" x 39 . "b" . ("a" x 40 . "b") x 3
+
+
+
+=== TEST 19: counts beyond the limit
+--- re: a{70000}
+--- s: aa
+--- err
+[error] syntax error at pos 1
+
+
+
+=== TEST 20: too many thread slots for the loop body
+--- re: (?:a{1,30}b){1,60000}
+--- s: ab
+--- fatal
+
+
+
+=== TEST 21: the largest count of a short loop body
+--- re: (a)(?:bc){2,65534}
+--- s: xabcbcbcb
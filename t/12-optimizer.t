@@ -0,0 +1,87 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: jumps out of nested alternations
+--- re: (a|b|c|d)(?:x|(y|z))
+--- s: --dz-
+--- cap: (2, 4) (2, 3) (3, 4)
+--- optimized: 27 -> 27 instructions, 3 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 2: jumps back to the start of a star
+--- re: ((?:ab|c|d)*)e
+--- s: abcdabxabdde
+--- optimized: 19 -> 19 instructions, 6 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 3: classes of a single byte
+--- re: [a][^\x00-`b-\xff]+[\x00-\xff]
+--- s: xaaaab
+--- optimized: 10 -> 10 instructions, 0 jumps threaded, 3 classes simplified
+
+
+
+=== TEST 4: classes of a single byte, caseless
+--- re: [a]B
+--- flags: i
+--- s: xAb
+--- cap: (1, 3)
+
+
+
+=== TEST 5: classes of all the bytes
+--- re: ([^\x00-\x01\x02-\xff]?)([\x00-\xff]{2})
+--- s eval: "x\n\0y"
+--- cap: (0, 2) (0, 0) (0, 2)
+--- optimized: 14 -> 14 instructions, 0 jumps threaded, 3 classes simplified
+
+
+
+=== TEST 6: unreachable jumps after the regexes
+--- re eval: ['a(b|c)', '(d|e|f)g', 'x|y']
+--- s: --fgac
+--- cap: (2, 4) (2, 3)
+--- match_id: 1
+--- optimized: 37 -> 35 instructions, 2 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 7: unreachable jumps in counter loops
+--- re: (?:a{40}|b)c
+--- s eval: "a" x 39 . "bc"
+--- optimized: 12 -> 11 instructions, 1 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 8: threaded jumps in a star of an assertion
+--- re: (c(b)*|\B)*.a
+--- s: xBc
+--- optimized: 21 -> 20 instructions, 3 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 9: threaded jumps in a star of an assertion and lazy loops
+--- re: (c([ab]+?c??)*|\B)*a
+--- s: Bc
+--- optimized: 23 -> 22 instructions, 3 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 10: jumps to the split of a star copied
+--- re: x(?:ab|cd)*y
+--- s: -xabcdaby
+--- optimized: 16 -> 16 instructions, 3 jumps threaded, 0 classes simplified
+
+
+
+=== TEST 11: jumps to a split kept in programs with counter loops
+--- re: (?:(?:ab|cd)*x){2,40}y
+--- s: abxcdabxxy
+--- optimized: 17 -> 17 instructions, 1 jumps threaded, 0 classes simplified
@@ -0,0 +1,51 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: word characters
+--- re: \w+
+--- s: --foo_Bar9--
+
+
+
+=== TEST 2: non-word characters
+--- re: a\W+b
+--- s: a_b a-+ b a@b
+
+
+
+=== TEST 3: classes of several ranges
+--- re: [a-cx-z0-2]+
+--- s: dd9cax0z3
+
+
+
+=== TEST 4: negated classes of several ranges
+--- re: [^a-c\s]+
+--- s: abc dxe	fa
+
+
+
+=== TEST 5: caseless classes
+--- re: [b-dk]+
+--- flags: i
+--- s: aBcDkKe
+--- cap: (1, 6)
+
+
+
+=== TEST 6: horizontal and vertical white space
+--- re: \h+\v\V\H
+--- s eval: "x\t \xa0\x85yz"
+--- cap: (1, 7)
+
+
+
+=== TEST 7: bitmap classes in loops
+--- re: (?:[a-c\d]x){2,40}\s
+--- s eval: "ax" x 10 . "b " . "cx" x 3 . "1x "
+--- cap: (22, 31)
@@ -0,0 +1,51 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: alternations
+--- re: ab(?:c|d+|)e
+--- s: xabddxabdde
+
+
+
+=== TEST 2: alternations, no match
+--- re: ab(?:c|d+|)e
+--- s: xabddxabdcee
+--- no_match
+
+
+
+=== TEST 3: the empty regex
+--- re: (?:a|)
+--- s: bbb
+
+
+
+=== TEST 4: the largest automaton
+--- re: (?:a[bc]d.e[^f]g\w){7}x
+--- s eval: "abd-e-g_" x 7 . "ab" . "acd-e-g_" x 7 . "x"
+
+
+
+=== TEST 5: too many positions
+--- re: (?:a[bc]d.e[^f]g\w){8}x
+--- s eval: "abd-e-g_" x 8 . "ab" . "acd-e-g_" x 8 . "x"
+
+
+
+=== TEST 6: multiple regexes
+--- re eval: ['foo\d+bar', 'b[aeiou]z', 'q+']
+--- s: foo12ba buz
+--- cap: (8, 11)
+--- match_id: 1
+
+
+
+=== TEST 7: literal prefixes and inner literals
+--- re eval: ['[a-z]+@[a-z]+\.com']
+--- s eval: "x\@y. " x 20 . "joe\@bar.com"
+--- cap: (100, 111)
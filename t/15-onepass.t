@@ -0,0 +1,56 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: anchored key-value pairs
+--- re: ^(\w+)=(\d+);
+--- s: timeout=300; retries=3;
+
+
+
+=== TEST 2: anchored key-value pairs, no match
+--- re: ^(\w+)=(\d+);
+--- s: timeout=30x;
+--- no_match
+
+
+
+=== TEST 3: header lines
+--- re: ^([A-Za-z-]+):[ \t]*([^\r\n]*)\r$
+--- s eval: "GET / HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n"
+
+
+
+=== TEST 4: unanchored with a literal lead
+--- re: foo(\d+)(x)?
+--- s: fo foo foo123xfoo4
+
+
+
+=== TEST 5: the unsaved groups of alternations
+--- re: a|(ab)
+--- s: bah
+
+
+
+=== TEST 6: matches ending at the end of the input
+--- re: ^(a+|b)\z
+--- s: aaab
+
+
+
+=== TEST 7: not one-pass
+--- re: ^(\w+)(\d+);
+--- s: ab12;
+
+
+
+=== TEST 8: multiple regexes
+--- re eval: ['^(\d+)-(\d+)', '^(\w+)=']
+--- s: name=12-34
+--- cap: (0, 5) (0, 4)
+--- match_id: 1
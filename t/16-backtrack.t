@@ -0,0 +1,86 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: greedy captures giving back
+--- re: ^(\w+)(\d+);
+--- s: ab12;
+
+
+
+=== TEST 2: unanchored, no match
+--- re: (\w+)@(\w+)\.com
+--- s: user@example.org
+--- no_match
+
+
+
+=== TEST 3: nested quantifiers
+--- re: ((a|ab)(c|bcd))(d*)
+--- s: xabcdd
+
+
+
+=== TEST 4: anchors inside alternations
+--- re: ^(?:(foo)$|(bar)\b)
+--- s eval: "baz\nbar baz"
+
+
+
+=== TEST 5: empty matches
+--- re: (a*)(b?)
+--- s: ccab
+
+
+
+=== TEST 6: look-ahead leading back into the same position
+--- re: \w*a(?:$|())(z*)
+--- s: ba
+
+
+
+=== TEST 7: nested look-ahead assertions
+--- re eval: '\b(?:$|())?$\b*'
+--- s eval: "\n a\nbx1aa"
+--- cap: (3, 3) (3, 3)
+
+
+
+=== TEST 8: multiple regexes
+--- re eval: ['(\d+)-(\d+)', '(\w+)=(\w*)']
+--- s: k=v 1-2
+--- cap: (0, 3) (0, 1) (2, 3)
+--- match_id: 1
+
+
+
+=== TEST 9: subjects too large to backtrack on
+--- re: ^(\w+)(\d+);
+--- s eval: "a" x 20000 . "1;"
+
+
+
+=== TEST 10: called again after a match at eof
+--- re: (\w+)@(\w+)\.com
+--- s: user@example.com
+--- after_eof: match
+
+
+
+=== TEST 11: called again after no match at eof
+--- re: (\w+)@(\w+)\.com
+--- s: user@example.org
+--- no_match
+--- after_eof: error
+
+
+
+=== TEST 12: called again after no match at eof, too large to backtrack on
+--- re: ^(\w+)(\d+);
+--- s eval: "a" x 20000 . "1"
+--- no_match
+--- after_eof: error
@@ -0,0 +1,56 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: overlapping alternatives
+--- re: ((a|ab)(c|bcd))(d*)
+--- s: xabcdd
+
+
+
+=== TEST 2: captures of several threads alive
+--- re: (\w+)@(\w+)\.com|(\d+)
+--- s: mail foo@bar.com or 42
+
+
+
+=== TEST 3: captures of several threads alive, no match
+--- re: (\w+)@(\w+)\.com
+--- s: mail foo@bar.org
+--- no_match
+
+
+
+=== TEST 4: look-ahead assertions
+--- re: (a|ab)(bc|c)$
+--- s eval: "abc\nxabc"
+
+
+
+=== TEST 5: the end of the input
+--- re: (x*)(x)\z
+--- s: axxxb xxx
+
+
+
+=== TEST 6: repeated groups
+--- re: (?:(\d+)-|(\d+)\.)+
+--- s: a 12-3.45-6
+
+
+
+=== TEST 7: literal prefix
+--- re: foo(\w*)bar
+--- s: fo foobar foo12barbar
+
+
+
+=== TEST 8: multiple regexes
+--- re eval: ['(\w+)=(\d+);', '(\w+):']
+--- s: name: a=1;
+--- cap: (0, 5) (0, 4)
+--- match_id: 1
@@ -0,0 +1,56 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: word boundaries
+--- re: \bfoo\w*\b
+--- s eval: "xfoo " x 5000 . "foobar baz"
+
+
+
+=== TEST 2: leftmost-first alternatives
+--- re: abcd\b|c\b|abc\b
+--- s eval: "ab " x 7000 . "abcd"
+
+
+
+=== TEST 3: lazy quantifiers
+--- re: \b(?:a|b).*?b\b
+--- s eval: "x" x 20000 . " a ab b"
+
+
+
+=== TEST 4: line anchors
+--- re: ^\d+\b(?:$|;)
+--- s eval: "a1\n" x 7000 . "42\nb"
+
+
+
+=== TEST 5: no match
+--- re: \bbar\b
+--- s eval: "xbarx " x 4000
+--- no_match
+
+
+
+=== TEST 6: empty matches
+--- re: \b\w*?\b
+--- s eval: "-" x 20000 . "ab"
+
+
+
+=== TEST 7: multiple regexes
+--- re eval: ['\d+\b', '\w+=']
+--- s eval: "-" x 20000 . "k=1 2"
+--- cap: (20000, 20002)
+--- match_id: 1
+
+
+
+=== TEST 8: non-capturing groups
+--- re: (?:a|ab)(?:c|bcd)\b(?:d*)
+--- s eval: "." x 20000 . "abcd"
@@ -0,0 +1,52 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: sparse matches
+--- re: (\w+)@(\w+)\.com\b
+--- s eval: "lorem ipsum dolor x-" x 3000 . " bob\@example.com"
+
+
+
+=== TEST 2: threads living across the skipped bytes
+--- re: (l\w+)y\b
+--- s eval: "lorem ipsum dolor x-" x 3000 . " ala lazy 42"
+
+
+
+=== TEST 3: not word boundaries
+--- re: \B(\w)(\d)\b
+--- s eval: "lorem ipsum dolor x-" x 3000 . " ab3 x-ray"
+
+
+
+=== TEST 4: no match
+--- re: (a|b)*c\b
+--- s eval: "lorem ipsum dolor x-" x 3000
+--- no_match
+
+
+
+=== TEST 5: alternatives
+--- re: (dog|lazy) (\d+)\b
+--- s eval: "the lazy dog jumps " x 3000 . "lazy 42"
+
+
+
+=== TEST 6: multiple regexes
+--- re eval: ['(\d+)\b;', '(\w+)=(\w*)\b']
+--- s eval: "a-b 1 " x 4000 . "k=1; 2;"
+--- cap: (24000, 24003) (24000, 24001) (24002, 24003)
+--- match_id: 1
+
+
+
+=== TEST 7: look-ahead assertions holding on an epsilon loop
+--- re: (\zc*?\W?|[a-cx-z]([ab]+?c??)*|\B)*((.{1,3}c??[ab]?){1,3}a+((x+?)|\B\d{2}\s{2,}))
+--- flags: i
+--- s eval: " 1x0Bcyzx"
+--- no_match
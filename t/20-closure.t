@@ -0,0 +1,43 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: long alternations
+--- re: (?:(a)|(b)|(c)|(d)|(e)|(f)|(g)|(h))+(\d)\b
+--- s eval: "lorem ipsum dolor x-" x 3000 . " xfacebad1 "
+
+
+
+=== TEST 2: ^ after newlines
+--- re: (?:-|^)(\w+)y\b
+--- s eval: "lorem ipsum\ndolor x-" x 3000 . "\nlazy 42"
+
+
+
+=== TEST 3: ^ not after newlines
+--- re: (?:\d|^)(l\w+)\b
+--- s eval: "a lorem ipsum dolor x-" x 1000 . " 5lazy"
+
+
+
+=== TEST 4: nested empty loops
+--- re: ((?:a*|b?)*)*(\d+)\b
+--- s eval: "lorem ipsum dolor x-" x 3000 . " ab 42"
+
+
+
+=== TEST 5: optional groups before a word boundary
+--- re: (x)?(y)?(z)?\b(\w+)\.
+--- s eval: "lorem ipsum dolor x-" x 3000 . " xyzzy."
+
+
+
+=== TEST 6: multiple regexes
+--- re eval: ['(a|b)*(\d+)\b;', '^(\w+)=(\w*)\b']
+--- s eval: "a-b 1 " x 4000 . "\nk=1; 2;"
+--- cap: (24001, 24004) (24001, 24002) (24003, 24004)
+--- match_id: 1
@@ -0,0 +1,38 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: many alternatives
+--- re eval: "(" . join("|", map { "w${_}x" } "aa" .. "hz") . ")\\b"
+--- s eval: "lorem w12 ipsum whzy " x 10 . "whzx wbax"
+
+
+
+=== TEST 2: many alternatives, no match
+--- re eval: "(" . join("|", map { "w${_}x" } "aa" .. "hz") . ")\\b"
+--- s eval: "lorem waax1 ipsum whz " x 10
+--- no_match
+
+
+
+=== TEST 3: look-ahead assertions holding in turn
+--- re: (\w+)\b(\W+)\b(\w)\B(\w*)\b(\W|$)
+--- s: .. aab bab yx
+
+
+
+=== TEST 4: many regexes
+--- re eval: [map { "w${_}x\\b" } 1 .. 500]
+--- s eval: "lorem w12 ipsum w499 " x 10 . "w498x w7x"
+--- cap: (210, 215)
+--- match_id: 497
+
+
+
+=== TEST 5: assertions holding more threads than the ones run
+--- re: ((\b\b\w??){1,40}[a-cx-z]{2})+?[a-cx-z]|[a-c]*
+--- s: bcbByzBcc
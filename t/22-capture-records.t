@@ -0,0 +1,50 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: rules of many groups
+--- re eval: "(?:" . join("|", map { join(" ", ("(\\w+)=(\\w+)") x 5) . " (r$_)\\b" } 1 .. 4) . ")"
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r3 k=v"
+
+
+
+=== TEST 2: rules of many groups, no match
+--- re eval: "(?:" . join("|", map { join(" ", ("(\\w+)=(\\w+)") x 5) . " (r$_)\\b" } 1 .. 4) . ")"
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r5"
+--- no_match
+
+
+
+=== TEST 3: groups saved again and again in loops
+--- re: (?:(a)|(b)|(c)|(d)|(e)|(f)|(g)|(h)|(i)|(j)|(k)|(l))+(x)
+--- s: abcdefghijklabcabcdefghiabcdefghijklkjihgfedcbax
+
+
+
+=== TEST 4: more saves than groups on shared captures
+--- re: ((a)|(ab))((c)|(bc))((d)|(cd))((e)|(de))((f)|(ef))(g)
+--- s: abcdefg
+
+
+
+=== TEST 5: many regexes of many groups
+--- re eval: [map { join(" ", ("(\\w+)=(\\w+)") x 3) . " (r$_)\\b" } 1 .. 8]
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r7 k=v"
+--- cap: (278, 304) (278, 281) (282, 285) (286, 289) (290, 293) (294, 297) (298, 301) (302, 304)
+--- match_id: 6
+
+
+
+=== TEST 6: records of lazy loops in a star of an assertion
+--- re: (c([ab]+?c??)*|\B)*a
+--- s: Bc
+
+
+
+=== TEST 7: records of lazy loops in a star of an assertion, matched
+--- re: (c([ab]+?c??)*|\B)*a
+--- s: xBcabcca
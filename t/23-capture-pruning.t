@@ -0,0 +1,73 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: $& only
+--- re: (\w+)=(\w+)\s+(\w+)=(\w+)
+--- s: foo = k1=v1  k2=v2 k3=v3
+--- captures: 0
+
+
+
+=== TEST 2: the first group only
+--- re: (a+)(b+)(c+)
+--- s: xaabbbcd
+--- captures: 1
+
+
+
+=== TEST 3: more captures wanted than groups
+--- re: (a+)(b+)
+--- s: xaabbbcd
+--- captures: 5
+
+
+
+=== TEST 4: groups dropped in loops
+--- re: (?:(a)|(b)|(c))+(d)
+--- s: xabcabdd
+--- captures: 1
+
+
+
+=== TEST 5: groups dropped in counted loops
+--- re: (a|(b)){2,3}(c)(d)?
+--- s: ababcd
+--- captures: 1
+
+
+
+=== TEST 6: groups dropped around assertions
+--- re: ^(\w+)(\s)\b(\w+)$
+--- s eval: "ab\ncd ef\n"
+--- captures: 0
+
+
+
+=== TEST 7: $& only, no match
+--- re: (\w+)=(\w+)\s+(\w+)=(\w+)
+--- s: foo = k1= v1
+--- captures: 0
+--- no_match
+
+
+
+=== TEST 8: many regexes, $& only
+--- re eval: [map { join(" ", ("(\\w+)=(\\w+)") x 3) . " (r$_)\\b" } 1 .. 8]
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r7 k=v"
+--- captures: 0
+--- cap: (278, 304)
+--- match_id: 6
+
+
+
+=== TEST 9: many regexes, the first groups only
+--- re eval: [map { join(" ", ("(\\w+)=(\\w+)") x 3) . " (r$_)\\b" } 1 .. 8]
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r7 k=v"
+--- captures: 2
+--- cap: (278, 304) (278, 281) (282, 285)
+--- match_id: 6
@@ -0,0 +1,122 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use t::SRegex 'no_plan';
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: captures
+--- re: b(a)r
+--- s: xxbar
+--- reload
+
+
+
+=== TEST 2: literal prefix
+--- re: foo\d+
+--- s: xxfoo12foo3
+--- reload
+
+
+
+=== TEST 3: inner literal
+--- re: \w+@example\.com
+--- s: mail to joe@example.com now
+--- reload
+
+
+
+=== TEST 4: leading bytes
+--- re: [xy]z+|q\d
+--- s: aaaaq1xzz
+--- reload
+
+
+
+=== TEST 5: counted repetition
+--- re: (a|b){2,4}c{3}
+--- s: xxababbccc
+--- reload
+
+
+
+=== TEST 6: classes and bitmaps
+--- re: [a-fA-F0-9_.:;]+[^\s\d]
+--- s: --09Ab.:z
+--- reload
+
+
+
+=== TEST 7: assertions
+--- re: ^c\w+$|\Ax\b
+--- s eval: "ab\ncdx\n"
+--- reload
+
+
+
+=== TEST 8: no match
+--- re: foo(bar|baz)
+--- s: foobax
+--- reload
+--- no_match
+
+
+
+=== TEST 9: captures wanted
+--- re: (a+)(b+)(c+)
+--- s: xaabbbcd
+--- captures: 1
+--- reload
+
+
+
+=== TEST 10: regexes with literal prefixes
+--- re eval: ['foo\d', 'bar']
+--- s: xxxxbarfoo1
+--- cap: (4, 7)
+--- match_id: 1
+--- reload
+
+
+
+=== TEST 11: caseless prefixes
+--- re eval: ['abc', 'ABD', 'abd']
+--- s: ABcAbDabd
+--- flags eval: "  i"
+--- cap: (3, 6)
+--- match_id: 2
+--- reload
+
+
+
+=== TEST 12: many regexes with one always started
+--- re eval: [(map { "k${_}=" } 1 .. 40), '\d\d\d']
+--- s: xk7k39=1
+--- cap: (3, 7)
+--- match_id: 38
+--- reload
+
+
+
+=== TEST 13: many regexes of many groups
+--- re eval: [map { join(" ", ("(\\w+)=(\\w+)") x 3) . " (r$_)\\b" } 1 .. 8]
+--- s eval: join(" ", map { "k$_=v$_" } 1 .. 40) . " r7 k=v"
+--- cap: (278, 304) (278, 281) (282, 285) (286, 289) (290, 293) (294, 297) (298, 301) (302, 304)
+--- match_id: 6
+--- reload
+
+
+
+=== TEST 14: many regexes, no match
+--- re eval: [map { "r${_}z" } 1 .. 40]
+--- s: r41z r4 z
+--- reload
+--- no_match
+
+
+
+=== TEST 15: shared class bitmaps
+--- re: \w+\s\S\h*\V[a-cx-z]+\W
+--- s eval: "--ab_1\tq \tzbx.;"
+--- reload
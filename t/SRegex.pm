@@ -18,6 +18,7 @@ our @EXPORT = qw( run_tests );
 
 our $UseValgrind = $ENV{TEST_SREGEX_USE_VALGRIND};
 our $ForceMultiRegexes = $ENV{TEST_SREGEX_FORCE_MULTI_REGEXES};
+our $Reload = $ENV{TEST_SREGEX_RELOAD};
 
 sub run_tests {
     for my $block (blocks()) {
@@ -60,6 +61,18 @@ sub run_test ($) {
         $prefix = "";
     }
 
+    if (defined $block->threads) {
+        push @opts, "--threads", $block->threads;
+    }
+
+    if (defined $block->captures) {
+        push @opts, "--captures", $block->captures;
+    }
+
+    if ($Reload || defined $block->reload) {
+        push @opts, "--reload";
+    }
+
     if (ref $re) {
         push @opts, "-n", scalar @$re;
 
@@ -134,9 +147,52 @@ sub run_test ($) {
             my ($thompson_match, $jitted_thompson_match, $splitted_jitted_thompson_match,
                 $splitted_thompson_match, $pike_match, $pike_cap,
                 $splitted_pike_match, $splitted_pike_cap, $splitted_pike_temp_cap,
-                $pike_re_id, $splitted_pike_re_id)
+                $pike_re_id, $splitted_pike_re_id, $dfa_match,
+                $splitted_dfa_match, $full_dfa_match, $splitted_full_dfa_match,
+                $pike_res, $splitted_pike_res, $jitted_pike_res,
+                $splitted_jitted_pike_res, $set_res, $splitted_set_res)
                 = parse_res($res);
 
+            if (defined $block->threads) {
+                like($res, qr/^threads: ok$/m,
+                     "$name - all threads agree with the single-threaded run");
+            }
+
+            if (defined $block->optimized && !$ForceMultiRegexes) {
+                my ($optimized) = ($res =~ /^optimized: (.+)$/m);
+                is($optimized, $block->optimized,
+                   "$name - optimizer counts ok");
+            }
+
+            if (defined $block->after_eof) {
+                my ($after_eof) = ($res =~ /^pike after eof (.+)$/m);
+                is($after_eof, $block->after_eof,
+                   "$name - pike vm called again after eof");
+            }
+
+            is(defined $set_res && $set_res ne 'no match' ? 1 : 0,
+               $thompson_match ? 1 : 0,
+               "$name - set agrees with thompson vm");
+            is(defined $splitted_set_res && $splitted_set_res ne 'no match'
+               ? 1 : 0, $splitted_thompson_match ? 1 : 0,
+               "$name - splitted set agrees with splitted thompson vm");
+
+            if (defined $block->match_set) {
+                is $set_res, $block->match_set, "$name - set ok";
+                is $splitted_set_res, $block->match_set,
+                   "$name - splitted set ok";
+            }
+
+            SKIP: {
+                skip "Pike JIT disabled", 2
+                    if defined $jitted_pike_res && $jitted_pike_res eq 'disabled';
+
+                is($jitted_pike_res, $pike_res,
+                   "$name - jitted pike vm agrees with pike vm");
+                is($splitted_jitted_pike_res, $splitted_pike_res,
+                   "$name - splitted jitted pike vm agrees with splitted pike vm");
+            }
+
             if ($ENV{TEST_SREGEX_VERBOSE}) {
                 my $cap = $pike_cap;
                 if (!defined $cap) {
@@ -199,12 +255,28 @@ sub run_test ($) {
 
                 if (defined $block->no_match) {
                     ok(!$splitted_thompson_match, "$name - splitted thompson vm should not match");
+                    ok(!$dfa_match, "$name - dfa should not match");
+                    ok(!$splitted_dfa_match, "$name - splitted dfa should not match");
                     ok(!$pike_match, "$name - pike vm should not match");
                 } else {
                     ok($splitted_thompson_match, "$name - splitted thompson vm should match");
+                    ok($dfa_match, "$name - dfa should match");
+                    ok($splitted_dfa_match, "$name - splitted dfa should match");
                     ok($pike_match, "$name - pike vm should match");
                 }
 
+                SKIP: {
+                    skip "Full DFA disabled", 2 if $full_dfa_match == -1;
+                    if (defined $block->no_match) {
+                        ok(!$full_dfa_match, "$name - full dfa should not match");
+                        ok(!$splitted_full_dfa_match, "$name - splitted full dfa should not match");
+
+                    } else {
+                        ok($full_dfa_match, "$name - full dfa should match");
+                        ok($splitted_full_dfa_match, "$name - splitted full dfa should match");
+                    }
+                }
+
                 if (defined $block->match_id) {
                     is $pike_re_id, $block->match_id, "$name - pike match id ok";
                 }
@@ -242,6 +314,12 @@ sub run_test ($) {
             } elsif ($s =~ m/$prefix$re/sm) {
                 my $expected_cap = fmt_cap(\@-, \@+);
 
+                if (defined $block->captures) {
+                    my @caps = ($expected_cap =~ /\(-?\d+, -?\d+\)/g);
+                    splice @caps, $block->captures + 1;
+                    $expected_cap = join " ", @caps;
+                }
+
                 #warn "regex: $prefix$re";
 
                 ok($thompson_match, "$name - thompson vm should match");
@@ -258,6 +336,15 @@ sub run_test ($) {
 
                 ok($splitted_thompson_match, "$name - splitted thompson vm should match");
 
+                ok($dfa_match, "$name - dfa should match");
+                ok($splitted_dfa_match, "$name - splitted dfa should match");
+
+                SKIP: {
+                    skip "Full DFA disabled", 2 if $full_dfa_match == -1;
+                    ok($full_dfa_match, "$name - full dfa should match");
+                    ok($splitted_full_dfa_match, "$name - splitted full dfa should match");
+                }
+
                 ok($pike_match, "$name - pike vm should match");
                 is($pike_cap, $expected_cap, "$name - pike vm capture ok");
 
@@ -282,6 +369,15 @@ sub run_test ($) {
                 }
 
                 ok(!$splitted_thompson_match, "$name - splitted thompson vm should not match");
+                ok(!$dfa_match, "$name - dfa should not match");
+                ok(!$splitted_dfa_match, "$name - splitted dfa should not match");
+
+                SKIP: {
+                    skip "Full DFA disabled", 2 if $full_dfa_match == -1;
+                    ok(!$full_dfa_match, "$name - full dfa should not match");
+                    ok(!$splitted_full_dfa_match, "$name - splitted full dfa should not match");
+                }
+
                 ok(!$pike_match, "$name - pike vm should not match");
                 ok(!$splitted_pike_match, "$name - splitted pike vm should not match");
             }
@@ -297,7 +393,10 @@ sub parse_res ($) {
     my ($thompson_match, $jitted_thompson_match, $splitted_jitted_thompson_match,
         $splitted_thompson_match, $pike_match, $pike_cap,
         $splitted_pike_match, $splitted_pike_cap, $splitted_pike_temp_cap,
-        $pike_re_id, $splitted_pike_re_id);
+        $pike_re_id, $splitted_pike_re_id, $dfa_match, $splitted_dfa_match,
+        $full_dfa_match, $splitted_full_dfa_match, $pike_res,
+        $splitted_pike_res, $jitted_pike_res, $splitted_jitted_pike_res,
+        $set_res, $splitted_set_res);
 
     while (<$in>) {
         if (/^thompson (.+)/) {
@@ -382,6 +481,120 @@ sub parse_res ($) {
                 $splitted_thompson_match = 0;
             }
 
+        } elsif (/^set (.+)/) {
+            if (defined $set_res) {
+                warn "duplicate set result: $_";
+                next;
+            }
+
+            $set_res = $1;
+
+        } elsif (/^splitted set (.+)/) {
+            if (defined $splitted_set_res) {
+                warn "duplicate splitted set result: $_";
+                next;
+            }
+
+            $splitted_set_res = $1;
+
+        } elsif (/^dfa (.+)/) {
+            my $res = $1;
+
+            if (defined $dfa_match) {
+                warn "duplicate dfa result: $_";
+                next;
+            }
+
+            if ($res eq 'match') {
+                $dfa_match = 1;
+
+            } elsif ($res eq 'no match') {
+                $dfa_match = 0;
+
+            } else {
+                warn "unknown dfa result: $res\n";
+                $dfa_match = 0;
+            }
+
+        } elsif (/^splitted dfa (.+)/) {
+            my $res = $1;
+
+            if (defined $splitted_dfa_match) {
+                warn "duplicate splitted dfa result: $_";
+                next;
+            }
+
+            if ($res eq 'match') {
+                $splitted_dfa_match = 1;
+
+            } elsif ($res eq 'no match') {
+                $splitted_dfa_match = 0;
+
+            } else {
+                warn "unknown splitted dfa result: $res\n";
+                $splitted_dfa_match = 0;
+            }
+
+        } elsif (/^full dfa (.+)/) {
+            my $res = $1;
+
+            if (defined $full_dfa_match) {
+                warn "duplicate full dfa result: $_";
+                next;
+            }
+
+            if ($res eq 'match') {
+                $full_dfa_match = 1;
+
+            } elsif ($res eq 'no match') {
+                $full_dfa_match = 0;
+
+            } elsif ($res eq 'disabled') {
+                $full_dfa_match = -1;
+
+            } else {
+                warn "unknown full dfa result: $res\n";
+                $full_dfa_match = 0;
+            }
+
+        } elsif (/^splitted full dfa (.+)/) {
+            my $res = $1;
+
+            if (defined $splitted_full_dfa_match) {
+                warn "duplicate splitted full dfa result: $_";
+                next;
+            }
+
+            if ($res eq 'match') {
+                $splitted_full_dfa_match = 1;
+
+            } elsif ($res eq 'no match') {
+                $splitted_full_dfa_match = 0;
+
+            } elsif ($res eq 'disabled') {
+                $splitted_full_dfa_match = -1;
+
+            } else {
+                warn "unknown splitted full dfa result: $res\n";
+                $splitted_full_dfa_match = 0;
+            }
+
+        } elsif (/^jitted pike (.+)/) {
+            if (defined $jitted_pike_res) {
+                warn "duplicate jitted pike result: $_";
+                next;
+            }
+
+            $jitted_pike_res = $1;
+
+        } elsif (/^splitted jitted pike (.+)/) {
+            if (defined $splitted_jitted_pike_res) {
+                warn "duplicate splitted jitted pike result: $_";
+                next;
+            }
+
+            $splitted_jitted_pike_res = $1;
+
         } elsif (/^pike (.+)/) {
             my $res = $1;
 
@@ -390,6 +603,8 @@ sub parse_res ($) {
                 next;
             }
 
+            $pike_res = $res;
+
             if ($res eq 'no match') {
                 $pike_match = 0;
 
@@ -407,6 +622,10 @@ sub parse_res ($) {
         } elsif (/^splitted pike (.+)/) {
             my $res = $1;
 
+            if (!defined $splitted_pike_res) {
+                $splitted_pike_res = $res;
+            }
+
             if ($res =~ s/^(?:\s*\[(?:\(-?\d+, -?\d+\))+\](?:\(-?\d+, -?\d+\))?)+\s*//) {
                 $splitted_pike_temp_cap = $&;
                 $splitted_pike_temp_cap =~ s/^\s+|\s+$//g;
@@ -437,7 +656,10 @@ sub parse_res ($) {
     return ($thompson_match, $jitted_thompson_match, $splitted_jitted_thompson_match,
         $splitted_thompson_match, $pike_match, $pike_cap,
         $splitted_pike_match, $splitted_pike_cap, $splitted_pike_temp_cap,
-        $pike_re_id, $splitted_pike_re_id);
+        $pike_re_id, $splitted_pike_re_id, $dfa_match, $splitted_dfa_match,
+        $full_dfa_match, $splitted_full_dfa_match, $pike_res,
+        $splitted_pike_res, $jitted_pike_res, $splitted_jitted_pike_res,
+        $set_res, $splitted_set_res);
 }
 
 